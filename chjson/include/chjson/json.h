@@ -23,7 +23,7 @@ typedef struct _json_t {
 
     union {
         // Map: string_t * -> json_t *
-        hash_map_t *object_ptr;
+        map_t *object_ptr;
         // List: json_t *
         list_t *list_ptr;
         string_t *string_ptr;
@@ -96,7 +96,7 @@ static inline json_type_t json_type(json_t *json) {
 // They will return NULL if the given json object is not the
 // correct type.
 
-hash_map_t *json_as_object(json_t *json);
+map_t *json_as_object(json_t *json);
 list_t *json_as_list(json_t *json);
 string_t *json_as_string(json_t *json);
 double *json_as_number(json_t *json);
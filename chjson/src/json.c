@@ -2,6 +2,7 @@
 #include "chjson/json.h"
 #include "chsys/mem.h"
 #include "chutil/map.h"
+#include "chutil/flat_map.h"
 #include "chutil/string.h"
 #include <stdarg.h>
 #include <stdio.h>
@@ -12,20 +13,21 @@ static json_t _NULL_JSON = {
 static json_t *NULL_JSON = &_NULL_JSON;
 
 json_t *new_json_object(void) {
-    hash_map_t *hm = new_hash_map(sizeof(string_t *), sizeof(json_t *),
+    // Most JSON objects only have a handful of keys.
+    map_t *m = new_map(FLAT_MAP_IMPL, sizeof(string_t *), sizeof(json_t *),
            (hash_map_hash_ft)s_indirect_hash, (hash_map_key_eq_ft)s_indirect_equals);
 
     json_t *json = safe_malloc(sizeof(json_t));
 
     json->type = CHJSON_OBJECT;
-    json->object_ptr = hm;
+    json->object_ptr = m;
 
     return json;
 }
 
 json_t *_new_json_object_from_kvps(int dummy, ...) {
     json_t *json = new_json_object();
-    hash_map_t *hm = json->object_ptr;
+    map_t *m = json->object_ptr;
 
     va_list arg_ptr;
     va_start(arg_ptr, dummy);
@@ -41,7 +43,7 @@ json_t *_new_json_object_from_kvps(int dummy, ...) {
             break;
         }
 
-        hm_put(hm, &key, &val);
+        m_put(m, &key, &val);
     }
 
     va_end(arg_ptr);
@@ -50,7 +52,8 @@ json_t *_new_json_object_from_kvps(int dummy, ...) {
 }
 
 json_t *new_json_list(void) {
-    list_t *l = new_list(ARRAY_LIST_IMPL, sizeof(json_t *));
+    // Most JSON arrays only hold a handful of elements.
+    list_t *l = new_list(SMALL_LIST_IMPL, sizeof(json_t *));
 
     json_t *json = safe_malloc(sizeof(json_t));
     json->type = CHJSON_LIST;
@@ -110,33 +113,35 @@ json_t *json_null(void) {
 }
 
 void delete_json(json_t *json) {
-    hash_map_t *hm;
+    map_t *m;
     list_t *l;
     string_t *s;
     
     key_val_pair_t kvp;
+    map_iter_t m_iter;
+    list_iter_t l_iter;
 
     string_t **key_ptr;
     json_t **val_ptr;
 
     switch (json->type) {
     case CHJSON_OBJECT:
-        hm = json_as_object(json);
-        hm_reset_iterator(hm);
-        while ((kvp = hm_next_kvp(hm)) != HASH_MAP_EXHAUSTED) {
-            key_ptr = (string_t **)kvp_key(hm, kvp);
-            val_ptr = (json_t **)kvp_val(hm, kvp);
+        m = json_as_object(json);
+        m_iter_begin(m, &m_iter);
+        while ((kvp = m_iter_next(&m_iter)) != HASH_MAP_EXHAUSTED) {
+            key_ptr = (string_t **)m_kvp_key(m, kvp);
+            val_ptr = (json_t **)m_kvp_val(m, kvp);
 
             delete_string(*key_ptr);
             delete_json(*val_ptr);
         }
-        delete_hash_map(hm);
+        delete_map(m);
         break;
 
     case CHJSON_LIST:
         l = json_as_list(json);
-        l_reset_iterator(l);
-        while ((val_ptr = (json_t **)l_next(l))) {
+        l_iter_begin(l, &l_iter);
+        while ((val_ptr = (json_t **)l_iter_next(&l_iter))) {
             delete_json(*val_ptr);
         }
         delete_list(l);
@@ -158,7 +163,7 @@ void delete_json(json_t *json) {
     safe_free(json);
 }
 
-hash_map_t *json_as_object(json_t *json) {
+map_t *json_as_object(json_t *json) {
     if (json->type == CHJSON_OBJECT) {
         return json->object_ptr;
     }
@@ -76,14 +76,14 @@ static stream_state_t escape_string_to_stream(const char *cstr, out_stream_t *os
 // If spaced is false, tabs is ignored.
 static stream_state_t json_to_stream_helper(json_t *json, out_stream_t *os, 
         bool spaced, size_t tabs) {
-    hash_map_t *hm;
+    map_t *m;
     list_t *l;
     bool first;
     char num_buf[CHJSON_NUMBER_MAX_STR_WIDTH];
 
     switch (json->type) {
     case CHJSON_OBJECT: 
-        hm = json->object_ptr;
+        m = json->object_ptr;
 
         OS_PUTC(os, '{');
     
@@ -91,10 +91,11 @@ static stream_state_t json_to_stream_helper(json_t *json, out_stream_t *os,
         first = true;
 
         key_val_pair_t kvp;
-        hm_reset_iterator(hm);
-        while ((kvp = hm_next_kvp(hm)) != HASH_MAP_EXHAUSTED) {
-            string_t *key = *(string_t **)kvp_key(hm, kvp);
-            json_t *val = *(json_t **)kvp_val(hm, kvp);
+        map_iter_t m_iter;
+        m_iter_begin(m, &m_iter);
+        while ((kvp = m_iter_next(&m_iter)) != HASH_MAP_EXHAUSTED) {
+            string_t *key = *(string_t **)m_kvp_key(m, kvp);
+            json_t *val = *(json_t **)m_kvp_val(m, kvp);
 
             if (!first) {
                 OS_PUTC(os, ',');
@@ -134,8 +135,9 @@ static stream_state_t json_to_stream_helper(json_t *json, out_stream_t *os,
 
         first = true;
         json_t **ele_ptr;
-        l_reset_iterator(l);
-        while ((ele_ptr = l_next(l))) {
+        list_iter_t l_iter;
+        l_iter_begin(l, &l_iter);
+        while ((ele_ptr = l_iter_next(&l_iter))) {
             if (!first) {
                 OS_PUTC(os, ',');
             } else {
@@ -206,7 +208,7 @@ bool json_equals(json_t *json1, json_t *json2) {
 
     switch (json1->type) {
     case CHJSON_OBJECT:
-        return hm_equals(json1->object_ptr, json2->object_ptr, 
+        return m_equals(json1->object_ptr, json2->object_ptr, 
                 (hash_map_val_eq_ft)json_indirect_equals);
     case CHJSON_LIST:
         return l_equals(json1->list_ptr, json2->list_ptr, 
@@ -241,9 +243,9 @@ json_t *json_lookup_key(json_t *json, string_t *key) {
     }
 
     json_t **val_ptr;
-    hash_map_t *hm = json->object_ptr;
+    map_t *m = json->object_ptr;
 
-    val_ptr = hm_get(hm, &key);
+    val_ptr = m_get(m, &key);
     if (!val_ptr) {
         return NULL;
     }
@@ -79,9 +79,9 @@ static parser_state_t _json_list_from_stream_no_trim(in_stream_t *is, list_t *l)
 static parser_state_t json_list_from_stream_no_trim(in_stream_t *is, json_t **dest);
 
 static parser_state_t _json_kvp_from_stream_no_trim(in_stream_t *is, string_t *k_builder, json_t **v_dest);
-static parser_state_t json_kvp_from_stream_no_trim(in_stream_t *is, hash_map_t *hm);
+static parser_state_t json_kvp_from_stream_no_trim(in_stream_t *is, map_t *m);
 
-static parser_state_t _json_object_from_stream_no_trim(in_stream_t *is, hash_map_t *hm);
+static parser_state_t _json_object_from_stream_no_trim(in_stream_t *is, map_t *m);
 static parser_state_t json_object_from_stream_no_trim(in_stream_t *is, json_t **dest);
 
 static parser_state_t json_from_in_stream_no_trim(in_stream_t *is, json_t **dest);
@@ -419,7 +419,7 @@ static parser_state_t _json_kvp_from_stream_no_trim(in_stream_t *is, string_t *k
     return PARSER_SUCCESS;
 }
 
-static parser_state_t json_kvp_from_stream_no_trim(in_stream_t *is, hash_map_t *hm) {
+static parser_state_t json_kvp_from_stream_no_trim(in_stream_t *is, map_t *m) {
     string_t *k_builder = new_string();
     json_t *v_json = NULL;
 
@@ -432,11 +432,11 @@ static parser_state_t json_kvp_from_stream_no_trim(in_stream_t *is, hash_map_t *
         return ps;
     }
 
-    hm_put(hm, &k_builder, &v_json);
+    m_put(m, &k_builder, &v_json);
     return PARSER_SUCCESS;
 }
 
-static parser_state_t _json_object_from_stream_no_trim(in_stream_t *is, hash_map_t *hm) {
+static parser_state_t _json_object_from_stream_no_trim(in_stream_t *is, map_t *m) {
     parser_state_t ps;
     stream_state_t ss;
     char c;
@@ -454,7 +454,7 @@ static parser_state_t _json_object_from_stream_no_trim(in_stream_t *is, hash_map
         return PARSER_SUCCESS;
     }
 
-    ps = json_kvp_from_stream_no_trim(is, hm);
+    ps = json_kvp_from_stream_no_trim(is, m);
     ASSERT_VALID_PARSE(ps);
 
     while (true) {
@@ -472,7 +472,7 @@ static parser_state_t _json_object_from_stream_no_trim(in_stream_t *is, hash_map
         }
 
         TRIM_WS(is);
-        ps = json_kvp_from_stream_no_trim(is, hm);
+        ps = json_kvp_from_stream_no_trim(is, m);
         ASSERT_VALID_PARSE(ps);
     }
 }
@@ -0,0 +1,127 @@
+
+#ifndef CHUTIL_ART_H
+#define CHUTIL_ART_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chutil/string.h"
+
+// Adaptive Radix Tree, a map from byte strings to fixed size values.
+//
+// Each level of the tree looks at one byte of the key. Inner nodes come
+// in 4 sizes (4, 16, 48 and 256 children) and are swapped for bigger or
+// smaller ones as children come and go, so sparse levels stay small.
+// Chains of nodes with a single child are collapsed into a prefix stored
+// in the node below. (Path compression)
+//
+// A lookup only looks at as many key bytes as it takes to reach a leaf,
+// then compares the full key once. No hashing at all. Keys can be any
+// bytes, and one key can be a prefix of another.
+//
+// Iteration visits keys in lexicographic byte order. (Shorter first when
+// one key is a prefix of another)
+
+// Bytes of prefix stored directly in a node. Longer prefixes are still
+// fine, the rest of the bytes are read from a leaf below when needed.
+#define ART_MAX_PREFIX 10
+
+typedef enum _art_node_type_t {
+    ART_LEAF = 0,
+    ART_NODE4,
+    ART_NODE16,
+    ART_NODE48,
+    ART_NODE256,
+} art_node_type_t;
+
+// Every node (and leaf) starts with its type. Children are stored as
+// art_node_t pointers, even when they are really leaves.
+typedef struct _art_node_t {
+    uint8_t type;
+    uint16_t num_children;
+
+    // Length of the compressed path, only the first ART_MAX_PREFIX
+    // bytes of it are stored.
+    uint32_t prefix_len;
+    uint8_t prefix[ART_MAX_PREFIX];
+
+    // The leaf of the key which ends exactly at this node, if any.
+    struct _art_leaf_t *leaf;
+} art_node_t;
+
+typedef struct _art_leaf_t {
+    uint8_t type;
+    size_t key_len;
+
+    // Value then key follow.
+} art_leaf_t;
+
+typedef struct _art_t {
+    size_t value_size;
+    size_t num_keys;
+
+    art_node_t *root;
+} art_t;
+
+art_t *new_art(size_t vs);
+void delete_art(art_t *art);
+
+static inline size_t art_num_keys(art_t *art) {
+    return art->num_keys;
+}
+
+static inline size_t art_value_size(art_t *art) {
+    return art->value_size;
+}
+
+// value can be NULL when vs is 0.
+void art_put(art_t *art, const void *key, size_t len, const void *value);
+
+// Returns NULL if key isn't in the tree.
+// The returned pointer is good until key is removed.
+void *art_get(art_t *art, const void *key, size_t len);
+
+bool art_remove(art_t *art, const void *key, size_t len);
+
+static inline bool art_get_copy(art_t *art, const void *key, size_t len, void *dest) {
+    void *val = art_get(art, key, len);
+    if (!val) {
+        return false;
+    }
+
+    memcpy(dest, val, art->value_size);
+    return true;
+}
+
+static inline bool art_contains(art_t *art, const void *key, size_t len) {
+    return art_get(art, key, len) != NULL;
+}
+
+// string_t versions, the tree never holds onto the string itself.
+
+static inline void art_put_s(art_t *art, const string_t *s, const void *value) {
+    art_put(art, s_get_cstr(s), s_len(s), value);
+}
+
+static inline void *art_get_s(art_t *art, const string_t *s) {
+    return art_get(art, s_get_cstr(s), s_len(s));
+}
+
+static inline bool art_remove_s(art_t *art, const string_t *s) {
+    return art_remove(art, s_get_cstr(s), s_len(s));
+}
+
+// Return false to stop iterating early.
+// DO NOT modify the tree from inside a visit.
+typedef bool (*art_visit_ft)(const void *key, size_t len, void *value, void *ctx);
+
+// Visits every pair, in key order.
+void art_for_each(art_t *art, art_visit_ft visit, void *ctx);
+
+// Visits every pair whose key starts with prefix, in key order.
+void art_prefix_for_each(art_t *art, const void *prefix, size_t len,
+        art_visit_ft visit, void *ctx);
+
+#endif
@@ -0,0 +1,124 @@
+
+#ifndef CHUTIL_BITSET_H
+#define CHUTIL_BITSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// A growable vector of bits, packed 64 to a word.
+//
+// Good for sets of small dense integer ids, a bitset uses 1 bit per id
+// where a list of bools uses 8 and a hash map set uses far more.
+//
+// Every bit at or past len is always 0, this way whole word operations
+// never need to worry about the tail of the last word.
+
+#define BITSET_WORD_BITS 64
+
+// Returned by the iterator when there are no more set bits.
+#define BITSET_EXHAUSTED SIZE_MAX
+
+typedef struct _bitset_t {
+    // Number of bits in the set.
+    size_t len;
+
+    // Number of words allocated.
+    size_t words_cap;
+    uint64_t *words;
+} bitset_t;
+
+// All len bits start cleared.
+bitset_t *new_bitset(size_t len);
+void delete_bitset(bitset_t *bs);
+
+static inline size_t bs_len(const bitset_t *bs) {
+    return bs->len;
+}
+
+// Number of words which hold the bits [0, len).
+static inline size_t bs_num_words(const bitset_t *bs) {
+    return (bs->len + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+// Growing adds cleared bits, shrinking throws away bits at the end.
+void bs_resize(bitset_t *bs, size_t len);
+
+// Out of bounds bits are just 0.
+static inline bool bs_test(const bitset_t *bs, size_t i) {
+    if (i >= bs->len) {
+        return false;
+    }
+
+    return (bs->words[i / BITSET_WORD_BITS] >> (i % BITSET_WORD_BITS)) & 1;
+}
+
+// The set grows to fit i if needed.
+static inline void bs_set(bitset_t *bs, size_t i) {
+    if (i >= bs->len) {
+        bs_resize(bs, i + 1);
+    }
+
+    bs->words[i / BITSET_WORD_BITS] |= (uint64_t)1 << (i % BITSET_WORD_BITS);
+}
+
+// Does nothing if i is out of bounds.
+static inline void bs_clear(bitset_t *bs, size_t i) {
+    if (i < bs->len) {
+        bs->words[i / BITSET_WORD_BITS] &= ~((uint64_t)1 << (i % BITSET_WORD_BITS));
+    }
+}
+
+static inline void bs_assign(bitset_t *bs, size_t i, bool val) {
+    if (val) {
+        bs_set(bs, i);
+    } else {
+        bs_clear(bs, i);
+    }
+}
+
+// Clears every bit, len stays the same.
+void bs_clear_all(bitset_t *bs);
+
+// Number of set bits.
+size_t bs_popcount(const bitset_t *bs);
+
+// Number of set bits in [0, i).
+size_t bs_rank(const bitset_t *bs, size_t i);
+
+// Finds the index of the kth set bit (starting from k = 0).
+// Returns false if there are k or fewer set bits.
+bool bs_select(const bitset_t *bs, size_t k, size_t *ind);
+
+// Two sets are equal if they have the same length and the same bits.
+bool bs_equals(const bitset_t *bs1, const bitset_t *bs2);
+
+// Whole set operations, the result is always written to dest.
+//
+// or and xor grow dest to the length of src if needed.
+// and and andnot never change the length of dest.
+// (Bits of dest past the length of src are cleared by and, kept by andnot)
+
+void bs_or(bitset_t *dest, const bitset_t *src);
+void bs_and(bitset_t *dest, const bitset_t *src);
+void bs_xor(bitset_t *dest, const bitset_t *src);
+
+// dest = dest & ~src
+void bs_andnot(bitset_t *dest, const bitset_t *src);
+
+// Iterates over the indices of set bits in increasing order.
+// Don't modify the set while iterating.
+typedef struct _bs_iter_t {
+    const bitset_t *bs;
+    size_t word_ind;
+
+    // What's left of the current word.
+    uint64_t word;
+} bs_iter_t;
+
+void bs_iter_begin(const bitset_t *bs, bs_iter_t *iter);
+
+// This will return BITSET_EXHAUSTED when done.
+size_t bs_iter_next(bs_iter_t *iter);
+
+#endif
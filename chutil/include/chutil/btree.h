@@ -0,0 +1,152 @@
+
+#ifndef CHUTIL_BTREE_H
+#define CHUTIL_BTREE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chutil/sort.h"
+
+// Ordered map, implemented as a B+ tree.
+//
+// Keys are kept sorted with respect to a comparator (same rules as in
+// chutil/sort.h), so, unlike the hash maps, pairs can be visited in order
+// and ranges of keys can be found without looking at the whole map.
+//
+// All pairs live in the leaves. Each leaf stores its keys back to back,
+// followed by its values, so a search within a node only touches keys.
+// Leaves are linked left to right, a scan never goes back up the tree.
+//
+// Nodes are sized to span a few cache lines (BTREE_NODE_BYTES), so the
+// fanout depends on the key and value sizes.
+//
+// Like the swiss map, pointers into the tree are only valid until the
+// tree is next modified. (Pairs move around within and between nodes)
+
+#define BTREE_NODE_BYTES 256
+
+// No matter how big the keys and values are, nodes always hold at least
+// this many keys.
+#define BTREE_MIN_CAP 4
+
+typedef struct _bt_node_t {
+    // Next leaf over to the right, NULL for the last leaf.
+    // (Unused in internal nodes)
+    struct _bt_node_t *next;
+
+    size_t num_keys;
+    bool leaf;
+
+    // Leaves: keys then values.
+    // Internal nodes: keys then num_keys + 1 children.
+} bt_node_t;
+
+typedef struct _btree_t {
+    size_t key_size;
+    size_t value_size;
+
+    sort_cmp_ft cmp;
+
+    size_t num_keys;
+
+    // Number of levels, the root is a leaf when this is 1.
+    size_t height;
+
+    bt_node_t *root;
+    bt_node_t *first_leaf;
+
+    // Max keys per node. Nodes have room for one more than this, so a
+    // node can overflow for a moment before it's split.
+    size_t leaf_cap;
+    size_t inner_cap;
+
+    // Byte offsets of the value and child arrays within a node.
+    size_t leaf_vals_off;
+    size_t inner_children_off;
+
+    size_t leaf_size;
+    size_t inner_size;
+
+    // Room for one key, used to pass separators up during a split.
+    void *key_buf;
+} btree_t;
+
+btree_t *new_btree(size_t ks, size_t vs, sort_cmp_ft cmp);
+
+// Builds a tree straight from n sorted pairs, without any searching or
+// splitting. keys (and values) are stored back to back, like the buffer of
+// an array list. If a key appears more than once, the last value is kept.
+//
+// values can be NULL when vs is 0.
+btree_t *new_btree_from_sorted(size_t ks, size_t vs, sort_cmp_ft cmp,
+        const void *keys, const void *values, size_t n);
+
+void delete_btree(btree_t *bt);
+
+static inline size_t bt_num_keys(btree_t *bt) {
+    return bt->num_keys;
+}
+
+static inline size_t bt_key_size(btree_t *bt) {
+    return bt->key_size;
+}
+
+static inline size_t bt_value_size(btree_t *bt) {
+    return bt->value_size;
+}
+
+void bt_put(btree_t *bt, const void *key, const void *value);
+
+// Returns NULL if key isn't in the tree.
+void *bt_get(btree_t *bt, const void *key);
+
+bool bt_remove(btree_t *bt, const void *key);
+
+static inline bool bt_get_copy(btree_t *bt, const void *key, void *dest) {
+    void *val = bt_get(bt, key);
+    if (!val) {
+        return false;
+    }
+
+    memcpy(dest, val, bt->value_size);
+    return true;
+}
+
+static inline bool bt_contains(btree_t *bt, const void *key) {
+    return bt_get(bt, key) != NULL;
+}
+
+// Iteration always goes in increasing key order.
+// DO NOT modify the tree while iterating.
+typedef struct _bt_iter_t {
+    btree_t *bt;
+
+    // Position of the next pair, leaf is NULL when exhausted.
+    bt_node_t *leaf;
+    size_t ind;
+
+    // Iteration stops before the first key not less than end.
+    // NULL means there is no end.
+    const void *end;
+} bt_iter_t;
+
+// Starts at the smallest key.
+void bt_iter_begin(btree_t *bt, bt_iter_t *iter);
+
+// Starts at the first key not less than key.
+void bt_lower_bound(btree_t *bt, const void *key, bt_iter_t *iter);
+
+// Starts at the first key greater than key.
+void bt_upper_bound(btree_t *bt, const void *key, bt_iter_t *iter);
+
+// Visits every key in [lo, hi). Either bound can be NULL to leave that
+// side open. hi is NOT copied, it must outlive the iterator.
+void bt_range(btree_t *bt, const void *lo, const void *hi, bt_iter_t *iter);
+
+// Writes the next pair's key and value to key and value, (either can be
+// NULL) and moves on. Returns false once there are no more pairs.
+bool bt_iter_next(bt_iter_t *iter, const void **key, void **value);
+
+#endif
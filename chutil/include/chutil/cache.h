@@ -0,0 +1,152 @@
+
+#ifndef CHUTIL_CACHE_H
+#define CHUTIL_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "chutil/map.h"
+#include "chutil/filter.h"
+
+// A map holding at most capacity pairs. Once full, each new key pushes
+// an old one out, which one depends on the policy.
+//
+// Pairs live right inside a hash_map_t (made with HM_SLAB_ENTRIES), with
+// the policy's links stored alongside each value. So there is no
+// allocation per pair, and a hit is a single hash map lookup.
+// Lookup, insertion and eviction are all O(1).
+
+typedef enum _cache_policy_t {
+    // Least Recently Used. A hit moves a pair to the front of a list,
+    // the back of the list is evicted.
+    CACHE_LRU,
+
+    // S3-FIFO. New keys start in a small FIFO queue (CACHE_SMALL_PERCENT
+    // of the cache) and are only promoted to the main queue if they are
+    // hit again before falling out. The main queue is a CLOCK, pairs hit
+    // since their last pass get another trip around. Keys recently evicted
+    // from the small queue are remembered, (just their hashes) and go
+    // straight to main when they come back.
+    //
+    // A hit only bumps a counter, nothing is moved. And a scan over many
+    // keys used only once can't flush the keys which are used often.
+    CACHE_S3FIFO,
+} cache_policy_t;
+
+#define CACHE_SMALL_PERCENT 10
+
+// Hits counted per pair in the S3-FIFO policy. (Capped at this)
+#define CACHE_MAX_FREQ 3
+
+typedef enum _cache_queue_ind_t {
+    CACHE_SMALL = 0,
+    CACHE_MAIN = 1,
+} cache_queue_ind_t;
+
+// Stored in front of every value in the underlying map.
+typedef struct _cache_node_t {
+    struct _cache_node_t *prev;
+    struct _cache_node_t *next;
+
+    uint8_t queue;
+    uint8_t freq;
+} cache_node_t;
+
+// head is the newest node, tail the next in line to go.
+typedef struct _cache_queue_t {
+    cache_node_t *head;
+    cache_node_t *tail;
+    size_t len;
+} cache_queue_t;
+
+// Called with every value as it leaves the cache. Evicted, removed,
+// overwritten or still there when the cache is deleted. A good place to
+// free whatever the value owns.
+typedef void (*cache_evict_ft)(const void *key, void *value, void *ctx);
+
+typedef struct _cache_t {
+    cache_policy_t policy;
+    size_t capacity;
+
+    size_t key_size;
+    size_t value_size;
+
+    // Nodes start this far into the map's values, so they stay aligned.
+    size_t node_offset;
+
+    hash_map_t *map;
+
+    cache_evict_ft evict_func;
+    void *evict_ctx;
+
+    // LRU only uses CACHE_SMALL.
+    cache_queue_t queues[2];
+
+    // Max length of the small queue. (S3-FIFO)
+    size_t small_cap;
+
+    // Hashes of keys recently evicted from the small queue, oldest at
+    // ghost_start. (S3-FIFO) ghost_filter answers whether a hash is in
+    // the ring.
+    uint64_t *ghost;
+    size_t ghost_cap;
+    size_t ghost_start;
+    size_t ghost_len;
+    cuckoo_filter_t *ghost_filter;
+
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} cache_t;
+
+// capacity must be at least 1.
+cache_t *new_cache(cache_policy_t policy, size_t capacity, size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+
+// Calls the evict callback on every pair left.
+void delete_cache(cache_t *c);
+
+// func can be NULL for no callback.
+static inline void cache_set_evict_func(cache_t *c, cache_evict_ft func, void *ctx) {
+    c->evict_func = func;
+    c->evict_ctx = ctx;
+}
+
+static inline size_t cache_num_keys(const cache_t *c) {
+    return hm_num_keys(c->map);
+}
+
+static inline size_t cache_capacity(const cache_t *c) {
+    return c->capacity;
+}
+
+// Returns NULL (a miss) if key isn't cached. Counts as a use of key.
+// The pointer is only good until the cache is next modified.
+void *cache_get(cache_t *c, const void *key);
+
+// Adds or overwrites key, evicting another pair if the cache is full.
+void cache_put(cache_t *c, const void *key, const void *value);
+
+bool cache_remove(cache_t *c, const void *key);
+
+static inline size_t cache_hits(const cache_t *c) {
+    return c->hits;
+}
+
+static inline size_t cache_misses(const cache_t *c) {
+    return c->misses;
+}
+
+// Only pairs pushed out to make room, not removed or overwritten ones.
+static inline size_t cache_evictions(const cache_t *c) {
+    return c->evictions;
+}
+
+static inline void cache_reset_stats(cache_t *c) {
+    c->hits = 0;
+    c->misses = 0;
+    c->evictions = 0;
+}
+
+#endif
@@ -0,0 +1,133 @@
+
+#ifndef CHUTIL_CONCURRENT_MAP_H
+#define CHUTIL_CONCURRENT_MAP_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "chutil/map.h"
+
+// A chained hash map which can be shared between threads.
+//
+// Writers (put/remove) lock one of CM_NUM_STRIPES mutexes, chosen by
+// chain, so writers to different chains rarely wait on each other.
+//
+// Readers (get_copy/contains/for_each) take no locks at all. Nodes are
+// never modified once they're in the map, an update swaps in a brand new
+// node. Unlinked nodes are only freed once every reader which could still
+// be looking at them is done. (Epoch based reclamation, see cm_try_advance
+// in the source)
+//
+// Readers only touch their own slot, (CM_NUM_READER_SLOTS of them, each on
+// its own cache line) and writers keep retired memory on their stripe. So
+// neither ever writes to memory shared by the whole map, other than a
+// rare epoch bump.
+//
+// Since a value can be freed right after a read returns, there is no
+// cm_get returning a pointer into the map. Values are always copied out.
+
+#define CM_NUM_STRIPES 64
+
+// Threads are spread over this many reader slots.
+#define CM_NUM_READER_SLOTS 64
+
+// A stripe tries to free its retired memory every time this many more
+// pieces have piled up.
+#define CM_RETIRE_BATCH 128
+
+#define CM_CACHE_LINE 64
+
+typedef struct _cm_node_t {
+    _Atomic(struct _cm_node_t *) next;
+    uint64_t hash_val;
+
+    // Key then value follow.
+} cm_node_t;
+
+typedef struct _cm_table_t {
+    // Always a power of 2.
+    size_t cap;
+    _Atomic(cm_node_t *) *chains;
+} cm_table_t;
+
+// Readers register under the parity of the epoch they started in.
+// Threads sharing a slot just share the counts.
+typedef struct _cm_reader_slot_t {
+    atomic_size_t readers[2];
+    uint8_t padding[CM_CACHE_LINE - (2 * sizeof(atomic_size_t))];
+} cm_reader_slot_t;
+
+// Memory waiting to be freed. Either a single node, or a whole table
+// along with every node still in it.
+typedef struct _cm_retired_t {
+    void *ptr;
+    bool is_table;
+
+    // The epoch when ptr was unlinked.
+    size_t epoch;
+} cm_retired_t;
+
+typedef struct _cm_stripe_t {
+    pthread_mutex_t mut;
+
+    // Memory retired by writers holding this stripe.
+    size_t num_retired;
+    size_t retired_cap;
+    size_t reclaim_at;
+    cm_retired_t *retired;
+} cm_stripe_t;
+
+typedef struct _concurrent_map_t {
+    size_t key_size;
+    size_t value_size;
+
+    hash_map_hash_ft hash_func;
+    hash_map_key_eq_ft eq_func;
+
+    _Atomic(cm_table_t *) table;
+    atomic_size_t num_keys;
+
+    cm_stripe_t stripes[CM_NUM_STRIPES];
+
+    // Old tables waiting to be freed. They're kept apart from the stripes
+    // since they're big, and a map which only grows may never retire
+    // enough on any one stripe to fill a batch. Writers try to free them
+    // every time while there are any. (Only its mutex and list are used)
+    cm_stripe_t retired_tables;
+    atomic_size_t num_retired_tables;
+
+    atomic_size_t epoch;
+
+    // reader_slots is reader_slots_mem rounded up to a cache line.
+    void *reader_slots_mem;
+    cm_reader_slot_t *reader_slots;
+} concurrent_map_t;
+
+concurrent_map_t *new_concurrent_map(size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+
+// No other thread may be using the map at this point.
+void delete_concurrent_map(concurrent_map_t *cm);
+
+static inline size_t cm_num_keys(concurrent_map_t *cm) {
+    return atomic_load(&(cm->num_keys));
+}
+
+void cm_put(concurrent_map_t *cm, const void *key, const void *value);
+bool cm_remove(concurrent_map_t *cm, const void *key);
+
+// Returns false if key isn't in the map.
+bool cm_get_copy(concurrent_map_t *cm, const void *key, void *dest);
+bool cm_contains(concurrent_map_t *cm, const void *key);
+
+typedef void (*cm_for_each_ft)(const void *key, const void *value, void *ctx);
+
+// Calls func on every pair. No locks are held, so func (or any other
+// thread) can put and remove while this runs. Changes made during the
+// walk may or may not be seen.
+void cm_for_each(concurrent_map_t *cm, cm_for_each_ft func, void *ctx);
+
+#endif
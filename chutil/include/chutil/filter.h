@@ -0,0 +1,144 @@
+
+#ifndef CHUTIL_FILTER_H
+#define CHUTIL_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "chutil/map.h"
+
+// Approximate set membership.
+//
+// A filter can say a key is definitely NOT in a set, or that it probably
+// is. There are never false negatives, but a small fraction of keys
+// never added will look like they were. (false positives)
+//
+// Filters are much smaller than the maps they sit in front of. When most
+// lookups miss, checking the filter first skips the map's chain walk and
+// eq_func calls almost every time:
+//
+//     if (!bf_maybe_contains(bf, key)) {
+//         return NULL;
+//     }
+//     return hm_get(hm, key);
+//
+// Both filters take the same hash functions as hash_map_t, and never look
+// at keys directly. There are _hashed versions of each call for when the
+// hash has already been computed.
+
+// Blocked Bloom filter.
+//
+// Each key only touches one 64 byte block. (One cache line) The hash
+// picks the block, then sets 1 bit in each of the block's 8 words.
+// So a lookup is one cache miss, and the bit tests don't depend on each
+// other. (The compiler can do all 8 at once)
+//
+// Keys can't be removed.
+
+#define BF_BLOCK_WORDS 8
+
+typedef struct _bf_block_t {
+    uint64_t words[BF_BLOCK_WORDS];
+} bf_block_t;
+
+typedef struct _bloom_filter_t {
+    hash_map_hash_ft hash_func;
+
+    size_t num_blocks;
+
+    // blocks is blocks_mem rounded up to a cache line.
+    void *blocks_mem;
+    bf_block_t *blocks;
+} bloom_filter_t;
+
+// Sized for expected_keys keys at bits_per_key bits each. 10 bits per key
+// gives roughly a 1% false positive rate, every 5 more about divides it by
+// 4 or 5.
+bloom_filter_t *new_bloom_filter(size_t expected_keys, size_t bits_per_key,
+        hash_map_hash_ft hf);
+void delete_bloom_filter(bloom_filter_t *bf);
+
+void bf_add_hashed(bloom_filter_t *bf, uint64_t hash_val);
+bool bf_maybe_contains_hashed(const bloom_filter_t *bf, uint64_t hash_val);
+
+static inline void bf_add(bloom_filter_t *bf, const void *key) {
+    bf_add_hashed(bf, bf->hash_func(key));
+}
+
+static inline bool bf_maybe_contains(const bloom_filter_t *bf, const void *key) {
+    return bf_maybe_contains_hashed(bf, bf->hash_func(key));
+}
+
+// Forgets every key.
+void bf_clear(bloom_filter_t *bf);
+
+// Cuckoo filter.
+//
+// Stores a 16 bit fingerprint per key, in a table of buckets holding
+// CF_BUCKET_SIZE fingerprints each. A key's fingerprint can live in one
+// of 2 buckets, the second found from the first and the fingerprint
+// alone. So fingerprints can be moved around (kicked) without the keys.
+//
+// Unlike the Bloom filter, keys can be removed. A lookup checks at most
+// 2 buckets, 8 bytes each.
+//
+// cf_remove must only be given keys which were actually added. Removing
+// anything else may remove another key's matching fingerprint, leaving a
+// false negative.
+
+#define CF_BUCKET_SIZE 4
+
+// Give up on kicking fingerprints around after this many moves.
+#define CF_MAX_KICKS 500
+
+typedef struct _cuckoo_filter_t {
+    hash_map_hash_ft hash_func;
+
+    // Always a power of 2.
+    size_t num_buckets;
+
+    // CF_BUCKET_SIZE per bucket, 0 means empty.
+    uint16_t *fps;
+
+    size_t num_keys;
+
+    // When an add runs out of kicks, the fingerprint left homeless is
+    // kept here. The filter is full until a remove makes room for it.
+    bool has_victim;
+    size_t victim_ind;
+    uint16_t victim_fp;
+
+    // Picks which fingerprint gets kicked.
+    uint64_t rng;
+} cuckoo_filter_t;
+
+// Sized to hold capacity keys. (A little more room is left, cuckoo
+// tables get slow to fill once they are about 95% full)
+cuckoo_filter_t *new_cuckoo_filter(size_t capacity, hash_map_hash_ft hf);
+void delete_cuckoo_filter(cuckoo_filter_t *cf);
+
+static inline size_t cf_num_keys(const cuckoo_filter_t *cf) {
+    return cf->num_keys;
+}
+
+// Returns false if the filter is full. (key isn't added)
+bool cf_add_hashed(cuckoo_filter_t *cf, uint64_t hash_val);
+bool cf_maybe_contains_hashed(const cuckoo_filter_t *cf, uint64_t hash_val);
+
+// Returns false if no matching fingerprint was found.
+bool cf_remove_hashed(cuckoo_filter_t *cf, uint64_t hash_val);
+
+static inline bool cf_add(cuckoo_filter_t *cf, const void *key) {
+    return cf_add_hashed(cf, cf->hash_func(key));
+}
+
+static inline bool cf_maybe_contains(const cuckoo_filter_t *cf, const void *key) {
+    return cf_maybe_contains_hashed(cf, cf->hash_func(key));
+}
+
+static inline bool cf_remove(cuckoo_filter_t *cf, const void *key) {
+    return cf_remove_hashed(cf, cf->hash_func(key));
+}
+
+#endif
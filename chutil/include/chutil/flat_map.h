@@ -0,0 +1,123 @@
+
+#ifndef CHUTIL_FLAT_MAP_H
+#define CHUTIL_FLAT_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chutil/map.h"
+
+// Compact map for the common case of just a handful of keys.
+// (Think JSON objects)
+//
+// Pairs are packed one after another in a single array, with their hashes
+// in a parallel array. While the map is small, a lookup is just a scan over
+// the hashes, no table at all. Once the map grows past FLAT_MAP_MAX_SCAN
+// pairs, an index of pair positions is built (open addressing, linear
+// probing) so big maps still get constant time lookups.
+//
+// Iteration follows insertion order, except that removing a pair moves
+// the last pair into its place.
+//
+// Like swiss_map_t, pointers into the map are only valid until the map
+// is next modified.
+
+#define FLAT_MAP_MAX_SCAN 8
+
+#define FLAT_MAP_INDEX_EMPTY UINT32_MAX
+
+typedef struct _flat_map_t {
+    size_t key_size;
+    size_t value_size;
+
+    // Key followed by value, rounded up to keep keys aligned.
+    size_t pair_size;
+
+    hash_map_hash_ft hash_func;
+    hash_map_key_eq_ft eq_func;
+
+    size_t num_keys;
+    size_t cap;
+
+    uint8_t *pairs;
+    uint64_t *hashes;
+
+    // index_cap is 0 until the index is built, after that
+    // it is always a power of 2 at least twice num_keys.
+    size_t index_cap;
+    uint32_t index_shift;
+    uint32_t *index;
+} flat_map_t;
+
+extern const map_impl_t *FLAT_MAP_IMPL;
+
+flat_map_t *new_flat_map(size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+void delete_flat_map(flat_map_t *fm);
+
+static inline size_t fm_num_keys(flat_map_t *fm) {
+    return fm->num_keys;
+}
+
+static inline size_t fm_key_size(flat_map_t *fm) {
+    return fm->key_size;
+}
+
+static inline size_t fm_value_size(flat_map_t *fm) {
+    return fm->value_size;
+}
+
+static inline const void *fm_kvp_key(flat_map_t *fm, key_val_pair_t kvp) {
+    (void)fm;
+    return kvp;
+}
+
+static inline void *fm_kvp_val(flat_map_t *fm, key_val_pair_t kvp) {
+    return (uint8_t *)kvp + fm->key_size;
+}
+
+// Pairs are indexable in iteration order.
+static inline key_val_pair_t fm_get_kvp(flat_map_t *fm, size_t i) {
+    return fm->pairs + (i * fm->pair_size);
+}
+
+typedef struct _fm_iter_t {
+    flat_map_t *fm;
+    size_t ind;
+} fm_iter_t;
+
+static inline void fm_iter_begin(flat_map_t *fm, fm_iter_t *iter) {
+    iter->fm = fm;
+    iter->ind = 0;
+}
+
+// This will return HASH_MAP_EXHAUSTED when done.
+static inline key_val_pair_t fm_iter_next(fm_iter_t *iter) {
+    if (iter->ind < iter->fm->num_keys) {
+        return fm_get_kvp(iter->fm, iter->ind++);
+    }
+
+    return HASH_MAP_EXHAUSTED;
+}
+
+void fm_put(flat_map_t *fm, const void *key, const void *value);
+void *fm_get(flat_map_t *fm, const void *key);
+bool fm_remove(flat_map_t *fm, const void *key);
+
+static inline bool fm_get_copy(flat_map_t *fm, const void *key, void *dest) {
+    void *val = fm_get(fm, key);
+    if (!val) {
+        return false;
+    }
+
+    memcpy(dest, val, fm->value_size);
+    return true;
+}
+
+static inline bool fm_contains(flat_map_t *fm, const void *key) {
+    return fm_get(fm, key) != NULL;
+}
+
+#endif
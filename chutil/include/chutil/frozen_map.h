@@ -0,0 +1,130 @@
+
+#ifndef CHUTIL_FROZEN_MAP_H
+#define CHUTIL_FROZEN_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chutil/map.h"
+
+// Read only map, made from a hash_map_t which is done changing.
+//
+// Keys are placed with a minimal perfect hash function. (CHD, "hash,
+// displace and compress") Every key is sent to a bucket, and each bucket
+// stores a displacement which moves its keys into free slots. There are
+// exactly as many slots as keys, no empty space and no chains.
+//
+// So a lookup is one call to the hash function, one read from the
+// displacement array and one key comparison. That's it.
+//
+// Everything lives in one allocation, which can be written straight to
+// a file and read back in with a single fread.
+
+// Written at the start of a saved frozen map.
+#define FROZEN_MAP_MAGIC 0x70616d6e7a6f7266ULL
+
+// Average number of keys per bucket. Bigger means less space for
+// displacements, but a slower freeze.
+#define FROZEN_MAP_BUCKET_SIZE 4
+
+// The part of a frozen map which is saved to disk.
+typedef struct _frozen_map_header_t {
+    uint64_t magic;
+
+    uint64_t key_size;
+    uint64_t value_size;
+
+    // Key then value, rounded up to 8 bytes.
+    uint64_t entry_size;
+
+    uint64_t num_keys;
+    uint64_t num_buckets;
+
+    // Mixed into every hash, picked at freeze time.
+    uint64_t seed;
+} frozen_map_header_t;
+
+typedef struct _frozen_map_disp_t {
+    uint32_t d0;
+    uint32_t d1;
+} frozen_map_disp_t;
+
+typedef struct _frozen_map_t {
+    hash_map_hash_ft hash_func;
+    hash_map_key_eq_ft eq_func;
+
+    // Size of the header plus everything after it.
+    size_t blob_size;
+
+    frozen_map_header_t header;
+
+    // num_buckets displacements then num_keys entries follow.
+} frozen_map_t;
+
+// Copies every pair out of hm. hm is left untouched, and can be deleted
+// right after.
+//
+// Returns NULL if two keys in hm have the exact same hash, a perfect hash
+// function can't tell those apart.
+frozen_map_t *hm_freeze(hash_map_t *hm);
+
+void delete_frozen_map(frozen_map_t *frm);
+
+static inline size_t frm_num_keys(const frozen_map_t *frm) {
+    return frm->header.num_keys;
+}
+
+static inline size_t frm_key_size(const frozen_map_t *frm) {
+    return frm->header.key_size;
+}
+
+static inline size_t frm_value_size(const frozen_map_t *frm) {
+    return frm->header.value_size;
+}
+
+// Returns NULL if key isn't in the map.
+// The pointer is good until the map is deleted.
+const void *frm_get(const frozen_map_t *frm, const void *key);
+
+static inline bool frm_get_copy(const frozen_map_t *frm, const void *key, void *dest) {
+    const void *val = frm_get(frm, key);
+    if (!val) {
+        return false;
+    }
+
+    memcpy(dest, val, frm->header.value_size);
+    return true;
+}
+
+static inline bool frm_contains(const frozen_map_t *frm, const void *key) {
+    return frm_get(frm, key) != NULL;
+}
+
+typedef void (*frm_for_each_ft)(const void *key, const void *value, void *ctx);
+
+// Visits every pair, in no particular order.
+void frm_for_each(const frozen_map_t *frm, frm_for_each_ft func, void *ctx);
+
+// Saving and loading.
+//
+// Keys and values are written as raw bytes, so this only makes sense
+// when they don't hold pointers. The same hash function must be given
+// when loading, and (like chutil/hash.h) the file should be read back
+// on a machine of the same endianness.
+
+// Returns false on a write error.
+bool frm_write(const frozen_map_t *frm, FILE *fp);
+
+// Returns NULL on a read error, or if what's read isn't a frozen map.
+// fp must be seekable, the rest of the file is checked to be big enough
+// before anything is allocated.
+frozen_map_t *frm_read(FILE *fp, hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+
+// Same as above, but open (and close) the file at fn.
+bool frm_save(const frozen_map_t *frm, const char *fn);
+frozen_map_t *frm_load(const char *fn, hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+
+#endif
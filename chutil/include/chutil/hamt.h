@@ -0,0 +1,103 @@
+
+#ifndef CHUTIL_HAMT_H
+#define CHUTIL_HAMT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "chutil/map.h"
+
+// Persistent (immutable) hash map, a Hash Array Mapped Trie.
+//
+// A hamt_t is never modified after it's made. hamt_put and hamt_remove
+// return a NEW version of the map, and the old version stays exactly as
+// it was. The two share every node not on the path to the changed key,
+// so an update only copies about log32(n) small nodes.
+//
+// Nodes are reference counted (atomically), so versions can be handed
+// to other threads freely. A thread holding a version sees a consistent
+// snapshot, no locks and no copying needed. Just remember every hamt_t
+// must be deleted by whoever ends up owning it.
+//
+// Each level of the trie looks at HAMT_BITS bits of the key's hash.
+// Nodes only store the slots in use, (entries inline, then children)
+// with two bitmaps saying which slots are which.
+
+#define HAMT_BITS 5
+
+// Past this depth the whole hash has been used, keys which still
+// collide are kept in a plain list. (64 / 5 rounded up)
+#define HAMT_MAX_DEPTH 13
+
+typedef struct _hamt_node_t {
+    atomic_size_t refs;
+
+    // Below HAMT_MAX_DEPTH: bit i of data_map means slot i is an entry,
+    // bit i of node_map means slot i is a child node.
+    //
+    // At HAMT_MAX_DEPTH: data_map is the number of entries, node_map is 0.
+    uint32_t data_map;
+    uint32_t node_map;
+
+    // Entries (hash, key, value) then child pointers follow.
+} hamt_node_t;
+
+typedef struct _hamt_t {
+    size_t key_size;
+    size_t value_size;
+
+    // Hash, then key, then value, rounded up to 8 bytes.
+    size_t entry_size;
+
+    hash_map_hash_ft hash_func;
+    hash_map_key_eq_ft eq_func;
+
+    size_t num_keys;
+
+    // NULL when the map is empty.
+    hamt_node_t *root;
+} hamt_t;
+
+hamt_t *new_hamt(size_t ks, size_t vs, hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+
+// Only lets go of this version, others are unaffected.
+void delete_hamt(hamt_t *h);
+
+// Another handle on the same version, O(1). Use this to give a thread
+// its own snapshot.
+hamt_t *hamt_copy(const hamt_t *h);
+
+static inline size_t hamt_num_keys(const hamt_t *h) {
+    return h->num_keys;
+}
+
+static inline size_t hamt_key_size(const hamt_t *h) {
+    return h->key_size;
+}
+
+static inline size_t hamt_value_size(const hamt_t *h) {
+    return h->value_size;
+}
+
+// Returns a new version with key set to value.
+hamt_t *hamt_put(const hamt_t *h, const void *key, const void *value);
+
+// Returns a new version without key. (Equal to h if key isn't in h)
+hamt_t *hamt_remove(const hamt_t *h, const void *key);
+
+// Returns NULL if key isn't in the map.
+// The pointer is good for as long as this version is.
+const void *hamt_get(const hamt_t *h, const void *key);
+
+static inline bool hamt_contains(const hamt_t *h, const void *key) {
+    return hamt_get(h, key) != NULL;
+}
+
+typedef void (*hamt_for_each_ft)(const void *key, const void *value, void *ctx);
+
+// Visits every pair, in no particular order.
+void hamt_for_each(const hamt_t *h, hamt_for_each_ft func, void *ctx);
+
+#endif
@@ -0,0 +1,26 @@
+
+#ifndef CHUTIL_HASH_H
+#define CHUTIL_HASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// General purpose 64-bit hashing. (Modeled after wyhash)
+//
+// Input is consumed 8 or 16 bytes at a time, every byte affects every
+// bit of the output. Good enough for hash tables, NOT cryptographic.
+//
+// Words are read in native byte order, so hashes should not be stored
+// somewhere they may be read back by a machine of different endianness.
+
+// Hashes len bytes starting at data.
+uint64_t hash_bytes_seeded(const void *data, size_t len, uint64_t seed);
+
+static inline uint64_t hash_bytes(const void *data, size_t len) {
+    return hash_bytes_seeded(data, len, 0);
+}
+
+// Scrambles a single integer. Cheap, and good for integer keys.
+uint64_t hash_u64(uint64_t x);
+
+#endif
@@ -46,6 +46,20 @@ static inline void hp_reset_iterator(heap_t *hp) {
 
 void *hp_next(heap_t *hp);
 
+// External iterator, leaves the heap untouched so many can run at once.
+// Values are visited in table order, NOT priority order.
+typedef struct _hp_iter_t {
+    heap_t *hp;
+    size_t ind;
+} hp_iter_t;
+
+static inline void hp_iter_begin(heap_t *hp, hp_iter_t *iter) {
+    iter->hp = hp;
+    iter->ind = 0;
+}
+
+void *hp_iter_next(hp_iter_t *iter);
+
 void hp_re_heap(heap_t *hp);
 
 #endif
@@ -4,10 +4,28 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 // Abstract List Types. (Really just reinventing C++ here.)
 
+struct _list_impl_t;
+
+// External iterator, meant to live on the stack of whoever is iterating.
+// The list itself is never written to while iterating, so any number of
+// these can traverse the same list at once. (e.g. nested loops or many
+// reader threads)
+//
+// Like the internal iterator, DO NOT modify the list while iterating.
+typedef struct _list_iter_t {
+    const struct _list_impl_t *impl;
+    void *list;
+
+    // Cursor state, what these mean is up to the implementation.
+    size_t ind;
+    void *node;
+} list_iter_t;
+
 typedef void *(*list_constructor_ft)(size_t);
 typedef void (*list_destructor_ft)(void *);
 typedef size_t (*list_len_ft)(void *);
@@ -20,6 +38,8 @@ typedef void (*list_pop_ft)(void *, void *);
 typedef void (*list_poll_ft)(void *, void *);
 typedef void (*list_reset_iterator_ft)(void *);
 typedef void *(*list_next_ft)(void *);
+typedef void (*list_iter_begin_ft)(void *, list_iter_t *);
+typedef void *(*list_iter_next_ft)(list_iter_t *);
 
 typedef struct _list_impl_t {
     list_constructor_ft constructor;
@@ -35,6 +55,9 @@ typedef struct _list_impl_t {
 
     list_reset_iterator_ft  reset_iterator;
     list_next_ft            next;
+
+    list_iter_begin_ft      iter_begin;
+    list_iter_next_ft       iter_next;
 } list_impl_t;
 
 typedef struct _list_t {
@@ -43,7 +66,18 @@ typedef struct _list_t {
 } list_t;
 
 extern const list_impl_t *ARRAY_LIST_IMPL;
+
+// An array list whose cells are plain old data. That is, two cells are
+// equal exactly when their bytes are equal. (No pointers to follow,
+// no padding with garbage in it, no floats where -0.0 == 0.0, etc.)
+//
+// Declaring this lets whole list equality and hashing work directly on
+// the contiguous bytes. (See l_equals and l_hash) The underlying list is
+// a plain array_list_t, only the impl says its cells are POD.
+extern const list_impl_t *POD_ARRAY_LIST_IMPL;
 extern const list_impl_t *LINKED_LIST_IMPL;
+extern const list_impl_t *SEG_LIST_IMPL;
+extern const list_impl_t *SMALL_LIST_IMPL;
 
 list_t *new_list(const list_impl_t *impl, size_t cs);
 void delete_list(list_t *l);
@@ -88,6 +122,16 @@ static inline void *l_next(list_t *l) {
     return l->impl->next(l->list);
 }
 
+static inline void l_iter_begin(list_t *l, list_iter_t *iter) {
+    iter->impl = l->impl;
+    l->impl->iter_begin(l->list, iter);
+}
+
+// Returns NULL when exhausted.
+static inline void *l_iter_next(list_iter_t *iter) {
+    return iter->impl->iter_next(iter);
+}
+
 // Concrete Arraylist
 
 typedef struct _array_list_t {
@@ -128,6 +172,13 @@ static inline void al_set(array_list_t *al, size_t i, const void *src) {
 }
 
 void al_push(array_list_t *al, const void *src);
+
+// Makes sure at least cap cells fit without another resize.
+void al_reserve(array_list_t *al, size_t cap);
+
+// Sets the length of al directly. Any new cells are left uninitialized.
+void al_resize(array_list_t *al, size_t len);
+
 void al_pop(array_list_t *al, void *dest);
 void al_poll(array_list_t *al, void *dest);
 
@@ -137,6 +188,24 @@ static inline void al_reset_iterator(array_list_t *al) {
 
 void *al_next(array_list_t *al);
 
+typedef struct _al_iter_t {
+    array_list_t *al;
+    size_t ind;
+} al_iter_t;
+
+static inline void al_iter_begin(array_list_t *al, al_iter_t *iter) {
+    iter->al = al;
+    iter->ind = 0;
+}
+
+static inline void *al_iter_next(al_iter_t *iter) {
+    if (iter->ind < iter->al->len) {
+        return al_get(iter->al, iter->ind++);
+    }
+
+    return NULL;
+}
+
 // Concrete Linked List
 
 typedef struct _linked_list_node_hdr_t {
@@ -189,5 +258,173 @@ static inline void ll_reset_iterator(linked_list_t *ll) {
 
 void *ll_next(linked_list_t *ll);
 
+typedef struct _ll_iter_t {
+    linked_list_node_hdr_t *node;
+} ll_iter_t;
+
+static inline void ll_iter_begin(linked_list_t *ll, ll_iter_t *iter) {
+    iter->node = ll->first;
+}
+
+static inline void *ll_iter_next(ll_iter_t *iter) {
+    if (iter->node) {
+        void *val_ptr = llnh_get_cell(iter->node);
+        iter->node = iter->node->next;
+
+        return val_ptr;
+    }
+
+    return NULL;
+}
+
+// Concrete Segmented List
+//
+// An array list which never moves its cells. Storage is a series of
+// segments, segment k holds SEG_LIST_FIRST_SEG_CAP << k cells.
+// Growing just allocates the next segment, nothing is ever copied, so
+// pointers returned by sgl_get stay valid for the life of the list.
+// (As long as the cell isn't polled/popped, of course)
+//
+// Finding a cell's segment is just a leading zero count, still O(1).
+
+#define SEG_LIST_FIRST_SEG_SHIFT 3
+#define SEG_LIST_FIRST_SEG_CAP ((size_t)1 << SEG_LIST_FIRST_SEG_SHIFT)
+
+// Enough segments to cover every possible index.
+#define SEG_LIST_MAX_SEGS (64 - SEG_LIST_FIRST_SEG_SHIFT)
+
+typedef struct _seg_list_t {
+    size_t cell_size;
+    size_t len;
+
+    // Number of segments allocated so far.
+    size_t num_segs;
+    void *segs[SEG_LIST_MAX_SEGS];
+
+    size_t iter_ind;
+} seg_list_t;
+
+seg_list_t *new_seg_list(size_t cs);
+void delete_seg_list(seg_list_t *sgl);
+
+static inline size_t sgl_len(seg_list_t *sgl) {
+    return sgl->len;
+}
+
+static inline size_t sgl_cell_size(seg_list_t *sgl) {
+    return sgl->cell_size;
+}
+
+// Total cells which fit in the currently allocated segments.
+static inline size_t sgl_cap(seg_list_t *sgl) {
+    return SEG_LIST_FIRST_SEG_CAP * (((size_t)1 << sgl->num_segs) - 1);
+}
+
+static inline void *sgl_get(seg_list_t *sgl, size_t i) {
+    // Segment k covers [FIRST * (2^k - 1), FIRST * (2^(k+1) - 1)).
+    // So, after adding FIRST, the top bit tells us our segment.
+    size_t j = i + SEG_LIST_FIRST_SEG_CAP;
+    size_t top_bit = (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(j);
+
+    size_t seg = top_bit - SEG_LIST_FIRST_SEG_SHIFT;
+    size_t offset = j - ((size_t)1 << top_bit);
+
+    return (uint8_t *)(sgl->segs[seg]) + (offset * sgl->cell_size);
+}
+
+static inline void sgl_get_copy(seg_list_t *sgl, size_t i, void *dest) {
+    memcpy(dest, sgl_get(sgl, i), sgl->cell_size);
+}
+
+static inline void sgl_set(seg_list_t *sgl, size_t i, const void *src) {
+    memcpy(sgl_get(sgl, i), src, sgl->cell_size);
+}
+
+void sgl_push(seg_list_t *sgl, const void *src);
+void sgl_pop(seg_list_t *sgl, void *dest);
+void sgl_poll(seg_list_t *sgl, void *dest);
+
+static inline void sgl_reset_iterator(seg_list_t *sgl) {
+    sgl->iter_ind = 0;
+}
+
+void *sgl_next(seg_list_t *sgl);
+
+// Walks segment by segment, so no index math per cell.
+typedef struct _sgl_iter_t {
+    seg_list_t *sgl;
+    size_t left;    // Cells left to visit.
+
+    size_t seg;
+    size_t seg_left; // Cells left in the current segment.
+    uint8_t *cell;
+} sgl_iter_t;
+
+void sgl_iter_begin(seg_list_t *sgl, sgl_iter_t *iter);
+void *sgl_iter_next(sgl_iter_t *iter);
+
+// Concrete Small List
+//
+// An array list with room for SMALL_LIST_INLINE_CELLS cells allocated
+// together with the list struct itself. Only once the list grows past
+// that are the cells moved out to a heap buffer.
+//
+// Most lists are tiny, so this makes them a single allocation with no
+// pointer chasing. arr always points at the live cells, wherever they are.
+
+#define SMALL_LIST_INLINE_CELLS 8
+
+typedef struct _small_list_t {
+    size_t cap;
+    size_t len;
+    size_t cell_size;
+    void *arr; // Either inline_cells or a heap buffer.
+
+    size_t iter_ind;
+
+    // SMALL_LIST_INLINE_CELLS * cell_size bytes.
+    uint8_t inline_cells[];
+} small_list_t;
+
+small_list_t *new_small_list(size_t cs);
+void delete_small_list(small_list_t *sml);
+
+static inline size_t sml_len(small_list_t *sml) {
+    return sml->len;
+}
+
+static inline size_t sml_cap(small_list_t *sml) {
+    return sml->cap;
+}
+
+static inline size_t sml_cell_size(small_list_t *sml) {
+    return sml->cell_size;
+}
+
+static inline bool sml_is_inline(small_list_t *sml) {
+    return sml->arr == (void *)(sml->inline_cells);
+}
+
+static inline void *sml_get(small_list_t *sml, size_t i) {
+    return (uint8_t *)(sml->arr) + (i * sml->cell_size);
+}
+
+static inline void sml_get_copy(small_list_t *sml, size_t i, void *dest) {
+    memcpy(dest, sml_get(sml, i), sml->cell_size);
+}
+
+static inline void sml_set(small_list_t *sml, size_t i, const void *src) {
+    memcpy(sml_get(sml, i), src, sml->cell_size);
+}
+
+void sml_push(small_list_t *sml, const void *src);
+void sml_pop(small_list_t *sml, void *dest);
+void sml_poll(small_list_t *sml, void *dest);
+
+static inline void sml_reset_iterator(small_list_t *sml) {
+    sml->iter_ind = 0;
+}
+
+void *sml_next(small_list_t *sml);
 
 #endif
@@ -3,7 +3,9 @@
 #define CHUTIL_LIST_HELPERS_H
 
 #include "chutil/list.h"
+#include "chutil/sort.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 // The point of these end points is to expose
 // helper functions for using any implementation
@@ -11,11 +13,31 @@
 //
 // The below functions will only use given virtual
 // functions and will assume nothing about underlying
-// list structure.
+// list structure. (Except for a few array list fast paths
+// which are noted below)
 
 typedef bool (*list_cell_equals_ft)(const void *cell1, const void *cell2);
+typedef uint64_t (*list_cell_hash_ft)(const void *cell);
 
 // Compare whether or not give lists are equivelant.
+//
+// If both lists are POD array lists (See POD_ARRAY_LIST_IMPL) with the
+// same cell size, they are compared with a single memcmp and eq is never
+// called. (eq can even be NULL in this case)
 bool l_equals(list_t *l1, list_t *l2, list_cell_equals_ft eq);
 
+// Hash an entire list, the order of the cells matters.
+//
+// POD array lists are hashed directly from their bytes and hash is
+// never called. (hash can be NULL in this case) This means a POD list's
+// hash should only be compared to the hashes of other POD lists.
+uint64_t l_hash(list_t *l, list_cell_hash_ft hash);
+
+// Sort any list in place. (See chutil/sort.h)
+//
+// The cells are copied out into a contiguous buffer, sorted, then
+// written back in order. Array lists are sorted directly in place.
+void l_sort(list_t *l, sort_cmp_ft cmp);
+void l_stable_sort(list_t *l, sort_cmp_ft cmp);
+
 #endif
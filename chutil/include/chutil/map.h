@@ -7,21 +7,181 @@
 #include <stdlib.h>
 #include <string.h>
 
-// Only hashmap implementation for now!
+// Abstract Map Types. (Same idea as list_t)
+//
+// Every implementation is built from a key size, a value size, a hash
+// function and a key equality function. So, any map can be swapped for
+// another without touching the code which uses it.
 
 typedef bool (*hash_map_key_eq_ft)(const void *, const void *);
 typedef bool (*hash_map_val_eq_ft)(const void *, const void *);
-typedef uint32_t (*hash_map_hash_ft)(const void *);
+typedef uint64_t (*hash_map_hash_ft)(const void *);
+
+// Options which can be given when creating a map.
+typedef uint32_t hash_map_flags_t;
+
+// Values are plain old data, two values are equal exactly when their bytes
+// are. hm_equals will then compare values with memcmp instead of val_eq.
+#define HM_POD_VALUES ((hash_map_flags_t)1 << 0)
+
+// Spread resizes out over time. Instead of moving every pair into the
+// bigger table at once, each hm_put/hm_remove moves a few chains. This
+// bounds the worst case latency of a single put, at the cost of holding
+// both tables for a while.
+#define HM_INCREMENTAL_RESIZE ((hash_map_flags_t)1 << 1)
+
+// Pairs are carved out of big slabs owned by the map, instead of each
+// getting its own malloc. Removed pairs go on a free list to be reused by
+// later puts, and deleting the map frees just the slabs. Pairs put one
+// after another also end up next to each other in memory.
+//
+// The catch, memory of removed pairs isn't given back until the map is
+// deleted.
+#define HM_SLAB_ENTRIES ((hash_map_flags_t)1 << 2)
 
 typedef void *key_val_pair_t;
 #define HASH_MAP_EXHAUSTED NULL
 
+struct _map_impl_t;
+
+// External iterator, works just like list_iter_t.
+// DO NOT modify the map while iterating.
+typedef struct _map_iter_t {
+    const struct _map_impl_t *impl;
+    void *map;
+
+    // Cursor state, what these mean is up to the implementation.
+    size_t ind;
+    void *node;
+} map_iter_t;
+
+typedef void *(*map_constructor_ft)(size_t, size_t, hash_map_hash_ft, hash_map_key_eq_ft);
+typedef void (*map_destructor_ft)(void *);
+typedef size_t (*map_num_keys_ft)(void *);
+typedef size_t (*map_key_size_ft)(void *);
+typedef size_t (*map_value_size_ft)(void *);
+typedef const void *(*map_kvp_key_ft)(void *, key_val_pair_t);
+typedef void *(*map_kvp_val_ft)(void *, key_val_pair_t);
+typedef void (*map_put_ft)(void *, const void *, const void *);
+typedef void *(*map_get_ft)(void *, const void *);
+typedef bool (*map_remove_ft)(void *, const void *);
+typedef void (*map_iter_begin_ft)(void *, map_iter_t *);
+typedef key_val_pair_t (*map_iter_next_ft)(map_iter_t *);
+
+typedef struct _map_impl_t {
+    map_constructor_ft  constructor;
+    map_destructor_ft   destructor;
+    map_num_keys_ft     num_keys;
+    map_key_size_ft     key_size;
+    map_value_size_ft   value_size;
+    map_kvp_key_ft      kvp_key;
+    map_kvp_val_ft      kvp_val;
+    map_put_ft          put;
+    map_get_ft          get;
+    map_remove_ft       remove;
+
+    map_iter_begin_ft   iter_begin;
+    map_iter_next_ft    iter_next;
+} map_impl_t;
+
+typedef struct _map_t {
+    void *map;
+    const map_impl_t *impl;
+} map_t;
+
+// Separately chained hash map. (hash_map_t below)
+extern const map_impl_t *HASH_MAP_IMPL;
+
+// Others live in their own headers.
+// SWISS_MAP_IMPL in chutil/swiss_map.h
+// FLAT_MAP_IMPL in chutil/flat_map.h
+
+map_t *new_map(const map_impl_t *impl, size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+void delete_map(map_t *m);
+
+static inline size_t m_num_keys(map_t *m) {
+    return m->impl->num_keys(m->map);
+}
+
+static inline size_t m_key_size(map_t *m) {
+    return m->impl->key_size(m->map);
+}
+
+static inline size_t m_value_size(map_t *m) {
+    return m->impl->value_size(m->map);
+}
+
+static inline const void *m_kvp_key(map_t *m, key_val_pair_t kvp) {
+    return m->impl->kvp_key(m->map, kvp);
+}
+
+static inline void *m_kvp_val(map_t *m, key_val_pair_t kvp) {
+    return m->impl->kvp_val(m->map, kvp);
+}
+
+static inline void m_put(map_t *m, const void *key, const void *value) {
+    m->impl->put(m->map, key, value);
+}
+
+// Returns NULL if key isn't in the map.
+// The returned pointer is only valid until the map is next modified.
+static inline void *m_get(map_t *m, const void *key) {
+    return m->impl->get(m->map, key);
+}
+
+static inline bool m_remove(map_t *m, const void *key) {
+    return m->impl->remove(m->map, key);
+}
+
+static inline bool m_get_copy(map_t *m, const void *key, void *dest) {
+    void *val = m_get(m, key);
+    if (!val) {
+        return false;
+    }
+
+    memcpy(dest, val, m_value_size(m));
+    return true;
+}
+
+static inline bool m_contains(map_t *m, const void *key) {
+    return m_get(m, key) != NULL;
+}
+
+static inline void m_iter_begin(map_t *m, map_iter_t *iter) {
+    iter->impl = m->impl;
+    m->impl->iter_begin(m->map, iter);
+}
+
+// This will return HASH_MAP_EXHAUSTED when done.
+static inline key_val_pair_t m_iter_next(map_iter_t *iter) {
+    return iter->impl->iter_next(iter);
+}
+
+// Works across implementations.
+bool m_equals(map_t *m1, map_t *m2, hash_map_val_eq_ft val_eq);
+
+// Concrete Chained Hash Map
+
 // Key Value chains form singly linked lists.
 typedef struct _key_val_header_t {
     struct _key_val_header_t *next;
-    uint32_t hash_val;
+    uint64_t hash_val;
 } key_val_header_t;
 
+// The hash stored with a pair which is in a hash_map_t.
+static inline uint64_t kvp_hash_val(key_val_pair_t kvp) {
+    return ((key_val_header_t *)((uint8_t *)kvp - sizeof(key_val_header_t)))->hash_val;
+}
+
+// A block of pair cells. (Only used with HM_SLAB_ENTRIES)
+typedef struct _hm_slab_t {
+    struct _hm_slab_t *next;
+    size_t num_cells;
+
+    // Cells follow.
+} hm_slab_t;
+
 typedef struct _hash_map_t {
     size_t key_size;
     size_t value_size;
@@ -29,18 +189,42 @@ typedef struct _hash_map_t {
     hash_map_hash_ft hash_func;
     hash_map_key_eq_ft eq_func;
 
+    hash_map_flags_t flags;
+
     size_t num_keys;
 
     size_t chains_cap;
     key_val_header_t **chains;
 
+    // Only used while a resize is in progress. (old_chains is NULL
+    // otherwise) Chains before migrate_ind have already been moved.
+    // Until then, chains past migrate_ind * (chains_cap / old_chains_cap)
+    // are left uninitialized.
+    size_t old_chains_cap;
+    key_val_header_t **old_chains;
+    size_t migrate_ind;
+
+    // Only used with HM_SLAB_ENTRIES. Cells are handed out from the front
+    // of slabs (slab_used of its slab_cells so far) or from free_cells,
+    // which are linked through their next fields.
+    size_t cell_size;
+    hm_slab_t *slabs;
+    size_t slab_cells;
+    size_t slab_used;
+    key_val_header_t *free_cells;
+
     size_t iter_chain_ind;
     key_val_header_t *iter; // header of next pair to return from next_kvp.
                             // NULL means empty.
 } hash_map_t;
 
-hash_map_t *new_hash_map(size_t ks, size_t vs, 
-        hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+hash_map_t *new_hash_map_with_flags(size_t ks, size_t vs, 
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef, hash_map_flags_t flags);
+
+static inline hash_map_t *new_hash_map(size_t ks, size_t vs, 
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    return new_hash_map_with_flags(ks, vs, hf, ef, 0);
+}
 
 void delete_hash_map(hash_map_t *hm);
 
@@ -58,6 +242,14 @@ static inline size_t hm_num_keys(hash_map_t *hm) {
     return hm->num_keys;
 }
 
+static inline size_t hm_key_size(hash_map_t *hm) {
+    return hm->key_size;
+}
+
+static inline size_t hm_value_size(hash_map_t *hm) {
+    return hm->value_size;
+}
+
 // These 2 functions are for iterating over the key_value pairs of a map.
 // NOTE: These calls are meant to be isolated from the others.
 // While iterating DO NOT call any function which could modify the map
@@ -69,10 +261,55 @@ void hm_reset_iterator(hash_map_t *hm);
 // This will return HASH_MAP_EXHAUSTED when done.
 key_val_pair_t hm_next_kvp(hash_map_t *hm);
 
+// External iterator, the iteration state lives here instead of in the map.
+// This way the map is never written to while iterating, so many of these
+// can traverse the same map at once (nested loops, reader threads, etc.)
+//
+// Same rule as above though, DO NOT modify the map while iterating.
+typedef struct _hm_iter_t {
+    hash_map_t *hm;
+    size_t chain_ind;
+    key_val_header_t *next; // NULL means exhausted.
+} hm_iter_t;
+
+void hm_iter_begin(hash_map_t *hm, hm_iter_t *iter);
+
+// This will return HASH_MAP_EXHAUSTED when done.
+key_val_pair_t hm_iter_next(hm_iter_t *iter);
+
 void hm_put(hash_map_t *hm, const void *key, const void *value);
 void *hm_get(hash_map_t *hm, const void *key);
 bool hm_remove(hash_map_t *hm, const void *key);
 
+// Returns a pointer to key's value, adding key first if it isn't already
+// in the map. A newly added value is zeroed. Either way the key is only
+// looked up once, unlike an hm_get followed by an hm_put.
+//
+// If inserted is non-NULL, it is set to whether key was added.
+// The returned pointer stays valid until key is removed.
+void *hm_get_or_insert(hash_map_t *hm, const void *key, bool *inserted);
+
+// Like hm_remove, but first copies the stored key and value out.
+// (Useful when they own memory which must be cleaned up)
+// Either destination can be NULL.
+bool hm_remove_copy(hash_map_t *hm, const void *key, void *key_dest, void *val_dest);
+
+// Grows the table so that n keys fit without any more resizing.
+// Handy before a big run of puts. (Never shrinks the table)
+void hm_reserve(hash_map_t *hm, size_t n);
+
+// Batched versions of hm_put and hm_get. keys holds n keys back to back,
+// (and values n values) just like an array list's buffer.
+//
+// Lookups within a batch are overlapped using prefetching, so when the map
+// is much bigger than the cache, these are a good deal faster than calling
+// hm_put/hm_get n times.
+void hm_put_batch(hash_map_t *hm, const void *keys, const void *values, size_t n);
+
+// dests[i] is set to what hm_get would return for the i'th key.
+// Returns how many keys were found.
+size_t hm_get_batch(hash_map_t *hm, const void *keys, size_t n, void **dests);
+
 static inline bool hm_get_copy(hash_map_t *hm, const void *key, void *dest) {
     void *val = hm_get(hm, key);
     if (!val) {
@@ -91,8 +328,81 @@ static inline bool hm_contains(hash_map_t *hm, const void *key) {
     return false;
 }
 
-// I decided not to make a helper functions class for maps
-// since there is only one map implementation.
+// Diagnostics, for checking how well a hash function spreads keys out.
+
+// Chains of length HM_STATS_HIST_LEN - 1 or more all go in the last slot
+// of the histogram.
+#define HM_STATS_HIST_LEN 16
+
+typedef struct _hm_stats_t {
+    size_t num_keys;
+
+    // Across both tables while a resize is in progress.
+    size_t num_chains;
+    size_t empty_chains;
+
+    // Keys per chain.
+    double load_factor;
+
+    size_t longest_chain;
+
+    // chain_hist[i] is the number of chains holding i pairs.
+    size_t chain_hist[HM_STATS_HIST_LEN];
+
+    // Pairs whose full 64-bit hash equals that of an earlier pair in the
+    // same chain. With a decent hash function, this should be 0 or very
+    // close to it. Anything more means the hash is throwing away bits.
+    size_t hash_collisions;
+
+    // Bytes held by the map, tables and pairs included. (Not counting
+    // malloc's own overhead)
+    size_t memory_bytes;
+} hm_stats_t;
+
+// Walks every chain, so O(n). Not for hot paths.
+hm_stats_t hm_stats(hash_map_t *hm);
+
+void hm_print_stats(const hm_stats_t *stats);
+
+// If both maps were created with HM_POD_VALUES, values are compared
+// with memcmp and val_eq is never called. (It can be NULL in this case)
 bool hm_equals(hash_map_t *hm1, hash_map_t *hm2, hash_map_val_eq_ft val_eq);
 
+// Set operations.
+//
+// The maps given should hold the same kind of keys. (Same key size and
+// equality) When they also share a hash function, the hashes stored with
+// each pair are reused instead of hashing keys again. Lookups are done in
+// batches with prefetching, like hm_get_batch.
+
+// Puts every pair of src into dest. Where both have a key, src's value
+// wins. dest and src must be different maps.
+void hm_union_into(hash_map_t *dest, hash_map_t *src);
+
+// A new map with the keys found in both, values are taken from hm1.
+// Only the smaller map is walked. (The result is made like hm1, same
+// functions and flags)
+hash_map_t *hm_intersect(hash_map_t *hm1, hash_map_t *hm2);
+
+// A new map with the pairs of hm1 whose keys aren't in hm2.
+hash_map_t *hm_difference(hash_map_t *hm1, hash_map_t *hm2);
+
+typedef enum _hm_diff_kind_t {
+    HM_DIFF_ADDED,      // Only in new_hm, old_val is NULL.
+    HM_DIFF_REMOVED,    // Only in old_hm, new_val is NULL.
+    HM_DIFF_CHANGED,    // In both, values differ.
+} hm_diff_kind_t;
+
+typedef void (*hm_diff_ft)(hm_diff_kind_t kind, const void *key,
+        const void *old_val, const void *new_val, void *ctx);
+
+// Calls func once for every key added, removed or changed going from
+// old_hm to new_hm, and returns how many calls were made. DO NOT modify
+// either map from inside func.
+//
+// Like hm_equals, val_eq can be NULL when both maps have HM_POD_VALUES.
+// old_hm is only walked if some of its keys weren't found in new_hm.
+size_t hm_diff(hash_map_t *old_hm, hash_map_t *new_hm, hash_map_val_eq_ft val_eq,
+        hm_diff_ft func, void *ctx);
+
 #endif
@@ -0,0 +1,91 @@
+
+#ifndef CHUTIL_MAPPED_LIST_H
+#define CHUTIL_MAPPED_LIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// An array list whose storage is a memory mapped file.
+//
+// The file is just a header followed by the cells, exactly as they sit
+// in memory. So, reopening a list is a single mmap, no parsing and no
+// pushing records back in one by one.
+//
+// Since cells are written to disk as raw bytes, only store plain data!
+// (No pointers, they won't mean anything the next time around)
+
+#define MAPPED_LIST_MAGIC 0x5453494c4c414d43ULL // "CMALLIST"
+
+typedef struct _mapped_list_header_t {
+    uint64_t magic;
+    uint64_t cell_size;
+    uint64_t len;
+    uint64_t cap;
+} mapped_list_header_t;
+
+typedef struct _mapped_array_list_t {
+    int fd;
+
+    // The whole mapping, header included.
+    size_t map_size;
+    mapped_list_header_t *hdr;
+
+    size_t iter_ind;
+} mapped_array_list_t;
+
+// Opens the list stored at path, creating the file if needed.
+//
+// Returns NULL if the file couldn't be opened/mapped, if it doesn't
+// hold a mapped list, or if the list it holds has a different cell size.
+mapped_array_list_t *new_mapped_array_list(const char *path, size_t cs);
+
+// Unmaps and closes. The contents are NOT explicitly synced, the OS will
+// write them back eventually. Use mal_flush if you need them on disk now.
+void delete_mapped_array_list(mapped_array_list_t *mal);
+
+// Blocks until every change so far is on disk. Returns false on error.
+bool mal_flush(mapped_array_list_t *mal);
+
+static inline size_t mal_len(mapped_array_list_t *mal) {
+    return mal->hdr->len;
+}
+
+static inline size_t mal_cap(mapped_array_list_t *mal) {
+    return mal->hdr->cap;
+}
+
+static inline size_t mal_cell_size(mapped_array_list_t *mal) {
+    return mal->hdr->cell_size;
+}
+
+// NOTE: Pushing can remap the file, which invalidates pointers from here.
+static inline void *mal_get(mapped_array_list_t *mal, size_t i) {
+    return (uint8_t *)(mal->hdr + 1) + (i * mal->hdr->cell_size);
+}
+
+static inline void mal_get_copy(mapped_array_list_t *mal, size_t i, void *dest) {
+    memcpy(dest, mal_get(mal, i), mal->hdr->cell_size);
+}
+
+static inline void mal_set(mapped_array_list_t *mal, size_t i, const void *src) {
+    memcpy(mal_get(mal, i), src, mal->hdr->cell_size);
+}
+
+void mal_push(mapped_array_list_t *mal, const void *src);
+void mal_pop(mapped_array_list_t *mal, void *dest);
+void mal_poll(mapped_array_list_t *mal, void *dest);
+
+// Drops every cell, keeps the capacity.
+static inline void mal_clear(mapped_array_list_t *mal) {
+    mal->hdr->len = 0;
+}
+
+static inline void mal_reset_iterator(mapped_array_list_t *mal) {
+    mal->iter_ind = 0;
+}
+
+void *mal_next(mapped_array_list_t *mal);
+
+#endif
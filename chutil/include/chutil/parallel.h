@@ -0,0 +1,87 @@
+
+#ifndef CHUTIL_PARALLEL_H
+#define CHUTIL_PARALLEL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "chutil/list.h"
+#include "chutil/sort.h"
+
+// A fixed pool of pthreads for fork/join style data parallelism.
+//
+// A job is split into some number of chunks. The workers (and the thread
+// which called tp_run) grab chunks until there are none left. tp_run only
+// returns once every chunk is done.
+//
+// Only one thread should be calling tp_run on a pool at a time, and a task
+// should never call tp_run on its own pool.
+
+typedef void (*thread_pool_task_ft)(void *ctx, size_t chunk);
+
+typedef struct _thread_pool_t {
+    size_t num_workers;
+    pthread_t *workers;
+
+    pthread_mutex_t mut;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    bool shutdown;
+
+    // The current job.
+    thread_pool_task_ft task;
+    void *ctx;
+    size_t num_chunks;
+    size_t next_chunk;
+    size_t chunks_done;
+} thread_pool_t;
+
+// nw can be 0, in which case every job runs on the calling thread.
+thread_pool_t *new_thread_pool(size_t nw);
+void delete_thread_pool(thread_pool_t *tp);
+
+// The calling thread counts as one more worker.
+static inline size_t tp_num_threads(thread_pool_t *tp) {
+    return tp->num_workers + 1;
+}
+
+void tp_run(thread_pool_t *tp, thread_pool_task_ft task, void *ctx, size_t num_chunks);
+
+// Data parallel helpers over array lists.
+//
+// The list is split into contiguous ranges, each range is handled
+// entirely by one thread. Given functions must be safe to call from
+// many threads at once.
+
+// Ranges smaller than this aren't worth handing to another thread.
+#define PARALLEL_MIN_CHUNK_CELLS 1024
+
+typedef void (*parallel_for_each_ft)(void *cell, void *ctx);
+
+// dest_cell will be a cell of the destination list.
+typedef void (*parallel_map_ft)(const void *src_cell, void *dest_cell, void *ctx);
+
+// Must be associative! acc = acc (op) cell.
+typedef void (*parallel_combine_ft)(void *acc, const void *cell, void *ctx);
+
+void al_parallel_for_each(thread_pool_t *tp, array_list_t *al,
+        parallel_for_each_ft func, void *ctx);
+
+// dest is resized to the length of src, then dest[i] = func(src[i]).
+// dest can have a different cell size than src.
+void al_parallel_map(thread_pool_t *tp, array_list_t *src, array_list_t *dest,
+        parallel_map_ft func, void *ctx);
+
+// Each range is folded starting from identity, then the partial results
+// are combined in order. So, combine must be associative, but need not
+// be commutative. The result is written to dest (one cell in size).
+void al_parallel_reduce(thread_pool_t *tp, array_list_t *al,
+        parallel_combine_ft combine, void *ctx, const void *identity, void *dest);
+
+// Each range is sorted with sort_cells, then ranges are merged pairwise,
+// each level of merges also running in parallel. NOT stable.
+void al_parallel_sort(thread_pool_t *tp, array_list_t *al, sort_cmp_ft cmp);
+
+#endif
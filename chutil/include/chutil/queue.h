@@ -0,0 +1,105 @@
+
+#ifndef CHUTIL_QUEUE_H
+#define CHUTIL_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "chutil/list.h"
+
+// Bounded Multi-Producer Multi-Consumer queue.
+//
+// This is a ring of slots, each slot has a sequence number which tells
+// producers and consumers whether or not it is their turn to use said slot.
+// (Dmitry Vyukov's design) No locks, and no allocations after construction.
+//
+// ONLY push/poll (and their try variants) are thread-safe!
+// Everything else (get, set, pop, iterating) assumes no other thread is
+// touching the queue at the same time.
+
+// Keeps the producer and consumer positions on different cache lines.
+#define MPMC_CACHE_LINE 64
+
+// Capacity used when constructing through MPMC_QUEUE_IMPL.
+//
+// The ring never grows, so a queue made this way holds at most 1024 cells.
+// Through the list interface, l_push is mq_push. On a full queue it blocks
+// until a consumer makes room, which slows producers down to the pace of
+// their consumers. Use mq_try_push to never block.
+#define MPMC_QUEUE_DEFAULT_CAP 1024
+
+typedef struct _mpmc_queue_t {
+    size_t cell_size;
+    size_t slot_size;
+
+    // Always a power of 2.
+    size_t cap;
+    size_t mask;
+
+    // cap slots, each slot is a sequence number followed by a cell.
+    uint8_t *slots;
+
+    size_t iter_ind;
+
+    uint8_t pad0[MPMC_CACHE_LINE];
+    atomic_size_t enqueue_pos;
+    uint8_t pad1[MPMC_CACHE_LINE - sizeof(atomic_size_t)];
+    atomic_size_t dequeue_pos;
+    uint8_t pad2[MPMC_CACHE_LINE - sizeof(atomic_size_t)];
+} mpmc_queue_t;
+
+extern const list_impl_t *MPMC_QUEUE_IMPL;
+
+// cap will be rounded up to a power of 2.
+mpmc_queue_t *new_mpmc_queue(size_t cs, size_t cap);
+void delete_mpmc_queue(mpmc_queue_t *mq);
+
+static inline size_t mq_cell_size(mpmc_queue_t *mq) {
+    return mq->cell_size;
+}
+
+static inline size_t mq_cap(mpmc_queue_t *mq) {
+    return mq->cap;
+}
+
+// While other threads are pushing/polling this is only a snapshot.
+size_t mq_len(mpmc_queue_t *mq);
+
+// Returns false if the queue is full.
+bool mq_try_push(mpmc_queue_t *mq, const void *src);
+
+// Returns false if the queue is empty. dest can be NULL.
+bool mq_try_poll(mpmc_queue_t *mq, void *dest);
+
+// Waits (yielding the CPU) until there is room. Another thread must be
+// polling, or this never returns.
+void mq_push(mpmc_queue_t *mq, const void *src);
+
+// Does nothing if the queue is empty. (Same as the other lists)
+static inline void mq_poll(mpmc_queue_t *mq, void *dest) {
+    mq_try_poll(mq, dest);
+}
+
+// NOT thread-safe. Index 0 is the next cell to be polled.
+void *mq_get(mpmc_queue_t *mq, size_t i);
+
+static inline void mq_get_copy(mpmc_queue_t *mq, size_t i, void *dest) {
+    memcpy(dest, mq_get(mq, i), mq->cell_size);
+}
+
+static inline void mq_set(mpmc_queue_t *mq, size_t i, const void *src) {
+    memcpy(mq_get(mq, i), src, mq->cell_size);
+}
+
+// NOT thread-safe. Removes the most recently pushed cell.
+void mq_pop(mpmc_queue_t *mq, void *dest);
+
+static inline void mq_reset_iterator(mpmc_queue_t *mq) {
+    mq->iter_ind = 0;
+}
+
+void *mq_next(mpmc_queue_t *mq);
+
+#endif
@@ -0,0 +1,77 @@
+
+#ifndef CHUTIL_SORT_H
+#define CHUTIL_SORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "chutil/list.h"
+
+// Sorting/Searching algorithms which work over any contiguous buffer
+// of fixed size cells. (Just like the arr of an array_list_t)
+//
+// A comparator should return a negative number if c1 belongs before c2,
+// a positive number if c1 belongs after c2, and 0 if they are equal.
+typedef int (*sort_cmp_ft)(const void *c1, const void *c2);
+
+// Used by the radix sort. Maps a cell to the unsigned integer it
+// should be ordered by. (For signed keys, flip the sign bit!)
+typedef uint64_t (*sort_key_ft)(const void *cell);
+
+// Introsort, NOT stable. O(nlogn) worst case, no allocations besides
+// a single cell sized buffer.
+void sort_cells(void *arr, size_t len, size_t cs, sort_cmp_ft cmp);
+
+// Merge sort, stable. Uses a temporary buffer the same size as arr.
+void stable_sort_cells(void *arr, size_t len, size_t cs, sort_cmp_ft cmp);
+
+// Merges the sorted runs [src, src + n1) and [src + n1, src + n1 + n2)
+// into dest, which must not overlap src. Ties go to the first run.
+void merge_cells(const void *src, size_t n1, size_t n2, size_t cs,
+        sort_cmp_ft cmp, void *dest);
+
+// LSD radix sort over the 64-bit key given by key_func, stable.
+// key_func is called exactly once per cell. Byte positions which are
+// the same across all keys are skipped entirely.
+void radix_sort_cells(void *arr, size_t len, size_t cs, sort_key_ft key_func);
+
+// arr must be sorted with respect to cmp.
+//
+// Returns true iff a cell equal to key is found.
+// Either way, if ind is non-NULL, it will be set to the lower bound of key.
+// (i.e. the first index whose cell is not less than key)
+bool bsearch_cells(const void *arr, size_t len, size_t cs, const void *key,
+        sort_cmp_ft cmp, size_t *ind);
+
+// Rearranges arr such that the cell at index n is the cell which would be
+// there if arr were sorted. Every cell before n will be <= it, and every cell
+// after n will be >= it. Average O(n).
+//
+// Does nothing if n >= len.
+void nth_element_cells(void *arr, size_t len, size_t cs, size_t n, sort_cmp_ft cmp);
+
+// Array list versions of the above.
+
+static inline void al_sort(array_list_t *al, sort_cmp_ft cmp) {
+    sort_cells(al->arr, al->len, al->cell_size, cmp);
+}
+
+static inline void al_stable_sort(array_list_t *al, sort_cmp_ft cmp) {
+    stable_sort_cells(al->arr, al->len, al->cell_size, cmp);
+}
+
+static inline void al_radix_sort(array_list_t *al, sort_key_ft key_func) {
+    radix_sort_cells(al->arr, al->len, al->cell_size, key_func);
+}
+
+static inline bool al_bsearch(array_list_t *al, const void *key,
+        sort_cmp_ft cmp, size_t *ind) {
+    return bsearch_cells(al->arr, al->len, al->cell_size, key, cmp, ind);
+}
+
+static inline void al_nth_element(array_list_t *al, size_t n, sort_cmp_ft cmp) {
+    nth_element_cells(al->arr, al->len, al->cell_size, n, cmp);
+}
+
+#endif
@@ -0,0 +1,114 @@
+
+#ifndef CHUTIL_SWISS_MAP_H
+#define CHUTIL_SWISS_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chutil/map.h"
+
+// Open addressing hash map in the style of Google's SwissTable.
+//
+// Key/Value pairs live inline in one big slot array, no allocation per
+// entry and no pointer chasing. Beside the slots is an array of control
+// bytes, one per slot. A control byte is either EMPTY, DELETED, or the
+// low 7 bits of the hash of the slot's key (the "tag").
+//
+// Slots are looked at 16 at a time (a group). A lookup compares the tag
+// against all 16 control bytes of a group at once (with SSE2 when
+// available) and only calls the key equality function on matches.
+//
+// Semantics are the same as hash_map_t. The big difference being that
+// a pointer returned from sm_get is only valid until the next sm_put.
+// (The whole slot array can move when the map grows)
+
+#define SWISS_GROUP_WIDTH 16
+
+#define SWISS_CTRL_EMPTY ((int8_t)-128)
+#define SWISS_CTRL_DELETED ((int8_t)-2)
+
+typedef struct _swiss_map_t {
+    size_t key_size;
+    size_t value_size;
+
+    // Key followed by value, rounded up to keep keys aligned.
+    size_t slot_size;
+
+    hash_map_hash_ft hash_func;
+    hash_map_key_eq_ft eq_func;
+
+    size_t num_keys;
+
+    // Tombstones left behind by removals, they count against the
+    // load factor until the next rehash.
+    size_t num_deleted;
+
+    // Always a power of 2, and a multiple of SWISS_GROUP_WIDTH.
+    size_t cap;
+
+    int8_t *ctrl;
+    uint8_t *slots;
+} swiss_map_t;
+
+extern const map_impl_t *SWISS_MAP_IMPL;
+
+swiss_map_t *new_swiss_map(size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef);
+void delete_swiss_map(swiss_map_t *sm);
+
+static inline size_t sm_num_keys(swiss_map_t *sm) {
+    return sm->num_keys;
+}
+
+static inline size_t sm_key_size(swiss_map_t *sm) {
+    return sm->key_size;
+}
+
+static inline size_t sm_value_size(swiss_map_t *sm) {
+    return sm->value_size;
+}
+
+static inline const void *sm_kvp_key(swiss_map_t *sm, key_val_pair_t kvp) {
+    (void)sm;
+    return kvp;
+}
+
+static inline void *sm_kvp_val(swiss_map_t *sm, key_val_pair_t kvp) {
+    return (uint8_t *)kvp + sm->key_size;
+}
+
+// Same rules as the hash_map_t external iterator, DO NOT modify the map
+// while iterating.
+typedef struct _sm_iter_t {
+    swiss_map_t *sm;
+    size_t ind;
+} sm_iter_t;
+
+void sm_iter_begin(swiss_map_t *sm, sm_iter_t *iter);
+
+// This will return HASH_MAP_EXHAUSTED when done.
+key_val_pair_t sm_iter_next(sm_iter_t *iter);
+
+void sm_put(swiss_map_t *sm, const void *key, const void *value);
+void *sm_get(swiss_map_t *sm, const void *key);
+bool sm_remove(swiss_map_t *sm, const void *key);
+
+static inline bool sm_get_copy(swiss_map_t *sm, const void *key, void *dest) {
+    void *val = sm_get(sm, key);
+    if (!val) {
+        return false;
+    }
+
+    memcpy(dest, val, sm->value_size);
+    return true;
+}
+
+static inline bool sm_contains(swiss_map_t *sm, const void *key) {
+    return sm_get(sm, key) != NULL;
+}
+
+bool sm_equals(swiss_map_t *sm1, swiss_map_t *sm2, hash_map_val_eq_ft val_eq);
+
+#endif
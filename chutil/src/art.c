@@ -0,0 +1,845 @@
+
+#include "chutil/art.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Node4 and Node16 keep their keys sorted, so children can be visited
+// in order. Node48 maps a byte to a slot in its child array. (0 is no
+// child, otherwise slot + 1) Node256 is just indexed by byte.
+
+typedef struct _art_node4_t {
+    art_node_t n;
+    uint8_t keys[4];
+    art_node_t *children[4];
+} art_node4_t;
+
+typedef struct _art_node16_t {
+    art_node_t n;
+    uint8_t keys[16];
+    art_node_t *children[16];
+} art_node16_t;
+
+typedef struct _art_node48_t {
+    art_node_t n;
+    uint8_t child_ind[256];
+    art_node_t *children[48];
+} art_node48_t;
+
+typedef struct _art_node256_t {
+    art_node_t n;
+    art_node_t *children[256];
+} art_node256_t;
+
+// Nodes shrink back down once they have this few children.
+// (A bit under the size of the smaller node, so a key flipping in and
+// out doesn't resize the node every time)
+#define ART_NODE16_SHRINK 3
+#define ART_NODE48_SHRINK 12
+#define ART_NODE256_SHRINK 37
+
+static inline size_t art_min(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static inline void *art_leaf_val(art_leaf_t *l) {
+    return (uint8_t *)l + sizeof(art_leaf_t);
+}
+
+static inline const uint8_t *art_leaf_key(art_t *art, art_leaf_t *l) {
+    return (uint8_t *)l + sizeof(art_leaf_t) + art->value_size;
+}
+
+// value can be NULL when there are no values. (A set)
+static inline void art_set_val(art_t *art, art_leaf_t *l, const void *value) {
+    if (art->value_size > 0) {
+        memcpy(art_leaf_val(l), value, art->value_size);
+    }
+}
+
+static art_leaf_t *new_art_leaf(art_t *art, const uint8_t *key, size_t len, const void *value) {
+    art_leaf_t *l = safe_malloc(sizeof(art_leaf_t) + art->value_size + len);
+
+    l->type = ART_LEAF;
+    l->key_len = len;
+
+    art_set_val(art, l, value);
+    memcpy((uint8_t *)art_leaf_key(art, l), key, len);
+
+    return l;
+}
+
+static inline bool art_leaf_matches(art_t *art, art_leaf_t *l, const uint8_t *key, size_t len) {
+    return l->key_len == len && memcmp(art_leaf_key(art, l), key, len) == 0;
+}
+
+static art_node_t *new_art_node(art_node_type_t type) {
+    art_node_t *n;
+
+    switch (type) {
+    case ART_NODE4:
+        n = safe_malloc(sizeof(art_node4_t));
+        break;
+
+    case ART_NODE16:
+        n = safe_malloc(sizeof(art_node16_t));
+        break;
+
+    case ART_NODE48:
+        n = safe_malloc(sizeof(art_node48_t));
+        memset(((art_node48_t *)n)->child_ind, 0, 256);
+        memset(((art_node48_t *)n)->children, 0, sizeof(art_node_t *) * 48);
+        break;
+
+    default:
+        n = safe_malloc(sizeof(art_node256_t));
+        memset(((art_node256_t *)n)->children, 0, sizeof(art_node_t *) * 256);
+        break;
+    }
+
+    n->type = type;
+    n->num_children = 0;
+    n->prefix_len = 0;
+    n->leaf = NULL;
+
+    return n;
+}
+
+// Everything but the children, used when swapping a node for
+// one of a different size.
+static void art_copy_header(art_node_t *dest, art_node_t *src) {
+    dest->num_children = src->num_children;
+    dest->prefix_len = src->prefix_len;
+    memcpy(dest->prefix, src->prefix, art_min(src->prefix_len, ART_MAX_PREFIX));
+    dest->leaf = src->leaf;
+}
+
+static void delete_art_node(art_node_t *n) {
+    if (n->type == ART_LEAF) {
+        safe_free(n);
+        return;
+    }
+
+    if (n->leaf) {
+        safe_free(n->leaf);
+    }
+
+    switch (n->type) {
+    case ART_NODE4:
+        for (size_t i = 0; i < n->num_children; i++) {
+            delete_art_node(((art_node4_t *)n)->children[i]);
+        }
+        break;
+
+    case ART_NODE16:
+        for (size_t i = 0; i < n->num_children; i++) {
+            delete_art_node(((art_node16_t *)n)->children[i]);
+        }
+        break;
+
+    case ART_NODE48:
+        for (size_t i = 0; i < 48; i++) {
+            if (((art_node48_t *)n)->children[i]) {
+                delete_art_node(((art_node48_t *)n)->children[i]);
+            }
+        }
+        break;
+
+    default:
+        for (size_t i = 0; i < 256; i++) {
+            if (((art_node256_t *)n)->children[i]) {
+                delete_art_node(((art_node256_t *)n)->children[i]);
+            }
+        }
+        break;
+    }
+
+    safe_free(n);
+}
+
+art_t *new_art(size_t vs) {
+    art_t *art = safe_malloc(sizeof(art_t));
+
+    art->value_size = vs;
+    art->num_keys = 0;
+    art->root = NULL;
+
+    return art;
+}
+
+void delete_art(art_t *art) {
+    if (art->root) {
+        delete_art_node(art->root);
+    }
+
+    safe_free(art);
+}
+
+// Returns where the child for byte b is stored, NULL if there is none.
+static art_node_t **art_find_child(art_node_t *n, uint8_t b) {
+    switch (n->type) {
+    case ART_NODE4: {
+        art_node4_t *n4 = (art_node4_t *)n;
+        for (size_t i = 0; i < n->num_children; i++) {
+            if (n4->keys[i] == b) {
+                return &(n4->children[i]);
+            }
+        }
+        return NULL;
+    }
+
+    case ART_NODE16: {
+        art_node16_t *n16 = (art_node16_t *)n;
+#ifdef __SSE2__
+        __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)b),
+                _mm_loadu_si128((const __m128i *)(n16->keys)));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(cmp) & ((1U << n->num_children) - 1);
+        if (mask) {
+            return &(n16->children[__builtin_ctz(mask)]);
+        }
+#else
+        for (size_t i = 0; i < n->num_children; i++) {
+            if (n16->keys[i] == b) {
+                return &(n16->children[i]);
+            }
+        }
+#endif
+        return NULL;
+    }
+
+    case ART_NODE48: {
+        art_node48_t *n48 = (art_node48_t *)n;
+        uint8_t ind = n48->child_ind[b];
+        return ind ? &(n48->children[ind - 1]) : NULL;
+    }
+
+    default: {
+        art_node256_t *n256 = (art_node256_t *)n;
+        return n256->children[b] ? &(n256->children[b]) : NULL;
+    }
+    }
+}
+
+// Inserts into a sorted key/child array with room to spare.
+static void art_sorted_insert(uint8_t *keys, art_node_t **children, size_t num,
+        uint8_t b, art_node_t *child) {
+    size_t pos = 0;
+    while (pos < num && keys[pos] < b) {
+        pos++;
+    }
+
+    memmove(keys + pos + 1, keys + pos, num - pos);
+    memmove(children + pos + 1, children + pos, (num - pos) * sizeof(art_node_t *));
+
+    keys[pos] = b;
+    children[pos] = child;
+}
+
+// Adds child under byte b. If n is full, it is replaced (at ref) by a
+// bigger node.
+static void art_add_child(art_node_t **ref, art_node_t *n, uint8_t b, art_node_t *child) {
+    switch (n->type) {
+    case ART_NODE4: {
+        art_node4_t *n4 = (art_node4_t *)n;
+        if (n->num_children < 4) {
+            art_sorted_insert(n4->keys, n4->children, n->num_children, b, child);
+            n->num_children++;
+            return;
+        }
+
+        art_node16_t *n16 = (art_node16_t *)new_art_node(ART_NODE16);
+        art_copy_header(&(n16->n), n);
+        memcpy(n16->keys, n4->keys, 4);
+        memcpy(n16->children, n4->children, sizeof(art_node_t *) * 4);
+
+        *ref = &(n16->n);
+        safe_free(n4);
+
+        art_add_child(ref, *ref, b, child);
+        return;
+    }
+
+    case ART_NODE16: {
+        art_node16_t *n16 = (art_node16_t *)n;
+        if (n->num_children < 16) {
+            art_sorted_insert(n16->keys, n16->children, n->num_children, b, child);
+            n->num_children++;
+            return;
+        }
+
+        art_node48_t *n48 = (art_node48_t *)new_art_node(ART_NODE48);
+        art_copy_header(&(n48->n), n);
+        for (size_t i = 0; i < 16; i++) {
+            n48->children[i] = n16->children[i];
+            n48->child_ind[n16->keys[i]] = (uint8_t)(i + 1);
+        }
+
+        *ref = &(n48->n);
+        safe_free(n16);
+
+        art_add_child(ref, *ref, b, child);
+        return;
+    }
+
+    case ART_NODE48: {
+        art_node48_t *n48 = (art_node48_t *)n;
+        if (n->num_children < 48) {
+            size_t slot = 0;
+            while (n48->children[slot]) {
+                slot++;
+            }
+
+            n48->children[slot] = child;
+            n48->child_ind[b] = (uint8_t)(slot + 1);
+            n->num_children++;
+            return;
+        }
+
+        art_node256_t *n256 = (art_node256_t *)new_art_node(ART_NODE256);
+        art_copy_header(&(n256->n), n);
+        for (size_t i = 0; i < 256; i++) {
+            if (n48->child_ind[i]) {
+                n256->children[i] = n48->children[n48->child_ind[i] - 1];
+            }
+        }
+
+        *ref = &(n256->n);
+        safe_free(n48);
+
+        art_add_child(ref, *ref, b, child);
+        return;
+    }
+
+    default: {
+        art_node256_t *n256 = (art_node256_t *)n;
+        n256->children[b] = child;
+        n->num_children++;
+        return;
+    }
+    }
+}
+
+// The smallest key below n. Used to recover prefix bytes which didn't
+// fit in a node. (Every leaf below n shares n's whole prefix)
+static art_leaf_t *art_min_leaf(art_node_t *n) {
+    while (n->type != ART_LEAF) {
+        // A key ending here is a prefix of everything else below.
+        if (n->leaf) {
+            return n->leaf;
+        }
+
+        switch (n->type) {
+        case ART_NODE4:
+            n = ((art_node4_t *)n)->children[0];
+            break;
+
+        case ART_NODE16:
+            n = ((art_node16_t *)n)->children[0];
+            break;
+
+        case ART_NODE48: {
+            art_node48_t *n48 = (art_node48_t *)n;
+            size_t b = 0;
+            while (!(n48->child_ind[b])) {
+                b++;
+            }
+            n = n48->children[n48->child_ind[b] - 1];
+            break;
+        }
+
+        default: {
+            art_node256_t *n256 = (art_node256_t *)n;
+            size_t b = 0;
+            while (!(n256->children[b])) {
+                b++;
+            }
+            n = n256->children[b];
+            break;
+        }
+        }
+    }
+
+    return (art_leaf_t *)n;
+}
+
+// Number of bytes of n's prefix which match key starting at depth.
+// Stops early at the end of key. (depth must be <= len)
+static size_t art_prefix_mismatch(art_t *art, art_node_t *n, const uint8_t *key,
+        size_t len, size_t depth) {
+    size_t max = art_min(n->prefix_len, len - depth);
+    size_t stored = art_min(max, ART_MAX_PREFIX);
+
+    size_t i;
+    for (i = 0; i < stored; i++) {
+        if (n->prefix[i] != key[depth + i]) {
+            return i;
+        }
+    }
+
+    if (max > ART_MAX_PREFIX) {
+        const uint8_t *leaf_key = art_leaf_key(art, art_min_leaf(n));
+        for (; i < max; i++) {
+            if (leaf_key[depth + i] != key[depth + i]) {
+                return i;
+            }
+        }
+    }
+
+    return i;
+}
+
+// Only looks at the stored part of the prefix. Lookups always end by
+// comparing a whole key, so the rest doesn't need checking on the way.
+static inline bool art_check_prefix(art_node_t *n, const uint8_t *key, size_t len, size_t depth) {
+    if (depth + n->prefix_len > len) {
+        return false;
+    }
+
+    return memcmp(n->prefix, key + depth, art_min(n->prefix_len, ART_MAX_PREFIX)) == 0;
+}
+
+static void art_insert(art_t *art, art_node_t **ref, const uint8_t *key, size_t len,
+        size_t depth, const void *value) {
+    art_node_t *n = *ref;
+
+    if (!n) {
+        *ref = (art_node_t *)new_art_leaf(art, key, len, value);
+        art->num_keys++;
+        return;
+    }
+
+    if (n->type == ART_LEAF) {
+        art_leaf_t *old = (art_leaf_t *)n;
+        if (art_leaf_matches(art, old, key, len)) {
+            art_set_val(art, old, value);
+            return;
+        }
+
+        // Two different keys, split them under a new node holding
+        // whatever they have in common.
+        const uint8_t *old_key = art_leaf_key(art, old);
+        size_t max = art_min(old->key_len, len) - depth;
+
+        size_t lcp = 0;
+        while (lcp < max && old_key[depth + lcp] == key[depth + lcp]) {
+            lcp++;
+        }
+
+        art_node_t *n4 = new_art_node(ART_NODE4);
+        n4->prefix_len = (uint32_t)lcp;
+        memcpy(n4->prefix, key + depth, art_min(lcp, ART_MAX_PREFIX));
+
+        size_t d = depth + lcp;
+        art_node_t *leaf = (art_node_t *)new_art_leaf(art, key, len, value);
+
+        if (old->key_len == d) {
+            n4->leaf = old;
+        } else {
+            art_add_child(&n4, n4, old_key[d], n);
+        }
+
+        if (len == d) {
+            n4->leaf = (art_leaf_t *)leaf;
+        } else {
+            art_add_child(&n4, n4, key[d], leaf);
+        }
+
+        *ref = n4;
+        art->num_keys++;
+        return;
+    }
+
+    if (n->prefix_len) {
+        size_t m = art_prefix_mismatch(art, n, key, len, depth);
+
+        if (m < n->prefix_len) {
+            // The key leaves n's path part way through, split the prefix.
+            art_node_t *n4 = new_art_node(ART_NODE4);
+            n4->prefix_len = (uint32_t)m;
+            memcpy(n4->prefix, n->prefix, art_min(m, ART_MAX_PREFIX));
+
+            uint8_t b;
+            if (n->prefix_len <= ART_MAX_PREFIX) {
+                b = n->prefix[m];
+                n->prefix_len -= (uint32_t)(m + 1);
+                memmove(n->prefix, n->prefix + m + 1, n->prefix_len);
+            } else {
+                const uint8_t *leaf_key = art_leaf_key(art, art_min_leaf(n));
+                b = leaf_key[depth + m];
+                n->prefix_len -= (uint32_t)(m + 1);
+                memcpy(n->prefix, leaf_key + depth + m + 1,
+                        art_min(n->prefix_len, ART_MAX_PREFIX));
+            }
+
+            art_add_child(&n4, n4, b, n);
+
+            art_node_t *leaf = (art_node_t *)new_art_leaf(art, key, len, value);
+            if (depth + m == len) {
+                n4->leaf = (art_leaf_t *)leaf;
+            } else {
+                art_add_child(&n4, n4, key[depth + m], leaf);
+            }
+
+            *ref = n4;
+            art->num_keys++;
+            return;
+        }
+
+        depth += n->prefix_len;
+    }
+
+    if (depth == len) {
+        if (n->leaf) {
+            art_set_val(art, n->leaf, value);
+        } else {
+            n->leaf = new_art_leaf(art, key, len, value);
+            art->num_keys++;
+        }
+
+        return;
+    }
+
+    art_node_t **child = art_find_child(n, key[depth]);
+    if (child) {
+        art_insert(art, child, key, len, depth + 1, value);
+        return;
+    }
+
+    art_add_child(ref, n, key[depth], (art_node_t *)new_art_leaf(art, key, len, value));
+    art->num_keys++;
+}
+
+void art_put(art_t *art, const void *key, size_t len, const void *value) {
+    art_insert(art, &(art->root), key, len, 0, value);
+}
+
+void *art_get(art_t *art, const void *key, size_t len) {
+    const uint8_t *k = key;
+    art_node_t *n = art->root;
+    size_t depth = 0;
+
+    while (n) {
+        if (n->type == ART_LEAF) {
+            art_leaf_t *l = (art_leaf_t *)n;
+            return art_leaf_matches(art, l, k, len) ? art_leaf_val(l) : NULL;
+        }
+
+        if (!art_check_prefix(n, k, len, depth)) {
+            return NULL;
+        }
+
+        depth += n->prefix_len;
+
+        if (depth == len) {
+            art_leaf_t *l = n->leaf;
+            return l && art_leaf_matches(art, l, k, len) ? art_leaf_val(l) : NULL;
+        }
+
+        art_node_t **child = art_find_child(n, k[depth]);
+        if (!child) {
+            return NULL;
+        }
+
+        n = *child;
+        depth++;
+    }
+
+    return NULL;
+}
+
+// Called on a Node4 which may now have too little in it to be worth
+// keeping. A lone leaf replaces the node, a lone child node absorbs
+// the node's path into its own prefix.
+static void art_collapse(art_node_t **ref) {
+    art_node4_t *n4 = (art_node4_t *)*ref;
+    art_node_t *n = &(n4->n);
+
+    if (n->num_children == 0) {
+        *ref = (art_node_t *)n->leaf;
+        safe_free(n4);
+        return;
+    }
+
+    if (n->num_children > 1 || n->leaf) {
+        return;
+    }
+
+    art_node_t *child = n4->children[0];
+
+    if (child->type != ART_LEAF) {
+        // New prefix is n's prefix, the byte leading to child, then
+        // child's prefix. Only the first ART_MAX_PREFIX bytes are kept.
+        uint8_t prefix[ART_MAX_PREFIX];
+        size_t stored = art_min(n->prefix_len, ART_MAX_PREFIX);
+
+        memcpy(prefix, n->prefix, stored);
+        if (stored < ART_MAX_PREFIX) {
+            prefix[stored++] = n4->keys[0];
+        }
+
+        size_t rest = art_min(art_min(child->prefix_len, ART_MAX_PREFIX), ART_MAX_PREFIX - stored);
+        memcpy(prefix + stored, child->prefix, rest);
+        stored += rest;
+
+        child->prefix_len += n->prefix_len + 1;
+        memcpy(child->prefix, prefix, stored);
+    }
+
+    *ref = child;
+    safe_free(n4);
+}
+
+// Removes the child under byte b, then shrinks n if it's gotten small.
+static void art_remove_child(art_node_t **ref, art_node_t *n, uint8_t b) {
+    switch (n->type) {
+    case ART_NODE4: {
+        art_node4_t *n4 = (art_node4_t *)n;
+        size_t pos = 0;
+        while (n4->keys[pos] != b) {
+            pos++;
+        }
+
+        size_t after = n->num_children - pos - 1;
+        memmove(n4->keys + pos, n4->keys + pos + 1, after);
+        memmove(n4->children + pos, n4->children + pos + 1, after * sizeof(art_node_t *));
+        n->num_children--;
+
+        art_collapse(ref);
+        return;
+    }
+
+    case ART_NODE16: {
+        art_node16_t *n16 = (art_node16_t *)n;
+        size_t pos = 0;
+        while (n16->keys[pos] != b) {
+            pos++;
+        }
+
+        size_t after = n->num_children - pos - 1;
+        memmove(n16->keys + pos, n16->keys + pos + 1, after);
+        memmove(n16->children + pos, n16->children + pos + 1, after * sizeof(art_node_t *));
+        n->num_children--;
+
+        if (n->num_children == ART_NODE16_SHRINK) {
+            art_node4_t *n4 = (art_node4_t *)new_art_node(ART_NODE4);
+            art_copy_header(&(n4->n), n);
+            memcpy(n4->keys, n16->keys, ART_NODE16_SHRINK);
+            memcpy(n4->children, n16->children, sizeof(art_node_t *) * ART_NODE16_SHRINK);
+
+            *ref = &(n4->n);
+            safe_free(n16);
+        }
+        return;
+    }
+
+    case ART_NODE48: {
+        art_node48_t *n48 = (art_node48_t *)n;
+        n48->children[n48->child_ind[b] - 1] = NULL;
+        n48->child_ind[b] = 0;
+        n->num_children--;
+
+        if (n->num_children == ART_NODE48_SHRINK) {
+            art_node16_t *n16 = (art_node16_t *)new_art_node(ART_NODE16);
+            art_copy_header(&(n16->n), n);
+
+            size_t i = 0;
+            for (size_t c = 0; c < 256; c++) {
+                if (n48->child_ind[c]) {
+                    n16->keys[i] = (uint8_t)c;
+                    n16->children[i] = n48->children[n48->child_ind[c] - 1];
+                    i++;
+                }
+            }
+
+            *ref = &(n16->n);
+            safe_free(n48);
+        }
+        return;
+    }
+
+    default: {
+        art_node256_t *n256 = (art_node256_t *)n;
+        n256->children[b] = NULL;
+        n->num_children--;
+
+        if (n->num_children == ART_NODE256_SHRINK) {
+            art_node48_t *n48 = (art_node48_t *)new_art_node(ART_NODE48);
+            art_copy_header(&(n48->n), n);
+
+            size_t slot = 0;
+            for (size_t c = 0; c < 256; c++) {
+                if (n256->children[c]) {
+                    n48->children[slot] = n256->children[c];
+                    n48->child_ind[c] = (uint8_t)(slot + 1);
+                    slot++;
+                }
+            }
+
+            *ref = &(n48->n);
+            safe_free(n256);
+        }
+        return;
+    }
+    }
+}
+
+static bool art_delete(art_t *art, art_node_t **ref, const uint8_t *key, size_t len,
+        size_t depth) {
+    art_node_t *n = *ref;
+
+    if (n->type == ART_LEAF) {
+        if (!art_leaf_matches(art, (art_leaf_t *)n, key, len)) {
+            return false;
+        }
+
+        safe_free(n);
+        *ref = NULL;
+        art->num_keys--;
+
+        return true;
+    }
+
+    if (!art_check_prefix(n, key, len, depth)) {
+        return false;
+    }
+
+    depth += n->prefix_len;
+
+    if (depth == len) {
+        if (!(n->leaf) || !art_leaf_matches(art, n->leaf, key, len)) {
+            return false;
+        }
+
+        safe_free(n->leaf);
+        n->leaf = NULL;
+        art->num_keys--;
+
+        if (n->type == ART_NODE4) {
+            art_collapse(ref);
+        }
+
+        return true;
+    }
+
+    art_node_t **child = art_find_child(n, key[depth]);
+    if (!child || !art_delete(art, child, key, len, depth + 1)) {
+        return false;
+    }
+
+    if (!(*child)) {
+        art_remove_child(ref, n, key[depth]);
+    }
+
+    return true;
+}
+
+bool art_remove(art_t *art, const void *key, size_t len) {
+    if (!(art->root)) {
+        return false;
+    }
+
+    return art_delete(art, &(art->root), key, len, 0);
+}
+
+// Visits everything below n in order, returns false if stopped early.
+static bool art_visit(art_t *art, art_node_t *n, art_visit_ft visit, void *ctx) {
+    if (n->type == ART_LEAF) {
+        art_leaf_t *l = (art_leaf_t *)n;
+        return visit(art_leaf_key(art, l), l->key_len, art_leaf_val(l), ctx);
+    }
+
+    if (n->leaf && !art_visit(art, (art_node_t *)n->leaf, visit, ctx)) {
+        return false;
+    }
+
+    switch (n->type) {
+    case ART_NODE4:
+        for (size_t i = 0; i < n->num_children; i++) {
+            if (!art_visit(art, ((art_node4_t *)n)->children[i], visit, ctx)) {
+                return false;
+            }
+        }
+        break;
+
+    case ART_NODE16:
+        for (size_t i = 0; i < n->num_children; i++) {
+            if (!art_visit(art, ((art_node16_t *)n)->children[i], visit, ctx)) {
+                return false;
+            }
+        }
+        break;
+
+    case ART_NODE48: {
+        art_node48_t *n48 = (art_node48_t *)n;
+        for (size_t b = 0; b < 256; b++) {
+            if (n48->child_ind[b] &&
+                    !art_visit(art, n48->children[n48->child_ind[b] - 1], visit, ctx)) {
+                return false;
+            }
+        }
+        break;
+    }
+
+    default: {
+        art_node256_t *n256 = (art_node256_t *)n;
+        for (size_t b = 0; b < 256; b++) {
+            if (n256->children[b] && !art_visit(art, n256->children[b], visit, ctx)) {
+                return false;
+            }
+        }
+        break;
+    }
+    }
+
+    return true;
+}
+
+void art_for_each(art_t *art, art_visit_ft visit, void *ctx) {
+    if (art->root) {
+        art_visit(art, art->root, visit, ctx);
+    }
+}
+
+void art_prefix_for_each(art_t *art, const void *prefix, size_t len,
+        art_visit_ft visit, void *ctx) {
+    const uint8_t *p = prefix;
+    art_node_t *n = art->root;
+    size_t depth = 0;
+
+    while (n) {
+        if (n->type == ART_LEAF) {
+            art_leaf_t *l = (art_leaf_t *)n;
+            if (l->key_len >= len && memcmp(art_leaf_key(art, l), p, len) == 0) {
+                visit(art_leaf_key(art, l), l->key_len, art_leaf_val(l), ctx);
+            }
+
+            return;
+        }
+
+        size_t m = art_prefix_mismatch(art, n, p, len, depth);
+
+        // The whole query matched, everything below n has it as a prefix.
+        if (depth + m == len) {
+            art_visit(art, n, visit, ctx);
+            return;
+        }
+
+        if (m < n->prefix_len) {
+            return;
+        }
+
+        depth += n->prefix_len;
+
+        art_node_t **child = art_find_child(n, p[depth]);
+        if (!child) {
+            return;
+        }
+
+        n = *child;
+        depth++;
+    }
+}
@@ -0,0 +1,189 @@
+
+#include "chutil/bitset.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+// The loops below work over whole words with no data dependent branches,
+// so the compiler is free to vectorize them.
+
+bitset_t *new_bitset(size_t len) {
+    bitset_t *bs = safe_malloc(sizeof(bitset_t));
+
+    bs->len = len;
+    bs->words_cap = bs_num_words(bs);
+    if (bs->words_cap == 0) {
+        bs->words_cap = 1;
+    }
+
+    bs->words = safe_malloc(sizeof(uint64_t) * bs->words_cap);
+    memset(bs->words, 0, sizeof(uint64_t) * bs->words_cap);
+
+    return bs;
+}
+
+void delete_bitset(bitset_t *bs) {
+    safe_free(bs->words);
+    safe_free(bs);
+}
+
+void bs_resize(bitset_t *bs, size_t len) {
+    size_t old_words = bs_num_words(bs);
+    size_t new_words = (len + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+
+    if (len < bs->len) {
+        // Keep the tail of the new last word clear.
+        if (len % BITSET_WORD_BITS) {
+            bs->words[new_words - 1] &=
+                ((uint64_t)1 << (len % BITSET_WORD_BITS)) - 1;
+        }
+
+        memset(bs->words + new_words, 0,
+                sizeof(uint64_t) * (old_words - new_words));
+    } else if (new_words > bs->words_cap) {
+        size_t new_cap = bs->words_cap * 2;
+        if (new_cap < new_words) {
+            new_cap = new_words;
+        }
+
+        bs->words = safe_realloc(bs->words, sizeof(uint64_t) * new_cap);
+
+        // Words past old_words are already 0 up to the old cap.
+        memset(bs->words + bs->words_cap, 0,
+                sizeof(uint64_t) * (new_cap - bs->words_cap));
+        bs->words_cap = new_cap;
+    }
+
+    bs->len = len;
+}
+
+void bs_clear_all(bitset_t *bs) {
+    memset(bs->words, 0, sizeof(uint64_t) * bs_num_words(bs));
+}
+
+size_t bs_popcount(const bitset_t *bs) {
+    size_t words = bs_num_words(bs);
+    size_t count = 0;
+
+    for (size_t i = 0; i < words; i++) {
+        count += __builtin_popcountll(bs->words[i]);
+    }
+
+    return count;
+}
+
+size_t bs_rank(const bitset_t *bs, size_t i) {
+    if (i > bs->len) {
+        i = bs->len;
+    }
+
+    size_t full_words = i / BITSET_WORD_BITS;
+    size_t count = 0;
+
+    for (size_t w = 0; w < full_words; w++) {
+        count += __builtin_popcountll(bs->words[w]);
+    }
+
+    if (i % BITSET_WORD_BITS) {
+        uint64_t mask = ((uint64_t)1 << (i % BITSET_WORD_BITS)) - 1;
+        count += __builtin_popcountll(bs->words[full_words] & mask);
+    }
+
+    return count;
+}
+
+bool bs_select(const bitset_t *bs, size_t k, size_t *ind) {
+    size_t words = bs_num_words(bs);
+
+    for (size_t w = 0; w < words; w++) {
+        uint64_t word = bs->words[w];
+        size_t pc = __builtin_popcountll(word);
+
+        if (k >= pc) {
+            k -= pc;
+            continue;
+        }
+
+        // Drop the lowest k set bits, the one we want is then the lowest.
+        for (; k > 0; k--) {
+            word &= word - 1;
+        }
+
+        *ind = (w * BITSET_WORD_BITS) + __builtin_ctzll(word);
+        return true;
+    }
+
+    return false;
+}
+
+bool bs_equals(const bitset_t *bs1, const bitset_t *bs2) {
+    return bs1->len == bs2->len &&
+        memcmp(bs1->words, bs2->words, sizeof(uint64_t) * bs_num_words(bs1)) == 0;
+}
+
+void bs_or(bitset_t *dest, const bitset_t *src) {
+    if (src->len > dest->len) {
+        bs_resize(dest, src->len);
+    }
+
+    size_t words = bs_num_words(src);
+    for (size_t i = 0; i < words; i++) {
+        dest->words[i] |= src->words[i];
+    }
+}
+
+void bs_and(bitset_t *dest, const bitset_t *src) {
+    size_t dest_words = bs_num_words(dest);
+    size_t src_words = bs_num_words(src);
+    size_t words = dest_words < src_words ? dest_words : src_words;
+
+    for (size_t i = 0; i < words; i++) {
+        dest->words[i] &= src->words[i];
+    }
+
+    memset(dest->words + words, 0, sizeof(uint64_t) * (dest_words - words));
+}
+
+void bs_xor(bitset_t *dest, const bitset_t *src) {
+    if (src->len > dest->len) {
+        bs_resize(dest, src->len);
+    }
+
+    size_t words = bs_num_words(src);
+    for (size_t i = 0; i < words; i++) {
+        dest->words[i] ^= src->words[i];
+    }
+}
+
+void bs_andnot(bitset_t *dest, const bitset_t *src) {
+    size_t dest_words = bs_num_words(dest);
+    size_t src_words = bs_num_words(src);
+    size_t words = dest_words < src_words ? dest_words : src_words;
+
+    for (size_t i = 0; i < words; i++) {
+        dest->words[i] &= ~(src->words[i]);
+    }
+}
+
+void bs_iter_begin(const bitset_t *bs, bs_iter_t *iter) {
+    iter->bs = bs;
+    iter->word_ind = 0;
+    iter->word = bs_num_words(bs) > 0 ? bs->words[0] : 0;
+}
+
+size_t bs_iter_next(bs_iter_t *iter) {
+    size_t words = bs_num_words(iter->bs);
+
+    while (iter->word == 0) {
+        if (iter->word_ind + 1 >= words) {
+            return BITSET_EXHAUSTED;
+        }
+
+        iter->word = iter->bs->words[++(iter->word_ind)];
+    }
+
+    size_t bit = __builtin_ctzll(iter->word);
+    iter->word &= iter->word - 1;
+
+    return (iter->word_ind * BITSET_WORD_BITS) + bit;
+}
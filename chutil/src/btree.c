@@ -0,0 +1,600 @@
+
+#include "chutil/btree.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+#define BT_ALIGN_UP(x) (((x) + 7) & ~(size_t)7)
+
+static inline void *bt_key(btree_t *bt, bt_node_t *n, size_t i) {
+    return (uint8_t *)n + sizeof(bt_node_t) + (i * bt->key_size);
+}
+
+static inline void *bt_val(btree_t *bt, bt_node_t *n, size_t i) {
+    return (uint8_t *)n + bt->leaf_vals_off + (i * bt->value_size);
+}
+
+static inline bt_node_t **bt_children(btree_t *bt, bt_node_t *n) {
+    return (bt_node_t **)((uint8_t *)n + bt->inner_children_off);
+}
+
+// Fewest keys a non-root node may have.
+static inline size_t bt_min_keys(btree_t *bt, bt_node_t *n) {
+    return (n->leaf ? bt->leaf_cap : bt->inner_cap) / 2;
+}
+
+static bt_node_t *new_bt_node(btree_t *bt, bool leaf) {
+    bt_node_t *n = safe_malloc(leaf ? bt->leaf_size : bt->inner_size);
+
+    n->next = NULL;
+    n->num_keys = 0;
+    n->leaf = leaf;
+
+    return n;
+}
+
+static void delete_bt_node(btree_t *bt, bt_node_t *n) {
+    if (!(n->leaf)) {
+        bt_node_t **children = bt_children(bt, n);
+        for (size_t i = 0; i <= n->num_keys; i++) {
+            delete_bt_node(bt, children[i]);
+        }
+    }
+
+    safe_free(n);
+}
+
+// Works out node capacities and layouts from the key and value sizes.
+static void bt_init_layout(btree_t *bt) {
+    size_t hdr = sizeof(bt_node_t);
+    size_t ks = bt->key_size;
+    size_t vs = bt->value_size;
+
+    // One slot is always kept spare for overflowing before a split.
+    size_t leaf_slots = (BTREE_NODE_BYTES - hdr) / (ks + vs);
+    bt->leaf_cap = leaf_slots > BTREE_MIN_CAP + 1 ? leaf_slots - 1 : BTREE_MIN_CAP;
+
+    bt->leaf_vals_off = BT_ALIGN_UP(hdr + ((bt->leaf_cap + 1) * ks));
+    bt->leaf_size = bt->leaf_vals_off + ((bt->leaf_cap + 1) * vs);
+
+    // Internal nodes have one more child than keys.
+    size_t inner_slots = (BTREE_NODE_BYTES - hdr - sizeof(bt_node_t *)) /
+        (ks + sizeof(bt_node_t *));
+    bt->inner_cap = inner_slots > BTREE_MIN_CAP + 1 ? inner_slots - 1 : BTREE_MIN_CAP;
+
+    bt->inner_children_off = BT_ALIGN_UP(hdr + ((bt->inner_cap + 1) * ks));
+    bt->inner_size = bt->inner_children_off +
+        ((bt->inner_cap + 2) * sizeof(bt_node_t *));
+}
+
+btree_t *new_btree(size_t ks, size_t vs, sort_cmp_ft cmp) {
+    if (ks == 0 || cmp == NULL) {
+        return NULL;
+    }
+
+    btree_t *bt = safe_malloc(sizeof(btree_t));
+
+    bt->key_size = ks;
+    bt->value_size = vs;
+    bt->cmp = cmp;
+
+    bt_init_layout(bt);
+
+    bt->num_keys = 0;
+    bt->height = 1;
+    bt->root = new_bt_node(bt, true);
+    bt->first_leaf = bt->root;
+
+    bt->key_buf = safe_malloc(ks);
+
+    return bt;
+}
+
+btree_t *new_btree_from_sorted(size_t ks, size_t vs, sort_cmp_ft cmp,
+        const void *keys, const void *values, size_t n) {
+    btree_t *bt = new_btree(ks, vs, cmp);
+    if (!bt) {
+        return NULL;
+    }
+
+    const uint8_t *key_bytes = keys;
+    const uint8_t *val_bytes = values;
+
+    size_t num_unique = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (i + 1 == n || cmp(key_bytes + (i * ks), key_bytes + ((i + 1) * ks)) != 0) {
+            num_unique++;
+        }
+    }
+
+    // Pairs are spread evenly over as few leaves as possible. When there
+    // is more than one leaf, this leaves every leaf at least half full.
+    size_t num_leaves = (num_unique + bt->leaf_cap - 1) / bt->leaf_cap;
+    if (num_leaves == 0) {
+        num_leaves = 1;
+    }
+
+    // Nodes of the level being built, and the smallest key under each.
+    bt_node_t **level = safe_malloc(sizeof(bt_node_t *) * num_leaves);
+    const void **mins = safe_malloc(sizeof(void *) * num_leaves);
+
+    safe_free(bt->root);
+
+    size_t src = 0;
+    bt_node_t *prev = NULL;
+
+    for (size_t l = 0; l < num_leaves; l++) {
+        bt_node_t *leaf = new_bt_node(bt, true);
+        size_t cnt = (num_unique / num_leaves) + (l < num_unique % num_leaves ? 1 : 0);
+
+        for (size_t j = 0; j < cnt; j++) {
+            // Skip to the last of a run of equal keys.
+            while (src + 1 < n &&
+                    cmp(key_bytes + (src * ks), key_bytes + ((src + 1) * ks)) == 0) {
+                src++;
+            }
+
+            memcpy(bt_key(bt, leaf, j), key_bytes + (src * ks), ks);
+            if (vs > 0) {
+                memcpy(bt_val(bt, leaf, j), val_bytes + (src * vs), vs);
+            }
+
+            src++;
+        }
+
+        leaf->num_keys = cnt;
+
+        if (prev) {
+            prev->next = leaf;
+        }
+        prev = leaf;
+
+        level[l] = leaf;
+        mins[l] = bt_key(bt, leaf, 0);
+    }
+
+    bt->num_keys = num_unique;
+    bt->first_leaf = level[0];
+
+    // Build internal levels until there is a single root. Same even
+    // spreading as above.
+    size_t count = num_leaves;
+    while (count > 1) {
+        size_t fanout = bt->inner_cap + 1;
+        size_t parents = (count + fanout - 1) / fanout;
+        size_t c = 0;
+
+        for (size_t p = 0; p < parents; p++) {
+            size_t num_children = (count / parents) + (p < count % parents ? 1 : 0);
+
+            bt_node_t *node = new_bt_node(bt, false);
+            bt_node_t **children = bt_children(bt, node);
+
+            const void *node_min = mins[c];
+            children[0] = level[c];
+
+            for (size_t j = 1; j < num_children; j++) {
+                memcpy(bt_key(bt, node, j - 1), mins[c + j], ks);
+                children[j] = level[c + j];
+            }
+
+            node->num_keys = num_children - 1;
+
+            // p <= c, so this never clobbers a node not yet used.
+            level[p] = node;
+            mins[p] = node_min;
+
+            c += num_children;
+        }
+
+        count = parents;
+        bt->height++;
+    }
+
+    bt->root = level[0];
+
+    safe_free(mins);
+    safe_free(level);
+
+    return bt;
+}
+
+void delete_btree(btree_t *bt) {
+    delete_bt_node(bt, bt->root);
+    safe_free(bt->key_buf);
+    safe_free(bt);
+}
+
+// Index of the child of internal node n whose subtree could hold key.
+// Child i holds keys in [key i - 1, key i).
+static size_t bt_child_ind(btree_t *bt, bt_node_t *n, const void *key) {
+    size_t ind;
+    if (bsearch_cells(bt_key(bt, n, 0), n->num_keys, bt->key_size, key, bt->cmp, &ind)) {
+        ind++;
+    }
+
+    return ind;
+}
+
+static bt_node_t *bt_find_leaf(btree_t *bt, const void *key) {
+    bt_node_t *n = bt->root;
+
+    while (!(n->leaf)) {
+        n = bt_children(bt, n)[bt_child_ind(bt, n, key)];
+    }
+
+    return n;
+}
+
+// Splits a leaf which has overflowed. Returns the new right half, and
+// writes its first key to bt->key_buf.
+static bt_node_t *bt_split_leaf(btree_t *bt, bt_node_t *n) {
+    bt_node_t *right = new_bt_node(bt, true);
+
+    size_t left_n = n->num_keys / 2;
+    size_t right_n = n->num_keys - left_n;
+
+    memcpy(bt_key(bt, right, 0), bt_key(bt, n, left_n), right_n * bt->key_size);
+    memcpy(bt_val(bt, right, 0), bt_val(bt, n, left_n), right_n * bt->value_size);
+
+    right->num_keys = right_n;
+    n->num_keys = left_n;
+
+    right->next = n->next;
+    n->next = right;
+
+    memcpy(bt->key_buf, bt_key(bt, right, 0), bt->key_size);
+
+    return right;
+}
+
+// Splits an internal node which has overflowed. The middle key moves up,
+// it's written to bt->key_buf.
+static bt_node_t *bt_split_inner(btree_t *bt, bt_node_t *n) {
+    bt_node_t *right = new_bt_node(bt, false);
+
+    size_t mid = n->num_keys / 2;
+    size_t right_n = n->num_keys - mid - 1;
+
+    memcpy(bt->key_buf, bt_key(bt, n, mid), bt->key_size);
+
+    memcpy(bt_key(bt, right, 0), bt_key(bt, n, mid + 1), right_n * bt->key_size);
+    memcpy(bt_children(bt, right), bt_children(bt, n) + mid + 1,
+            (right_n + 1) * sizeof(bt_node_t *));
+
+    right->num_keys = right_n;
+    n->num_keys = mid;
+
+    return right;
+}
+
+// Puts key into the subtree at n. If n has to split, the new right
+// sibling is returned, and the key separating the two is in bt->key_buf.
+static bt_node_t *bt_insert(btree_t *bt, bt_node_t *n, const void *key, const void *value) {
+    size_t ks = bt->key_size;
+    size_t vs = bt->value_size;
+
+    if (n->leaf) {
+        size_t pos;
+        if (bsearch_cells(bt_key(bt, n, 0), n->num_keys, ks, key, bt->cmp, &pos)) {
+            memcpy(bt_val(bt, n, pos), value, vs);
+            return NULL;
+        }
+
+        size_t after = n->num_keys - pos;
+        memmove(bt_key(bt, n, pos + 1), bt_key(bt, n, pos), after * ks);
+        memmove(bt_val(bt, n, pos + 1), bt_val(bt, n, pos), after * vs);
+
+        memcpy(bt_key(bt, n, pos), key, ks);
+        memcpy(bt_val(bt, n, pos), value, vs);
+
+        n->num_keys++;
+        bt->num_keys++;
+
+        return n->num_keys > bt->leaf_cap ? bt_split_leaf(bt, n) : NULL;
+    }
+
+    size_t ci = bt_child_ind(bt, n, key);
+    bt_node_t **children = bt_children(bt, n);
+
+    bt_node_t *new_child = bt_insert(bt, children[ci], key, value);
+    if (!new_child) {
+        return NULL;
+    }
+
+    // The separator goes in at ci, the new child right after the old one.
+    size_t after = n->num_keys - ci;
+    memmove(bt_key(bt, n, ci + 1), bt_key(bt, n, ci), after * ks);
+    memmove(children + ci + 2, children + ci + 1, after * sizeof(bt_node_t *));
+
+    memcpy(bt_key(bt, n, ci), bt->key_buf, ks);
+    children[ci + 1] = new_child;
+
+    n->num_keys++;
+
+    return n->num_keys > bt->inner_cap ? bt_split_inner(bt, n) : NULL;
+}
+
+void bt_put(btree_t *bt, const void *key, const void *value) {
+    bt_node_t *right = bt_insert(bt, bt->root, key, value);
+    if (!right) {
+        return;
+    }
+
+    // The root split, grow a level.
+    bt_node_t *root = new_bt_node(bt, false);
+
+    memcpy(bt_key(bt, root, 0), bt->key_buf, bt->key_size);
+    bt_children(bt, root)[0] = bt->root;
+    bt_children(bt, root)[1] = right;
+    root->num_keys = 1;
+
+    bt->root = root;
+    bt->height++;
+}
+
+void *bt_get(btree_t *bt, const void *key) {
+    bt_node_t *leaf = bt_find_leaf(bt, key);
+
+    size_t pos;
+    if (!bsearch_cells(bt_key(bt, leaf, 0), leaf->num_keys, bt->key_size, key, bt->cmp, &pos)) {
+        return NULL;
+    }
+
+    return bt_val(bt, leaf, pos);
+}
+
+// Rebalancing after a removal.
+//
+// When a child drops below its minimum, it first tries to take a pair
+// from a sibling with some to spare. Otherwise it is merged with a
+// sibling. (Merges always free the right node)
+
+static void bt_borrow_left(btree_t *bt, bt_node_t *parent, size_t ci) {
+    size_t ks = bt->key_size;
+    size_t vs = bt->value_size;
+
+    bt_node_t **pc = bt_children(bt, parent);
+    bt_node_t *left = pc[ci - 1];
+    bt_node_t *child = pc[ci];
+
+    if (child->leaf) {
+        memmove(bt_key(bt, child, 1), bt_key(bt, child, 0), child->num_keys * ks);
+        memmove(bt_val(bt, child, 1), bt_val(bt, child, 0), child->num_keys * vs);
+
+        memcpy(bt_key(bt, child, 0), bt_key(bt, left, left->num_keys - 1), ks);
+        memcpy(bt_val(bt, child, 0), bt_val(bt, left, left->num_keys - 1), vs);
+
+        memcpy(bt_key(bt, parent, ci - 1), bt_key(bt, child, 0), ks);
+    } else {
+        bt_node_t **cc = bt_children(bt, child);
+
+        memmove(bt_key(bt, child, 1), bt_key(bt, child, 0), child->num_keys * ks);
+        memmove(cc + 1, cc, (child->num_keys + 1) * sizeof(bt_node_t *));
+
+        // The separator comes down, left's last key goes up.
+        memcpy(bt_key(bt, child, 0), bt_key(bt, parent, ci - 1), ks);
+        cc[0] = bt_children(bt, left)[left->num_keys];
+
+        memcpy(bt_key(bt, parent, ci - 1), bt_key(bt, left, left->num_keys - 1), ks);
+    }
+
+    left->num_keys--;
+    child->num_keys++;
+}
+
+static void bt_borrow_right(btree_t *bt, bt_node_t *parent, size_t ci) {
+    size_t ks = bt->key_size;
+    size_t vs = bt->value_size;
+
+    bt_node_t **pc = bt_children(bt, parent);
+    bt_node_t *child = pc[ci];
+    bt_node_t *right = pc[ci + 1];
+
+    if (child->leaf) {
+        memcpy(bt_key(bt, child, child->num_keys), bt_key(bt, right, 0), ks);
+        memcpy(bt_val(bt, child, child->num_keys), bt_val(bt, right, 0), vs);
+
+        memmove(bt_key(bt, right, 0), bt_key(bt, right, 1), (right->num_keys - 1) * ks);
+        memmove(bt_val(bt, right, 0), bt_val(bt, right, 1), (right->num_keys - 1) * vs);
+
+        memcpy(bt_key(bt, parent, ci), bt_key(bt, right, 0), ks);
+    } else {
+        bt_node_t **rc = bt_children(bt, right);
+
+        memcpy(bt_key(bt, child, child->num_keys), bt_key(bt, parent, ci), ks);
+        bt_children(bt, child)[child->num_keys + 1] = rc[0];
+
+        memcpy(bt_key(bt, parent, ci), bt_key(bt, right, 0), ks);
+
+        memmove(bt_key(bt, right, 0), bt_key(bt, right, 1), (right->num_keys - 1) * ks);
+        memmove(rc, rc + 1, right->num_keys * sizeof(bt_node_t *));
+    }
+
+    right->num_keys--;
+    child->num_keys++;
+}
+
+// Merges child li + 1 of parent into child li.
+static void bt_merge(btree_t *bt, bt_node_t *parent, size_t li) {
+    size_t ks = bt->key_size;
+    size_t vs = bt->value_size;
+
+    bt_node_t **pc = bt_children(bt, parent);
+    bt_node_t *left = pc[li];
+    bt_node_t *right = pc[li + 1];
+
+    if (left->leaf) {
+        memcpy(bt_key(bt, left, left->num_keys), bt_key(bt, right, 0), right->num_keys * ks);
+        memcpy(bt_val(bt, left, left->num_keys), bt_val(bt, right, 0), right->num_keys * vs);
+
+        left->num_keys += right->num_keys;
+        left->next = right->next;
+    } else {
+        // The separator comes down between the two halves.
+        memcpy(bt_key(bt, left, left->num_keys), bt_key(bt, parent, li), ks);
+        memcpy(bt_key(bt, left, left->num_keys + 1), bt_key(bt, right, 0), right->num_keys * ks);
+        memcpy(bt_children(bt, left) + left->num_keys + 1, bt_children(bt, right),
+                (right->num_keys + 1) * sizeof(bt_node_t *));
+
+        left->num_keys += right->num_keys + 1;
+    }
+
+    size_t after = parent->num_keys - li - 1;
+    memmove(bt_key(bt, parent, li), bt_key(bt, parent, li + 1), after * ks);
+    memmove(pc + li + 1, pc + li + 2, after * sizeof(bt_node_t *));
+    parent->num_keys--;
+
+    safe_free(right);
+}
+
+static void bt_fix_child(btree_t *bt, bt_node_t *parent, size_t ci) {
+    bt_node_t **pc = bt_children(bt, parent);
+    size_t min = bt_min_keys(bt, pc[ci]);
+
+    bt_node_t *left = ci > 0 ? pc[ci - 1] : NULL;
+    bt_node_t *right = ci < parent->num_keys ? pc[ci + 1] : NULL;
+
+    if (left && left->num_keys > min) {
+        bt_borrow_left(bt, parent, ci);
+    } else if (right && right->num_keys > min) {
+        bt_borrow_right(bt, parent, ci);
+    } else if (left) {
+        bt_merge(bt, parent, ci - 1);
+    } else {
+        bt_merge(bt, parent, ci);
+    }
+}
+
+// Returns false if key isn't in the subtree at n.
+static bool bt_delete(btree_t *bt, bt_node_t *n, const void *key) {
+    size_t ks = bt->key_size;
+    size_t vs = bt->value_size;
+
+    if (n->leaf) {
+        size_t pos;
+        if (!bsearch_cells(bt_key(bt, n, 0), n->num_keys, ks, key, bt->cmp, &pos)) {
+            return false;
+        }
+
+        size_t after = n->num_keys - pos - 1;
+        memmove(bt_key(bt, n, pos), bt_key(bt, n, pos + 1), after * ks);
+        memmove(bt_val(bt, n, pos), bt_val(bt, n, pos + 1), after * vs);
+
+        n->num_keys--;
+        bt->num_keys--;
+
+        return true;
+    }
+
+    // NOTE: separators are left alone even if they equal the removed key,
+    // they only need to split the key space correctly, not be in the tree.
+    size_t ci = bt_child_ind(bt, n, key);
+    bt_node_t *child = bt_children(bt, n)[ci];
+
+    if (!bt_delete(bt, child, key)) {
+        return false;
+    }
+
+    if (child->num_keys < bt_min_keys(bt, child)) {
+        bt_fix_child(bt, n, ci);
+    }
+
+    return true;
+}
+
+bool bt_remove(btree_t *bt, const void *key) {
+    if (!bt_delete(bt, bt->root, key)) {
+        return false;
+    }
+
+    // The root lost its last separator, drop a level.
+    if (!(bt->root->leaf) && bt->root->num_keys == 0) {
+        bt_node_t *old_root = bt->root;
+        bt->root = bt_children(bt, old_root)[0];
+        bt->height--;
+
+        safe_free(old_root);
+    }
+
+    return true;
+}
+
+// Moves iter off the end of a leaf onto the start of the next one.
+static void bt_iter_settle(bt_iter_t *iter) {
+    while (iter->leaf && iter->ind >= iter->leaf->num_keys) {
+        iter->leaf = iter->leaf->next;
+        iter->ind = 0;
+    }
+}
+
+void bt_iter_begin(btree_t *bt, bt_iter_t *iter) {
+    iter->bt = bt;
+    iter->leaf = bt->first_leaf;
+    iter->ind = 0;
+    iter->end = NULL;
+
+    bt_iter_settle(iter);
+}
+
+static void bt_seek(btree_t *bt, const void *key, bool upper, bt_iter_t *iter) {
+    bt_node_t *leaf = bt_find_leaf(bt, key);
+
+    size_t pos;
+    if (bsearch_cells(bt_key(bt, leaf, 0), leaf->num_keys, bt->key_size, key, bt->cmp, &pos)
+            && upper) {
+        pos++;
+    }
+
+    iter->bt = bt;
+    iter->leaf = leaf;
+    iter->ind = pos;
+    iter->end = NULL;
+
+    bt_iter_settle(iter);
+}
+
+void bt_lower_bound(btree_t *bt, const void *key, bt_iter_t *iter) {
+    bt_seek(bt, key, false, iter);
+}
+
+void bt_upper_bound(btree_t *bt, const void *key, bt_iter_t *iter) {
+    bt_seek(bt, key, true, iter);
+}
+
+void bt_range(btree_t *bt, const void *lo, const void *hi, bt_iter_t *iter) {
+    if (lo) {
+        bt_lower_bound(bt, lo, iter);
+    } else {
+        bt_iter_begin(bt, iter);
+    }
+
+    iter->end = hi;
+}
+
+bool bt_iter_next(bt_iter_t *iter, const void **key, void **value) {
+    if (!(iter->leaf)) {
+        return false;
+    }
+
+    btree_t *bt = iter->bt;
+    const void *k = bt_key(bt, iter->leaf, iter->ind);
+
+    if (iter->end && bt->cmp(k, iter->end) >= 0) {
+        iter->leaf = NULL;
+        return false;
+    }
+
+    if (key) {
+        *key = k;
+    }
+
+    if (value) {
+        *value = bt_val(bt, iter->leaf, iter->ind);
+    }
+
+    iter->ind++;
+    bt_iter_settle(iter);
+
+    return true;
+}
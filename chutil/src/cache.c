@@ -0,0 +1,288 @@
+
+#include "chutil/cache.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+// Each pair in the map is laid out as:
+//
+// | key | padding | cache_node_t | value |
+//
+// The padding just rounds the key up to 8 bytes. (Pairs in a slab always
+// start 8 byte aligned)
+
+// val is the map's value, not the user's.
+static inline cache_node_t *cache_val_node(const cache_t *c, void *val) {
+    return (cache_node_t *)((uint8_t *)val + c->node_offset);
+}
+
+static inline key_val_pair_t cache_node_kvp(const cache_t *c, cache_node_t *node) {
+    return (uint8_t *)node - c->node_offset - c->key_size;
+}
+
+static inline void *cache_node_val(cache_node_t *node) {
+    return (uint8_t *)node + sizeof(cache_node_t);
+}
+
+static inline uint64_t cache_node_hash(const cache_t *c, cache_node_t *node) {
+    return kvp_hash_val(cache_node_kvp(c, node));
+}
+
+static void cache_push_head(cache_t *c, cache_queue_ind_t q, cache_node_t *node) {
+    cache_queue_t *queue = &(c->queues[q]);
+
+    node->queue = (uint8_t)q;
+    node->prev = NULL;
+    node->next = queue->head;
+
+    if (queue->head) {
+        queue->head->prev = node;
+    } else {
+        queue->tail = node;
+    }
+
+    queue->head = node;
+    queue->len++;
+}
+
+static void cache_unlink(cache_t *c, cache_node_t *node) {
+    cache_queue_t *queue = &(c->queues[node->queue]);
+
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        queue->head = node->next;
+    }
+
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        queue->tail = node->prev;
+    }
+
+    queue->len--;
+}
+
+cache_t *new_cache(cache_policy_t policy, size_t capacity, size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    size_t node_offset = ((ks + 7) & ~(size_t)7) - ks;
+
+    hash_map_t *map = new_hash_map_with_flags(ks, node_offset + sizeof(cache_node_t) + vs,
+            hf, ef, HM_SLAB_ENTRIES);
+    if (!map) {
+        return NULL;
+    }
+
+    // A put adds its pair before evicting, so there can briefly be one
+    // more than capacity.
+    hm_reserve(map, capacity + 1);
+
+    cache_t *c = safe_malloc(sizeof(cache_t));
+
+    c->policy = policy;
+    c->capacity = capacity;
+    c->key_size = ks;
+    c->value_size = vs;
+    c->node_offset = node_offset;
+    c->map = map;
+
+    c->evict_func = NULL;
+    c->evict_ctx = NULL;
+
+    memset(c->queues, 0, sizeof(c->queues));
+
+    c->small_cap = 0;
+    c->ghost = NULL;
+    c->ghost_cap = 0;
+    c->ghost_start = 0;
+    c->ghost_len = 0;
+    c->ghost_filter = NULL;
+
+    if (policy == CACHE_S3FIFO) {
+        c->small_cap = (capacity * CACHE_SMALL_PERCENT) / 100;
+        if (c->small_cap == 0) {
+            c->small_cap = 1;
+        }
+
+        // Remember about as many keys as main holds.
+        c->ghost_cap = capacity - c->small_cap;
+        if (c->ghost_cap == 0) {
+            c->ghost_cap = 1;
+        }
+
+        c->ghost = safe_malloc(sizeof(uint64_t) * c->ghost_cap);
+        c->ghost_filter = new_cuckoo_filter(c->ghost_cap, hf);
+    }
+
+    c->hits = 0;
+    c->misses = 0;
+    c->evictions = 0;
+
+    return c;
+}
+
+void delete_cache(cache_t *c) {
+    if (c->evict_func) {
+        for (size_t q = 0; q < 2; q++) {
+            for (cache_node_t *node = c->queues[q].head; node; node = node->next) {
+                c->evict_func(cache_node_kvp(c, node), cache_node_val(node), c->evict_ctx);
+            }
+        }
+    }
+
+    if (c->ghost) {
+        safe_free(c->ghost);
+        delete_cuckoo_filter(c->ghost_filter);
+    }
+
+    delete_hash_map(c->map);
+    safe_free(c);
+}
+
+// The ghost ring is only a hint. If the filter ever refuses a hash,
+// (it's sized so it shouldn't) a returning key just starts in small.
+static void cache_ghost_add(cache_t *c, uint64_t hash_val) {
+    if (c->ghost_len == c->ghost_cap) {
+        cf_remove_hashed(c->ghost_filter, c->ghost[c->ghost_start]);
+
+        c->ghost_start = (c->ghost_start + 1) % c->ghost_cap;
+        c->ghost_len--;
+    }
+
+    c->ghost[(c->ghost_start + c->ghost_len) % c->ghost_cap] = hash_val;
+    c->ghost_len++;
+
+    cf_add_hashed(c->ghost_filter, hash_val);
+}
+
+// Unlinks node and takes it out of the map.
+static void cache_drop(cache_t *c, cache_node_t *node) {
+    key_val_pair_t kvp = cache_node_kvp(c, node);
+
+    if (c->evict_func) {
+        c->evict_func(kvp, cache_node_val(node), c->evict_ctx);
+    }
+
+    cache_unlink(c, node);
+
+    // The key passed in is the stored one, that's fine. It's only read
+    // before the cell is put on the map's free list.
+    hm_remove(c->map, kvp);
+}
+
+static void cache_evict_one(cache_t *c) {
+    c->evictions++;
+
+    if (c->policy == CACHE_LRU) {
+        cache_drop(c, c->queues[CACHE_SMALL].tail);
+        return;
+    }
+
+    cache_queue_t *small_q = &(c->queues[CACHE_SMALL]);
+    cache_queue_t *main_q = &(c->queues[CACHE_MAIN]);
+
+    // Every pass either promotes a node or uses up one of its hits,
+    // so this ends.
+    while (true) {
+        if (small_q->len >= c->small_cap || main_q->len == 0) {
+            cache_node_t *node = small_q->tail;
+
+            if (node->freq > 0) {
+                cache_unlink(c, node);
+                node->freq = 0;
+                cache_push_head(c, CACHE_MAIN, node);
+                continue;
+            }
+
+            cache_ghost_add(c, cache_node_hash(c, node));
+            cache_drop(c, node);
+
+            return;
+        }
+
+        cache_node_t *node = main_q->tail;
+        if (node->freq > 0) {
+            node->freq--;
+            cache_unlink(c, node);
+            cache_push_head(c, CACHE_MAIN, node);
+            continue;
+        }
+
+        cache_drop(c, node);
+        return;
+    }
+}
+
+// A use of node, from a hit or an overwrite.
+static inline void cache_touch(cache_t *c, cache_node_t *node) {
+    if (c->policy == CACHE_LRU) {
+        if (c->queues[CACHE_SMALL].head != node) {
+            cache_unlink(c, node);
+            cache_push_head(c, CACHE_SMALL, node);
+        }
+    } else if (node->freq < CACHE_MAX_FREQ) {
+        node->freq++;
+    }
+}
+
+void *cache_get(cache_t *c, const void *key) {
+    void *val = hm_get(c->map, key);
+    if (!val) {
+        c->misses++;
+        return NULL;
+    }
+
+    c->hits++;
+
+    cache_node_t *node = cache_val_node(c, val);
+    cache_touch(c, node);
+
+    return cache_node_val(node);
+}
+
+void cache_put(cache_t *c, const void *key, const void *value) {
+    bool inserted;
+    void *val = hm_get_or_insert(c->map, key, &inserted);
+    cache_node_t *node = cache_val_node(c, val);
+
+    if (!inserted) {
+        if (c->evict_func) {
+            c->evict_func(cache_node_kvp(c, node), cache_node_val(node), c->evict_ctx);
+        }
+
+        memcpy(cache_node_val(node), value, c->value_size);
+        cache_touch(c, node);
+
+        return;
+    }
+
+    memcpy(cache_node_val(node), value, c->value_size);
+    node->freq = 0;
+
+    // node isn't in a queue yet, so it can't be the one evicted.
+    if (hm_num_keys(c->map) > c->capacity) {
+        cache_evict_one(c);
+    }
+
+    cache_queue_ind_t q = CACHE_SMALL;
+    if (c->policy == CACHE_S3FIFO &&
+            cf_maybe_contains_hashed(c->ghost_filter, cache_node_hash(c, node))) {
+        q = CACHE_MAIN;
+    }
+
+    cache_push_head(c, q, node);
+}
+
+bool cache_remove(cache_t *c, const void *key) {
+    void *val = hm_get(c->map, key);
+    if (!val) {
+        return false;
+    }
+
+    cache_drop(c, cache_val_node(c, val));
+    return true;
+}
@@ -0,0 +1,459 @@
+
+#include "chutil/concurrent_map.h"
+#include "chsys/mem.h"
+#include "chsys/log.h"
+
+#include <string.h>
+
+#define CM_INIT_CAP 16
+
+static inline void *cm_node_key(cm_node_t *node) {
+    return (uint8_t *)node + sizeof(cm_node_t);
+}
+
+static inline void *cm_node_val(concurrent_map_t *cm, cm_node_t *node) {
+    return (uint8_t *)cm_node_key(node) + cm->key_size;
+}
+
+// Same Fibonacci hashing as hash_map_t.
+static inline size_t cm_chain_ind(uint64_t hash_val, size_t cap) {
+    return (size_t)((hash_val * 0x9e3779b97f4a7c15ULL) >>
+            (64 - __builtin_ctzll(cap)));
+}
+
+static cm_node_t *new_cm_node(concurrent_map_t *cm, uint64_t hash_val,
+        const void *key, const void *value) {
+    cm_node_t *node = safe_malloc(sizeof(cm_node_t) + cm->key_size + cm->value_size);
+
+    atomic_init(&(node->next), NULL);
+    node->hash_val = hash_val;
+    memcpy(cm_node_key(node), key, cm->key_size);
+    memcpy(cm_node_val(cm, node), value, cm->value_size);
+
+    return node;
+}
+
+static cm_table_t *new_cm_table(size_t cap) {
+    cm_table_t *table = safe_malloc(sizeof(cm_table_t));
+
+    table->cap = cap;
+    table->chains = safe_malloc(sizeof(_Atomic(cm_node_t *)) * cap);
+    for (size_t i = 0; i < cap; i++) {
+        atomic_init(&(table->chains[i]), NULL);
+    }
+
+    return table;
+}
+
+// Reclamation
+//
+// A reader bumps readers[epoch % 2] in its slot for as long as it is
+// reading. The epoch can only go from e to e + 1 once no slot has a
+// reader left from e - 1. (Same parity as e + 1)
+//
+// Something unlinked in epoch r can only be seen by readers from r or
+// earlier. (Readers which start after the unlink can't find it in the
+// first place) Once the epoch reaches r + 2, every reader from r has
+// finished, and it can be freed.
+//
+// No one ever waits on this. Writers just try to move the epoch along
+// and free whatever is old enough, the rest waits for the next try.
+
+static _Thread_local size_t cm_thread_slot = SIZE_MAX;
+static atomic_size_t cm_next_thread_slot = 0;
+
+static inline cm_reader_slot_t *cm_my_slot(concurrent_map_t *cm) {
+    if (cm_thread_slot == SIZE_MAX) {
+        cm_thread_slot = atomic_fetch_add(&cm_next_thread_slot, 1) % CM_NUM_READER_SLOTS;
+    }
+
+    return &(cm->reader_slots[cm_thread_slot]);
+}
+
+static size_t cm_read_begin(concurrent_map_t *cm, cm_reader_slot_t *slot) {
+    while (true) {
+        size_t e = atomic_load(&(cm->epoch));
+        atomic_fetch_add(&(slot->readers[e & 1]), 1);
+
+        // If the epoch moved on while we registered, a writer might
+        // have already checked our slot, try again.
+        if (atomic_load(&(cm->epoch)) == e) {
+            return e;
+        }
+
+        atomic_fetch_sub(&(slot->readers[e & 1]), 1);
+    }
+}
+
+static inline void cm_read_end(cm_reader_slot_t *slot, size_t e) {
+    atomic_fetch_sub(&(slot->readers[e & 1]), 1);
+}
+
+// Moves the epoch forward by 1 if no reader from the epoch before the
+// current one is left. Returns the epoch after.
+static size_t cm_try_advance(concurrent_map_t *cm) {
+    size_t e = atomic_load(&(cm->epoch));
+
+    for (size_t i = 0; i < CM_NUM_READER_SLOTS; i++) {
+        if (atomic_load(&(cm->reader_slots[i].readers[(e + 1) & 1])) > 0) {
+            return e;
+        }
+    }
+
+    // If this fails, someone else moved it for us.
+    atomic_compare_exchange_strong(&(cm->epoch), &e, e + 1);
+
+    return atomic_load(&(cm->epoch));
+}
+
+static void cm_free_table(cm_table_t *table) {
+    for (size_t i = 0; i < table->cap; i++) {
+        cm_node_t *iter = atomic_load(&(table->chains[i]));
+        while (iter) {
+            cm_node_t *next = atomic_load(&(iter->next));
+            safe_free(iter);
+            iter = next;
+        }
+    }
+
+    safe_free((void *)table->chains);
+    safe_free(table);
+}
+
+static inline void cm_free_retired(cm_retired_t *r) {
+    if (r->is_table) {
+        cm_free_table(r->ptr);
+    } else {
+        safe_free(r->ptr);
+    }
+}
+
+// Frees everything on the stripe which is old enough.
+// Expects the stripe to be held.
+static void cm_reclaim(concurrent_map_t *cm, cm_stripe_t *stripe) {
+    // It takes 2 steps for the newest retiree to be freeable.
+    cm_try_advance(cm);
+    size_t e = cm_try_advance(cm);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < stripe->num_retired; i++) {
+        if (stripe->retired[i].epoch + 2 <= e) {
+            cm_free_retired(&(stripe->retired[i]));
+        } else {
+            stripe->retired[kept++] = stripe->retired[i];
+        }
+    }
+
+    stripe->num_retired = kept;
+    stripe->reclaim_at = kept + CM_RETIRE_BATCH;
+}
+
+// Hands over memory which has just been unlinked from the map, it'll be
+// freed once no reader can be looking at it.
+// Expects the stripe to be held.
+static void cm_retire(concurrent_map_t *cm, cm_stripe_t *stripe, void *ptr, bool is_table) {
+    if (stripe->num_retired == stripe->retired_cap) {
+        stripe->retired_cap = stripe->retired_cap ? stripe->retired_cap * 2 : CM_RETIRE_BATCH;
+        stripe->retired = safe_realloc(stripe->retired,
+                sizeof(cm_retired_t) * stripe->retired_cap);
+    }
+
+    stripe->retired[stripe->num_retired++] = (cm_retired_t){
+        .ptr = ptr,
+        .is_table = is_table,
+        .epoch = atomic_load(&(cm->epoch)),
+    };
+
+    if (stripe->num_retired >= stripe->reclaim_at) {
+        cm_reclaim(cm, stripe);
+    }
+}
+
+// Frees whichever old tables are safe to free. Never waits, if another
+// writer is already at it, that's good enough.
+static void cm_reclaim_tables(concurrent_map_t *cm) {
+    if (atomic_load(&(cm->num_retired_tables)) == 0 ||
+            pthread_mutex_trylock(&(cm->retired_tables.mut)) != 0) {
+        return;
+    }
+
+    cm_reclaim(cm, &(cm->retired_tables));
+    atomic_store(&(cm->num_retired_tables), cm->retired_tables.num_retired);
+
+    pthread_mutex_unlock(&(cm->retired_tables.mut));
+}
+
+static void cm_init_stripe(cm_stripe_t *stripe) {
+    pthread_mutex_init(&(stripe->mut), NULL);
+    stripe->num_retired = 0;
+    stripe->retired_cap = 0;
+    stripe->reclaim_at = CM_RETIRE_BATCH;
+    stripe->retired = NULL;
+}
+
+// No one else is around, so nothing to wait on.
+static void cm_destroy_stripe(cm_stripe_t *stripe) {
+    for (size_t i = 0; i < stripe->num_retired; i++) {
+        cm_free_retired(&(stripe->retired[i]));
+    }
+
+    if (stripe->retired) {
+        safe_free(stripe->retired);
+    }
+
+    pthread_mutex_destroy(&(stripe->mut));
+}
+
+concurrent_map_t *new_concurrent_map(size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    if (ks == 0 || hf == NULL || ef == NULL) {
+        return NULL;
+    }
+
+    concurrent_map_t *cm = safe_malloc(sizeof(concurrent_map_t));
+
+    cm->key_size = ks;
+    cm->value_size = vs;
+    cm->hash_func = hf;
+    cm->eq_func = ef;
+
+    atomic_init(&(cm->table), new_cm_table(CM_INIT_CAP));
+    atomic_init(&(cm->num_keys), 0);
+
+    for (size_t i = 0; i < CM_NUM_STRIPES; i++) {
+        cm_init_stripe(&(cm->stripes[i]));
+    }
+
+    cm_init_stripe(&(cm->retired_tables));
+    atomic_init(&(cm->num_retired_tables), 0);
+
+    atomic_init(&(cm->epoch), 0);
+
+    cm->reader_slots_mem = safe_malloc((sizeof(cm_reader_slot_t) * CM_NUM_READER_SLOTS) +
+            CM_CACHE_LINE - 1);
+    cm->reader_slots = (cm_reader_slot_t *)(((uintptr_t)cm->reader_slots_mem +
+                CM_CACHE_LINE - 1) & ~(uintptr_t)(CM_CACHE_LINE - 1));
+
+    for (size_t i = 0; i < CM_NUM_READER_SLOTS; i++) {
+        atomic_init(&(cm->reader_slots[i].readers[0]), 0);
+        atomic_init(&(cm->reader_slots[i].readers[1]), 0);
+    }
+
+    return cm;
+}
+
+void delete_concurrent_map(concurrent_map_t *cm) {
+    cm_free_table(atomic_load(&(cm->table)));
+
+    for (size_t i = 0; i < CM_NUM_STRIPES; i++) {
+        cm_destroy_stripe(&(cm->stripes[i]));
+    }
+
+    cm_destroy_stripe(&(cm->retired_tables));
+
+    safe_free(cm->reader_slots_mem);
+    safe_free(cm);
+}
+
+// Locks the stripe covering hash_val's chain in the current table.
+// Returns said table, which can't be swapped out until the stripe
+// is unlocked.
+static cm_table_t *cm_lock_chain(concurrent_map_t *cm, uint64_t hash_val,
+        cm_stripe_t **stripe) {
+    while (true) {
+        cm_table_t *table = atomic_load(&(cm->table));
+        size_t chain_ind = cm_chain_ind(hash_val, table->cap);
+
+        *stripe = &(cm->stripes[chain_ind & (CM_NUM_STRIPES - 1)]);
+        pthread_mutex_lock(&((*stripe)->mut));
+
+        // A resize holds every stripe, so if the table is still the same
+        // now, it'll stay that way until we unlock.
+        if (atomic_load(&(cm->table)) == table) {
+            return table;
+        }
+
+        pthread_mutex_unlock(&((*stripe)->mut));
+    }
+}
+
+// Doubles the table. Readers keep using the old table until the new one
+// is published, so every node is copied rather than relinked. (Relinking
+// would send readers still in the old table down the wrong chains)
+//
+// old_cap is the capacity the caller saw when it decided to resize.
+static void cm_resize(concurrent_map_t *cm, size_t old_cap) {
+    for (size_t i = 0; i < CM_NUM_STRIPES; i++) {
+        pthread_mutex_lock(&(cm->stripes[i].mut));
+    }
+
+    cm_table_t *old_table = atomic_load(&(cm->table));
+
+    // Someone else got here first.
+    if (old_table->cap != old_cap) {
+        for (size_t i = 0; i < CM_NUM_STRIPES; i++) {
+            pthread_mutex_unlock(&(cm->stripes[i].mut));
+        }
+
+        return;
+    }
+
+    cm_table_t *new_table = new_cm_table(old_table->cap * 2);
+
+    for (size_t i = 0; i < old_table->cap; i++) {
+        cm_node_t *iter = atomic_load(&(old_table->chains[i]));
+        while (iter) {
+            cm_node_t *copy = new_cm_node(cm, iter->hash_val,
+                    cm_node_key(iter), cm_node_val(cm, iter));
+
+            size_t new_ind = cm_chain_ind(iter->hash_val, new_table->cap);
+            atomic_init(&(copy->next), atomic_load(&(new_table->chains[new_ind])));
+            atomic_init(&(new_table->chains[new_ind]), copy);
+
+            iter = atomic_load(&(iter->next));
+        }
+    }
+
+    atomic_store(&(cm->table), new_table);
+
+    for (size_t i = 0; i < CM_NUM_STRIPES; i++) {
+        pthread_mutex_unlock(&(cm->stripes[i].mut));
+    }
+
+    // Now nothing new can reach the old table. It goes out with all its
+    // nodes in one piece, no one will touch them again.
+    pthread_mutex_lock(&(cm->retired_tables.mut));
+
+    cm_retire(cm, &(cm->retired_tables), old_table, true);
+    cm_reclaim(cm, &(cm->retired_tables));
+    atomic_store(&(cm->num_retired_tables), cm->retired_tables.num_retired);
+
+    pthread_mutex_unlock(&(cm->retired_tables.mut));
+}
+
+void cm_put(concurrent_map_t *cm, const void *key, const void *value) {
+    uint64_t hash_val = cm->hash_func(key);
+
+    cm_stripe_t *stripe;
+    cm_table_t *table = cm_lock_chain(cm, hash_val, &stripe);
+
+    _Atomic(cm_node_t *) *link = &(table->chains[cm_chain_ind(hash_val, table->cap)]);
+    cm_node_t *iter;
+
+    while ((iter = atomic_load(link))) {
+        if (iter->hash_val == hash_val && cm->eq_func(cm_node_key(iter), key)) {
+            break;
+        }
+
+        link = &(iter->next);
+    }
+
+    // Either replace the old node, or add to the front of the chain.
+    cm_node_t *node = new_cm_node(cm, hash_val, key, value);
+
+    // Once the stripe is unlocked, table could be freed at any moment.
+    size_t cap = table->cap;
+    bool needs_resize = false;
+
+    if (iter) {
+        atomic_init(&(node->next), atomic_load(&(iter->next)));
+        atomic_store(link, node);
+
+        cm_retire(cm, stripe, iter, false);
+    } else {
+        _Atomic(cm_node_t *) *head = &(table->chains[cm_chain_ind(hash_val, table->cap)]);
+        atomic_init(&(node->next), atomic_load(head));
+        atomic_store(head, node);
+
+        size_t num_keys = atomic_fetch_add(&(cm->num_keys), 1) + 1;
+        needs_resize = num_keys * 2 > cap;
+    }
+
+    pthread_mutex_unlock(&(stripe->mut));
+
+    if (needs_resize) {
+        cm_resize(cm, cap);
+    }
+
+    cm_reclaim_tables(cm);
+}
+
+bool cm_remove(concurrent_map_t *cm, const void *key) {
+    uint64_t hash_val = cm->hash_func(key);
+
+    cm_stripe_t *stripe;
+    cm_table_t *table = cm_lock_chain(cm, hash_val, &stripe);
+
+    _Atomic(cm_node_t *) *link = &(table->chains[cm_chain_ind(hash_val, table->cap)]);
+    cm_node_t *iter;
+
+    while ((iter = atomic_load(link))) {
+        if (iter->hash_val == hash_val && cm->eq_func(cm_node_key(iter), key)) {
+            break;
+        }
+
+        link = &(iter->next);
+    }
+
+    if (iter) {
+        // Readers already on iter can still follow its next pointer.
+        atomic_store(link, atomic_load(&(iter->next)));
+        atomic_fetch_sub(&(cm->num_keys), 1);
+
+        cm_retire(cm, stripe, iter, false);
+    }
+
+    pthread_mutex_unlock(&(stripe->mut));
+
+    cm_reclaim_tables(cm);
+
+    return iter != NULL;
+}
+
+bool cm_get_copy(concurrent_map_t *cm, const void *key, void *dest) {
+    uint64_t hash_val = cm->hash_func(key);
+    bool found = false;
+
+    cm_reader_slot_t *slot = cm_my_slot(cm);
+    size_t e = cm_read_begin(cm, slot);
+
+    cm_table_t *table = atomic_load(&(cm->table));
+    cm_node_t *iter = atomic_load(&(table->chains[cm_chain_ind(hash_val, table->cap)]));
+
+    while (iter) {
+        if (iter->hash_val == hash_val && cm->eq_func(cm_node_key(iter), key)) {
+            if (dest) {
+                memcpy(dest, cm_node_val(cm, iter), cm->value_size);
+            }
+
+            found = true;
+            break;
+        }
+
+        iter = atomic_load(&(iter->next));
+    }
+
+    cm_read_end(slot, e);
+
+    return found;
+}
+
+bool cm_contains(concurrent_map_t *cm, const void *key) {
+    return cm_get_copy(cm, key, NULL);
+}
+
+void cm_for_each(concurrent_map_t *cm, cm_for_each_ft func, void *ctx) {
+    cm_reader_slot_t *slot = cm_my_slot(cm);
+    size_t e = cm_read_begin(cm, slot);
+
+    cm_table_t *table = atomic_load(&(cm->table));
+    for (size_t i = 0; i < table->cap; i++) {
+        cm_node_t *iter = atomic_load(&(table->chains[i]));
+        while (iter) {
+            func(cm_node_key(iter), cm_node_val(cm, iter), ctx);
+            iter = atomic_load(&(iter->next));
+        }
+    }
+
+    cm_read_end(slot, e);
+}
@@ -0,0 +1,256 @@
+
+#include "chutil/filter.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+// Bloom filter
+
+#define BF_BLOCK_BITS (BF_BLOCK_WORDS * 64)
+#define BF_CACHE_LINE 64
+
+// Odd constants, one per word. Multiplying the low half of the hash by
+// each and keeping the top 6 bits gives each word its own bit to check.
+static const uint32_t BF_SALTS[BF_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+bloom_filter_t *new_bloom_filter(size_t expected_keys, size_t bits_per_key,
+        hash_map_hash_ft hf) {
+    bloom_filter_t *bf = safe_malloc(sizeof(bloom_filter_t));
+
+    size_t num_blocks = ((expected_keys * bits_per_key) + BF_BLOCK_BITS - 1) / BF_BLOCK_BITS;
+    if (num_blocks == 0) {
+        num_blocks = 1;
+    }
+
+    bf->hash_func = hf;
+    bf->num_blocks = num_blocks;
+
+    bf->blocks_mem = safe_malloc((num_blocks * sizeof(bf_block_t)) + BF_CACHE_LINE - 1);
+    bf->blocks = (bf_block_t *)(((uintptr_t)bf->blocks_mem + BF_CACHE_LINE - 1) &
+            ~(uintptr_t)(BF_CACHE_LINE - 1));
+
+    bf_clear(bf);
+
+    return bf;
+}
+
+void delete_bloom_filter(bloom_filter_t *bf) {
+    safe_free(bf->blocks_mem);
+    safe_free(bf);
+}
+
+// The top half of the hash picks the block, the bottom half the bits.
+static inline bf_block_t *bf_block(const bloom_filter_t *bf, uint64_t hash_val) {
+    return &(bf->blocks[((hash_val >> 32) * bf->num_blocks) >> 32]);
+}
+
+static inline uint64_t bf_mask(uint32_t h, size_t i) {
+    return (uint64_t)1 << ((h * BF_SALTS[i]) >> 26);
+}
+
+void bf_add_hashed(bloom_filter_t *bf, uint64_t hash_val) {
+    bf_block_t *block = bf_block(bf, hash_val);
+    uint32_t h = (uint32_t)hash_val;
+
+    for (size_t i = 0; i < BF_BLOCK_WORDS; i++) {
+        block->words[i] |= bf_mask(h, i);
+    }
+}
+
+bool bf_maybe_contains_hashed(const bloom_filter_t *bf, uint64_t hash_val) {
+    const bf_block_t *block = bf_block(bf, hash_val);
+    uint32_t h = (uint32_t)hash_val;
+
+    // No early exit, so the loop stays branch free.
+    uint64_t missing = 0;
+    for (size_t i = 0; i < BF_BLOCK_WORDS; i++) {
+        uint64_t mask = bf_mask(h, i);
+        missing |= (block->words[i] & mask) ^ mask;
+    }
+
+    return missing == 0;
+}
+
+void bf_clear(bloom_filter_t *bf) {
+    memset(bf->blocks, 0, bf->num_blocks * sizeof(bf_block_t));
+}
+
+// Cuckoo filter
+
+// Fingerprints come from the bottom 16 bits of the hash, the first
+// bucket from the top bits. 0 is saved for empty slots.
+static inline uint16_t cf_fingerprint(uint64_t hash_val) {
+    uint16_t fp = (uint16_t)hash_val;
+    return fp ? fp : 1;
+}
+
+static inline size_t cf_index(const cuckoo_filter_t *cf, uint64_t hash_val) {
+    return (size_t)(hash_val >> 32) & (cf->num_buckets - 1);
+}
+
+// XOR with a scrambled fingerprint, so alt(alt(i)) == i.
+static inline size_t cf_alt_index(const cuckoo_filter_t *cf, size_t ind, uint16_t fp) {
+    return (ind ^ (size_t)(fp * 0x5bd1e995U)) & (cf->num_buckets - 1);
+}
+
+static inline uint64_t cf_next_rand(cuckoo_filter_t *cf) {
+    cf->rng ^= cf->rng << 13;
+    cf->rng ^= cf->rng >> 7;
+    cf->rng ^= cf->rng << 17;
+    return cf->rng;
+}
+
+cuckoo_filter_t *new_cuckoo_filter(size_t capacity, hash_map_hash_ft hf) {
+    cuckoo_filter_t *cf = safe_malloc(sizeof(cuckoo_filter_t));
+
+    // Aim for at most 95% full.
+    size_t min_buckets = ((capacity * 20 / 19) + CF_BUCKET_SIZE - 1) / CF_BUCKET_SIZE;
+
+    // 2 buckets at least, otherwise a key's alternate bucket is its first.
+    size_t num_buckets = 2;
+    while (num_buckets < min_buckets) {
+        num_buckets *= 2;
+    }
+
+    cf->hash_func = hf;
+    cf->num_buckets = num_buckets;
+
+    cf->fps = safe_malloc(num_buckets * CF_BUCKET_SIZE * sizeof(uint16_t));
+    memset(cf->fps, 0, num_buckets * CF_BUCKET_SIZE * sizeof(uint16_t));
+
+    cf->num_keys = 0;
+    cf->has_victim = false;
+    cf->victim_ind = 0;
+    cf->victim_fp = 0;
+
+    cf->rng = 0x9e3779b97f4a7c15ULL;
+
+    return cf;
+}
+
+void delete_cuckoo_filter(cuckoo_filter_t *cf) {
+    safe_free(cf->fps);
+    safe_free(cf);
+}
+
+static bool cf_bucket_insert(cuckoo_filter_t *cf, size_t ind, uint16_t fp) {
+    uint16_t *bucket = cf->fps + (ind * CF_BUCKET_SIZE);
+
+    for (size_t i = 0; i < CF_BUCKET_SIZE; i++) {
+        if (bucket[i] == 0) {
+            bucket[i] = fp;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool cf_bucket_contains(const cuckoo_filter_t *cf, size_t ind, uint16_t fp) {
+    const uint16_t *bucket = cf->fps + (ind * CF_BUCKET_SIZE);
+
+    bool found = false;
+    for (size_t i = 0; i < CF_BUCKET_SIZE; i++) {
+        found |= bucket[i] == fp;
+    }
+
+    return found;
+}
+
+static bool cf_bucket_remove(cuckoo_filter_t *cf, size_t ind, uint16_t fp) {
+    uint16_t *bucket = cf->fps + (ind * CF_BUCKET_SIZE);
+
+    for (size_t i = 0; i < CF_BUCKET_SIZE; i++) {
+        if (bucket[i] == fp) {
+            bucket[i] = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Places fp in bucket ind or its alternate, kicking other fingerprints
+// out of the way if needed. If we run out of kicks, whichever fingerprint
+// is left over becomes the victim.
+static void cf_insert(cuckoo_filter_t *cf, size_t ind, uint16_t fp) {
+    size_t alt = cf_alt_index(cf, ind, fp);
+    if (cf_bucket_insert(cf, ind, fp) || cf_bucket_insert(cf, alt, fp)) {
+        return;
+    }
+
+    if (cf_next_rand(cf) & 1) {
+        ind = alt;
+    }
+
+    for (size_t kick = 0; kick < CF_MAX_KICKS; kick++) {
+        uint16_t *slot = cf->fps + (ind * CF_BUCKET_SIZE) + (cf_next_rand(cf) % CF_BUCKET_SIZE);
+
+        uint16_t kicked = *slot;
+        *slot = fp;
+        fp = kicked;
+
+        ind = cf_alt_index(cf, ind, fp);
+        if (cf_bucket_insert(cf, ind, fp)) {
+            return;
+        }
+    }
+
+    cf->has_victim = true;
+    cf->victim_ind = ind;
+    cf->victim_fp = fp;
+}
+
+bool cf_add_hashed(cuckoo_filter_t *cf, uint64_t hash_val) {
+    if (cf->has_victim) {
+        return false;
+    }
+
+    cf_insert(cf, cf_index(cf, hash_val), cf_fingerprint(hash_val));
+    cf->num_keys++;
+
+    return true;
+}
+
+bool cf_maybe_contains_hashed(const cuckoo_filter_t *cf, uint64_t hash_val) {
+    uint16_t fp = cf_fingerprint(hash_val);
+    size_t i1 = cf_index(cf, hash_val);
+    size_t i2 = cf_alt_index(cf, i1, fp);
+
+    if (cf_bucket_contains(cf, i1, fp) || cf_bucket_contains(cf, i2, fp)) {
+        return true;
+    }
+
+    return cf->has_victim && cf->victim_fp == fp &&
+        (cf->victim_ind == i1 || cf->victim_ind == i2);
+}
+
+bool cf_remove_hashed(cuckoo_filter_t *cf, uint64_t hash_val) {
+    uint16_t fp = cf_fingerprint(hash_val);
+    size_t i1 = cf_index(cf, hash_val);
+    size_t i2 = cf_alt_index(cf, i1, fp);
+
+    if (cf->has_victim && cf->victim_fp == fp &&
+            (cf->victim_ind == i1 || cf->victim_ind == i2)) {
+        cf->has_victim = false;
+        cf->num_keys--;
+        return true;
+    }
+
+    if (!cf_bucket_remove(cf, i1, fp) && !cf_bucket_remove(cf, i2, fp)) {
+        return false;
+    }
+
+    cf->num_keys--;
+
+    // There's room now, try to give the victim a home.
+    if (cf->has_victim) {
+        cf->has_victim = false;
+        cf_insert(cf, cf->victim_ind, cf->victim_fp);
+    }
+
+    return true;
+}
@@ -0,0 +1,266 @@
+
+#include "chutil/flat_map.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+#define FM_INIT_CAP 4
+
+// Smallest index ever built.
+#define FM_INIT_INDEX_CAP 16
+
+static inline void *fm_pair(flat_map_t *fm, size_t i) {
+    return fm->pairs + (i * fm->pair_size);
+}
+
+// Fibonacci hashing, the top bits of the product pick the home slot.
+static inline size_t fm_home(flat_map_t *fm, uint64_t hash_val) {
+    return (size_t)((hash_val * 0x9e3779b97f4a7c15ULL) >> fm->index_shift);
+}
+
+static void fm_index_insert(flat_map_t *fm, uint32_t p) {
+    size_t mask = fm->index_cap - 1;
+    size_t slot = fm_home(fm, fm->hashes[p]);
+
+    while (fm->index[slot] != FLAT_MAP_INDEX_EMPTY) {
+        slot = (slot + 1) & mask;
+    }
+
+    fm->index[slot] = p;
+}
+
+static void fm_build_index(flat_map_t *fm, size_t index_cap) {
+    if (fm->index) {
+        safe_free(fm->index);
+    }
+
+    fm->index_cap = index_cap;
+    fm->index_shift = 64 - __builtin_ctzll(index_cap);
+    fm->index = safe_malloc(sizeof(uint32_t) * index_cap);
+    memset(fm->index, 0xFF, sizeof(uint32_t) * index_cap);
+
+    for (size_t p = 0; p < fm->num_keys; p++) {
+        fm_index_insert(fm, (uint32_t)p);
+    }
+}
+
+// Empties the given index slot. Later entries of the same run are shifted
+// back to fill the gap, so lookups never need tombstones.
+static void fm_index_delete(flat_map_t *fm, size_t slot) {
+    size_t mask = fm->index_cap - 1;
+    size_t hole = slot;
+    size_t i = slot;
+
+    while (true) {
+        i = (i + 1) & mask;
+
+        uint32_t p = fm->index[i];
+        if (p == FLAT_MAP_INDEX_EMPTY) {
+            break;
+        }
+
+        // p can only move back if its home isn't between the hole and i.
+        size_t home = fm_home(fm, fm->hashes[p]);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            fm->index[hole] = p;
+            hole = i;
+        }
+    }
+
+    fm->index[hole] = FLAT_MAP_INDEX_EMPTY;
+}
+
+// Finds the index slot holding pair p, and makes it hold new_p instead.
+static void fm_index_repoint(flat_map_t *fm, uint32_t p, uint32_t new_p) {
+    size_t mask = fm->index_cap - 1;
+    size_t slot = fm_home(fm, fm->hashes[p]);
+
+    while (fm->index[slot] != p) {
+        slot = (slot + 1) & mask;
+    }
+
+    fm->index[slot] = new_p;
+}
+
+// Returns the position of key, or num_keys if it isn't in the map.
+// If the index is built, and slot is non-NULL, the index slot of the key
+// is written to slot.
+static size_t fm_find(flat_map_t *fm, const void *key, uint64_t hash_val, size_t *slot) {
+    if (!(fm->index)) {
+        for (size_t p = 0; p < fm->num_keys; p++) {
+            if (fm->hashes[p] == hash_val && fm->eq_func(fm_pair(fm, p), key)) {
+                return p;
+            }
+        }
+
+        return fm->num_keys;
+    }
+
+    size_t mask = fm->index_cap - 1;
+    size_t s = fm_home(fm, hash_val);
+
+    uint32_t p;
+    while ((p = fm->index[s]) != FLAT_MAP_INDEX_EMPTY) {
+        if (fm->hashes[p] == hash_val && fm->eq_func(fm_pair(fm, p), key)) {
+            if (slot) {
+                *slot = s;
+            }
+
+            return p;
+        }
+
+        s = (s + 1) & mask;
+    }
+
+    return fm->num_keys;
+}
+
+flat_map_t *new_flat_map(size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    if (ks == 0 || hf == NULL || ef == NULL) {
+        return NULL;
+    }
+
+    flat_map_t *fm = safe_malloc(sizeof(flat_map_t));
+
+    fm->key_size = ks;
+    fm->value_size = vs;
+
+    // Same alignment rule as the swiss map.
+    size_t align = ks & -ks;
+    if (align > 8) {
+        align = 8;
+    }
+    fm->pair_size = (ks + vs + align - 1) & ~(align - 1);
+
+    fm->hash_func = hf;
+    fm->eq_func = ef;
+
+    fm->num_keys = 0;
+    fm->cap = FM_INIT_CAP;
+
+    fm->pairs = safe_malloc(fm->pair_size * fm->cap);
+    fm->hashes = safe_malloc(sizeof(uint64_t) * fm->cap);
+
+    fm->index_cap = 0;
+    fm->index_shift = 0;
+    fm->index = NULL;
+
+    return fm;
+}
+
+void delete_flat_map(flat_map_t *fm) {
+    if (fm->index) {
+        safe_free(fm->index);
+    }
+
+    safe_free(fm->hashes);
+    safe_free(fm->pairs);
+    safe_free(fm);
+}
+
+void fm_put(flat_map_t *fm, const void *key, const void *value) {
+    uint64_t hash_val = fm->hash_func(key);
+
+    size_t p = fm_find(fm, key, hash_val, NULL);
+    if (p < fm->num_keys) {
+        memcpy(fm_kvp_val(fm, fm_pair(fm, p)), value, fm->value_size);
+        return;
+    }
+
+    if (fm->num_keys == fm->cap) {
+        fm->cap *= 2;
+        fm->pairs = safe_realloc(fm->pairs, fm->pair_size * fm->cap);
+        fm->hashes = safe_realloc(fm->hashes, sizeof(uint64_t) * fm->cap);
+    }
+
+    void *pair = fm_pair(fm, p);
+    memcpy(pair, key, fm->key_size);
+    memcpy(fm_kvp_val(fm, pair), value, fm->value_size);
+    fm->hashes[p] = hash_val;
+
+    fm->num_keys++;
+
+    if (fm->index) {
+        if (fm->num_keys * 2 > fm->index_cap) {
+            fm_build_index(fm, fm->index_cap * 2);
+        } else {
+            fm_index_insert(fm, (uint32_t)p);
+        }
+    } else if (fm->num_keys > FLAT_MAP_MAX_SCAN) {
+        size_t index_cap = FM_INIT_INDEX_CAP;
+        while (index_cap < fm->num_keys * 2) {
+            index_cap *= 2;
+        }
+
+        fm_build_index(fm, index_cap);
+    }
+}
+
+void *fm_get(flat_map_t *fm, const void *key) {
+    size_t p = fm_find(fm, key, fm->hash_func(key), NULL);
+    if (p == fm->num_keys) {
+        return NULL;
+    }
+
+    return fm_kvp_val(fm, fm_pair(fm, p));
+}
+
+bool fm_remove(flat_map_t *fm, const void *key) {
+    size_t slot = 0;
+    size_t p = fm_find(fm, key, fm->hash_func(key), &slot);
+    if (p == fm->num_keys) {
+        return false;
+    }
+
+    size_t last = fm->num_keys - 1;
+
+    if (fm->index) {
+        fm_index_delete(fm, slot);
+    }
+
+    // Fill the gap with the last pair.
+    if (p != last) {
+        if (fm->index) {
+            fm_index_repoint(fm, (uint32_t)last, (uint32_t)p);
+        }
+
+        memcpy(fm_pair(fm, p), fm_pair(fm, last), fm->pair_size);
+        fm->hashes[p] = fm->hashes[last];
+    }
+
+    fm->num_keys--;
+
+    return true;
+}
+
+static void fm_map_iter_begin(flat_map_t *fm, map_iter_t *iter) {
+    iter->map = fm;
+    iter->ind = 0;
+}
+
+static key_val_pair_t fm_map_iter_next(map_iter_t *iter) {
+    flat_map_t *fm = iter->map;
+    if (iter->ind < fm->num_keys) {
+        return fm_pair(fm, iter->ind++);
+    }
+
+    return HASH_MAP_EXHAUSTED;
+}
+
+static const map_impl_t FLAT_MAP_IMPL_VAL = {
+    .constructor = (map_constructor_ft)new_flat_map,
+    .destructor = (map_destructor_ft)delete_flat_map,
+    .num_keys = (map_num_keys_ft)fm_num_keys,
+    .key_size = (map_key_size_ft)fm_key_size,
+    .value_size = (map_value_size_ft)fm_value_size,
+    .kvp_key = (map_kvp_key_ft)fm_kvp_key,
+    .kvp_val = (map_kvp_val_ft)fm_kvp_val,
+    .put = (map_put_ft)fm_put,
+    .get = (map_get_ft)fm_get,
+    .remove = (map_remove_ft)fm_remove,
+
+    .iter_begin = (map_iter_begin_ft)fm_map_iter_begin,
+    .iter_next = fm_map_iter_next,
+};
+const map_impl_t *FLAT_MAP_IMPL = &FLAT_MAP_IMPL_VAL;
@@ -0,0 +1,444 @@
+
+#include "chutil/frozen_map.h"
+#include "chsys/mem.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Seeds tried before giving up on a freeze. Each failure is unlikely,
+// so running out means keys which can never be told apart.
+#define FRM_MAX_SEEDS 64
+
+// Displacements tried for one bucket before trying a new seed.
+#define FRM_MAX_TRIES ((uint64_t)1 << 22)
+
+#define FRM_INITIAL_SEED 0x243f6a8885a308d3ULL
+
+// Where a key lands, for a given seed.
+//
+// The top half of the first mix picks the bucket, the bottom half is f1.
+// f2 comes from a second mix. (Each scaled into range with a multiply
+// and shift rather than a %) A bucket with displacement (d0, d1) puts
+// each of its keys at (f1 + d0 * f2 + d1) % num_keys.
+typedef struct _frm_place_t {
+    uint32_t bucket;
+    uint32_t f1;
+    uint32_t f2;
+} frm_place_t;
+
+static inline uint64_t frm_mix(uint64_t x) {
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ULL;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ULL;
+    x ^= x >> 32;
+    return x;
+}
+
+static inline frm_place_t frm_place(const frozen_map_header_t *header, uint64_t hash_val) {
+    uint64_t g1 = frm_mix(hash_val ^ header->seed);
+    uint64_t g2 = frm_mix(g1 + 0x9e3779b97f4a7c15ULL);
+
+    frm_place_t p = {
+        .bucket = (uint32_t)(((g1 >> 32) * header->num_buckets) >> 32),
+        .f1 = (uint32_t)(((g1 & UINT32_MAX) * header->num_keys) >> 32),
+        .f2 = (uint32_t)(((g2 >> 32) * header->num_keys) >> 32),
+    };
+
+    return p;
+}
+
+static inline uint32_t frm_slot(const frozen_map_header_t *header, frm_place_t p,
+        frozen_map_disp_t d) {
+    return (uint32_t)(((uint64_t)p.f1 + d.d1 + ((uint64_t)d.d0 * p.f2)) % header->num_keys);
+}
+
+static inline frozen_map_disp_t *frm_disps(const frozen_map_t *frm) {
+    return (frozen_map_disp_t *)((uint8_t *)&(frm->header) + sizeof(frozen_map_header_t));
+}
+
+static inline uint8_t *frm_entry(const frozen_map_t *frm, size_t i) {
+    return (uint8_t *)(frm_disps(frm) + frm->header.num_buckets) + (i * frm->header.entry_size);
+}
+
+static inline size_t frm_blob_size(const frozen_map_header_t *header) {
+    return sizeof(frozen_map_header_t) + (header->num_buckets * sizeof(frozen_map_disp_t)) +
+        (header->num_keys * header->entry_size);
+}
+
+static frozen_map_t *new_frozen_map(hash_map_hash_ft hf, hash_map_key_eq_ft ef,
+        const frozen_map_header_t *header) {
+    size_t blob_size = frm_blob_size(header);
+    frozen_map_t *frm = safe_malloc(offsetof(frozen_map_t, header) + blob_size);
+
+    frm->hash_func = hf;
+    frm->eq_func = ef;
+    frm->blob_size = blob_size;
+    frm->header = *header;
+
+    return frm;
+}
+
+// Scratch space used while searching for displacements.
+typedef struct _frm_builder_t {
+    size_t n;
+
+    const uint8_t **kvps;
+    uint64_t *hashes;
+    frm_place_t *places;
+
+    // Keys grouped by bucket. Bucket b's keys are
+    // bucket_keys[bucket_starts[b] .. bucket_starts[b + 1])
+    uint32_t *bucket_starts;
+    uint32_t *bucket_keys;
+
+    // Buckets, biggest first.
+    uint32_t *order;
+
+    // Which key sits in each slot. (UINT32_MAX when free)
+    uint32_t *slots;
+} frm_builder_t;
+
+typedef enum _frm_search_result_t {
+    FRM_FOUND,
+    FRM_NOT_FOUND,
+
+    // Two keys with the exact same hash, no seed will ever help.
+    FRM_HOPELESS,
+} frm_search_result_t;
+
+// Looks for a displacement which puts every key of bucket b in a free slot.
+// On success the keys are placed.
+static frm_search_result_t frm_place_bucket(frm_builder_t *b, const frozen_map_header_t *header,
+        uint32_t bucket, frozen_map_disp_t *disp) {
+    const uint32_t *keys = b->bucket_keys + b->bucket_starts[bucket];
+    uint32_t k = b->bucket_starts[bucket + 1] - b->bucket_starts[bucket];
+
+    for (uint32_t i = 0; i < k; i++) {
+        for (uint32_t j = i + 1; j < k; j++) {
+            if (b->hashes[keys[i]] == b->hashes[keys[j]]) {
+                return FRM_HOPELESS;
+            }
+        }
+    }
+
+    uint64_t m = header->num_keys;
+    uint64_t tries = 0;
+
+    frozen_map_disp_t d;
+    for (d.d0 = 0; d.d0 < m; d.d0++) {
+        for (d.d1 = 0; d.d1 < m; d.d1++) {
+            if (++tries > FRM_MAX_TRIES) {
+                return FRM_NOT_FOUND;
+            }
+
+            // Claim slots one at a time, so keys of this bucket which land
+            // on each other are caught too.
+            uint32_t placed = 0;
+            for (; placed < k; placed++) {
+                uint32_t slot = frm_slot(header, b->places[keys[placed]], d);
+                if (b->slots[slot] != UINT32_MAX) {
+                    break;
+                }
+
+                b->slots[slot] = keys[placed];
+            }
+
+            if (placed == k) {
+                *disp = d;
+                return FRM_FOUND;
+            }
+
+            while (placed > 0) {
+                placed--;
+                b->slots[frm_slot(header, b->places[keys[placed]], d)] = UINT32_MAX;
+            }
+        }
+    }
+
+    return FRM_NOT_FOUND;
+}
+
+// Tries to find a displacement for every bucket using header's seed.
+static frm_search_result_t frm_try_seed(frm_builder_t *b, const frozen_map_header_t *header,
+        frozen_map_disp_t *disps) {
+    size_t n = b->n;
+    size_t r = header->num_buckets;
+
+    for (size_t i = 0; i < n; i++) {
+        b->places[i] = frm_place(header, b->hashes[i]);
+        b->slots[i] = UINT32_MAX;
+    }
+
+    // Counting sort keys into buckets.
+    memset(b->bucket_starts, 0, sizeof(uint32_t) * (r + 1));
+    for (size_t i = 0; i < n; i++) {
+        b->bucket_starts[b->places[i].bucket + 1]++;
+    }
+
+    uint32_t max_k = 0;
+    for (size_t i = 0; i < r; i++) {
+        if (b->bucket_starts[i + 1] > max_k) {
+            max_k = b->bucket_starts[i + 1];
+        }
+
+        b->bucket_starts[i + 1] += b->bucket_starts[i];
+    }
+
+    // order is borrowed as a fill cursor for each bucket here.
+    memcpy(b->order, b->bucket_starts, sizeof(uint32_t) * r);
+    for (size_t i = 0; i < n; i++) {
+        b->bucket_keys[b->order[b->places[i].bucket]++] = (uint32_t)i;
+    }
+
+    // Then a counting sort of buckets by size, biggest first. Big buckets
+    // are the hardest to place, so they go while the table is emptiest.
+    uint32_t *size_starts = safe_malloc(sizeof(uint32_t) * (max_k + 2));
+    memset(size_starts, 0, sizeof(uint32_t) * (max_k + 2));
+
+    for (size_t i = 0; i < r; i++) {
+        uint32_t k = b->bucket_starts[i + 1] - b->bucket_starts[i];
+        size_starts[(max_k - k) + 1]++;
+    }
+
+    for (uint32_t i = 0; i <= max_k; i++) {
+        size_starts[i + 1] += size_starts[i];
+    }
+
+    for (size_t i = 0; i < r; i++) {
+        uint32_t k = b->bucket_starts[i + 1] - b->bucket_starts[i];
+        b->order[size_starts[max_k - k]++] = (uint32_t)i;
+    }
+
+    safe_free(size_starts);
+
+    frozen_map_disp_t zero = {0, 0};
+
+    // Slots before this are all taken, only used once the buckets left
+    // hold a single key.
+    size_t free_slot = 0;
+
+    for (size_t i = 0; i < r; i++) {
+        uint32_t bucket = b->order[i];
+        uint32_t k = b->bucket_starts[bucket + 1] - b->bucket_starts[bucket];
+        disps[bucket] = zero;
+
+        if (k == 0) {
+            continue;
+        }
+
+        // A single key can go in any free slot, d1 is just picked to
+        // land it there. (Searching would be slow, the table is nearly
+        // full by now)
+        if (k == 1) {
+            while (b->slots[free_slot] != UINT32_MAX) {
+                free_slot++;
+            }
+
+            uint32_t key = b->bucket_keys[b->bucket_starts[bucket]];
+            disps[bucket].d1 = (uint32_t)((free_slot + n - b->places[key].f1) % n);
+            b->slots[free_slot] = key;
+
+            continue;
+        }
+
+        frm_search_result_t res = frm_place_bucket(b, header, bucket, &(disps[bucket]));
+        if (res != FRM_FOUND) {
+            return res;
+        }
+    }
+
+    return FRM_FOUND;
+}
+
+frozen_map_t *hm_freeze(hash_map_t *hm) {
+    size_t n = hm->num_keys;
+
+    // Slots and buckets are indexed with 32 bits.
+    if (n >= UINT32_MAX) {
+        return NULL;
+    }
+
+    frozen_map_header_t header = {
+        .magic = FROZEN_MAP_MAGIC,
+        .key_size = hm->key_size,
+        .value_size = hm->value_size,
+        .entry_size = (hm->key_size + hm->value_size + 7) & ~(size_t)7,
+        .num_keys = n,
+        .num_buckets = (n + FROZEN_MAP_BUCKET_SIZE - 1) / FROZEN_MAP_BUCKET_SIZE,
+        .seed = FRM_INITIAL_SEED,
+    };
+
+    frozen_map_t *frm = new_frozen_map(hm->hash_func, hm->eq_func, &header);
+    if (n == 0) {
+        return frm;
+    }
+
+    size_t r = header.num_buckets;
+
+    frm_builder_t b = {
+        .n = n,
+        .kvps = safe_malloc(sizeof(uint8_t *) * n),
+        .hashes = safe_malloc(sizeof(uint64_t) * n),
+        .places = safe_malloc(sizeof(frm_place_t) * n),
+        .bucket_starts = safe_malloc(sizeof(uint32_t) * (r + 1)),
+        .bucket_keys = safe_malloc(sizeof(uint32_t) * n),
+        .order = safe_malloc(sizeof(uint32_t) * r),
+        .slots = safe_malloc(sizeof(uint32_t) * n),
+    };
+
+    hm_iter_t iter;
+    key_val_pair_t kvp;
+    size_t i = 0;
+
+    hm_iter_begin(hm, &iter);
+    while ((kvp = hm_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        b.kvps[i] = kvp;
+
+        // The hash stored in the chain header saves calling hash_func again.
+        b.hashes[i] = kvp_hash_val(kvp);
+        i++;
+    }
+
+    frm_search_result_t res = FRM_NOT_FOUND;
+    for (size_t s = 0; s < FRM_MAX_SEEDS && res == FRM_NOT_FOUND; s++) {
+        frm->header.seed = FRM_INITIAL_SEED + (s * 0x9e3779b97f4a7c15ULL);
+        res = frm_try_seed(&b, &(frm->header), frm_disps(frm));
+    }
+
+    if (res == FRM_FOUND) {
+        size_t pair_size = header.key_size + header.value_size;
+
+        for (size_t slot = 0; slot < n; slot++) {
+            uint8_t *entry = frm_entry(frm, slot);
+
+            memcpy(entry, b.kvps[b.slots[slot]], pair_size);
+            memset(entry + pair_size, 0, header.entry_size - pair_size);
+        }
+    } else {
+        safe_free(frm);
+        frm = NULL;
+    }
+
+    safe_free(b.kvps);
+    safe_free(b.hashes);
+    safe_free(b.places);
+    safe_free(b.bucket_starts);
+    safe_free(b.bucket_keys);
+    safe_free(b.order);
+    safe_free(b.slots);
+
+    return frm;
+}
+
+void delete_frozen_map(frozen_map_t *frm) {
+    safe_free(frm);
+}
+
+const void *frm_get(const frozen_map_t *frm, const void *key) {
+    const frozen_map_header_t *header = &(frm->header);
+    if (header->num_keys == 0) {
+        return NULL;
+    }
+
+    frm_place_t p = frm_place(header, frm->hash_func(key));
+    const uint8_t *entry = frm_entry(frm, frm_slot(header, p, frm_disps(frm)[p.bucket]));
+
+    if (!(frm->eq_func(entry, key))) {
+        return NULL;
+    }
+
+    return entry + header->key_size;
+}
+
+void frm_for_each(const frozen_map_t *frm, frm_for_each_ft func, void *ctx) {
+    for (size_t i = 0; i < frm->header.num_keys; i++) {
+        const uint8_t *entry = frm_entry(frm, i);
+        func(entry, entry + frm->header.key_size, ctx);
+    }
+}
+
+bool frm_write(const frozen_map_t *frm, FILE *fp) {
+    return fwrite(&(frm->header), 1, frm->blob_size, fp) == frm->blob_size;
+}
+
+// Number of bytes between the current position and the end of fp.
+// Returns false if fp can't seek.
+static bool frm_bytes_left(FILE *fp, size_t *left) {
+    long pos = ftell(fp);
+    if (pos < 0 || fseek(fp, 0, SEEK_END) != 0) {
+        return false;
+    }
+
+    long end = ftell(fp);
+    if (end < 0 || fseek(fp, pos, SEEK_SET) != 0) {
+        return false;
+    }
+
+    *left = end > pos ? (size_t)(end - pos) : 0;
+    return true;
+}
+
+frozen_map_t *frm_read(FILE *fp, hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    frozen_map_header_t header;
+    if (fread(&header, sizeof(frozen_map_header_t), 1, fp) != 1) {
+        return NULL;
+    }
+
+    // Reject anything which couldn't have come from hm_freeze, so a bad
+    // file can't send a lookup out of bounds. (The size limits also keep
+    // the blob size from overflowing)
+    bool valid = header.magic == FROZEN_MAP_MAGIC &&
+        header.num_keys < UINT32_MAX &&
+        header.key_size < ((uint64_t)1 << 30) &&
+        header.value_size < ((uint64_t)1 << 30) &&
+        header.entry_size == ((header.key_size + header.value_size + 7) & ~(uint64_t)7) &&
+        header.num_buckets == (header.num_keys + FROZEN_MAP_BUCKET_SIZE - 1) / 
+            FROZEN_MAP_BUCKET_SIZE;
+
+    if (!valid) {
+        return NULL;
+    }
+
+    // Make sure the file actually holds the whole map before allocating
+    // space for it. Otherwise a bad header could ask for any amount.
+    size_t rest = frm_blob_size(&header) - sizeof(frozen_map_header_t);
+    size_t left;
+
+    if (!frm_bytes_left(fp, &left) || left < rest) {
+        return NULL;
+    }
+
+    frozen_map_t *frm = new_frozen_map(hf, ef, &header);
+
+    if (fread(frm_disps(frm), 1, rest, fp) != rest) {
+        safe_free(frm);
+        return NULL;
+    }
+
+    return frm;
+}
+
+bool frm_save(const frozen_map_t *frm, const char *fn) {
+    FILE *fp = fopen(fn, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    bool written = frm_write(frm, fp);
+
+    // fclose flushes, so it can fail too.
+    return fclose(fp) == 0 && written;
+}
+
+frozen_map_t *frm_load(const char *fn, hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    FILE *fp = fopen(fn, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    frozen_map_t *frm = frm_read(fp, hf, ef);
+    fclose(fp);
+
+    return frm;
+}
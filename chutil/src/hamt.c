@@ -0,0 +1,465 @@
+
+#include "chutil/hamt.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+#define HAMT_NONE SIZE_MAX
+
+// A key/value pair to be written into a node, along with its hash.
+typedef struct _hamt_kv_t {
+    uint64_t hash_val;
+    const void *key;
+    const void *value;
+} hamt_kv_t;
+
+static inline uint32_t hamt_frag(uint64_t hash_val, size_t depth) {
+    return (uint32_t)((hash_val >> (depth * HAMT_BITS)) & ((1U << HAMT_BITS) - 1));
+}
+
+// Position of bit's slot amongst the set bits of map.
+static inline size_t hamt_index(uint32_t map, uint32_t bit) {
+    return (size_t)__builtin_popcount(map & (bit - 1));
+}
+
+static inline size_t hamt_num_entries(const hamt_node_t *n, size_t depth) {
+    return depth >= HAMT_MAX_DEPTH ? n->data_map : (size_t)__builtin_popcount(n->data_map);
+}
+
+static inline size_t hamt_num_children(const hamt_node_t *n) {
+    return (size_t)__builtin_popcount(n->node_map);
+}
+
+static inline uint8_t *hamt_entry(const hamt_t *h, const hamt_node_t *n, size_t i) {
+    return (uint8_t *)n + sizeof(hamt_node_t) + (i * h->entry_size);
+}
+
+static inline uint64_t hamt_entry_hash(const uint8_t *entry) {
+    uint64_t hash_val;
+    memcpy(&hash_val, entry, sizeof(uint64_t));
+    return hash_val;
+}
+
+static inline const void *hamt_entry_key(const uint8_t *entry) {
+    return entry + sizeof(uint64_t);
+}
+
+static inline const void *hamt_entry_val(const hamt_t *h, const uint8_t *entry) {
+    return entry + sizeof(uint64_t) + h->key_size;
+}
+
+static inline hamt_kv_t hamt_entry_kv(const hamt_t *h, const uint8_t *entry) {
+    hamt_kv_t kv = {
+        .hash_val = hamt_entry_hash(entry),
+        .key = hamt_entry_key(entry),
+        .value = hamt_entry_val(h, entry),
+    };
+
+    return kv;
+}
+
+static inline hamt_node_t **hamt_children(const hamt_t *h, const hamt_node_t *n, size_t depth) {
+    return (hamt_node_t **)hamt_entry(h, n, hamt_num_entries(n, depth));
+}
+
+static inline void hamt_retain(hamt_node_t *n) {
+    atomic_fetch_add(&(n->refs), 1);
+}
+
+static void hamt_release(const hamt_t *h, hamt_node_t *n, size_t depth) {
+    if (atomic_fetch_sub(&(n->refs), 1) != 1) {
+        return;
+    }
+
+    hamt_node_t **children = hamt_children(h, n, depth);
+    size_t num_children = hamt_num_children(n);
+
+    for (size_t i = 0; i < num_children; i++) {
+        hamt_release(h, children[i], depth + 1);
+    }
+
+    safe_free(n);
+}
+
+static hamt_node_t *hamt_alloc(const hamt_t *h, size_t num_entries, size_t num_children,
+        uint32_t data_map, uint32_t node_map) {
+    hamt_node_t *n = safe_malloc(sizeof(hamt_node_t) + (num_entries * h->entry_size) +
+            (num_children * sizeof(hamt_node_t *)));
+
+    atomic_init(&(n->refs), 1);
+    n->data_map = data_map;
+    n->node_map = node_map;
+
+    return n;
+}
+
+static void hamt_write_entry(const hamt_t *h, uint8_t *entry, const hamt_kv_t *kv) {
+    memcpy(entry, &(kv->hash_val), sizeof(uint64_t));
+    memcpy(entry + sizeof(uint64_t), kv->key, h->key_size);
+    memcpy(entry + sizeof(uint64_t) + h->key_size, kv->value, h->value_size);
+}
+
+// Path copying.
+//
+// Builds a new node from src (which is left alone) with the given maps.
+// Entry entry_skip of src is dropped, and kv is placed at entry_ins in the
+// new node. Same for children with child_skip/child_ins/child. Any of
+// these can be HAMT_NONE.
+//
+// Children carried over from src gain a reference. child is handed over
+// as is.
+static hamt_node_t *hamt_rebuild(const hamt_t *h, const hamt_node_t *src, size_t depth,
+        uint32_t data_map, uint32_t node_map,
+        size_t entry_skip, size_t entry_ins, const hamt_kv_t *kv,
+        size_t child_skip, size_t child_ins, hamt_node_t *child) {
+    size_t src_entries = hamt_num_entries(src, depth);
+    size_t src_children = hamt_num_children(src);
+
+    size_t num_entries = src_entries - (entry_skip != HAMT_NONE) + (entry_ins != HAMT_NONE);
+    size_t num_children = src_children - (child_skip != HAMT_NONE) + (child_ins != HAMT_NONE);
+
+    hamt_node_t *n = hamt_alloc(h, num_entries, num_children, data_map, node_map);
+
+    size_t j = 0;
+    for (size_t i = 0; i < num_entries; i++) {
+        if (i == entry_ins) {
+            hamt_write_entry(h, hamt_entry(h, n, i), kv);
+            continue;
+        }
+
+        if (j == entry_skip) {
+            j++;
+        }
+
+        memcpy(hamt_entry(h, n, i), hamt_entry(h, src, j++), h->entry_size);
+    }
+
+    hamt_node_t **src_kids = hamt_children(h, src, depth);
+    hamt_node_t **kids = hamt_children(h, n, depth);
+
+    j = 0;
+    for (size_t i = 0; i < num_children; i++) {
+        if (i == child_ins) {
+            kids[i] = child;
+            continue;
+        }
+
+        if (j == child_skip) {
+            j++;
+        }
+
+        kids[i] = src_kids[j++];
+        hamt_retain(kids[i]);
+    }
+
+    return n;
+}
+
+// A node holding just a and b, which have different keys.
+static hamt_node_t *hamt_merge(const hamt_t *h, const hamt_kv_t *a, const hamt_kv_t *b,
+        size_t depth) {
+    if (depth >= HAMT_MAX_DEPTH) {
+        hamt_node_t *n = hamt_alloc(h, 2, 0, 2, 0);
+        hamt_write_entry(h, hamt_entry(h, n, 0), a);
+        hamt_write_entry(h, hamt_entry(h, n, 1), b);
+        return n;
+    }
+
+    uint32_t fa = hamt_frag(a->hash_val, depth);
+    uint32_t fb = hamt_frag(b->hash_val, depth);
+
+    if (fa == fb) {
+        hamt_node_t *n = hamt_alloc(h, 0, 1, 0, 1U << fa);
+        hamt_children(h, n, depth)[0] = hamt_merge(h, a, b, depth + 1);
+        return n;
+    }
+
+    hamt_node_t *n = hamt_alloc(h, 2, 0, (1U << fa) | (1U << fb), 0);
+    hamt_write_entry(h, hamt_entry(h, n, fa < fb ? 0 : 1), a);
+    hamt_write_entry(h, hamt_entry(h, n, fa < fb ? 1 : 0), b);
+    return n;
+}
+
+static inline bool hamt_entry_matches(const hamt_t *h, const uint8_t *entry,
+        uint64_t hash_val, const void *key) {
+    return hamt_entry_hash(entry) == hash_val && h->eq_func(hamt_entry_key(entry), key);
+}
+
+// Returns the new version of n with kv in it. added is set to whether
+// the key is new.
+static hamt_node_t *hamt_insert(const hamt_t *h, const hamt_node_t *n, size_t depth,
+        const hamt_kv_t *kv, bool *added) {
+    if (depth >= HAMT_MAX_DEPTH) {
+        size_t num_entries = n->data_map;
+
+        for (size_t i = 0; i < num_entries; i++) {
+            if (hamt_entry_matches(h, hamt_entry(h, n, i), kv->hash_val, kv->key)) {
+                *added = false;
+                return hamt_rebuild(h, n, depth, n->data_map, 0,
+                        i, i, kv, HAMT_NONE, HAMT_NONE, NULL);
+            }
+        }
+
+        *added = true;
+        return hamt_rebuild(h, n, depth, n->data_map + 1, 0,
+                HAMT_NONE, num_entries, kv, HAMT_NONE, HAMT_NONE, NULL);
+    }
+
+    uint32_t bit = 1U << hamt_frag(kv->hash_val, depth);
+
+    if (n->data_map & bit) {
+        size_t ei = hamt_index(n->data_map, bit);
+        const uint8_t *entry = hamt_entry(h, n, ei);
+
+        if (hamt_entry_matches(h, entry, kv->hash_val, kv->key)) {
+            *added = false;
+            return hamt_rebuild(h, n, depth, n->data_map, n->node_map,
+                    ei, ei, kv, HAMT_NONE, HAMT_NONE, NULL);
+        }
+
+        // Slot taken by another key, both move down into a new child.
+        hamt_kv_t old_kv = hamt_entry_kv(h, entry);
+        hamt_node_t *child = hamt_merge(h, &old_kv, kv, depth + 1);
+
+        *added = true;
+        return hamt_rebuild(h, n, depth, n->data_map & ~bit, n->node_map | bit,
+                ei, HAMT_NONE, NULL, HAMT_NONE, hamt_index(n->node_map, bit), child);
+    }
+
+    if (n->node_map & bit) {
+        size_t ci = hamt_index(n->node_map, bit);
+        hamt_node_t *child = hamt_insert(h, hamt_children(h, n, depth)[ci], depth + 1, kv, added);
+
+        return hamt_rebuild(h, n, depth, n->data_map, n->node_map,
+                HAMT_NONE, HAMT_NONE, NULL, ci, ci, child);
+    }
+
+    *added = true;
+    return hamt_rebuild(h, n, depth, n->data_map | bit, n->node_map,
+            HAMT_NONE, hamt_index(n->data_map, bit), kv, HAMT_NONE, HAMT_NONE, NULL);
+}
+
+// Returns the new version of n without key, NULL if that leaves n empty.
+// removed is set to false (and NULL returned) if key isn't there.
+static hamt_node_t *hamt_delete(const hamt_t *h, const hamt_node_t *n, size_t depth,
+        uint64_t hash_val, const void *key, bool *removed) {
+    *removed = false;
+
+    if (depth >= HAMT_MAX_DEPTH) {
+        size_t num_entries = n->data_map;
+
+        for (size_t i = 0; i < num_entries; i++) {
+            if (hamt_entry_matches(h, hamt_entry(h, n, i), hash_val, key)) {
+                *removed = true;
+
+                if (num_entries == 1) {
+                    return NULL;
+                }
+
+                return hamt_rebuild(h, n, depth, n->data_map - 1, 0,
+                        i, HAMT_NONE, NULL, HAMT_NONE, HAMT_NONE, NULL);
+            }
+        }
+
+        return NULL;
+    }
+
+    uint32_t bit = 1U << hamt_frag(hash_val, depth);
+
+    if (n->data_map & bit) {
+        size_t ei = hamt_index(n->data_map, bit);
+        if (!hamt_entry_matches(h, hamt_entry(h, n, ei), hash_val, key)) {
+            return NULL;
+        }
+
+        *removed = true;
+
+        if (n->data_map == bit && n->node_map == 0) {
+            return NULL;
+        }
+
+        return hamt_rebuild(h, n, depth, n->data_map & ~bit, n->node_map,
+                ei, HAMT_NONE, NULL, HAMT_NONE, HAMT_NONE, NULL);
+    }
+
+    if (!(n->node_map & bit)) {
+        return NULL;
+    }
+
+    size_t ci = hamt_index(n->node_map, bit);
+    hamt_node_t *child = hamt_delete(h, hamt_children(h, n, depth)[ci], depth + 1,
+            hash_val, key, removed);
+
+    if (!(*removed)) {
+        return NULL;
+    }
+
+    if (!child) {
+        if (n->node_map == bit && n->data_map == 0) {
+            return NULL;
+        }
+
+        return hamt_rebuild(h, n, depth, n->data_map, n->node_map & ~bit,
+                HAMT_NONE, HAMT_NONE, NULL, ci, HAMT_NONE, NULL);
+    }
+
+    // A child left with a single entry is folded back into this node,
+    // so a trie never has chains of near empty nodes.
+    if (child->node_map == 0 && hamt_num_entries(child, depth + 1) == 1) {
+        hamt_kv_t kv = hamt_entry_kv(h, hamt_entry(h, child, 0));
+
+        hamt_node_t *folded = hamt_rebuild(h, n, depth, n->data_map | bit, n->node_map & ~bit,
+                HAMT_NONE, hamt_index(n->data_map, bit), &kv, ci, HAMT_NONE, NULL);
+
+        hamt_release(h, child, depth + 1);
+        return folded;
+    }
+
+    return hamt_rebuild(h, n, depth, n->data_map, n->node_map,
+            HAMT_NONE, HAMT_NONE, NULL, ci, ci, child);
+}
+
+hamt_t *new_hamt(size_t ks, size_t vs, hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    if (ks == 0 || hf == NULL || ef == NULL) {
+        return NULL;
+    }
+
+    hamt_t *h = safe_malloc(sizeof(hamt_t));
+
+    h->key_size = ks;
+    h->value_size = vs;
+    h->entry_size = (sizeof(uint64_t) + ks + vs + 7) & ~(size_t)7;
+
+    h->hash_func = hf;
+    h->eq_func = ef;
+
+    h->num_keys = 0;
+    h->root = NULL;
+
+    return h;
+}
+
+void delete_hamt(hamt_t *h) {
+    if (h->root) {
+        hamt_release(h, h->root, 0);
+    }
+
+    safe_free(h);
+}
+
+hamt_t *hamt_copy(const hamt_t *h) {
+    hamt_t *copy = safe_malloc(sizeof(hamt_t));
+    *copy = *h;
+
+    if (copy->root) {
+        hamt_retain(copy->root);
+    }
+
+    return copy;
+}
+
+hamt_t *hamt_put(const hamt_t *h, const void *key, const void *value) {
+    hamt_kv_t kv = {
+        .hash_val = h->hash_func(key),
+        .key = key,
+        .value = value,
+    };
+
+    hamt_t *next = safe_malloc(sizeof(hamt_t));
+    *next = *h;
+
+    if (!(h->root)) {
+        uint32_t bit = 1U << hamt_frag(kv.hash_val, 0);
+
+        next->root = hamt_alloc(h, 1, 0, bit, 0);
+        hamt_write_entry(h, hamt_entry(h, next->root, 0), &kv);
+        next->num_keys = 1;
+
+        return next;
+    }
+
+    bool added;
+    next->root = hamt_insert(h, h->root, 0, &kv, &added);
+
+    if (added) {
+        next->num_keys++;
+    }
+
+    return next;
+}
+
+hamt_t *hamt_remove(const hamt_t *h, const void *key) {
+    if (!(h->root)) {
+        return hamt_copy(h);
+    }
+
+    bool removed;
+    hamt_node_t *root = hamt_delete(h, h->root, 0, h->hash_func(key), key, &removed);
+
+    if (!removed) {
+        return hamt_copy(h);
+    }
+
+    hamt_t *next = safe_malloc(sizeof(hamt_t));
+    *next = *h;
+
+    next->root = root;
+    next->num_keys--;
+
+    return next;
+}
+
+const void *hamt_get(const hamt_t *h, const void *key) {
+    const hamt_node_t *n = h->root;
+    if (!n) {
+        return NULL;
+    }
+
+    uint64_t hash_val = h->hash_func(key);
+
+    for (size_t depth = 0; depth < HAMT_MAX_DEPTH; depth++) {
+        uint32_t bit = 1U << hamt_frag(hash_val, depth);
+
+        if (n->data_map & bit) {
+            const uint8_t *entry = hamt_entry(h, n, hamt_index(n->data_map, bit));
+            return hamt_entry_matches(h, entry, hash_val, key) ? hamt_entry_val(h, entry) : NULL;
+        }
+
+        if (!(n->node_map & bit)) {
+            return NULL;
+        }
+
+        n = hamt_children(h, n, depth)[hamt_index(n->node_map, bit)];
+    }
+
+    // Full hash collision list.
+    for (size_t i = 0; i < n->data_map; i++) {
+        const uint8_t *entry = hamt_entry(h, n, i);
+        if (hamt_entry_matches(h, entry, hash_val, key)) {
+            return hamt_entry_val(h, entry);
+        }
+    }
+
+    return NULL;
+}
+
+static void hamt_visit(const hamt_t *h, const hamt_node_t *n, size_t depth,
+        hamt_for_each_ft func, void *ctx) {
+    size_t num_entries = hamt_num_entries(n, depth);
+    for (size_t i = 0; i < num_entries; i++) {
+        const uint8_t *entry = hamt_entry(h, n, i);
+        func(hamt_entry_key(entry), hamt_entry_val(h, entry), ctx);
+    }
+
+    hamt_node_t **children = hamt_children(h, n, depth);
+    size_t num_children = hamt_num_children(n);
+    for (size_t i = 0; i < num_children; i++) {
+        hamt_visit(h, children[i], depth + 1, func, ctx);
+    }
+}
+
+void hamt_for_each(const hamt_t *h, hamt_for_each_ft func, void *ctx) {
+    if (h->root) {
+        hamt_visit(h, h->root, 0, func, ctx);
+    }
+}
@@ -0,0 +1,116 @@
+
+#include "chutil/hash.h"
+
+#include <string.h>
+
+static const uint64_t HASH_SECRET[4] = {
+    0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+    0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL,
+};
+
+// Full 64x64 -> 128 bit multiply, low half to *a, high half to *b.
+static inline void hash_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 u128_t;
+
+    u128_t r = (u128_t)(*a) * (*b);
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+// memcpy keeps unaligned reads legal, the compiler turns these
+// into single loads.
+static inline uint64_t hash_r8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_r4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 1 to 3 bytes.
+static inline uint64_t hash_r3(const uint8_t *p, size_t k) {
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint64_t hash_bytes_seeded(const void *data, size_t len, uint64_t seed) {
+    const uint8_t *p = data;
+    uint64_t a, b;
+
+    seed ^= hash_mix(seed ^ HASH_SECRET[0], HASH_SECRET[1]);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            // Two possibly overlapping reads from each end.
+            size_t off = (len >> 3) << 2;
+            a = (hash_r4(p) << 32) | hash_r4(p + off);
+            b = (hash_r4(p + len - 4) << 32) | hash_r4(p + len - 4 - off);
+        } else if (len > 0) {
+            a = hash_r3(p, len);
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            // Three independent lanes, so the multiplies can overlap.
+            uint64_t see1 = seed, see2 = seed;
+
+            do {
+                seed = hash_mix(hash_r8(p) ^ HASH_SECRET[1], hash_r8(p + 8) ^ seed);
+                see1 = hash_mix(hash_r8(p + 16) ^ HASH_SECRET[2], hash_r8(p + 24) ^ see1);
+                see2 = hash_mix(hash_r8(p + 32) ^ HASH_SECRET[3], hash_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = hash_mix(hash_r8(p) ^ HASH_SECRET[1], hash_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        // The last 16 bytes, these may overlap what was already hashed.
+        a = hash_r8(p + i - 16);
+        b = hash_r8(p + i - 8);
+    }
+
+    a ^= HASH_SECRET[1];
+    b ^= seed;
+    hash_mum(&a, &b);
+
+    return hash_mix(a ^ HASH_SECRET[0] ^ len, b ^ HASH_SECRET[1]);
+}
+
+uint64_t hash_u64(uint64_t x) {
+    return hash_mix(x ^ HASH_SECRET[0], HASH_SECRET[1]);
+}
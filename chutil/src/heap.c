@@ -194,6 +194,17 @@ void *hp_next(heap_t *hp) {
     return NULL;
 }
 
+void *hp_iter_next(hp_iter_t *iter) {
+    heap_val_header_t *hdr = hp_get_header(iter->hp, iter->ind);
+
+    if (hdr) {
+        iter->ind++;
+        return hvh_to_hv(hdr);
+    }
+
+    return NULL;
+}
+
 void hp_re_heap(heap_t *hp) {
     // First thing we do, is recalculate all priorities!
     for (size_t i = 0; i < hp->len; i++) {
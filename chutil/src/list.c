@@ -2,6 +2,64 @@
 #include "chsys/mem.h"
 #include <string.h>
 
+// list_iter_t adapters for the concrete iterators.
+
+static void al_list_iter_begin(array_list_t *al, list_iter_t *iter) {
+    iter->list = al;
+    iter->ind = 0;
+}
+
+static void *al_list_iter_next(list_iter_t *iter) {
+    array_list_t *al = iter->list;
+    if (iter->ind < al->len) {
+        return al_get(al, iter->ind++);
+    }
+
+    return NULL;
+}
+
+static void ll_list_iter_begin(linked_list_t *ll, list_iter_t *iter) {
+    iter->list = ll;
+    iter->node = ll->first;
+}
+
+static void *ll_list_iter_next(list_iter_t *iter) {
+    linked_list_node_hdr_t *node = iter->node;
+    if (node) {
+        iter->node = node->next;
+        return llnh_get_cell(node);
+    }
+
+    return NULL;
+}
+
+static void sgl_list_iter_begin(seg_list_t *sgl, list_iter_t *iter) {
+    iter->list = sgl;
+    iter->ind = 0;
+}
+
+static void *sgl_list_iter_next(list_iter_t *iter) {
+    seg_list_t *sgl = iter->list;
+    if (iter->ind < sgl->len) {
+        return sgl_get(sgl, iter->ind++);
+    }
+
+    return NULL;
+}
+
+static void sml_list_iter_begin(small_list_t *sml, list_iter_t *iter) {
+    iter->list = sml;
+    iter->ind = 0;
+}
+
+static void *sml_list_iter_next(list_iter_t *iter) {
+    small_list_t *sml = iter->list;
+    if (iter->ind < sml->len) {
+        return sml_get(sml, iter->ind++);
+    }
+
+    return NULL;
+}
 
 // Concrete function usages:
 static const list_impl_t ARRAY_LIST_IMPL_VAL = {
@@ -18,9 +76,33 @@ static const list_impl_t ARRAY_LIST_IMPL_VAL = {
 
     .reset_iterator = (list_reset_iterator_ft)al_reset_iterator,
     .next = (list_next_ft)al_next,
+
+    .iter_begin = (list_iter_begin_ft)al_list_iter_begin,
+    .iter_next = al_list_iter_next,
 };
 const list_impl_t *ARRAY_LIST_IMPL = &ARRAY_LIST_IMPL_VAL;
 
+// Same as an array list in every way, l_is_pod just checks for this impl.
+static const list_impl_t POD_ARRAY_LIST_IMPL_VAL = {
+    .constructor = (list_constructor_ft)new_array_list,
+    .destructor = (list_destructor_ft)delete_array_list,
+    .len = (list_len_ft)al_len,
+    .cell_size = (list_cell_size_ft)al_cell_size,
+    .get = (list_get_ft)al_get,
+    .get_copy = (list_get_copy_ft)al_get_copy,
+    .set = (list_set_ft)al_set,
+    .push = (list_push_ft)al_push,
+    .pop = (list_pop_ft)al_pop,
+    .poll = (list_poll_ft)al_poll,
+
+    .reset_iterator = (list_reset_iterator_ft)al_reset_iterator,
+    .next = (list_next_ft)al_next,
+
+    .iter_begin = (list_iter_begin_ft)al_list_iter_begin,
+    .iter_next = al_list_iter_next,
+};
+const list_impl_t *POD_ARRAY_LIST_IMPL = &POD_ARRAY_LIST_IMPL_VAL;
+
 static const list_impl_t LINKED_LIST_IMPL_VAL = {
     .constructor = (list_constructor_ft)new_linked_list,
     .destructor = (list_destructor_ft)delete_linked_list,
@@ -35,9 +117,52 @@ static const list_impl_t LINKED_LIST_IMPL_VAL = {
 
     .reset_iterator = (list_reset_iterator_ft)ll_reset_iterator,
     .next = (list_next_ft)ll_next,
+
+    .iter_begin = (list_iter_begin_ft)ll_list_iter_begin,
+    .iter_next = ll_list_iter_next,
 };
 const list_impl_t *LINKED_LIST_IMPL = &LINKED_LIST_IMPL_VAL;
 
+static const list_impl_t SEG_LIST_IMPL_VAL = {
+    .constructor = (list_constructor_ft)new_seg_list,
+    .destructor = (list_destructor_ft)delete_seg_list,
+    .len = (list_len_ft)sgl_len,
+    .cell_size = (list_cell_size_ft)sgl_cell_size,
+    .get = (list_get_ft)sgl_get,
+    .get_copy = (list_get_copy_ft)sgl_get_copy,
+    .set = (list_set_ft)sgl_set,
+    .push = (list_push_ft)sgl_push,
+    .pop = (list_pop_ft)sgl_pop,
+    .poll = (list_poll_ft)sgl_poll,
+
+    .reset_iterator = (list_reset_iterator_ft)sgl_reset_iterator,
+    .next = (list_next_ft)sgl_next,
+
+    .iter_begin = (list_iter_begin_ft)sgl_list_iter_begin,
+    .iter_next = sgl_list_iter_next,
+};
+const list_impl_t *SEG_LIST_IMPL = &SEG_LIST_IMPL_VAL;
+
+static const list_impl_t SMALL_LIST_IMPL_VAL = {
+    .constructor = (list_constructor_ft)new_small_list,
+    .destructor = (list_destructor_ft)delete_small_list,
+    .len = (list_len_ft)sml_len,
+    .cell_size = (list_cell_size_ft)sml_cell_size,
+    .get = (list_get_ft)sml_get,
+    .get_copy = (list_get_copy_ft)sml_get_copy,
+    .set = (list_set_ft)sml_set,
+    .push = (list_push_ft)sml_push,
+    .pop = (list_pop_ft)sml_pop,
+    .poll = (list_poll_ft)sml_poll,
+
+    .reset_iterator = (list_reset_iterator_ft)sml_reset_iterator,
+    .next = (list_next_ft)sml_next,
+
+    .iter_begin = (list_iter_begin_ft)sml_list_iter_begin,
+    .iter_next = sml_list_iter_next,
+};
+const list_impl_t *SMALL_LIST_IMPL = &SMALL_LIST_IMPL_VAL;
+
 list_t *new_list(const list_impl_t *impl, size_t cs) {
     void *list = impl->constructor(cs); 
     list_t *l = safe_malloc(sizeof(list_t));
@@ -87,6 +212,20 @@ void al_push(array_list_t *al, const void *src) {
     al->len++;
 }
 
+void al_reserve(array_list_t *al, size_t cap) {
+    if (cap <= al->cap) {
+        return;
+    }
+
+    al->arr = safe_realloc(al->arr, al->cell_size * cap);
+    al->cap = cap;
+}
+
+void al_resize(array_list_t *al, size_t len) {
+    al_reserve(al, len);
+    al->len = len;
+}
+
 void al_pop(array_list_t *al, void *dest) {
     if (al->len == 0) {
         return;
@@ -259,5 +398,211 @@ void *ll_next(linked_list_t *ll) {
     return NULL;
 }
 
+// Segmented List
+
+static inline size_t sgl_seg_cap(size_t seg) {
+    return SEG_LIST_FIRST_SEG_CAP << seg;
+}
+
+seg_list_t *new_seg_list(size_t cs) {
+    if (cs == 0) {
+        return NULL;
+    }
+
+    seg_list_t *sgl = safe_malloc(sizeof(seg_list_t));
+    sgl->cell_size = cs;
+    sgl->len = 0;
+
+    // No segments until the first push.
+    sgl->num_segs = 0;
+    sgl->iter_ind = 0;
+
+    return sgl;
+}
+
+void delete_seg_list(seg_list_t *sgl) {
+    for (size_t seg = 0; seg < sgl->num_segs; seg++) {
+        safe_free(sgl->segs[seg]);
+    }
+
+    safe_free(sgl);
+}
+
+void sgl_push(seg_list_t *sgl, const void *src) {
+    if (sgl->len == sgl_cap(sgl)) {
+        // Never a realloc, just add on the next segment.
+        sgl->segs[sgl->num_segs] = 
+            safe_malloc(sgl->cell_size * sgl_seg_cap(sgl->num_segs));
+        sgl->num_segs++;
+    }
+
+    sgl_set(sgl, sgl->len, src);
+    sgl->len++;
+}
+
+void sgl_pop(seg_list_t *sgl, void *dest) {
+    if (sgl->len == 0) {
+        return;
+    }
+
+    if (dest) {
+        sgl_get_copy(sgl, sgl->len - 1, dest);
+    }
+
+    // Segments are kept around for later pushes.
+    sgl->len--;
+}
+
+void sgl_poll(seg_list_t *sgl, void *dest) {
+    if (sgl->len == 0) {
+        return;
+    }
+
+    if (dest) {
+        sgl_get_copy(sgl, 0, dest);
+    }
+
+    // Shift every cell down by one. Each segment is shifted with a single
+    // memmove, then the first cell of the next segment is brought into
+    // its last slot.
+    size_t cs = sgl->cell_size;
+    size_t seg_start = 0;
+
+    for (size_t seg = 0; seg_start < sgl->len; seg++) {
+        uint8_t *cells = sgl->segs[seg];
+        size_t seg_len = sgl->len - seg_start;
+        if (seg_len > sgl_seg_cap(seg)) {
+            seg_len = sgl_seg_cap(seg);
+        }
+
+        memmove(cells, cells + cs, (seg_len - 1) * cs);
+
+        size_t next_start = seg_start + sgl_seg_cap(seg);
+        if (next_start < sgl->len) {
+            memcpy(cells + ((seg_len - 1) * cs), sgl->segs[seg + 1], cs);
+        }
+
+        seg_start = next_start;
+    }
+
+    sgl->len--;
+}
+
+void *sgl_next(seg_list_t *sgl) {
+    if (sgl->iter_ind < sgl->len) {
+        return sgl_get(sgl, sgl->iter_ind++);
+    }
+
+    return NULL;
+}
+
+void sgl_iter_begin(seg_list_t *sgl, sgl_iter_t *iter) {
+    iter->sgl = sgl;
+    iter->left = sgl->len;
 
+    iter->seg = 0;
+    iter->seg_left = SEG_LIST_FIRST_SEG_CAP;
+    iter->cell = sgl->num_segs > 0 ? sgl->segs[0] : NULL;
+}
 
+void *sgl_iter_next(sgl_iter_t *iter) {
+    if (iter->left == 0) {
+        return NULL;
+    }
+
+    if (iter->seg_left == 0) {
+        iter->seg++;
+        iter->seg_left = sgl_seg_cap(iter->seg);
+        iter->cell = iter->sgl->segs[iter->seg];
+    }
+
+    void *ret_ptr = iter->cell;
+
+    iter->cell += iter->sgl->cell_size;
+    iter->seg_left--;
+    iter->left--;
+
+    return ret_ptr;
+}
+
+// Small List
+
+small_list_t *new_small_list(size_t cs) {
+    if (cs == 0) {
+        return NULL;
+    }
+
+    // Inline cells come along in the same allocation.
+    small_list_t *sml = safe_malloc(sizeof(small_list_t) + 
+            (cs * SMALL_LIST_INLINE_CELLS));
+
+    sml->cap = SMALL_LIST_INLINE_CELLS;
+    sml->len = 0;
+    sml->cell_size = cs;
+    sml->arr = sml->inline_cells;
+
+    sml->iter_ind = 0;
+
+    return sml;
+}
+
+void delete_small_list(small_list_t *sml) {
+    if (!sml_is_inline(sml)) {
+        safe_free(sml->arr);
+    }
+
+    safe_free(sml);
+}
+
+void sml_push(small_list_t *sml, const void *src) {
+    if (sml->len == sml->cap) {
+        size_t new_cap = sml->cap * 2;
+
+        if (sml_is_inline(sml)) {
+            // Spill to the heap for the first time.
+            void *arr = safe_malloc(sml->cell_size * new_cap);
+            memcpy(arr, sml->inline_cells, sml->cell_size * sml->len);
+            sml->arr = arr;
+        } else {
+            sml->arr = safe_realloc(sml->arr, sml->cell_size * new_cap);
+        }
+
+        sml->cap = new_cap;
+    }
+
+    sml_set(sml, sml->len, src);
+    sml->len++;
+}
+
+void sml_pop(small_list_t *sml, void *dest) {
+    if (sml->len == 0) {
+        return;
+    }
+
+    if (dest) {
+        sml_get_copy(sml, sml->len - 1, dest);
+    }
+
+    sml->len--;
+}
+
+void sml_poll(small_list_t *sml, void *dest) {
+    if (sml->len == 0) {
+        return;
+    }
+
+    if (dest) {
+        sml_get_copy(sml, 0, dest);
+    }
+
+    memmove(sml_get(sml, 0), sml_get(sml, 1), (sml->len - 1) * sml->cell_size);
+    sml->len--;
+}
+
+void *sml_next(small_list_t *sml) {
+    if (sml->iter_ind < sml->len) {
+        return sml_get(sml, sml->iter_ind++);
+    }
+
+    return NULL;
+}
@@ -1,21 +1,41 @@
 
 #include "chutil/list_helpers.h"
 #include "chutil/list.h"
+#include "chutil/sort.h"
+#include "chutil/hash.h"
+#include "chsys/mem.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static inline bool l_is_pod(list_t *l) {
+    return l->impl == POD_ARRAY_LIST_IMPL;
+}
 
 bool l_equals(list_t *l1, list_t *l2, list_cell_equals_ft eq) {
     if (l_len(l1) != l_len(l2)) {
         return false;
     }
 
+    if (l_is_pod(l1) && l_is_pod(l2) && l_cell_size(l1) == l_cell_size(l2)) {
+        array_list_t *al1 = l1->list;
+        array_list_t *al2 = l2->list;
+
+        return memcmp(al1->arr, al2->arr, al1->len * al1->cell_size) == 0;
+    }
+
     const void *cell1;
     const void *cell2;
 
-    l_reset_iterator(l1);
-    l_reset_iterator(l2);
+    list_iter_t iter1;
+    list_iter_t iter2;
+
+    l_iter_begin(l1, &iter1);
+    l_iter_begin(l2, &iter2);
 
     // NOTE: we really only need to check one of these not being NULL
     // because we know the lengths are equal, but whatevs.
-    while ((cell1 = l_next(l1)) && (cell2 = l_next(l2))) {
+    while ((cell1 = l_iter_next(&iter1)) && (cell2 = l_iter_next(&iter2))) {
         if (!eq(cell1, cell2)) {
             return false;
         }
@@ -23,3 +43,69 @@ bool l_equals(list_t *l1, list_t *l2, list_cell_equals_ft eq) {
 
     return true;
 }
+
+uint64_t l_hash(list_t *l, list_cell_hash_ft hash) {
+    if (l_is_pod(l)) {
+        array_list_t *al = l->list;
+        return hash_bytes(al->arr, al->len * al->cell_size);
+    }
+
+    uint64_t hash_val = 23;
+    const void *cell;
+    list_iter_t iter;
+
+    l_iter_begin(l, &iter);
+    while ((cell = l_iter_next(&iter))) {
+        hash_val = (hash_val * 31) + hash(cell);
+    }
+
+    return hash_val;
+}
+
+typedef void (*cells_sort_ft)(void *arr, size_t len, size_t cs, sort_cmp_ft cmp);
+
+static void l_sort_with(list_t *l, sort_cmp_ft cmp, cells_sort_ft sort_func) {
+    if (l->impl == ARRAY_LIST_IMPL || l->impl == POD_ARRAY_LIST_IMPL) {
+        array_list_t *al = l->list;
+        sort_func(al->arr, al->len, al->cell_size, cmp);
+        return;
+    }
+
+    size_t len = l_len(l);
+    size_t cs = l_cell_size(l);
+
+    if (len < 2) {
+        return;
+    }
+
+    uint8_t *buf = safe_malloc(len * cs);
+    uint8_t *buf_cell;
+    void *cell;
+    list_iter_t iter;
+
+    buf_cell = buf;
+    l_iter_begin(l, &iter);
+    while ((cell = l_iter_next(&iter))) {
+        memcpy(buf_cell, cell, cs);
+        buf_cell += cs;
+    }
+
+    sort_func(buf, len, cs, cmp);
+
+    buf_cell = buf;
+    l_iter_begin(l, &iter);
+    while ((cell = l_iter_next(&iter))) {
+        memcpy(cell, buf_cell, cs);
+        buf_cell += cs;
+    }
+
+    safe_free(buf);
+}
+
+void l_sort(list_t *l, sort_cmp_ft cmp) {
+    l_sort_with(l, cmp, sort_cells);
+}
+
+void l_stable_sort(list_t *l, sort_cmp_ft cmp) {
+    l_sort_with(l, cmp, stable_sort_cells);
+}
@@ -1,54 +1,277 @@
 
 #include "chutil/map.h"
 #include "chsys/mem.h"
+#include <stdio.h>
 #include <string.h>
 
 static inline key_val_pair_t kvh_to_kvp(key_val_header_t *kvh) {
     return (uint8_t *)kvh + sizeof(key_val_header_t);
 }
 
+// map_iter_t adapter, chain_ind lives in ind, next lives in node.
+
+static void hm_map_iter_begin(hash_map_t *hm, map_iter_t *iter) {
+    hm_iter_t hm_iter;
+    hm_iter_begin(hm, &hm_iter);
+
+    iter->map = hm;
+    iter->ind = hm_iter.chain_ind;
+    iter->node = hm_iter.next;
+}
+
+static key_val_pair_t hm_map_iter_next(map_iter_t *iter) {
+    hm_iter_t hm_iter = {
+        .hm = iter->map,
+        .chain_ind = iter->ind,
+        .next = iter->node,
+    };
+
+    key_val_pair_t kvp = hm_iter_next(&hm_iter);
+
+    iter->ind = hm_iter.chain_ind;
+    iter->node = hm_iter.next;
+
+    return kvp;
+}
+
+static const map_impl_t HASH_MAP_IMPL_VAL = {
+    .constructor = (map_constructor_ft)new_hash_map,
+    .destructor = (map_destructor_ft)delete_hash_map,
+    .num_keys = (map_num_keys_ft)hm_num_keys,
+    .key_size = (map_key_size_ft)hm_key_size,
+    .value_size = (map_value_size_ft)hm_value_size,
+    .kvp_key = (map_kvp_key_ft)kvp_key,
+    .kvp_val = (map_kvp_val_ft)kvp_val,
+    .put = (map_put_ft)hm_put,
+    .get = (map_get_ft)hm_get,
+    .remove = (map_remove_ft)hm_remove,
+
+    .iter_begin = (map_iter_begin_ft)hm_map_iter_begin,
+    .iter_next = hm_map_iter_next,
+};
+const map_impl_t *HASH_MAP_IMPL = &HASH_MAP_IMPL_VAL;
+
+map_t *new_map(const map_impl_t *impl, size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    void *map = impl->constructor(ks, vs, hf, ef);
+    map_t *m = safe_malloc(sizeof(map_t));
+
+    m->map = map;
+    m->impl = impl;
+    return m;
+}
+
+void delete_map(map_t *m) {
+    m->impl->destructor(m->map);
+    safe_free(m);
+}
+
+bool m_equals(map_t *m1, map_t *m2, hash_map_val_eq_ft val_eq) {
+    if (m_num_keys(m1) != m_num_keys(m2)) {
+        return false;
+    }
+
+    key_val_pair_t kvp;
+    map_iter_t iter;
+
+    m_iter_begin(m1, &iter);
+    while ((kvp = m_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        const void *m2_val = m_get(m2, m_kvp_key(m1, kvp));
+
+        if (!m2_val || !val_eq(m_kvp_val(m1, kvp), m2_val)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// chains_cap is always a power of 2. The hash is multiplied by 2^64 / phi
+// and the top bits are used as the chain index. (Fibonacci hashing)
+// This is a lot cheaper than %, and spreads out hashes whose low bits
+// are all the same.
+static inline size_t hm_chain_ind(uint64_t hash_val, size_t chains_cap) {
+    return (size_t)((hash_val * 0x9e3779b97f4a7c15ULL) >> 
+            (64 - __builtin_ctzll(chains_cap)));
+}
+
 // Once the number of elements in the map is greater
 // than (1 / HM_FILL_FACTOR) * chains_cap, resize! 
 #define HM_FILL_FACTOR 2
 
-static void hm_check_resize(hash_map_t *hm) {
-    if (hm->num_keys * HM_FILL_FACTOR <= hm->chains_cap) {
-        return;
+// Chains moved from the old table per put/remove while an incremental
+// resize is in progress. A resize starts when num_keys passes half of
+// chains_cap, and the next can't start for another chains_cap / 2 puts.
+// Moving more than 2 chains per put means we are always done in time.
+#define HM_MIGRATE_CHAINS_PER_OP 4
+
+// Total number of chains across both tables.
+// Chains [0, chains_cap) are the current table, the rest are the old table.
+static inline size_t hm_total_chains(hash_map_t *hm) {
+    return hm->chains_cap + (hm->old_chains ? hm->old_chains_cap : 0);
+}
+
+// Old chain i is spread over this many new chains, starting at
+// i * hm_spread(hm). (Fibonacci hashing keeps the top bits, so old chain
+// i only ever maps there)
+static inline size_t hm_spread(hash_map_t *hm) {
+    return hm->chains_cap / hm->old_chains_cap;
+}
+
+static inline key_val_header_t *hm_chain_at(hash_map_t *hm, size_t ind) {
+    if (ind >= hm->chains_cap) {
+        return hm->old_chains[ind - hm->chains_cap];
     }
 
-    size_t new_cap = hm->chains_cap * 2;
-    key_val_header_t **new_chains = safe_malloc(sizeof(key_val_header_t *) * new_cap);
-    for (size_t i = 0; i < new_cap; i++) {
-        new_chains[i] = NULL;
+    // New chains only get cleared as their old chain is moved over,
+    // the rest hold garbage.
+    if (hm->old_chains && ind >= hm->migrate_ind * hm_spread(hm)) {
+        return NULL;
     }
 
-    for (size_t i = 0; i < hm->chains_cap; i++) {
-        key_val_header_t *iter = hm->chains[i];
+    return hm->chains[ind];
+}
+
+// Returns the head of the chain which does (or would) hold a key
+// with the given hash.
+//
+// During a resize, keys whose old chain hasn't been moved yet stay in
+// the old table (new keys included). This way every key has exactly one
+// place it could be, and a lookup only ever walks one chain.
+static key_val_header_t **hm_chain_slot(hash_map_t *hm, uint64_t hash_val) {
+    if (hm->old_chains) {
+        size_t old_ind = hm_chain_ind(hash_val, hm->old_chains_cap);
+        if (old_ind >= hm->migrate_ind) {
+            return &(hm->old_chains[old_ind]);
+        }
+    }
+
+    return &(hm->chains[hm_chain_ind(hash_val, hm->chains_cap)]);
+}
+
+// Moves up to n chains from the old table into the current one.
+static void hm_migrate(hash_map_t *hm, size_t n) {
+    if (!(hm->old_chains)) {
+        return;
+    }
+
+    size_t spread = hm_spread(hm);
+
+    for (; n > 0 && hm->migrate_ind < hm->old_chains_cap; n--) {
+        key_val_header_t *iter = hm->old_chains[hm->migrate_ind];
         key_val_header_t *next;
 
+        // The only new chains iter's pairs can land in.
+        for (size_t i = 0; i < spread; i++) {
+            hm->chains[(hm->migrate_ind * spread) + i] = NULL;
+        }
+
         while (iter) {
             next = iter->next;
 
-            size_t new_ind = iter->hash_val % new_cap;
-            iter->next = new_chains[new_ind];
-            new_chains[new_ind] = iter;
+            size_t new_ind = hm_chain_ind(iter->hash_val, hm->chains_cap);
+            iter->next = hm->chains[new_ind];
+            hm->chains[new_ind] = iter;
             
             iter = next;
         }
+
+        hm->old_chains[hm->migrate_ind++] = NULL;
     }
 
-    // NOTE: we have moved all kvps over to the new chain...
-    // so they themselves need not be freed as they still are in use.
-    //
-    // Only the actual table must be freed.
-    safe_free(hm->chains);
+    if (hm->migrate_ind == hm->old_chains_cap) {
+        // NOTE: we have moved all kvps over to the new chains...
+        // so they themselves need not be freed as they still are in use.
+        //
+        // Only the actual table must be freed.
+        safe_free(hm->old_chains);
+
+        hm->old_chains = NULL;
+        hm->old_chains_cap = 0;
+        hm->migrate_ind = 0;
+    }
+}
+
+// Swaps in a new table of the given size, the current table becomes the
+// old table. When eager is false, and the map was made with
+// HM_INCREMENTAL_RESIZE, pairs are moved over later by hm_migrate.
+//
+// The new table isn't cleared here, hm_migrate clears each part of it
+// right before filling it. So starting a resize costs one allocation and
+// nothing else.
+static void hm_start_resize(hash_map_t *hm, size_t new_cap, bool eager) {
+    // Shouldn't really happen (see HM_MIGRATE_CHAINS_PER_OP), but only
+    // one resize can be going at a time.
+    if (hm->old_chains) {
+        hm_migrate(hm, hm->old_chains_cap);
+    }
+
+    hm->old_chains = hm->chains;
+    hm->old_chains_cap = hm->chains_cap;
+    hm->migrate_ind = 0;
 
     hm->chains_cap = new_cap;
-    hm->chains = new_chains;
+    hm->chains = safe_malloc(sizeof(key_val_header_t *) * hm->chains_cap);
+
+    if (eager || !(hm->flags & HM_INCREMENTAL_RESIZE)) {
+        hm_migrate(hm, hm->old_chains_cap);
+    }
 }
 
-hash_map_t *new_hash_map(size_t ks, size_t vs, 
-        hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+static void hm_check_resize(hash_map_t *hm) {
+    if (hm->num_keys * HM_FILL_FACTOR <= hm->chains_cap) {
+        return;
+    }
+
+    hm_start_resize(hm, hm->chains_cap * 2, false);
+}
+
+// Slabs start small, so small maps stay small, then double up to a cap.
+#define HM_SLAB_MIN_CELLS 16
+#define HM_SLAB_MAX_CELLS 4096
+
+static key_val_header_t *hm_alloc_entry(hash_map_t *hm) {
+    if (!(hm->flags & HM_SLAB_ENTRIES)) {
+        return safe_malloc(sizeof(key_val_header_t) + hm->key_size + hm->value_size);
+    }
+
+    if (hm->free_cells) {
+        key_val_header_t *kvh = hm->free_cells;
+        hm->free_cells = kvh->next;
+        return kvh;
+    }
+
+    if (!(hm->slabs) || hm->slab_used == hm->slab_cells) {
+        size_t cells = hm->slabs ? hm->slab_cells * 2 : HM_SLAB_MIN_CELLS;
+        if (cells > HM_SLAB_MAX_CELLS) {
+            cells = HM_SLAB_MAX_CELLS;
+        }
+
+        hm_slab_t *slab = safe_malloc(sizeof(hm_slab_t) + (cells * hm->cell_size));
+        slab->next = hm->slabs;
+        slab->num_cells = cells;
+
+        hm->slabs = slab;
+        hm->slab_cells = cells;
+        hm->slab_used = 0;
+    }
+
+    uint8_t *cells = (uint8_t *)hm->slabs + sizeof(hm_slab_t);
+    return (key_val_header_t *)(cells + (hm->slab_used++ * hm->cell_size));
+}
+
+static void hm_free_entry(hash_map_t *hm, key_val_header_t *kvh) {
+    if (!(hm->flags & HM_SLAB_ENTRIES)) {
+        safe_free(kvh);
+        return;
+    }
+
+    kvh->next = hm->free_cells;
+    hm->free_cells = kvh;
+}
+
+hash_map_t *new_hash_map_with_flags(size_t ks, size_t vs, 
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef, hash_map_flags_t flags) {
     if (ks == 0 || hf == NULL || ef == NULL) {
         return NULL;
     }
@@ -62,6 +285,8 @@ hash_map_t *new_hash_map(size_t ks, size_t vs,
     hm->hash_func = hf;
     hm->eq_func = ef;
 
+    hm->flags = flags;
+
     hm->num_keys = 0;
 
     // Start with table size of 8, arb choice.
@@ -72,36 +297,70 @@ hash_map_t *new_hash_map(size_t ks, size_t vs,
         hm->chains[i] = NULL;
     }
 
+    hm->old_chains_cap = 0;
+    hm->old_chains = NULL;
+    hm->migrate_ind = 0;
+
+    // Rounded so every cell's header stays aligned.
+    hm->cell_size = (sizeof(key_val_header_t) + ks + vs + 7) & ~(size_t)7;
+    hm->slabs = NULL;
+    hm->slab_cells = 0;
+    hm->slab_used = 0;
+    hm->free_cells = NULL;
+
     return hm;
 }
 
 void delete_hash_map(hash_map_t *hm) {
-    for (size_t i = 0; i < hm->chains_cap; i++) {
-        key_val_header_t *iter = hm->chains[i];
-        key_val_header_t *next;
+    if (hm->flags & HM_SLAB_ENTRIES) {
+        // No need to walk the chains at all.
+        hm_slab_t *slab = hm->slabs;
+        while (slab) {
+            hm_slab_t *next = slab->next;
+            safe_free(slab);
+            slab = next;
+        }
+    } else {
+        size_t total_chains = hm_total_chains(hm);
 
-        while (iter) {
-            next = iter->next;
-            safe_free(iter);
-            iter = next;
+        for (size_t i = 0; i < total_chains; i++) {
+            key_val_header_t *iter = hm_chain_at(hm, i);
+            key_val_header_t *next;
+
+            while (iter) {
+                next = iter->next;
+                safe_free(iter);
+                iter = next;
+            }
         }
     }
 
+    if (hm->old_chains) {
+        safe_free(hm->old_chains);
+    }
+
     safe_free(hm->chains);
     safe_free(hm);
 }
 
-void hm_reset_iterator(hash_map_t *hm) {
-    for (size_t chain_ind = 0; chain_ind < hm->chains_cap; chain_ind++) {
-        if (hm->chains[chain_ind]) {
-            hm->iter_chain_ind = chain_ind;
-            hm->iter = hm->chains[chain_ind];
-            return;
-        }
+// Returns the index of the first non-empty chain at or after start.
+// Returns hm_total_chains(hm) if there is none.
+static size_t hm_find_chain(hash_map_t *hm, size_t start) {
+    size_t total_chains = hm_total_chains(hm);
+
+    size_t chain_ind = start;
+    while (chain_ind < total_chains && !hm_chain_at(hm, chain_ind)) {
+        chain_ind++;
     }
 
-    // Our map is empty...
-    hm->iter = NULL;
+    return chain_ind;
+}
+
+void hm_reset_iterator(hash_map_t *hm) {
+    hm->iter_chain_ind = hm_find_chain(hm, 0);
+    hm->iter = hm->iter_chain_ind < hm_total_chains(hm)
+        ? hm_chain_at(hm, hm->iter_chain_ind) 
+        : NULL; // Our map is empty...
 }
 
 key_val_pair_t hm_next_kvp(hash_map_t *hm) {
@@ -115,62 +374,128 @@ key_val_pair_t hm_next_kvp(hash_map_t *hm) {
         hm->iter = hm->iter->next;
     } else {
         // Find the next non null chain (if it exists)
-        hm->iter_chain_ind++;
-
-        while (hm->iter_chain_ind < hm->chains_cap && 
-                !(hm->chains[hm->iter_chain_ind])) {
-            hm->iter_chain_ind++;
-        }
-        
-        hm->iter = hm->iter_chain_ind < hm->chains_cap 
-            ? hm->chains[hm->iter_chain_ind] 
+        hm->iter_chain_ind = hm_find_chain(hm, hm->iter_chain_ind + 1);
+        hm->iter = hm->iter_chain_ind < hm_total_chains(hm)
+            ? hm_chain_at(hm, hm->iter_chain_ind) 
             : NULL;
     }
     
     return ret_kvp;
 }
 
-void hm_put(hash_map_t *hm, const void *key, const void *value) {
-    uint32_t hash_val = hm->hash_func(key);
-    size_t chain_ind = hash_val % hm->chains_cap;
+void hm_iter_begin(hash_map_t *hm, hm_iter_t *iter) {
+    iter->hm = hm;
+    iter->chain_ind = hm_find_chain(hm, 0);
+    iter->next = iter->chain_ind < hm_total_chains(hm)
+        ? hm_chain_at(hm, iter->chain_ind) 
+        : NULL;
+}
+
+key_val_pair_t hm_iter_next(hm_iter_t *iter) {
+    if (!(iter->next)) {
+        return HASH_MAP_EXHAUSTED;
+    }
+
+    key_val_pair_t ret_kvp = kvh_to_kvp(iter->next);
 
-    key_val_header_t *iter = hm->chains[chain_ind];
+    if (iter->next->next) {
+        iter->next = iter->next->next;
+    } else {
+        hash_map_t *hm = iter->hm;
+
+        iter->chain_ind = hm_find_chain(hm, iter->chain_ind + 1);
+        iter->next = iter->chain_ind < hm_total_chains(hm)
+            ? hm_chain_at(hm, iter->chain_ind) 
+            : NULL;
+    }
+
+    return ret_kvp;
+}
+
+void hm_reserve(hash_map_t *hm, size_t n) {
+    if (n * HM_FILL_FACTOR <= hm->chains_cap) {
+        return;
+    }
+
+    size_t new_cap = hm->chains_cap;
+    while (n * HM_FILL_FACTOR > new_cap) {
+        new_cap *= 2;
+    }
+
+    // Done all at once, the caller asked for the work up front.
+    hm_start_resize(hm, new_cap, true);
+}
+
+// Returns the value of key, adding key to the map first if needed.
+// A freshly added value is left uninitialized.
+static void *hm_find_or_insert(hash_map_t *hm, const void *key, uint64_t hash_val,
+        bool *inserted) {
+    hm_migrate(hm, HM_MIGRATE_CHAINS_PER_OP);
+
+    key_val_header_t **chain = hm_chain_slot(hm, hash_val);
+
+    key_val_header_t *iter = *chain;
     while (iter) {
         key_val_pair_t kvp = kvh_to_kvp(iter);
         if (iter->hash_val == hash_val && hm->eq_func(kvp_key(hm, kvp), key)) {
-            memcpy(kvp_val(hm, kvp), value, hm->value_size);
-            return; // We can just exit after an update.
+            *inserted = false;
+            return kvp_val(hm, kvp);
         }
         
         iter = iter->next;
     }
 
     // No match... new kvp must be made...
-    key_val_header_t *new_kvh = safe_malloc(sizeof(key_val_header_t) + 
-            hm->key_size + hm->value_size);
+    key_val_header_t *new_kvh = hm_alloc_entry(hm);
     
     // Place our header in the chain.
-    new_kvh->next = hm->chains[chain_ind]; 
-    hm->chains[chain_ind] = new_kvh;
+    new_kvh->next = *chain; 
+    *chain = new_kvh;
 
     new_kvh->hash_val = hash_val;
 
     key_val_pair_t kvp = kvh_to_kvp(new_kvh);
 
-    // populate the fields.
     memcpy((void *)kvp_key(hm, kvp), key, hm->key_size);
-    memcpy(kvp_val(hm, kvp), value, hm->value_size);
 
     // Finally, increase our number of keys and check resize!
+    // (Resizing only relinks headers, kvp stays put)
     hm->num_keys++;
     hm_check_resize(hm);
+
+    *inserted = true;
+    return kvp_val(hm, kvp);
 }
 
-void *hm_get(hash_map_t *hm, const void *key) {
-    uint32_t hash_val = hm->hash_func(key);
-    size_t chain_ind = hash_val % hm->chains_cap;
+static void hm_put_hashed(hash_map_t *hm, const void *key, const void *value,
+        uint64_t hash_val) {
+    bool inserted;
+    void *val = hm_find_or_insert(hm, key, hash_val, &inserted);
+
+    memcpy(val, value, hm->value_size);
+}
+
+void hm_put(hash_map_t *hm, const void *key, const void *value) {
+    hm_put_hashed(hm, key, value, hm->hash_func(key));
+}
+
+void *hm_get_or_insert(hash_map_t *hm, const void *key, bool *inserted) {
+    bool ins;
+    void *val = hm_find_or_insert(hm, key, hm->hash_func(key), &ins);
 
-    key_val_header_t *iter = hm->chains[chain_ind];
+    if (ins) {
+        memset(val, 0, hm->value_size);
+    }
+
+    if (inserted) {
+        *inserted = ins;
+    }
+
+    return val;
+}
+
+static void *hm_get_hashed(hash_map_t *hm, const void *key, uint64_t hash_val) {
+    key_val_header_t *iter = *hm_chain_slot(hm, hash_val);
     while (iter) {
         key_val_pair_t kvp = kvh_to_kvp(iter);
         if (iter->hash_val == hash_val && hm->eq_func(kvp_key(hm, kvp), key)) {
@@ -183,12 +508,109 @@ void *hm_get(hash_map_t *hm, const void *key) {
     return NULL;
 }
 
-bool hm_remove(hash_map_t *hm, const void *key) {
-    uint32_t hash_val = hm->hash_func(key);
-    size_t chain_ind = hash_val % hm->chains_cap;
+void *hm_get(hash_map_t *hm, const void *key) {
+    return hm_get_hashed(hm, key, hm->hash_func(key));
+}
+
+// Batches are worked through HM_BATCH_WIDTH keys at a time.
+//
+// Each round hashes every key, prefetches every chain slot, then prefetches
+// every chain head, and only then walks the chains. This way the cache
+// misses of different keys overlap instead of being paid one after another.
+#define HM_BATCH_WIDTH 16
+
+// __builtin_prefetch wants its read/write hint to be a constant.
+static inline void hm_prefetch(const void *addr, bool for_write) {
+    if (for_write) {
+        __builtin_prefetch(addr, 1);
+    } else {
+        __builtin_prefetch(addr, 0);
+    }
+}
+
+// Prefetches the chains of hashes [0, n).
+static void hm_prefetch_hashed(hash_map_t *hm, const uint64_t *hashes, size_t n,
+        bool for_write) {
+    key_val_header_t **slots[HM_BATCH_WIDTH];
+
+    for (size_t i = 0; i < n; i++) {
+        slots[i] = hm_chain_slot(hm, hashes[i]);
+        hm_prefetch(slots[i], for_write);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        key_val_header_t *head = *(slots[i]);
+        if (head) {
+            hm_prefetch(head, for_write);
+        }
+    }
+}
+
+// Fills in the hashes of keys [0, n), and prefetches where they lead.
+static void hm_prefetch_batch(hash_map_t *hm, const uint8_t *keys, size_t n,
+        uint64_t *hashes, bool for_write) {
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = hm->hash_func(keys + (i * hm->key_size));
+    }
+
+    hm_prefetch_hashed(hm, hashes, n, for_write);
+}
+
+void hm_put_batch(hash_map_t *hm, const void *keys, const void *values, size_t n) {
+    const uint8_t *key_bytes = keys;
+    const uint8_t *val_bytes = values;
+    uint64_t hashes[HM_BATCH_WIDTH];
+
+    for (size_t start = 0; start < n; start += HM_BATCH_WIDTH) {
+        size_t width = n - start < HM_BATCH_WIDTH ? n - start : HM_BATCH_WIDTH;
+
+        const uint8_t *batch_keys = key_bytes + (start * hm->key_size);
+        const uint8_t *batch_vals = val_bytes + (start * hm->value_size);
+
+        hm_prefetch_batch(hm, batch_keys, width, hashes, true);
+
+        // A put can resize the table, which just makes the prefetches
+        // useless, never wrong. Chains are looked up again here.
+        for (size_t i = 0; i < width; i++) {
+            hm_put_hashed(hm, batch_keys + (i * hm->key_size),
+                    batch_vals + (i * hm->value_size), hashes[i]);
+        }
+    }
+}
+
+size_t hm_get_batch(hash_map_t *hm, const void *keys, size_t n, void **dests) {
+    const uint8_t *key_bytes = keys;
+    uint64_t hashes[HM_BATCH_WIDTH];
+    size_t found = 0;
+
+    for (size_t start = 0; start < n; start += HM_BATCH_WIDTH) {
+        size_t width = n - start < HM_BATCH_WIDTH ? n - start : HM_BATCH_WIDTH;
+
+        const uint8_t *batch_keys = key_bytes + (start * hm->key_size);
+
+        hm_prefetch_batch(hm, batch_keys, width, hashes, false);
+
+        for (size_t i = 0; i < width; i++) {
+            void *val = hm_get_hashed(hm, batch_keys + (i * hm->key_size), hashes[i]);
+            dests[start + i] = val;
+
+            if (val) {
+                found++;
+            }
+        }
+    }
+
+    return found;
+}
+
+bool hm_remove_copy(hash_map_t *hm, const void *key, void *key_dest, void *val_dest) {
+    hm_migrate(hm, HM_MIGRATE_CHAINS_PER_OP);
+
+    uint64_t hash_val = hm->hash_func(key);
+    key_val_header_t **chain = hm_chain_slot(hm, hash_val);
 
     key_val_header_t *prev = NULL;
-    key_val_header_t *iter = hm->chains[chain_ind];
+    key_val_header_t *iter = *chain;
     while (iter) {
         key_val_pair_t kvp = kvh_to_kvp(iter);
         if (iter->hash_val == hash_val && hm->eq_func(kvp_key(hm, kvp), key)) {
@@ -207,36 +629,127 @@ bool hm_remove(hash_map_t *hm, const void *key) {
         prev->next = iter->next;
     } else {
         // When iter is the front of a chain.
-        hm->chains[chain_ind] = iter->next;
+        *chain = iter->next;
+    }
+
+    key_val_pair_t kvp = kvh_to_kvp(iter);
+
+    if (key_dest) {
+        memcpy(key_dest, kvp_key(hm, kvp), hm->key_size);
+    }
+
+    if (val_dest) {
+        memcpy(val_dest, kvp_val(hm, kvp), hm->value_size);
     }
 
     // Finally FREE!!!
-    safe_free(iter);
+    hm_free_entry(hm, iter);
     
     hm->num_keys--;
 
     return true;
 }
 
+bool hm_remove(hash_map_t *hm, const void *key) {
+    return hm_remove_copy(hm, key, NULL, NULL);
+}
+
+hm_stats_t hm_stats(hash_map_t *hm) {
+    hm_stats_t stats;
+    memset(&stats, 0, sizeof(hm_stats_t));
+
+    stats.num_keys = hm->num_keys;
+    stats.num_chains = hm_total_chains(hm);
+    stats.load_factor = (double)hm->num_keys / (double)stats.num_chains;
+
+    for (size_t i = 0; i < stats.num_chains; i++) {
+        size_t len = 0;
+
+        for (key_val_header_t *iter = hm_chain_at(hm, i); iter; iter = iter->next) {
+            // Chains are short, checking against every earlier pair is fine.
+            for (key_val_header_t *prev = hm_chain_at(hm, i); prev != iter; prev = prev->next) {
+                if (prev->hash_val == iter->hash_val) {
+                    stats.hash_collisions++;
+                    break;
+                }
+            }
+
+            len++;
+        }
+
+        if (len == 0) {
+            stats.empty_chains++;
+        }
+
+        if (len > stats.longest_chain) {
+            stats.longest_chain = len;
+        }
+
+        stats.chain_hist[len < HM_STATS_HIST_LEN ? len : HM_STATS_HIST_LEN - 1]++;
+    }
+
+    stats.memory_bytes = sizeof(hash_map_t) + 
+        (hm->chains_cap * sizeof(key_val_header_t *)) +
+        (hm->old_chains ? hm->old_chains_cap * sizeof(key_val_header_t *) : 0);
+
+    if (hm->flags & HM_SLAB_ENTRIES) {
+        for (hm_slab_t *slab = hm->slabs; slab; slab = slab->next) {
+            stats.memory_bytes += sizeof(hm_slab_t) + (slab->num_cells * hm->cell_size);
+        }
+    } else {
+        stats.memory_bytes += hm->num_keys * 
+            (sizeof(key_val_header_t) + hm->key_size + hm->value_size);
+    }
+
+    return stats;
+}
+
+void hm_print_stats(const hm_stats_t *stats) {
+    printf("Keys: %zu, Chains: %zu (%zu empty), Load Factor: %.3f\n",
+            stats->num_keys, stats->num_chains, stats->empty_chains, stats->load_factor);
+    printf("Longest Chain: %zu, Hash Collisions: %zu, Memory: %zu bytes\n",
+            stats->longest_chain, stats->hash_collisions, stats->memory_bytes);
+
+    for (size_t i = 0; i < HM_STATS_HIST_LEN; i++) {
+        if (stats->chain_hist[i] == 0) {
+            continue;
+        }
+
+        printf("  %2zu%s: %zu\n", i, i == HM_STATS_HIST_LEN - 1 ? "+" : " ", 
+                stats->chain_hist[i]);
+    }
+}
+
 bool hm_equals(hash_map_t *hm1, hash_map_t *hm2, hash_map_val_eq_ft val_eq) {
     if (hm_num_keys(hm1) != hm_num_keys(hm2)) {
         return false;
     }
 
+    bool pod_values = (hm1->flags & HM_POD_VALUES) && (hm2->flags & HM_POD_VALUES) &&
+        hm1->value_size == hm2->value_size;
+
     key_val_pair_t hm1_kvp;
     const void *hm1_key;
     const void *hm1_val;
 
     const void *hm2_val;
+
+    hm_iter_t iter;
     
-    hm_reset_iterator(hm1);
-    while ((hm1_kvp = hm_next_kvp(hm1)) != HASH_MAP_EXHAUSTED) {
+    hm_iter_begin(hm1, &iter);
+    while ((hm1_kvp = hm_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
         hm1_key = kvp_key(hm1, hm1_kvp); 
         hm1_val = kvp_val(hm1, hm1_kvp);
 
         hm2_val = hm_get(hm2, hm1_key);  
 
-        if (!hm2_val || !val_eq(hm1_val, hm2_val)) {
+        if (!hm2_val) {
+            return false;
+        }
+
+        if (pod_values 
+                ? memcmp(hm1_val, hm2_val, hm1->value_size) != 0 
+                : !val_eq(hm1_val, hm2_val)) {
             return false;
         }
 
@@ -244,3 +757,191 @@ bool hm_equals(hash_map_t *hm1, hash_map_t *hm2, hash_map_val_eq_ft val_eq) {
 
     return true;
 }
+
+// Set operations.
+//
+// These all walk one map and look its keys up in (or put them into)
+// another, HM_BATCH_WIDTH keys at a time with the chains prefetched.
+// When both maps share a hash function, the hashes stored in the walked
+// map's headers are used as is, so no key is ever hashed.
+
+// Fills kvps with up to HM_BATCH_WIDTH more pairs from iter, and hashes
+// with their hashes under target's hash function. Returns how many.
+static size_t hm_next_batch(hm_iter_t *iter, hash_map_t *target,
+        key_val_pair_t *kvps, uint64_t *hashes) {
+    hash_map_t *src = iter->hm;
+    bool same_hash = src->hash_func == target->hash_func;
+
+    // Walking src is a string of misses too, so the chains a little past
+    // this batch are prefetched as well.
+    size_t total_chains = hm_total_chains(src);
+    size_t ahead = iter->chain_ind + HM_BATCH_WIDTH;
+    for (size_t i = ahead; i < ahead + HM_BATCH_WIDTH && i < total_chains; i++) {
+        key_val_header_t *head = hm_chain_at(src, i);
+        if (head) {
+            hm_prefetch(head, false);
+        }
+    }
+
+    size_t n = 0;
+    key_val_pair_t kvp;
+
+    while (n < HM_BATCH_WIDTH && (kvp = hm_iter_next(iter)) != HASH_MAP_EXHAUSTED) {
+        kvps[n] = kvp;
+        hashes[n] = same_hash ? kvp_hash_val(kvp) : target->hash_func(kvp_key(src, kvp));
+        n++;
+    }
+
+    return n;
+}
+
+void hm_union_into(hash_map_t *dest, hash_map_t *src) {
+    // The result has at least as many keys as src.
+    hm_reserve(dest, src->num_keys);
+
+    key_val_pair_t kvps[HM_BATCH_WIDTH];
+    uint64_t hashes[HM_BATCH_WIDTH];
+    size_t n;
+
+    hm_iter_t iter;
+    hm_iter_begin(src, &iter);
+
+    while ((n = hm_next_batch(&iter, dest, kvps, hashes)) > 0) {
+        hm_prefetch_hashed(dest, hashes, n, true);
+
+        for (size_t i = 0; i < n; i++) {
+            hm_put_hashed(dest, kvp_key(src, kvps[i]), kvp_val(src, kvps[i]), hashes[i]);
+        }
+    }
+}
+
+static hash_map_t *hm_new_like(hash_map_t *hm) {
+    return new_hash_map_with_flags(hm->key_size, hm->value_size, 
+            hm->hash_func, hm->eq_func, hm->flags);
+}
+
+hash_map_t *hm_intersect(hash_map_t *hm1, hash_map_t *hm2) {
+    hash_map_t *res = hm_new_like(hm1);
+
+    // Walk whichever map is smaller, values always come from hm1 though.
+    bool walk_hm1 = hm1->num_keys <= hm2->num_keys;
+    hash_map_t *walked = walk_hm1 ? hm1 : hm2;
+    hash_map_t *probed = walk_hm1 ? hm2 : hm1;
+
+    key_val_pair_t kvps[HM_BATCH_WIDTH];
+    uint64_t hashes[HM_BATCH_WIDTH];
+    size_t n;
+
+    hm_iter_t iter;
+    hm_iter_begin(walked, &iter);
+
+    while ((n = hm_next_batch(&iter, probed, kvps, hashes)) > 0) {
+        hm_prefetch_hashed(probed, hashes, n, false);
+
+        for (size_t i = 0; i < n; i++) {
+            const void *key = kvp_key(walked, kvps[i]);
+            void *probed_val = hm_get_hashed(probed, key, hashes[i]);
+
+            if (!probed_val) {
+                continue;
+            }
+
+            if (walk_hm1) {
+                hm_put_hashed(res, key, kvp_val(hm1, kvps[i]), kvp_hash_val(kvps[i]));
+            } else {
+                // hashes[i] is already under hm1's hash function.
+                hm_put_hashed(res, key, probed_val, hashes[i]);
+            }
+        }
+    }
+
+    return res;
+}
+
+hash_map_t *hm_difference(hash_map_t *hm1, hash_map_t *hm2) {
+    hash_map_t *res = hm_new_like(hm1);
+
+    key_val_pair_t kvps[HM_BATCH_WIDTH];
+    uint64_t hashes[HM_BATCH_WIDTH];
+    size_t n;
+
+    hm_iter_t iter;
+    hm_iter_begin(hm1, &iter);
+
+    while ((n = hm_next_batch(&iter, hm2, kvps, hashes)) > 0) {
+        hm_prefetch_hashed(hm2, hashes, n, false);
+
+        for (size_t i = 0; i < n; i++) {
+            const void *key = kvp_key(hm1, kvps[i]);
+
+            if (!hm_get_hashed(hm2, key, hashes[i])) {
+                hm_put_hashed(res, key, kvp_val(hm1, kvps[i]), kvp_hash_val(kvps[i]));
+            }
+        }
+    }
+
+    return res;
+}
+
+size_t hm_diff(hash_map_t *old_hm, hash_map_t *new_hm, hash_map_val_eq_ft val_eq,
+        hm_diff_ft func, void *ctx) {
+    bool pod_values = (old_hm->flags & HM_POD_VALUES) && (new_hm->flags & HM_POD_VALUES) &&
+        old_hm->value_size == new_hm->value_size;
+
+    key_val_pair_t kvps[HM_BATCH_WIDTH];
+    uint64_t hashes[HM_BATCH_WIDTH];
+    size_t n;
+
+    size_t diffs = 0;
+    size_t common = 0;
+
+    hm_iter_t iter;
+
+    // Added and changed keys come from walking new_hm.
+    hm_iter_begin(new_hm, &iter);
+    while ((n = hm_next_batch(&iter, old_hm, kvps, hashes)) > 0) {
+        hm_prefetch_hashed(old_hm, hashes, n, false);
+
+        for (size_t i = 0; i < n; i++) {
+            const void *key = kvp_key(new_hm, kvps[i]);
+            const void *new_val = kvp_val(new_hm, kvps[i]);
+            const void *old_val = hm_get_hashed(old_hm, key, hashes[i]);
+
+            if (!old_val) {
+                func(HM_DIFF_ADDED, key, NULL, new_val, ctx);
+                diffs++;
+                continue;
+            }
+
+            common++;
+
+            if (pod_values 
+                    ? memcmp(old_val, new_val, old_hm->value_size) != 0 
+                    : !val_eq(old_val, new_val)) {
+                func(HM_DIFF_CHANGED, key, old_val, new_val, ctx);
+                diffs++;
+            }
+        }
+    }
+
+    // Every key of old_hm was seen already, no need to walk it.
+    if (common == old_hm->num_keys) {
+        return diffs;
+    }
+
+    hm_iter_begin(old_hm, &iter);
+    while ((n = hm_next_batch(&iter, new_hm, kvps, hashes)) > 0) {
+        hm_prefetch_hashed(new_hm, hashes, n, false);
+
+        for (size_t i = 0; i < n; i++) {
+            const void *key = kvp_key(old_hm, kvps[i]);
+
+            if (!hm_get_hashed(new_hm, key, hashes[i])) {
+                func(HM_DIFF_REMOVED, key, kvp_val(old_hm, kvps[i]), NULL, ctx);
+                diffs++;
+            }
+        }
+    }
+
+    return diffs;
+}
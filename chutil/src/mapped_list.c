@@ -0,0 +1,171 @@
+
+// Needed for mremap, we fall back to munmap/mmap without it.
+#define _GNU_SOURCE
+
+#include "chutil/mapped_list.h"
+#include "chsys/mem.h"
+#include "chsys/log.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Capacity given to a brand new file.
+#define MAPPED_LIST_INIT_CAP 16
+
+static inline size_t mal_map_size(size_t cs, size_t cap) {
+    return sizeof(mapped_list_header_t) + (cs * cap);
+}
+
+static void *mal_map(int fd, size_t size) {
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return mem == MAP_FAILED ? NULL : mem;
+}
+
+mapped_array_list_t *new_mapped_array_list(const char *path, size_t cs) {
+    if (cs == 0) {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t file_size = (size_t)st.st_size;
+    size_t map_size;
+    mapped_list_header_t *hdr;
+
+    if (file_size == 0) {
+        // Fresh file, lay down an empty list.
+        map_size = mal_map_size(cs, MAPPED_LIST_INIT_CAP);
+        if (ftruncate(fd, map_size) != 0 || !(hdr = mal_map(fd, map_size))) {
+            close(fd);
+            return NULL;
+        }
+
+        hdr->magic = MAPPED_LIST_MAGIC;
+        hdr->cell_size = cs;
+        hdr->len = 0;
+        hdr->cap = MAPPED_LIST_INIT_CAP;
+    } else {
+        if (file_size < sizeof(mapped_list_header_t) ||
+                !(hdr = mal_map(fd, file_size))) {
+            close(fd);
+            return NULL;
+        }
+
+        map_size = file_size;
+
+        // Make sure this really is one of our lists, and that it
+        // actually fits in the file. (Dividing, since cs * cap could
+        // overflow for a bad cap)
+        if (hdr->magic != MAPPED_LIST_MAGIC || hdr->cell_size != cs ||
+                hdr->len > hdr->cap ||
+                hdr->cap > (file_size - sizeof(mapped_list_header_t)) / cs) {
+            munmap(hdr, map_size);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    mapped_array_list_t *mal = safe_malloc(sizeof(mapped_array_list_t));
+    mal->fd = fd;
+    mal->map_size = map_size;
+    mal->hdr = hdr;
+    mal->iter_ind = 0;
+
+    return mal;
+}
+
+void delete_mapped_array_list(mapped_array_list_t *mal) {
+    munmap(mal->hdr, mal->map_size);
+    close(mal->fd);
+    safe_free(mal);
+}
+
+bool mal_flush(mapped_array_list_t *mal) {
+    return msync(mal->hdr, mal->map_size, MS_SYNC) == 0;
+}
+
+static void mal_grow(mapped_array_list_t *mal) {
+    size_t cs = mal->hdr->cell_size;
+    size_t new_cap = mal->hdr->cap * 2;
+    size_t new_size = mal_map_size(cs, new_cap);
+
+    if (ftruncate(mal->fd, new_size) != 0) {
+        log_fatal("Failed to grow mapped list file");
+    }
+
+    void *mem;
+
+#ifdef MREMAP_MAYMOVE
+    mem = mremap(mal->hdr, mal->map_size, new_size, MREMAP_MAYMOVE);
+    if (mem == MAP_FAILED) {
+        mem = NULL;
+    }
+#else
+    munmap(mal->hdr, mal->map_size);
+    mem = mal_map(mal->fd, new_size);
+#endif
+
+    if (!mem) {
+        log_fatal("Failed to remap mapped list");
+    }
+
+    mal->hdr = mem;
+    mal->map_size = new_size;
+    mal->hdr->cap = new_cap;
+}
+
+void mal_push(mapped_array_list_t *mal, const void *src) {
+    if (mal->hdr->len == mal->hdr->cap) {
+        mal_grow(mal);
+    }
+
+    mal_set(mal, mal->hdr->len, src);
+    mal->hdr->len++;
+}
+
+void mal_pop(mapped_array_list_t *mal, void *dest) {
+    if (mal->hdr->len == 0) {
+        return;
+    }
+
+    if (dest) {
+        mal_get_copy(mal, mal->hdr->len - 1, dest);
+    }
+
+    mal->hdr->len--;
+}
+
+void mal_poll(mapped_array_list_t *mal, void *dest) {
+    if (mal->hdr->len == 0) {
+        return;
+    }
+
+    if (dest) {
+        mal_get_copy(mal, 0, dest);
+    }
+
+    memmove(mal_get(mal, 0), mal_get(mal, 1),
+            (mal->hdr->len - 1) * mal->hdr->cell_size);
+
+    mal->hdr->len--;
+}
+
+void *mal_next(mapped_array_list_t *mal) {
+    if (mal->iter_ind < mal->hdr->len) {
+        return mal_get(mal, mal->iter_ind++);
+    }
+
+    return NULL;
+}
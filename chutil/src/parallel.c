@@ -0,0 +1,349 @@
+
+#include "chutil/parallel.h"
+#include "chutil/list.h"
+#include "chutil/sort.h"
+#include "chsys/mem.h"
+#include "chsys/log.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+// Thread Pool
+
+// Grabs and runs chunks of the current job until there are none left.
+// Expects tp->mut to be held, it will be held again on return.
+static void tp_work_locked(thread_pool_t *tp) {
+    while (tp->next_chunk < tp->num_chunks) {
+        size_t chunk = tp->next_chunk++;
+        thread_pool_task_ft task = tp->task;
+        void *ctx = tp->ctx;
+
+        pthread_mutex_unlock(&(tp->mut));
+        task(ctx, chunk);
+        pthread_mutex_lock(&(tp->mut));
+
+        tp->chunks_done++;
+        if (tp->chunks_done == tp->num_chunks) {
+            pthread_cond_signal(&(tp->done_cond));
+        }
+    }
+}
+
+static void *tp_worker(void *arg) {
+    thread_pool_t *tp = arg;
+
+    pthread_mutex_lock(&(tp->mut));
+    while (true) {
+        while (!(tp->shutdown) && tp->next_chunk >= tp->num_chunks) {
+            pthread_cond_wait(&(tp->work_cond), &(tp->mut));
+        }
+
+        if (tp->shutdown) {
+            break;
+        }
+
+        tp_work_locked(tp);
+    }
+    pthread_mutex_unlock(&(tp->mut));
+
+    return NULL;
+}
+
+thread_pool_t *new_thread_pool(size_t nw) {
+    thread_pool_t *tp = safe_malloc(sizeof(thread_pool_t));
+
+    tp->num_workers = nw;
+    tp->workers = nw > 0 ? safe_malloc(sizeof(pthread_t) * nw) : NULL;
+
+    pthread_mutex_init(&(tp->mut), NULL);
+    pthread_cond_init(&(tp->work_cond), NULL);
+    pthread_cond_init(&(tp->done_cond), NULL);
+
+    tp->shutdown = false;
+
+    tp->task = NULL;
+    tp->ctx = NULL;
+    tp->num_chunks = 0;
+    tp->next_chunk = 0;
+    tp->chunks_done = 0;
+
+    for (size_t i = 0; i < nw; i++) {
+        if (pthread_create(&(tp->workers[i]), NULL, tp_worker, tp)) {
+            log_fatal("Failed to create thread pool worker");
+        }
+    }
+
+    return tp;
+}
+
+void delete_thread_pool(thread_pool_t *tp) {
+    pthread_mutex_lock(&(tp->mut));
+    tp->shutdown = true;
+    pthread_cond_broadcast(&(tp->work_cond));
+    pthread_mutex_unlock(&(tp->mut));
+
+    for (size_t i = 0; i < tp->num_workers; i++) {
+        pthread_join(tp->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&(tp->done_cond));
+    pthread_cond_destroy(&(tp->work_cond));
+    pthread_mutex_destroy(&(tp->mut));
+
+    if (tp->workers) {
+        safe_free(tp->workers);
+    }
+    safe_free(tp);
+}
+
+void tp_run(thread_pool_t *tp, thread_pool_task_ft task, void *ctx, size_t num_chunks) {
+    if (num_chunks == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&(tp->mut));
+
+    tp->task = task;
+    tp->ctx = ctx;
+    tp->num_chunks = num_chunks;
+    tp->next_chunk = 0;
+    tp->chunks_done = 0;
+
+    if (num_chunks > 1) {
+        pthread_cond_broadcast(&(tp->work_cond));
+    }
+
+    // We help out too.
+    tp_work_locked(tp);
+
+    while (tp->chunks_done < tp->num_chunks) {
+        pthread_cond_wait(&(tp->done_cond), &(tp->mut));
+    }
+
+    pthread_mutex_unlock(&(tp->mut));
+}
+
+// Array List Helpers
+
+// Every helper splits [0, len) into num_chunks near equal ranges.
+typedef struct _parallel_range_t {
+    size_t len;
+    size_t num_chunks;
+} parallel_range_t;
+
+static parallel_range_t parallel_range(thread_pool_t *tp, size_t len) {
+    parallel_range_t range;
+    range.len = len;
+
+    // A few chunks per thread so uneven work still balances out.
+    range.num_chunks = tp_num_threads(tp) * 4;
+
+    size_t max_chunks = (len + PARALLEL_MIN_CHUNK_CELLS - 1) / PARALLEL_MIN_CHUNK_CELLS;
+    if (range.num_chunks > max_chunks) {
+        range.num_chunks = max_chunks;
+    }
+
+    return range;
+}
+
+static inline size_t pr_start(const parallel_range_t *range, size_t chunk) {
+    return (range->len * chunk) / range->num_chunks;
+}
+
+static inline size_t pr_end(const parallel_range_t *range, size_t chunk) {
+    return (range->len * (chunk + 1)) / range->num_chunks;
+}
+
+typedef struct _for_each_ctx_t {
+    array_list_t *al;
+    parallel_range_t range;
+    parallel_for_each_ft func;
+    void *ctx;
+} for_each_ctx_t;
+
+static void for_each_task(for_each_ctx_t *fec, size_t chunk) {
+    size_t end = pr_end(&(fec->range), chunk);
+    for (size_t i = pr_start(&(fec->range), chunk); i < end; i++) {
+        fec->func(al_get(fec->al, i), fec->ctx);
+    }
+}
+
+void al_parallel_for_each(thread_pool_t *tp, array_list_t *al,
+        parallel_for_each_ft func, void *ctx) {
+    for_each_ctx_t fec = {
+        .al = al,
+        .range = parallel_range(tp, al_len(al)),
+        .func = func,
+        .ctx = ctx,
+    };
+
+    tp_run(tp, (thread_pool_task_ft)for_each_task, &fec, fec.range.num_chunks);
+}
+
+typedef struct _map_ctx_t {
+    array_list_t *src;
+    array_list_t *dest;
+    parallel_range_t range;
+    parallel_map_ft func;
+    void *ctx;
+} map_ctx_t;
+
+static void map_task(map_ctx_t *mc, size_t chunk) {
+    size_t end = pr_end(&(mc->range), chunk);
+    for (size_t i = pr_start(&(mc->range), chunk); i < end; i++) {
+        mc->func(al_get(mc->src, i), al_get(mc->dest, i), mc->ctx);
+    }
+}
+
+void al_parallel_map(thread_pool_t *tp, array_list_t *src, array_list_t *dest,
+        parallel_map_ft func, void *ctx) {
+    // Sized up front, so no thread ever causes a realloc.
+    al_resize(dest, al_len(src));
+
+    map_ctx_t mc = {
+        .src = src,
+        .dest = dest,
+        .range = parallel_range(tp, al_len(src)),
+        .func = func,
+        .ctx = ctx,
+    };
+
+    tp_run(tp, (thread_pool_task_ft)map_task, &mc, mc.range.num_chunks);
+}
+
+typedef struct _reduce_ctx_t {
+    array_list_t *al;
+    parallel_range_t range;
+    parallel_combine_ft combine;
+    void *ctx;
+    const void *identity;
+
+    // One accumulator per chunk.
+    uint8_t *partials;
+} reduce_ctx_t;
+
+static void reduce_task(reduce_ctx_t *rc, size_t chunk) {
+    size_t cs = al_cell_size(rc->al);
+    void *acc = rc->partials + (chunk * cs);
+
+    memcpy(acc, rc->identity, cs);
+
+    size_t end = pr_end(&(rc->range), chunk);
+    for (size_t i = pr_start(&(rc->range), chunk); i < end; i++) {
+        rc->combine(acc, al_get(rc->al, i), rc->ctx);
+    }
+}
+
+void al_parallel_reduce(thread_pool_t *tp, array_list_t *al,
+        parallel_combine_ft combine, void *ctx, const void *identity, void *dest) {
+    size_t cs = al_cell_size(al);
+
+    reduce_ctx_t rc = {
+        .al = al,
+        .range = parallel_range(tp, al_len(al)),
+        .combine = combine,
+        .ctx = ctx,
+        .identity = identity,
+        .partials = NULL,
+    };
+
+    memcpy(dest, identity, cs);
+
+    if (rc.range.num_chunks == 0) {
+        return;
+    }
+
+    rc.partials = safe_malloc(cs * rc.range.num_chunks);
+    tp_run(tp, (thread_pool_task_ft)reduce_task, &rc, rc.range.num_chunks);
+
+    // Partials are combined in order, so only associativity is needed.
+    for (size_t chunk = 0; chunk < rc.range.num_chunks; chunk++) {
+        combine(dest, rc.partials + (chunk * cs), ctx);
+    }
+
+    safe_free(rc.partials);
+}
+
+typedef struct _sort_ctx_t {
+    size_t cs;
+    sort_cmp_ft cmp;
+
+    // Sorted runs, run i is [bounds[i], bounds[i + 1])
+    size_t *bounds;
+    size_t num_runs;
+
+    // Every merge level reads from src and writes to dest.
+    uint8_t *src;
+    uint8_t *dest;
+} sort_ctx_t;
+
+static void sort_task(sort_ctx_t *sc, size_t chunk) {
+    size_t start = sc->bounds[chunk];
+    size_t end = sc->bounds[chunk + 1];
+    sort_cells(sc->src + (start * sc->cs), end - start, sc->cs, sc->cmp);
+}
+
+// Merges run pair (2 * chunk, 2 * chunk + 1). An unpaired last run
+// is just copied across.
+static void merge_task(sort_ctx_t *sc, size_t chunk) {
+    size_t left = chunk * 2;
+    size_t start = sc->bounds[left];
+    size_t mid = sc->bounds[left + 1];
+    size_t end = left + 2 <= sc->num_runs ? sc->bounds[left + 2] : mid;
+
+    merge_cells(sc->src + (start * sc->cs), mid - start, end - mid,
+            sc->cs, sc->cmp, sc->dest + (start * sc->cs));
+}
+
+void al_parallel_sort(thread_pool_t *tp, array_list_t *al, sort_cmp_ft cmp) {
+    parallel_range_t range = parallel_range(tp, al_len(al));
+
+    if (range.num_chunks <= 1) {
+        al_sort(al, cmp);
+        return;
+    }
+
+    size_t cs = al_cell_size(al);
+
+    sort_ctx_t sc = {
+        .cs = cs,
+        .cmp = cmp,
+        .bounds = safe_malloc(sizeof(size_t) * (range.num_chunks + 1)),
+        .num_runs = range.num_chunks,
+        .src = al->arr,
+        .dest = safe_malloc(cs * al_len(al)),
+    };
+
+    for (size_t i = 0; i <= range.num_chunks; i++) {
+        sc.bounds[i] = pr_start(&range, i);
+    }
+
+    tp_run(tp, (thread_pool_task_ft)sort_task, &sc, sc.num_runs);
+
+    uint8_t *buf = sc.dest;
+
+    while (sc.num_runs > 1) {
+        size_t num_merges = (sc.num_runs + 1) / 2;
+        tp_run(tp, (thread_pool_task_ft)merge_task, &sc, num_merges);
+
+        // Every other bound disappears.
+        size_t new_runs = 0;
+        for (size_t i = 0; i < sc.num_runs; i += 2) {
+            sc.bounds[new_runs++] = sc.bounds[i];
+        }
+        sc.bounds[new_runs] = al_len(al);
+        sc.num_runs = new_runs;
+
+        uint8_t *t = sc.src;
+        sc.src = sc.dest;
+        sc.dest = t;
+    }
+
+    if (sc.src != al->arr) {
+        memcpy(al->arr, sc.src, cs * al_len(al));
+    }
+
+    safe_free(buf);
+    safe_free(sc.bounds);
+}
@@ -0,0 +1,210 @@
+
+#include "chutil/queue.h"
+#include "chutil/list.h"
+#include "chsys/mem.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct _mpmc_slot_hdr_t {
+    atomic_size_t seq;
+} mpmc_slot_hdr_t;
+
+static inline mpmc_slot_hdr_t *mq_slot(mpmc_queue_t *mq, size_t pos) {
+    return (mpmc_slot_hdr_t *)(mq->slots + ((pos & mq->mask) * mq->slot_size));
+}
+
+static inline void *mqsh_get_cell(mpmc_slot_hdr_t *hdr) {
+    return hdr + 1;
+}
+
+// The list constructor only gets a cell size.
+static mpmc_queue_t *new_mpmc_queue_default(size_t cs) {
+    return new_mpmc_queue(cs, MPMC_QUEUE_DEFAULT_CAP);
+}
+
+static void mq_list_iter_begin(mpmc_queue_t *mq, list_iter_t *iter) {
+    iter->list = mq;
+    iter->ind = 0;
+}
+
+static void *mq_list_iter_next(list_iter_t *iter) {
+    mpmc_queue_t *mq = iter->list;
+    if (iter->ind < mq_len(mq)) {
+        return mq_get(mq, iter->ind++);
+    }
+
+    return NULL;
+}
+
+static const list_impl_t MPMC_QUEUE_IMPL_VAL = {
+    .constructor = (list_constructor_ft)new_mpmc_queue_default,
+    .destructor = (list_destructor_ft)delete_mpmc_queue,
+    .len = (list_len_ft)mq_len,
+    .cell_size = (list_cell_size_ft)mq_cell_size,
+    .get = (list_get_ft)mq_get,
+    .get_copy = (list_get_copy_ft)mq_get_copy,
+    .set = (list_set_ft)mq_set,
+    .push = (list_push_ft)mq_push,
+    .pop = (list_pop_ft)mq_pop,
+    .poll = (list_poll_ft)mq_poll,
+
+    .reset_iterator = (list_reset_iterator_ft)mq_reset_iterator,
+    .next = (list_next_ft)mq_next,
+
+    .iter_begin = (list_iter_begin_ft)mq_list_iter_begin,
+    .iter_next = mq_list_iter_next,
+};
+const list_impl_t *MPMC_QUEUE_IMPL = &MPMC_QUEUE_IMPL_VAL;
+
+mpmc_queue_t *new_mpmc_queue(size_t cs, size_t cap) {
+    if (cs == 0 || cap == 0) {
+        return NULL;
+    }
+
+    size_t pow_cap = 1;
+    while (pow_cap < cap) {
+        pow_cap <<= 1;
+    }
+
+    mpmc_queue_t *mq = safe_malloc(sizeof(mpmc_queue_t));
+
+    mq->cell_size = cs;
+
+    // Round slots up so every sequence number stays aligned.
+    size_t slot_size = sizeof(mpmc_slot_hdr_t) + cs;
+    size_t align = sizeof(mpmc_slot_hdr_t);
+    mq->slot_size = ((slot_size + align - 1) / align) * align;
+
+    mq->cap = pow_cap;
+    mq->mask = pow_cap - 1;
+    mq->slots = safe_malloc(mq->slot_size * mq->cap);
+
+    for (size_t i = 0; i < mq->cap; i++) {
+        atomic_init(&(mq_slot(mq, i)->seq), i);
+    }
+
+    mq->iter_ind = 0;
+
+    atomic_init(&(mq->enqueue_pos), 0);
+    atomic_init(&(mq->dequeue_pos), 0);
+
+    return mq;
+}
+
+void delete_mpmc_queue(mpmc_queue_t *mq) {
+    safe_free(mq->slots);
+    safe_free(mq);
+}
+
+size_t mq_len(mpmc_queue_t *mq) {
+    size_t deq = atomic_load_explicit(&(mq->dequeue_pos), memory_order_relaxed);
+    size_t enq = atomic_load_explicit(&(mq->enqueue_pos), memory_order_relaxed);
+
+    // The two loads aren't taken together, so the consumers may
+    // appear to be ahead.
+    return enq > deq ? enq - deq : 0;
+}
+
+bool mq_try_push(mpmc_queue_t *mq, const void *src) {
+    mpmc_slot_hdr_t *slot;
+    size_t pos = atomic_load_explicit(&(mq->enqueue_pos), memory_order_relaxed);
+
+    while (true) {
+        slot = mq_slot(mq, pos);
+        size_t seq = atomic_load_explicit(&(slot->seq), memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            // The slot is free for position pos, try to claim it.
+            if (atomic_compare_exchange_weak_explicit(&(mq->enqueue_pos), &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+            // On failure, pos now holds the current enqueue position.
+        } else if (diff < 0) {
+            // The slot still holds a cell from the previous lap, full!
+            return false;
+        } else {
+            // Another producer beat us here.
+            pos = atomic_load_explicit(&(mq->enqueue_pos), memory_order_relaxed);
+        }
+    }
+
+    memcpy(mqsh_get_cell(slot), src, mq->cell_size);
+
+    // Hand the slot over to the consumer of position pos.
+    atomic_store_explicit(&(slot->seq), pos + 1, memory_order_release);
+
+    return true;
+}
+
+bool mq_try_poll(mpmc_queue_t *mq, void *dest) {
+    mpmc_slot_hdr_t *slot;
+    size_t pos = atomic_load_explicit(&(mq->dequeue_pos), memory_order_relaxed);
+
+    while (true) {
+        slot = mq_slot(mq, pos);
+        size_t seq = atomic_load_explicit(&(slot->seq), memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&(mq->dequeue_pos), &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Nothing has been written here yet, empty!
+            return false;
+        } else {
+            pos = atomic_load_explicit(&(mq->dequeue_pos), memory_order_relaxed);
+        }
+    }
+
+    if (dest) {
+        memcpy(dest, mqsh_get_cell(slot), mq->cell_size);
+    }
+
+    // Hand the slot over to the producer of the next lap.
+    atomic_store_explicit(&(slot->seq), pos + mq->mask + 1, memory_order_release);
+
+    return true;
+}
+
+void mq_push(mpmc_queue_t *mq, const void *src) {
+    while (!mq_try_push(mq, src)) {
+        sched_yield();
+    }
+}
+
+void *mq_get(mpmc_queue_t *mq, size_t i) {
+    size_t deq = atomic_load_explicit(&(mq->dequeue_pos), memory_order_relaxed);
+    return mqsh_get_cell(mq_slot(mq, deq + i));
+}
+
+void mq_pop(mpmc_queue_t *mq, void *dest) {
+    if (mq_len(mq) == 0) {
+        return;
+    }
+
+    size_t pos = atomic_load_explicit(&(mq->enqueue_pos), memory_order_relaxed) - 1;
+    mpmc_slot_hdr_t *slot = mq_slot(mq, pos);
+
+    if (dest) {
+        memcpy(dest, mqsh_get_cell(slot), mq->cell_size);
+    }
+
+    // Give the slot back to whoever pushes position pos next.
+    atomic_store_explicit(&(slot->seq), pos, memory_order_relaxed);
+    atomic_store_explicit(&(mq->enqueue_pos), pos, memory_order_release);
+}
+
+void *mq_next(mpmc_queue_t *mq) {
+    if (mq->iter_ind < mq_len(mq)) {
+        return mq_get(mq, mq->iter_ind++);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,432 @@
+
+#include "chutil/sort.h"
+#include "chsys/mem.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Ranges this size or smaller are just insertion sorted.
+#define SORT_INSERTION_THRESHOLD 16
+
+static inline uint8_t *cell_at(uint8_t *arr, size_t cs, size_t i) {
+    return arr + (i * cs);
+}
+
+// Most of our cells are 4 or 8 bytes, so we give those their own
+// paths. The fixed size memcpys become single loads and stores.
+static inline void swap_cells(uint8_t *c1, uint8_t *c2, size_t cs) {
+    if (c1 == c2) {
+        return;
+    }
+
+    switch (cs) {
+    case sizeof(uint32_t): {
+        uint32_t t1, t2;
+        memcpy(&t1, c1, sizeof(uint32_t));
+        memcpy(&t2, c2, sizeof(uint32_t));
+        memcpy(c1, &t2, sizeof(uint32_t));
+        memcpy(c2, &t1, sizeof(uint32_t));
+        return;
+    }
+    case sizeof(uint64_t): {
+        uint64_t t1, t2;
+        memcpy(&t1, c1, sizeof(uint64_t));
+        memcpy(&t2, c2, sizeof(uint64_t));
+        memcpy(c1, &t2, sizeof(uint64_t));
+        memcpy(c2, &t1, sizeof(uint64_t));
+        return;
+    }
+    default: {
+        // Larger records are swapped in word sized pieces, then
+        // byte by byte for whatever is left over.
+        uint64_t t;
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= cs; i += sizeof(uint64_t)) {
+            memcpy(&t, c1 + i, sizeof(uint64_t));
+            memcpy(c1 + i, c2 + i, sizeof(uint64_t));
+            memcpy(c2 + i, &t, sizeof(uint64_t));
+        }
+
+        for (; i < cs; i++) {
+            uint8_t b = c1[i];
+            c1[i] = c2[i];
+            c2[i] = b;
+        }
+        return;
+    }
+    }
+}
+
+// Stable, tmp must be able to hold one cell.
+static void insertion_sort(uint8_t *arr, size_t len, size_t cs,
+        sort_cmp_ft cmp, uint8_t *tmp) {
+    for (size_t i = 1; i < len; i++) {
+        uint8_t *cell = cell_at(arr, cs, i);
+
+        // Already in place, most common case for nearly sorted input.
+        if (cmp(cell - cs, cell) <= 0) {
+            continue;
+        }
+
+        memcpy(tmp, cell, cs);
+
+        size_t j = i;
+        while (j > 0 && cmp(cell_at(arr, cs, j - 1), tmp) > 0) {
+            j--;
+        }
+
+        memmove(cell_at(arr, cs, j + 1), cell_at(arr, cs, j), (i - j) * cs);
+        memcpy(cell_at(arr, cs, j), tmp, cs);
+    }
+}
+
+static void sift_down(uint8_t *arr, size_t len, size_t cs,
+        sort_cmp_ft cmp, size_t i) {
+    while (true) {
+        size_t largest = i;
+        size_t left = (2 * i) + 1;
+        size_t right = left + 1;
+
+        if (left < len &&
+                cmp(cell_at(arr, cs, left), cell_at(arr, cs, largest)) > 0) {
+            largest = left;
+        }
+
+        if (right < len &&
+                cmp(cell_at(arr, cs, right), cell_at(arr, cs, largest)) > 0) {
+            largest = right;
+        }
+
+        if (largest == i) {
+            return;
+        }
+
+        swap_cells(cell_at(arr, cs, i), cell_at(arr, cs, largest), cs);
+        i = largest;
+    }
+}
+
+static void heap_sort(uint8_t *arr, size_t len, size_t cs, sort_cmp_ft cmp) {
+    for (size_t i = len / 2; i > 0; i--) {
+        sift_down(arr, len, cs, cmp, i - 1);
+    }
+
+    for (size_t end = len - 1; end > 0; end--) {
+        swap_cells(arr, cell_at(arr, cs, end), cs);
+        sift_down(arr, end, cs, cmp, 0);
+    }
+}
+
+// Expects len > SORT_INSERTION_THRESHOLD.
+//
+// The median of the first, middle and last cells is used as the pivot.
+// Returns the final index of the pivot p. Everything before p will be <= it,
+// everything after p will be >= it.
+static size_t partition(uint8_t *arr, size_t len, size_t cs, sort_cmp_ft cmp) {
+    uint8_t *a = cell_at(arr, cs, 1);
+    uint8_t *b = cell_at(arr, cs, len / 2);
+    uint8_t *c = cell_at(arr, cs, len - 1);
+
+    // Order a <= b <= c.
+    if (cmp(b, a) < 0) {
+        swap_cells(a, b, cs);
+    }
+
+    if (cmp(c, b) < 0) {
+        swap_cells(b, c, cs);
+        if (cmp(b, a) < 0) {
+            swap_cells(a, b, cs);
+        }
+    }
+
+    // Pivot lives at index 0 while partitioning.
+    // a and c now act as sentinels for the two scans below.
+    swap_cells(arr, b, cs);
+
+    size_t i = 1;
+    size_t j = len - 1;
+
+    while (true) {
+        do {
+            i++;
+        } while (cmp(cell_at(arr, cs, i), arr) < 0);
+
+        do {
+            j--;
+        } while (cmp(arr, cell_at(arr, cs, j)) < 0);
+
+        if (i >= j) {
+            break;
+        }
+
+        swap_cells(cell_at(arr, cs, i), cell_at(arr, cs, j), cs);
+    }
+
+    swap_cells(arr, cell_at(arr, cs, j), cs);
+    return j;
+}
+
+static size_t depth_limit(size_t len) {
+    size_t depth = 0;
+    while (len > 1) {
+        len >>= 1;
+        depth++;
+    }
+
+    return depth * 2;
+}
+
+static void intro_sort(uint8_t *arr, size_t len, size_t cs,
+        sort_cmp_ft cmp, uint8_t *tmp, size_t depth) {
+    while (len > SORT_INSERTION_THRESHOLD) {
+        if (depth == 0) {
+            // Quicksort is going quadratic on us, bail out to heap sort.
+            heap_sort(arr, len, cs, cmp);
+            return;
+        }
+        depth--;
+
+        size_t p = partition(arr, len, cs, cmp);
+
+        uint8_t *right = cell_at(arr, cs, p + 1);
+        size_t right_len = len - p - 1;
+
+        // Recurse on the smaller half, loop on the larger.
+        // This keeps our stack depth logarithmic.
+        if (p < right_len) {
+            intro_sort(arr, p, cs, cmp, tmp, depth);
+            arr = right;
+            len = right_len;
+        } else {
+            intro_sort(right, right_len, cs, cmp, tmp, depth);
+            len = p;
+        }
+    }
+
+    insertion_sort(arr, len, cs, cmp, tmp);
+}
+
+void sort_cells(void *arr, size_t len, size_t cs, sort_cmp_ft cmp) {
+    if (len < 2 || cs == 0) {
+        return;
+    }
+
+    uint8_t *tmp = safe_malloc(cs);
+    intro_sort(arr, len, cs, cmp, tmp, depth_limit(len));
+    safe_free(tmp);
+}
+
+// Ties go to the first run, this is what makes our merge sort stable.
+void merge_cells(const void *src, size_t n1, size_t n2, size_t cs,
+        sort_cmp_ft cmp, void *dest_arr) {
+    uint8_t *dest = dest_arr;
+    const uint8_t *left = src;
+    const uint8_t *left_end = left + (n1 * cs);
+    const uint8_t *right = left_end;
+    const uint8_t *right_end = right + (n2 * cs);
+
+    while (left < left_end && right < right_end) {
+        if (cmp(right, left) < 0) {
+            memcpy(dest, right, cs);
+            right += cs;
+        } else {
+            memcpy(dest, left, cs);
+            left += cs;
+        }
+        dest += cs;
+    }
+
+    if (left < left_end) {
+        memcpy(dest, left, left_end - left);
+        dest += left_end - left;
+    }
+
+    if (right < right_end) {
+        memcpy(dest, right, right_end - right);
+    }
+}
+
+void stable_sort_cells(void *arr, size_t len, size_t cs, sort_cmp_ft cmp) {
+    if (len < 2 || cs == 0) {
+        return;
+    }
+
+    uint8_t *tmp = safe_malloc(cs);
+
+    // Bottom up merge sort, start by insertion sorting small runs.
+    for (size_t i = 0; i < len; i += SORT_INSERTION_THRESHOLD) {
+        size_t run_len = len - i < SORT_INSERTION_THRESHOLD
+            ? len - i : SORT_INSERTION_THRESHOLD;
+        insertion_sort(cell_at(arr, cs, i), run_len, cs, cmp, tmp);
+    }
+
+    safe_free(tmp);
+
+    if (len <= SORT_INSERTION_THRESHOLD) {
+        return;
+    }
+
+    uint8_t *buf = safe_malloc(len * cs);
+
+    // We ping pong between arr and buf each pass.
+    uint8_t *src = arr;
+    uint8_t *dest = buf;
+
+    for (size_t width = SORT_INSERTION_THRESHOLD; width < len; width *= 2) {
+        for (size_t i = 0; i < len; i += 2 * width) {
+            size_t n1 = len - i < width ? len - i : width;
+            size_t n2 = len - i - n1 < width ? len - i - n1 : width;
+
+            merge_cells(cell_at(src, cs, i), n1, n2, cs, cmp,
+                    cell_at(dest, cs, i));
+        }
+
+        uint8_t *t = src;
+        src = dest;
+        dest = t;
+    }
+
+    if (src != arr) {
+        memcpy(arr, src, len * cs);
+    }
+
+    safe_free(buf);
+}
+
+typedef struct _radix_entry_t {
+    uint64_t key;
+    size_t ind;
+} radix_entry_t;
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (sizeof(uint64_t) * 8 / RADIX_BITS)
+
+void radix_sort_cells(void *arr, size_t len, size_t cs, sort_key_ft key_func) {
+    if (len < 2 || cs == 0) {
+        return;
+    }
+
+    // We sort (key, index) pairs, then permute the actual cells once
+    // at the very end. This way large records are only ever copied twice.
+    radix_entry_t *entries = safe_malloc(sizeof(radix_entry_t) * len);
+    radix_entry_t *entries_buf = safe_malloc(sizeof(radix_entry_t) * len);
+
+    // Histograms for every pass are all built in one go.
+    size_t (*counts)[RADIX_BUCKETS] =
+        safe_malloc(sizeof(size_t) * RADIX_BUCKETS * RADIX_PASSES);
+    memset(counts, 0, sizeof(size_t) * RADIX_BUCKETS * RADIX_PASSES);
+
+    for (size_t i = 0; i < len; i++) {
+        uint64_t key = key_func(cell_at(arr, cs, i));
+        entries[i].key = key;
+        entries[i].ind = i;
+
+        for (size_t p = 0; p < RADIX_PASSES; p++) {
+            counts[p][(key >> (p * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    radix_entry_t *src = entries;
+    radix_entry_t *dest = entries_buf;
+
+    for (size_t p = 0; p < RADIX_PASSES; p++) {
+        size_t shift = p * RADIX_BITS;
+
+        // If every key has the same digit here, this pass is a no-op.
+        size_t digit = (src[0].key >> shift) & (RADIX_BUCKETS - 1);
+        if (counts[p][digit] == len) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+            size_t c = counts[p][b];
+            counts[p][b] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < len; i++) {
+            size_t b = (src[i].key >> shift) & (RADIX_BUCKETS - 1);
+            dest[counts[p][b]++] = src[i];
+        }
+
+        radix_entry_t *t = src;
+        src = dest;
+        dest = t;
+    }
+
+    // Finally, gather the cells in order.
+    uint8_t *cells_buf = safe_malloc(len * cs);
+    for (size_t i = 0; i < len; i++) {
+        memcpy(cell_at(cells_buf, cs, i), cell_at(arr, cs, src[i].ind), cs);
+    }
+    memcpy(arr, cells_buf, len * cs);
+
+    safe_free(cells_buf);
+    safe_free(counts);
+    safe_free(entries_buf);
+    safe_free(entries);
+}
+
+bool bsearch_cells(const void *arr, size_t len, size_t cs, const void *key,
+        sort_cmp_ft cmp, size_t *ind) {
+    const uint8_t *cells = arr;
+
+    size_t lo = 0;
+    size_t hi = len;
+
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+
+        if (cmp(cells + (mid * cs), key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (ind) {
+        *ind = lo;
+    }
+
+    return lo < len && cmp(cells + (lo * cs), key) == 0;
+}
+
+void nth_element_cells(void *arr, size_t len, size_t cs, size_t n, sort_cmp_ft cmp) {
+    if (n >= len || cs == 0) {
+        return;
+    }
+
+    uint8_t *cells = arr;
+    size_t depth = depth_limit(len);
+
+    uint8_t *tmp = safe_malloc(cs);
+
+    while (len > SORT_INSERTION_THRESHOLD) {
+        if (depth == 0) {
+            heap_sort(cells, len, cs, cmp);
+            safe_free(tmp);
+            return;
+        }
+        depth--;
+
+        size_t p = partition(cells, len, cs, cmp);
+
+        if (n == p) {
+            safe_free(tmp);
+            return;
+        }
+
+        if (n < p) {
+            len = p;
+        } else {
+            cells = cell_at(cells, cs, p + 1);
+            len = len - p - 1;
+            n = n - p - 1;
+        }
+    }
+
+    insertion_sort(cells, len, cs, cmp, tmp);
+    safe_free(tmp);
+}
@@ -1,5 +1,6 @@
 
 #include "chutil/string.h"
+#include "chutil/hash.h"
 #include "chsys/mem.h"
 #include <stdlib.h>
 #include <string.h>
@@ -94,13 +95,8 @@ bool s_equals(const string_t *s1, const string_t *s2) {
     return strcmp(s_get_cstr(s1), s_get_cstr(s2)) == 0;
 }
 
-uint32_t s_hash(const string_t *s) {
-    uint32_t hash_val = 23;    
-    for (size_t i = 0; i < s_len(s); i++) {
-        hash_val = (hash_val * 31) + s_get_char(s, i);
-    }
-
-    return hash_val;
+uint64_t s_hash(const string_t *s) {
+    return hash_bytes(s_get_cstr(s), s_len(s));
 }
 
 string_t *s_substring(const string_t *s, size_t start, size_t end) {
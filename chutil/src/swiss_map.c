@@ -0,0 +1,368 @@
+
+#include "chutil/swiss_map.h"
+#include "chsys/mem.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Starting capacity, one group.
+#define SM_INIT_CAP SWISS_GROUP_WIDTH
+
+// Max load is 7/8ths of the slots. (Tombstones included)
+static inline size_t sm_growth_limit(size_t cap) {
+    return cap - (cap / 8);
+}
+
+// User hashes can be pretty weak (the identity for small ints),
+// so mix all the bits around before splitting the hash into a group
+// index and a tag. (This is the murmur3 finalizer)
+static inline uint64_t sm_mix(uint64_t hash_val) {
+    uint64_t h = hash_val;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static inline int8_t sm_tag(uint64_t h) {
+    return (int8_t)(h & 0x7F);
+}
+
+static inline size_t sm_first_group(uint64_t h, size_t num_groups) {
+    return (size_t)(h >> 7) & (num_groups - 1);
+}
+
+static inline void *sm_slot(swiss_map_t *sm, size_t ind) {
+    return sm->slots + (ind * sm->slot_size);
+}
+
+// Group matching, each returns a 16 bit mask with bit i set iff
+// control byte i of the group satisfies the condition.
+
+#ifdef __SSE2__
+
+static inline uint32_t group_match(const int8_t *g, int8_t tag) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+}
+
+// EMPTY and DELETED are the only control bytes with the high bit set.
+static inline uint32_t group_match_free(const int8_t *g) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+    return (uint32_t)_mm_movemask_epi8(ctrl);
+}
+
+#else
+
+static inline uint32_t group_match(const int8_t *g, int8_t tag) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SWISS_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(g[i] == tag) << i;
+    }
+
+    return mask;
+}
+
+static inline uint32_t group_match_free(const int8_t *g) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SWISS_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(g[i] < 0) << i;
+    }
+
+    return mask;
+}
+
+#endif
+
+static inline uint32_t group_match_empty(const int8_t *g) {
+    return group_match(g, SWISS_CTRL_EMPTY);
+}
+
+// Groups are probed triangularly (1, 2, 3, ... groups further each time).
+// With a power of 2 number of groups this visits every group.
+typedef struct _sm_probe_t {
+    size_t group;
+    size_t group_mask;
+    size_t step;
+} sm_probe_t;
+
+static inline sm_probe_t sm_probe_start(size_t cap, uint64_t h) {
+    size_t num_groups = cap / SWISS_GROUP_WIDTH;
+
+    sm_probe_t p = {
+        .group = sm_first_group(h, num_groups),
+        .group_mask = num_groups - 1,
+        .step = 0,
+    };
+
+    return p;
+}
+
+static inline void sm_probe_next(sm_probe_t *p) {
+    p->step++;
+    p->group = (p->group + p->step) & p->group_mask;
+}
+
+// Returns the slot index of key, or cap if it isn't in the map.
+static size_t sm_find(swiss_map_t *sm, const void *key, uint64_t h) {
+    int8_t tag = sm_tag(h);
+    sm_probe_t p = sm_probe_start(sm->cap, h);
+
+    while (true) {
+        const int8_t *g = sm->ctrl + (p.group * SWISS_GROUP_WIDTH);
+
+        uint32_t matches = group_match(g, tag);
+        while (matches) {
+            size_t ind = (p.group * SWISS_GROUP_WIDTH) + __builtin_ctz(matches);
+            if (sm->eq_func(sm_slot(sm, ind), key)) {
+                return ind;
+            }
+
+            matches &= matches - 1;
+        }
+
+        // Insertion never skips over an empty slot, so an empty slot in
+        // this group means key can't be any further along.
+        if (group_match_empty(g)) {
+            return sm->cap;
+        }
+
+        sm_probe_next(&p);
+    }
+}
+
+// Returns the first EMPTY or DELETED slot along the probe sequence of h.
+static size_t sm_find_free(int8_t *ctrl, size_t cap, uint64_t h) {
+    sm_probe_t p = sm_probe_start(cap, h);
+
+    while (true) {
+        uint32_t free_slots = group_match_free(ctrl + (p.group * SWISS_GROUP_WIDTH));
+        if (free_slots) {
+            return (p.group * SWISS_GROUP_WIDTH) + __builtin_ctz(free_slots);
+        }
+
+        sm_probe_next(&p);
+    }
+}
+
+static void sm_alloc_table(swiss_map_t *sm, size_t cap) {
+    sm->cap = cap;
+    sm->ctrl = safe_malloc(cap);
+    memset(sm->ctrl, (uint8_t)SWISS_CTRL_EMPTY, cap);
+    sm->slots = safe_malloc(cap * sm->slot_size);
+}
+
+// Moves every pair into a fresh table of size new_cap.
+// This also throws away all tombstones.
+static void sm_rehash(swiss_map_t *sm, size_t new_cap) {
+    size_t old_cap = sm->cap;
+    int8_t *old_ctrl = sm->ctrl;
+    uint8_t *old_slots = sm->slots;
+
+    sm_alloc_table(sm, new_cap);
+
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old_ctrl[i] < 0) {
+            continue;
+        }
+
+        void *old_slot = old_slots + (i * sm->slot_size);
+        uint64_t h = sm_mix(sm->hash_func(old_slot));
+
+        size_t ind = sm_find_free(sm->ctrl, sm->cap, h);
+        sm->ctrl[ind] = sm_tag(h);
+        memcpy(sm_slot(sm, ind), old_slot, sm->slot_size);
+    }
+
+    sm->num_deleted = 0;
+
+    safe_free(old_ctrl);
+    safe_free(old_slots);
+}
+
+swiss_map_t *new_swiss_map(size_t ks, size_t vs,
+        hash_map_hash_ft hf, hash_map_key_eq_ft ef) {
+    if (ks == 0 || hf == NULL || ef == NULL) {
+        return NULL;
+    }
+
+    swiss_map_t *sm = safe_malloc(sizeof(swiss_map_t));
+
+    sm->key_size = ks;
+    sm->value_size = vs;
+
+    // Keys are aligned to the largest power of 2 (up to 8) dividing
+    // their size, so word sized keys are never split.
+    size_t align = ks & -ks;
+    if (align > 8) {
+        align = 8;
+    }
+    sm->slot_size = (ks + vs + align - 1) & ~(align - 1);
+
+    sm->hash_func = hf;
+    sm->eq_func = ef;
+
+    sm->num_keys = 0;
+    sm->num_deleted = 0;
+
+    sm_alloc_table(sm, SM_INIT_CAP);
+
+    return sm;
+}
+
+void delete_swiss_map(swiss_map_t *sm) {
+    safe_free(sm->ctrl);
+    safe_free(sm->slots);
+    safe_free(sm);
+}
+
+void sm_iter_begin(swiss_map_t *sm, sm_iter_t *iter) {
+    iter->sm = sm;
+    iter->ind = 0;
+}
+
+key_val_pair_t sm_iter_next(sm_iter_t *iter) {
+    swiss_map_t *sm = iter->sm;
+
+    while (iter->ind < sm->cap) {
+        size_t ind = iter->ind++;
+        if (sm->ctrl[ind] >= 0) {
+            return sm_slot(sm, ind);
+        }
+    }
+
+    return HASH_MAP_EXHAUSTED;
+}
+
+void sm_put(swiss_map_t *sm, const void *key, const void *value) {
+    uint64_t h = sm_mix(sm->hash_func(key));
+
+    size_t ind = sm_find(sm, key, h);
+    if (ind < sm->cap) {
+        memcpy(sm_kvp_val(sm, sm_slot(sm, ind)), value, sm->value_size);
+        return;
+    }
+
+    ind = sm_find_free(sm->ctrl, sm->cap, h);
+
+    // Reusing a tombstone never uses up more of the table.
+    if (sm->ctrl[ind] == SWISS_CTRL_EMPTY &&
+            sm->num_keys + sm->num_deleted + 1 > sm_growth_limit(sm->cap)) {
+        // If most of the used up space is tombstones, cleaning them up
+        // is enough, otherwise grow.
+        size_t new_cap = sm->num_keys + 1 > sm_growth_limit(sm->cap) / 2
+            ? sm->cap * 2
+            : sm->cap;
+
+        sm_rehash(sm, new_cap);
+        ind = sm_find_free(sm->ctrl, sm->cap, h);
+    }
+
+    if (sm->ctrl[ind] == SWISS_CTRL_DELETED) {
+        sm->num_deleted--;
+    }
+
+    sm->ctrl[ind] = sm_tag(h);
+
+    void *slot = sm_slot(sm, ind);
+    memcpy(slot, key, sm->key_size);
+    memcpy(sm_kvp_val(sm, slot), value, sm->value_size);
+
+    sm->num_keys++;
+}
+
+void *sm_get(swiss_map_t *sm, const void *key) {
+    uint64_t h = sm_mix(sm->hash_func(key));
+
+    size_t ind = sm_find(sm, key, h);
+    if (ind == sm->cap) {
+        return NULL;
+    }
+
+    return sm_kvp_val(sm, sm_slot(sm, ind));
+}
+
+bool sm_remove(swiss_map_t *sm, const void *key) {
+    uint64_t h = sm_mix(sm->hash_func(key));
+
+    size_t ind = sm_find(sm, key, h);
+    if (ind == sm->cap) {
+        return false;
+    }
+
+    // A probe only continues past a group if the group has no empty
+    // slots. So, if this group still has one, no probe can depend on
+    // this slot being taken, and it can go straight back to EMPTY.
+    const int8_t *g = sm->ctrl + ((ind / SWISS_GROUP_WIDTH) * SWISS_GROUP_WIDTH);
+    if (group_match_empty(g)) {
+        sm->ctrl[ind] = SWISS_CTRL_EMPTY;
+    } else {
+        sm->ctrl[ind] = SWISS_CTRL_DELETED;
+        sm->num_deleted++;
+    }
+
+    sm->num_keys--;
+
+    return true;
+}
+
+static void sm_map_iter_begin(swiss_map_t *sm, map_iter_t *iter) {
+    iter->map = sm;
+    iter->ind = 0;
+}
+
+static key_val_pair_t sm_map_iter_next(map_iter_t *iter) {
+    sm_iter_t sm_iter = {
+        .sm = iter->map,
+        .ind = iter->ind,
+    };
+
+    key_val_pair_t kvp = sm_iter_next(&sm_iter);
+    iter->ind = sm_iter.ind;
+
+    return kvp;
+}
+
+static const map_impl_t SWISS_MAP_IMPL_VAL = {
+    .constructor = (map_constructor_ft)new_swiss_map,
+    .destructor = (map_destructor_ft)delete_swiss_map,
+    .num_keys = (map_num_keys_ft)sm_num_keys,
+    .key_size = (map_key_size_ft)sm_key_size,
+    .value_size = (map_value_size_ft)sm_value_size,
+    .kvp_key = (map_kvp_key_ft)sm_kvp_key,
+    .kvp_val = (map_kvp_val_ft)sm_kvp_val,
+    .put = (map_put_ft)sm_put,
+    .get = (map_get_ft)sm_get,
+    .remove = (map_remove_ft)sm_remove,
+
+    .iter_begin = (map_iter_begin_ft)sm_map_iter_begin,
+    .iter_next = sm_map_iter_next,
+};
+const map_impl_t *SWISS_MAP_IMPL = &SWISS_MAP_IMPL_VAL;
+
+bool sm_equals(swiss_map_t *sm1, swiss_map_t *sm2, hash_map_val_eq_ft val_eq) {
+    if (sm_num_keys(sm1) != sm_num_keys(sm2)) {
+        return false;
+    }
+
+    key_val_pair_t kvp;
+    sm_iter_t iter;
+
+    sm_iter_begin(sm1, &iter);
+    while ((kvp = sm_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        const void *sm2_val = sm_get(sm2, sm_kvp_key(sm1, kvp));
+
+        if (!sm2_val || !val_eq(sm_kvp_val(sm1, kvp), sm2_val)) {
+            return false;
+        }
+    }
+
+    return true;
+}
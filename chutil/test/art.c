@@ -0,0 +1,225 @@
+
+#include "art.h"
+#include "chutil/art.h"
+#include "chutil/string.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static void test_art_put_get_remove(void) {
+    art_t *art = new_art(sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(art);
+
+    // Keys which are prefixes of each other, the empty key included.
+    const char *keys[] = {"", "a", "ab", "abc", "abd", "b", "abcdef", "xyz"};
+    const uint32_t num_keys = sizeof(keys) / sizeof(keys[0]);
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+        art_put(art, keys[i], strlen(keys[i]), &i);
+    }
+    TEST_ASSERT_EQUAL_size_t(num_keys, art_num_keys(art));
+
+    uint32_t val;
+    for (uint32_t i = 0; i < num_keys; i++) {
+        TEST_ASSERT_TRUE(art_get_copy(art, keys[i], strlen(keys[i]), &val));
+        TEST_ASSERT_EQUAL_UINT32(i, val);
+    }
+
+    TEST_ASSERT_FALSE(art_contains(art, "abcd", 4));
+    TEST_ASSERT_FALSE(art_contains(art, "x", 1));
+    TEST_ASSERT_FALSE(art_contains(art, "abcdefg", 7));
+
+    // Update.
+    val = 100;
+    art_put(art, "ab", 2, &val);
+    TEST_ASSERT_EQUAL_size_t(num_keys, art_num_keys(art));
+    TEST_ASSERT_EQUAL_UINT32(100, *(uint32_t *)art_get(art, "ab", 2));
+
+    // Remove in an order which collapses nodes along the way.
+    TEST_ASSERT_TRUE(art_remove(art, "abc", 3));
+    TEST_ASSERT_FALSE(art_remove(art, "abc", 3));
+    TEST_ASSERT_TRUE(art_contains(art, "abcdef", 6));
+    TEST_ASSERT_TRUE(art_remove(art, "abd", 3));
+    TEST_ASSERT_TRUE(art_contains(art, "abcdef", 6));
+    TEST_ASSERT_TRUE(art_remove(art, "ab", 2));
+    TEST_ASSERT_TRUE(art_contains(art, "abcdef", 6));
+    TEST_ASSERT_TRUE(art_contains(art, "a", 1));
+    TEST_ASSERT_TRUE(art_remove(art, "", 0));
+    TEST_ASSERT_EQUAL_size_t(num_keys - 4, art_num_keys(art));
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+        TEST_ASSERT_TRUE(art_remove(art, keys[i], strlen(keys[i])) || 
+                !art_contains(art, keys[i], strlen(keys[i])));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(0, art_num_keys(art));
+    TEST_ASSERT_NULL(art->root);
+
+    delete_art(art);
+}
+
+// Keys with a long shared start, and every possible byte after it, so
+// every node size is used on the way up and back down.
+static void make_wide_key(uint8_t *key, size_t i) {
+    memset(key, 'p', 20);
+    key[20] = (uint8_t)(i % 256);
+    key[21] = (uint8_t)(i / 256);
+}
+
+static void test_art_node_sizes(void) {
+    art_t *art = new_art(sizeof(uint64_t));
+
+    const size_t NUM_KEYS = 256 * 3;
+    uint8_t key[22];
+    uint64_t val;
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        make_wide_key(key, i);
+        val = i;
+        art_put(art, key, sizeof(key), &val);
+    }
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, art_num_keys(art));
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        make_wide_key(key, i);
+        TEST_ASSERT_TRUE(art_get_copy(art, key, sizeof(key), &val));
+        TEST_ASSERT_EQUAL_UINT64(i, val);
+    }
+
+    // Lookups which leave the long prefix part way through.
+    TEST_ASSERT_FALSE(art_contains(art, "ppppppppppppppq", 15));
+    TEST_ASSERT_FALSE(art_contains(art, "pppppppppppppppppppp", 20));
+
+    // Then a key which splits the long prefix.
+    memset(key, 'p', sizeof(key));
+    key[15] = 'q';
+    val = 1;
+    art_put(art, key, sizeof(key), &val);
+    TEST_ASSERT_TRUE(art_contains(art, key, sizeof(key)));
+
+    TEST_ASSERT_TRUE(art_remove(art, key, sizeof(key)));
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        make_wide_key(key, i);
+        if (i % 256 < 250) {
+            TEST_ASSERT_TRUE(art_remove(art, key, sizeof(key)));
+        }
+    }
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        make_wide_key(key, i);
+        TEST_ASSERT_EQUAL(i % 256 >= 250, art_contains(art, key, sizeof(key)));
+    }
+
+    delete_art(art);
+}
+
+typedef struct _test_art_collect_t {
+    char keys[64][16];
+    size_t count;
+    size_t limit;
+} test_art_collect_t;
+
+static bool test_art_collect_f(const void *key, size_t len, void *value, test_art_collect_t *c) {
+    (void)value;
+
+    memcpy(c->keys[c->count], key, len);
+    c->keys[c->count][len] = '\0';
+    c->count++;
+
+    return c->count < c->limit;
+}
+
+static void test_art_ordered(void) {
+    art_t *art = new_art(0);
+
+    const char *keys[] = {"team", "tea", "ten", "toast", "to", "t", "a", "zebra", "tear", "teams"};
+    const char *sorted[] = {"a", "t", "tea", "team", "teams", "tear", "ten", "to", "toast", "zebra"};
+
+    for (size_t i = 0; i < 10; i++) {
+        art_put(art, keys[i], strlen(keys[i]), NULL);
+    }
+
+    test_art_collect_t c = {.count = 0, .limit = 64};
+    art_for_each(art, (art_visit_ft)test_art_collect_f, &c);
+
+    TEST_ASSERT_EQUAL_size_t(10, c.count);
+    for (size_t i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_STRING(sorted[i], c.keys[i]);
+    }
+
+    // Prefix queries.
+    c.count = 0;
+    art_prefix_for_each(art, "te", 2, (art_visit_ft)test_art_collect_f, &c);
+    TEST_ASSERT_EQUAL_size_t(5, c.count);
+    TEST_ASSERT_EQUAL_STRING("tea", c.keys[0]);
+    TEST_ASSERT_EQUAL_STRING("ten", c.keys[4]);
+
+    c.count = 0;
+    art_prefix_for_each(art, "toa", 3, (art_visit_ft)test_art_collect_f, &c);
+    TEST_ASSERT_EQUAL_size_t(1, c.count);
+    TEST_ASSERT_EQUAL_STRING("toast", c.keys[0]);
+
+    c.count = 0;
+    art_prefix_for_each(art, "tx", 2, (art_visit_ft)test_art_collect_f, &c);
+    TEST_ASSERT_EQUAL_size_t(0, c.count);
+
+    c.count = 0;
+    art_prefix_for_each(art, "", 0, (art_visit_ft)test_art_collect_f, &c);
+    TEST_ASSERT_EQUAL_size_t(10, c.count);
+
+    // Stopping early.
+    c.count = 0;
+    c.limit = 3;
+    art_for_each(art, (art_visit_ft)test_art_collect_f, &c);
+    TEST_ASSERT_EQUAL_size_t(3, c.count);
+
+    delete_art(art);
+}
+
+static void test_art_strings(void) {
+    art_t *art = new_art(sizeof(size_t));
+
+    string_t *s = new_string();
+    char buf[32];
+
+    for (size_t i = 0; i < 500; i++) {
+        sprintf(buf, "user/%zu/name", i);
+
+        delete_string(s);
+        s = new_string_from_cstr(buf);
+        art_put_s(art, s, &i);
+    }
+
+    size_t val;
+    for (size_t i = 0; i < 500; i++) {
+        sprintf(buf, "user/%zu/name", i);
+
+        delete_string(s);
+        s = new_string_from_cstr(buf);
+
+        TEST_ASSERT_NOT_NULL(art_get_s(art, s));
+        val = *(size_t *)art_get_s(art, s);
+        TEST_ASSERT_EQUAL_size_t(i, val);
+
+        if (i % 2) {
+            TEST_ASSERT_TRUE(art_remove_s(art, s));
+        }
+    }
+
+    TEST_ASSERT_EQUAL_size_t(250, art_num_keys(art));
+
+    delete_string(s);
+    delete_art(art);
+}
+
+void art_tests(void) {
+    RUN_TEST(test_art_put_get_remove);
+    RUN_TEST(test_art_node_sizes);
+    RUN_TEST(test_art_ordered);
+    RUN_TEST(test_art_strings);
+}
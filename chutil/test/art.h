@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_ART_H
+#define TEST_CHUTIL_ART_H
+
+void art_tests(void);
+
+#endif
@@ -0,0 +1,169 @@
+
+#include "bitset.h"
+#include "chutil/bitset.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+
+static void test_bs_set_and_test(void) {
+    bitset_t *bs = new_bitset(10);
+
+    TEST_ASSERT_EQUAL_size_t(10, bs_len(bs));
+    TEST_ASSERT_FALSE(bs_test(bs, 3));
+
+    bs_set(bs, 3);
+    TEST_ASSERT_TRUE(bs_test(bs, 3));
+    TEST_ASSERT_FALSE(bs_test(bs, 4));
+
+    bs_clear(bs, 3);
+    TEST_ASSERT_FALSE(bs_test(bs, 3));
+
+    // Setting out of bounds grows the set.
+    bs_set(bs, 200);
+    TEST_ASSERT_EQUAL_size_t(201, bs_len(bs));
+    TEST_ASSERT_TRUE(bs_test(bs, 200));
+    TEST_ASSERT_FALSE(bs_test(bs, 199));
+    TEST_ASSERT_FALSE(bs_test(bs, 1000));
+
+    bs_assign(bs, 64, true);
+    TEST_ASSERT_TRUE(bs_test(bs, 64));
+    bs_assign(bs, 64, false);
+    TEST_ASSERT_FALSE(bs_test(bs, 64));
+
+    TEST_ASSERT_EQUAL_size_t(1, bs_popcount(bs));
+
+    bs_clear_all(bs);
+    TEST_ASSERT_EQUAL_size_t(0, bs_popcount(bs));
+    TEST_ASSERT_EQUAL_size_t(201, bs_len(bs));
+
+    delete_bitset(bs);
+}
+
+static void test_bs_resize(void) {
+    bitset_t *bs = new_bitset(0);
+
+    for (size_t i = 0; i < 300; i++) {
+        bs_set(bs, i);
+    }
+    TEST_ASSERT_EQUAL_size_t(300, bs_popcount(bs));
+
+    // Shrinking throws away bits...
+    bs_resize(bs, 70);
+    TEST_ASSERT_EQUAL_size_t(70, bs_popcount(bs));
+
+    // and they don't come back when growing again.
+    bs_resize(bs, 300);
+    TEST_ASSERT_EQUAL_size_t(70, bs_popcount(bs));
+    TEST_ASSERT_FALSE(bs_test(bs, 70));
+    TEST_ASSERT_TRUE(bs_test(bs, 69));
+
+    delete_bitset(bs);
+}
+
+static void test_bs_rank_and_select(void) {
+    bitset_t *bs = new_bitset(0);
+
+    // Every multiple of 3.
+    for (size_t i = 0; i < 500; i += 3) {
+        bs_set(bs, i);
+    }
+
+    for (size_t i = 0; i <= 500; i++) {
+        TEST_ASSERT_EQUAL_size_t((i + 2) / 3, bs_rank(bs, i));
+    }
+
+    size_t ind;
+    size_t pc = bs_popcount(bs);
+
+    for (size_t k = 0; k < pc; k++) {
+        TEST_ASSERT_TRUE(bs_select(bs, k, &ind));
+        TEST_ASSERT_EQUAL_size_t(k * 3, ind);
+        TEST_ASSERT_EQUAL_size_t(k, bs_rank(bs, ind));
+    }
+
+    TEST_ASSERT_FALSE(bs_select(bs, pc, &ind));
+
+    delete_bitset(bs);
+}
+
+static void test_bs_set_ops(void) {
+    bitset_t *evens = new_bitset(0);
+    bitset_t *threes = new_bitset(0);
+
+    for (size_t i = 0; i < 200; i += 2) {
+        bs_set(evens, i);
+    }
+
+    for (size_t i = 0; i < 300; i += 3) {
+        bs_set(threes, i);
+    }
+
+    bitset_t *bs = new_bitset(0);
+
+    bs_or(bs, evens);
+    TEST_ASSERT_TRUE(bs_equals(bs, evens));
+
+    bs_and(bs, threes);
+    for (size_t i = 0; i < bs_len(bs); i++) {
+        TEST_ASSERT_EQUAL(i % 6 == 0, bs_test(bs, i));
+    }
+
+    bs_or(bs, threes);
+    TEST_ASSERT_EQUAL_size_t(bs_len(threes), bs_len(bs));
+    TEST_ASSERT_TRUE(bs_equals(bs, threes));
+
+    bs_xor(bs, evens);
+    for (size_t i = 0; i < bs_len(bs); i++) {
+        bool expected = (i % 3 == 0) != (i < 200 && i % 2 == 0);
+        TEST_ASSERT_EQUAL(expected, bs_test(bs, i));
+    }
+
+    bs_clear_all(bs);
+    bs_or(bs, threes);
+    bs_andnot(bs, evens);
+    for (size_t i = 0; i < bs_len(bs); i++) {
+        bool expected = (i % 3 == 0) && !(i < 200 && i % 2 == 0);
+        TEST_ASSERT_EQUAL(expected, bs_test(bs, i));
+    }
+
+    // and with a shorter set clears the rest.
+    bs_and(bs, evens);
+    TEST_ASSERT_EQUAL_size_t(0, bs_popcount(bs));
+
+    delete_bitset(bs);
+    delete_bitset(threes);
+    delete_bitset(evens);
+}
+
+static void test_bs_iterator(void) {
+    bitset_t *bs = new_bitset(0);
+
+    bs_iter_t iter;
+    bs_iter_begin(bs, &iter);
+    TEST_ASSERT_EQUAL_size_t(BITSET_EXHAUSTED, bs_iter_next(&iter));
+
+    size_t expected[] = {0, 1, 63, 64, 130, 500};
+    size_t num = sizeof(expected) / sizeof(size_t);
+
+    for (size_t i = 0; i < num; i++) {
+        bs_set(bs, expected[i]);
+    }
+
+    bs_iter_begin(bs, &iter);
+    for (size_t i = 0; i < num; i++) {
+        TEST_ASSERT_EQUAL_size_t(expected[i], bs_iter_next(&iter));
+    }
+    TEST_ASSERT_EQUAL_size_t(BITSET_EXHAUSTED, bs_iter_next(&iter));
+
+    delete_bitset(bs);
+}
+
+void bitset_tests(void) {
+    RUN_TEST(test_bs_set_and_test);
+    RUN_TEST(test_bs_resize);
+    RUN_TEST(test_bs_rank_and_select);
+    RUN_TEST(test_bs_set_ops);
+    RUN_TEST(test_bs_iterator);
+}
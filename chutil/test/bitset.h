@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_BITSET_H
+#define TEST_CHUTIL_BITSET_H
+
+void bitset_tests(void);
+
+#endif
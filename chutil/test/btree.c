@@ -0,0 +1,285 @@
+
+#include "btree.h"
+#include "chutil/btree.h"
+#include "chsys/mem.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static int u64_cmp_f(const uint64_t *k1, const uint64_t *k2) {
+    return *k1 < *k2 ? -1 : (*k1 > *k2 ? 1 : 0);
+}
+
+static btree_t *new_u64_btree(void) {
+    return new_btree(sizeof(uint64_t), sizeof(uint64_t), (sort_cmp_ft)u64_cmp_f);
+}
+
+// Keys must come out strictly increasing, and there must be num_keys
+// of them.
+static void assert_bt_sorted(btree_t *bt) {
+    bt_iter_t iter;
+    const void *key;
+
+    size_t count = 0;
+    uint64_t prev = 0;
+
+    bt_iter_begin(bt, &iter);
+    while (bt_iter_next(&iter, &key, NULL)) {
+        uint64_t k = *(const uint64_t *)key;
+
+        if (count > 0) {
+            TEST_ASSERT_TRUE(prev < k);
+        }
+
+        prev = k;
+        count++;
+    }
+
+    TEST_ASSERT_EQUAL_size_t(bt_num_keys(bt), count);
+}
+
+static void test_bt_put_get_remove(void) {
+    btree_t *bt = new_u64_btree();
+    TEST_ASSERT_NOT_NULL(bt);
+
+    const uint64_t NUM_KEYS = 5000;
+    bool in[5000] = {false};
+    uint64_t key, val;
+
+    // 7919 is prime, so this visits every key in a scrambled order.
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        key = (i * 7919) % NUM_KEYS;
+        val = key * 2;
+        bt_put(bt, &key, &val);
+        in[key] = true;
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, bt_num_keys(bt));
+    TEST_ASSERT_TRUE(bt->height > 2);
+    assert_bt_sorted(bt);
+
+    // Updates.
+    for (key = 0; key < NUM_KEYS; key += 5) {
+        val = key * 3;
+        bt_put(bt, &key, &val);
+    }
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, bt_num_keys(bt));
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_TRUE(bt_get_copy(bt, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key % 5 == 0 ? key * 3 : key * 2, val);
+    }
+
+    // Remove most keys, in another scrambled order, checking everything
+    // along the way so every kind of rebalance gets hit.
+    size_t num_keys = NUM_KEYS;
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        key = (i * 104729) % NUM_KEYS;
+        if (key % 10 == 0) {
+            continue;
+        }
+
+        TEST_ASSERT_TRUE(bt_remove(bt, &key));
+        TEST_ASSERT_FALSE(bt_remove(bt, &key));
+        in[key] = false;
+        num_keys--;
+
+        if (i % 250 == 0) {
+            assert_bt_sorted(bt);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_size_t(num_keys, bt_num_keys(bt));
+    assert_bt_sorted(bt);
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_EQUAL(in[key], bt_contains(bt, &key));
+    }
+
+    // Then everything.
+    for (key = 0; key < NUM_KEYS; key += 10) {
+        TEST_ASSERT_TRUE(bt_remove(bt, &key));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(0, bt_num_keys(bt));
+    TEST_ASSERT_EQUAL_size_t(1, bt->height);
+
+    bt_iter_t iter;
+    bt_iter_begin(bt, &iter);
+    TEST_ASSERT_FALSE(bt_iter_next(&iter, NULL, NULL));
+
+    delete_btree(bt);
+}
+
+static void test_bt_bounds(void) {
+    btree_t *bt = new_u64_btree();
+
+    // Only multiples of 10.
+    uint64_t key, val;
+    for (key = 0; key < 10000; key += 10) {
+        val = key + 1;
+        bt_put(bt, &key, &val);
+    }
+
+    bt_iter_t iter;
+    const void *k;
+    void *v;
+
+    key = 55;
+    bt_lower_bound(bt, &key, &iter);
+    TEST_ASSERT_TRUE(bt_iter_next(&iter, &k, &v));
+    TEST_ASSERT_EQUAL_UINT64(60, *(const uint64_t *)k);
+    TEST_ASSERT_EQUAL_UINT64(61, *(uint64_t *)v);
+
+    key = 60;
+    bt_lower_bound(bt, &key, &iter);
+    TEST_ASSERT_TRUE(bt_iter_next(&iter, &k, NULL));
+    TEST_ASSERT_EQUAL_UINT64(60, *(const uint64_t *)k);
+
+    bt_upper_bound(bt, &key, &iter);
+    TEST_ASSERT_TRUE(bt_iter_next(&iter, &k, NULL));
+    TEST_ASSERT_EQUAL_UINT64(70, *(const uint64_t *)k);
+
+    // Past the end.
+    key = 9990;
+    bt_upper_bound(bt, &key, &iter);
+    TEST_ASSERT_FALSE(bt_iter_next(&iter, &k, NULL));
+
+    // [1000, 2000) should be exactly 100 keys.
+    uint64_t lo = 1000;
+    uint64_t hi = 2000;
+    size_t count = 0;
+
+    bt_range(bt, &lo, &hi, &iter);
+    while (bt_iter_next(&iter, &k, NULL)) {
+        TEST_ASSERT_EQUAL_UINT64(lo + (count * 10), *(const uint64_t *)k);
+        count++;
+    }
+    TEST_ASSERT_EQUAL_size_t(100, count);
+
+    // Open ended on either side.
+    count = 0;
+    bt_range(bt, NULL, &hi, &iter);
+    while (bt_iter_next(&iter, NULL, NULL)) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_size_t(200, count);
+
+    count = 0;
+    bt_range(bt, &hi, NULL, &iter);
+    while (bt_iter_next(&iter, NULL, NULL)) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_size_t(800, count);
+
+    delete_btree(bt);
+}
+
+static void test_bt_from_sorted(void) {
+    // Sizes around the leaf capacity, and much bigger.
+    const size_t sizes[] = {0, 1, 13, 14, 15, 29, 1000, 20001};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+
+        uint64_t *keys = safe_malloc(sizeof(uint64_t) * (n + 1));
+        uint64_t *vals = safe_malloc(sizeof(uint64_t) * (n + 1));
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = i * 2;
+            vals[i] = i;
+        }
+
+        btree_t *bt = new_btree_from_sorted(sizeof(uint64_t), sizeof(uint64_t),
+                (sort_cmp_ft)u64_cmp_f, keys, vals, n);
+
+        TEST_ASSERT_EQUAL_size_t(n, bt_num_keys(bt));
+        assert_bt_sorted(bt);
+
+        uint64_t key, val;
+        for (size_t i = 0; i < n; i++) {
+            TEST_ASSERT_TRUE(bt_get_copy(bt, &(keys[i]), &val));
+            TEST_ASSERT_EQUAL_UINT64(i, val);
+
+            key = keys[i] + 1;
+            TEST_ASSERT_FALSE(bt_contains(bt, &key));
+        }
+
+        // A bulk loaded tree is a normal tree.
+        for (key = 1; key < 2 * n; key += 4) {
+            bt_put(bt, &key, &key);
+        }
+        for (key = 0; key < 2 * n; key += 4) {
+            TEST_ASSERT_TRUE(bt_remove(bt, &key));
+        }
+        assert_bt_sorted(bt);
+
+        delete_btree(bt);
+        safe_free(vals);
+        safe_free(keys);
+    }
+}
+
+static void test_bt_from_sorted_dups(void) {
+    uint64_t keys[] = {1, 1, 2, 3, 3, 3, 4};
+    uint64_t vals[] = {0, 1, 2, 3, 4, 5, 6};
+
+    btree_t *bt = new_btree_from_sorted(sizeof(uint64_t), sizeof(uint64_t),
+            (sort_cmp_ft)u64_cmp_f, keys, vals, 7);
+
+    TEST_ASSERT_EQUAL_size_t(4, bt_num_keys(bt));
+
+    uint64_t key, val;
+
+    key = 1;
+    TEST_ASSERT_TRUE(bt_get_copy(bt, &key, &val));
+    TEST_ASSERT_EQUAL_UINT64(1, val);
+
+    key = 3;
+    TEST_ASSERT_TRUE(bt_get_copy(bt, &key, &val));
+    TEST_ASSERT_EQUAL_UINT64(5, val);
+
+    delete_btree(bt);
+}
+
+#define TEST_BT_NAME_LEN 12
+
+static int name_cmp_f(const char *n1, const char *n2) {
+    return strncmp(n1, n2, TEST_BT_NAME_LEN);
+}
+
+static void test_bt_string_keys(void) {
+    btree_t *bt = new_btree(TEST_BT_NAME_LEN, sizeof(uint32_t), (sort_cmp_ft)name_cmp_f);
+
+    const char *names[] = {"pear", "apple", "fig", "banana", "cherry", "date"};
+    const char *sorted[] = {"apple", "banana", "cherry", "date", "fig", "pear"};
+
+    char name[TEST_BT_NAME_LEN];
+    for (uint32_t i = 0; i < 6; i++) {
+        memset(name, 0, sizeof(name));
+        strcpy(name, names[i]);
+        bt_put(bt, name, &i);
+    }
+
+    bt_iter_t iter;
+    const void *k;
+    size_t i = 0;
+
+    bt_iter_begin(bt, &iter);
+    while (bt_iter_next(&iter, &k, NULL)) {
+        TEST_ASSERT_EQUAL_STRING(sorted[i++], (const char *)k);
+    }
+    TEST_ASSERT_EQUAL_size_t(6, i);
+
+    delete_btree(bt);
+}
+
+void btree_tests(void) {
+    RUN_TEST(test_bt_put_get_remove);
+    RUN_TEST(test_bt_bounds);
+    RUN_TEST(test_bt_from_sorted);
+    RUN_TEST(test_bt_from_sorted_dups);
+    RUN_TEST(test_bt_string_keys);
+}
@@ -0,0 +1,177 @@
+
+#include "cache.h"
+#include "chutil/cache.h"
+#include "chutil/hash.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+
+static bool u64_eq_f(const uint64_t *k1, const uint64_t *k2) {
+    return *k1 == *k2;
+}
+
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return hash_u64(*k);
+}
+
+static cache_t *new_u64_cache(cache_policy_t policy, size_t capacity) {
+    return new_cache(policy, capacity, sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+}
+
+static void cache_put_u64(cache_t *c, uint64_t key, uint64_t val) {
+    cache_put(c, &key, &val);
+}
+
+static bool cache_has_u64(cache_t *c, uint64_t key) {
+    return cache_get(c, &key) != NULL;
+}
+
+static void test_cache_lru(void) {
+    cache_t *c = new_u64_cache(CACHE_LRU, 3);
+    TEST_ASSERT_NOT_NULL(c);
+
+    cache_put_u64(c, 1, 10);
+    cache_put_u64(c, 2, 20);
+    cache_put_u64(c, 3, 30);
+
+    // 1 is now the most recently used, so 2 goes first.
+    TEST_ASSERT_TRUE(cache_has_u64(c, 1));
+    cache_put_u64(c, 4, 40);
+
+    TEST_ASSERT_EQUAL_size_t(3, cache_num_keys(c));
+    TEST_ASSERT_FALSE(cache_has_u64(c, 2));
+    TEST_ASSERT_TRUE(cache_has_u64(c, 3));
+
+    // Overwriting counts as a use too. (3 is used, then 1)
+    cache_put_u64(c, 1, 11);
+    cache_put_u64(c, 5, 50);
+    TEST_ASSERT_FALSE(cache_has_u64(c, 4));
+
+    uint64_t key = 1;
+    uint64_t *val = cache_get(c, &key);
+    TEST_ASSERT_NOT_NULL(val);
+    TEST_ASSERT_EQUAL_UINT64(11, *val);
+
+    TEST_ASSERT_TRUE(cache_remove(c, &key));
+    TEST_ASSERT_FALSE(cache_remove(c, &key));
+    TEST_ASSERT_EQUAL_size_t(2, cache_num_keys(c));
+
+    TEST_ASSERT_EQUAL_size_t(2, cache_evictions(c));
+
+    delete_cache(c);
+}
+
+typedef struct _evict_log_t {
+    size_t count;
+    uint64_t key_sum;
+    uint64_t val_sum;
+} evict_log_t;
+
+static void log_evict_f(const void *key, void *value, void *ctx) {
+    evict_log_t *log = ctx;
+
+    log->count++;
+    log->key_sum += *(const uint64_t *)key;
+    log->val_sum += *(uint64_t *)value;
+}
+
+static void test_cache_evict_func_and_stats(void) {
+    cache_policy_t policies[] = {CACHE_LRU, CACHE_S3FIFO};
+
+    for (size_t p = 0; p < 2; p++) {
+        cache_t *c = new_u64_cache(policies[p], 50);
+
+        evict_log_t log = {0, 0, 0};
+        cache_set_evict_func(c, log_evict_f, &log);
+
+        for (uint64_t key = 0; key < 200; key++) {
+            cache_put_u64(c, key, key * 2);
+        }
+
+        TEST_ASSERT_EQUAL_size_t(50, cache_num_keys(c));
+        TEST_ASSERT_EQUAL_size_t(150, cache_evictions(c));
+        TEST_ASSERT_EQUAL_size_t(150, log.count);
+
+        size_t hits = 0;
+        for (uint64_t key = 0; key < 200; key++) {
+            if (cache_has_u64(c, key)) {
+                hits++;
+            }
+        }
+
+        TEST_ASSERT_EQUAL_size_t(50, hits);
+        TEST_ASSERT_EQUAL_size_t(50, cache_hits(c));
+        TEST_ASSERT_EQUAL_size_t(150, cache_misses(c));
+
+        cache_reset_stats(c);
+        TEST_ASSERT_EQUAL_size_t(0, cache_hits(c));
+
+        // Everything put is let go of exactly once by the end.
+        delete_cache(c);
+
+        TEST_ASSERT_EQUAL_size_t(200, log.count);
+        TEST_ASSERT_EQUAL_UINT64(199 * 200 / 2, log.key_sum);
+        TEST_ASSERT_EQUAL_UINT64(199 * 200, log.val_sum);
+    }
+}
+
+// Keys [0, 80) are used a few times, then come a lot of keys used just
+// once. (A scan) LRU lets the scan flush the hot keys, S3-FIFO shouldn't.
+static size_t hot_keys_after_scan(cache_policy_t policy) {
+    cache_t *c = new_u64_cache(policy, 100);
+
+    for (size_t round = 0; round < 3; round++) {
+        for (uint64_t key = 0; key < 80; key++) {
+            if (!cache_has_u64(c, key)) {
+                cache_put_u64(c, key, key);
+            }
+        }
+    }
+
+    for (uint64_t key = 1000; key < 1500; key++) {
+        cache_put_u64(c, key, key);
+    }
+
+    size_t hot = 0;
+    for (uint64_t key = 0; key < 80; key++) {
+        if (cache_has_u64(c, key)) {
+            hot++;
+        }
+    }
+
+    delete_cache(c);
+    return hot;
+}
+
+static void test_cache_s3fifo_scan_resistance(void) {
+    TEST_ASSERT_EQUAL_size_t(0, hot_keys_after_scan(CACHE_LRU));
+    TEST_ASSERT_EQUAL_size_t(80, hot_keys_after_scan(CACHE_S3FIFO));
+}
+
+static void test_cache_capacity_one(void) {
+    cache_policy_t policies[] = {CACHE_LRU, CACHE_S3FIFO};
+
+    for (size_t p = 0; p < 2; p++) {
+        cache_t *c = new_u64_cache(policies[p], 1);
+
+        for (uint64_t key = 0; key < 10; key++) {
+            cache_put_u64(c, key, key);
+            TEST_ASSERT_TRUE(cache_has_u64(c, key));
+            TEST_ASSERT_EQUAL_size_t(1, cache_num_keys(c));
+        }
+
+        delete_cache(c);
+    }
+
+    TEST_ASSERT_NULL(new_u64_cache(CACHE_LRU, 0));
+}
+
+void cache_tests(void) {
+    RUN_TEST(test_cache_lru);
+    RUN_TEST(test_cache_evict_func_and_stats);
+    RUN_TEST(test_cache_s3fifo_scan_resistance);
+    RUN_TEST(test_cache_capacity_one);
+}
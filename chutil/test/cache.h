@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_CACHE_H
+#define TEST_CHUTIL_CACHE_H
+
+void cache_tests(void);
+
+#endif
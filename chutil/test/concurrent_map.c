@@ -0,0 +1,208 @@
+
+#include "concurrent_map.h"
+#include "chutil/concurrent_map.h"
+#include "chutil/hash.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+static bool u64_eq_f(const uint64_t *k1, const uint64_t *k2) {
+    return *k1 == *k2;
+}
+
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return hash_u64(*k);
+}
+
+static concurrent_map_t *new_u64_concurrent_map(void) {
+    return new_concurrent_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+}
+
+static void test_cm_single_thread(void) {
+    concurrent_map_t *cm = new_u64_concurrent_map();
+    TEST_ASSERT_NOT_NULL(cm);
+
+    const uint64_t NUM_KEYS = 1000;
+    uint64_t key, val;
+
+    // Enough keys for a few resizes and retire batches.
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key * 3;
+        cm_put(cm, &key, &val);
+    }
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, cm_num_keys(cm));
+
+    // With no readers around, old tables are freed as soon as they're
+    // replaced, even though the map only grew.
+    TEST_ASSERT_EQUAL_size_t(0, atomic_load(&(cm->num_retired_tables)));
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_TRUE(cm_get_copy(cm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key * 3, val);
+    }
+
+    // Updates don't change the key count.
+    for (key = 0; key < NUM_KEYS; key += 2) {
+        val = key + 1;
+        cm_put(cm, &key, &val);
+    }
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, cm_num_keys(cm));
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_TRUE(cm_get_copy(cm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key % 2 == 0 ? key + 1 : key * 3, val);
+    }
+
+    for (key = 0; key < NUM_KEYS; key += 3) {
+        TEST_ASSERT_TRUE(cm_remove(cm, &key));
+        TEST_ASSERT_FALSE(cm_remove(cm, &key));
+    }
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_EQUAL(key % 3 != 0, cm_contains(cm, &key));
+    }
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS - ((NUM_KEYS + 2) / 3), cm_num_keys(cm));
+
+    delete_concurrent_map(cm);
+}
+
+static void test_cm_sum_f(const uint64_t *key, const uint64_t *value, uint64_t *sum) {
+    TEST_ASSERT_EQUAL_UINT64(*key * 2, *value);
+    *sum += *key;
+}
+
+static void test_cm_for_each(void) {
+    concurrent_map_t *cm = new_u64_concurrent_map();
+
+    uint64_t key, val;
+    for (key = 1; key <= 100; key++) {
+        val = key * 2;
+        cm_put(cm, &key, &val);
+    }
+
+    uint64_t sum = 0;
+    cm_for_each(cm, (cm_for_each_ft)test_cm_sum_f, &sum);
+    TEST_ASSERT_EQUAL_UINT64(5050, sum);
+
+    delete_concurrent_map(cm);
+}
+
+#define TEST_CM_WRITERS 2
+#define TEST_CM_READERS 2
+#define TEST_CM_PER_WRITER 2000
+#define TEST_CM_ROUNDS 3
+
+typedef struct _test_cm_ctx_t {
+    concurrent_map_t *cm;
+    size_t id;
+
+    atomic_size_t *writers_done;
+    atomic_bool *bad_value;
+} test_cm_ctx_t;
+
+// Values are always key * round, so a reader can tell if it ever sees
+// a torn or freed value.
+static void *test_cm_writer(void *arg) {
+    test_cm_ctx_t *ctx = arg;
+    uint64_t start = ctx->id * TEST_CM_PER_WRITER;
+
+    for (uint64_t round = 1; round <= TEST_CM_ROUNDS; round++) {
+        for (uint64_t key = start; key < start + TEST_CM_PER_WRITER; key++) {
+            uint64_t val = key * round;
+            cm_put(ctx->cm, &key, &val);
+        }
+    }
+
+    // Take out every other key.
+    for (uint64_t key = start; key < start + TEST_CM_PER_WRITER; key += 2) {
+        cm_remove(ctx->cm, &key);
+    }
+
+    atomic_fetch_add(ctx->writers_done, 1);
+
+    return NULL;
+}
+
+static void *test_cm_reader(void *arg) {
+    test_cm_ctx_t *ctx = arg;
+    const uint64_t total = TEST_CM_WRITERS * TEST_CM_PER_WRITER;
+
+    while (atomic_load(ctx->writers_done) < TEST_CM_WRITERS) {
+        for (uint64_t key = 1; key < total; key += 7) {
+            uint64_t val;
+            if (!cm_get_copy(ctx->cm, &key, &val)) {
+                continue;
+            }
+
+            if (val % key != 0 || val / key < 1 || val / key > TEST_CM_ROUNDS) {
+                atomic_store(ctx->bad_value, true);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void test_cm_concurrent(void) {
+    const uint64_t total = TEST_CM_WRITERS * TEST_CM_PER_WRITER;
+
+    concurrent_map_t *cm = new_u64_concurrent_map();
+
+    atomic_size_t writers_done;
+    atomic_init(&writers_done, 0);
+    atomic_bool bad_value;
+    atomic_init(&bad_value, false);
+
+    pthread_t writers[TEST_CM_WRITERS];
+    pthread_t readers[TEST_CM_READERS];
+    test_cm_ctx_t ctxs[TEST_CM_WRITERS + TEST_CM_READERS];
+
+    for (size_t i = 0; i < TEST_CM_WRITERS + TEST_CM_READERS; i++) {
+        ctxs[i].cm = cm;
+        ctxs[i].id = i;
+        ctxs[i].writers_done = &writers_done;
+        ctxs[i].bad_value = &bad_value;
+    }
+
+    for (size_t i = 0; i < TEST_CM_READERS; i++) {
+        pthread_create(&(readers[i]), NULL, test_cm_reader,
+                &(ctxs[TEST_CM_WRITERS + i]));
+    }
+
+    for (size_t i = 0; i < TEST_CM_WRITERS; i++) {
+        pthread_create(&(writers[i]), NULL, test_cm_writer, &(ctxs[i]));
+    }
+
+    for (size_t i = 0; i < TEST_CM_WRITERS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+
+    for (size_t i = 0; i < TEST_CM_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    TEST_ASSERT_FALSE(atomic_load(&bad_value));
+    TEST_ASSERT_EQUAL_size_t(total / 2, cm_num_keys(cm));
+
+    for (uint64_t key = 0; key < total; key++) {
+        uint64_t val;
+        TEST_ASSERT_EQUAL(key % 2 == 1, cm_get_copy(cm, &key, &val));
+
+        if (key % 2 == 1) {
+            TEST_ASSERT_EQUAL_UINT64(key * TEST_CM_ROUNDS, val);
+        }
+    }
+
+    delete_concurrent_map(cm);
+}
+
+void concurrent_map_tests(void) {
+    RUN_TEST(test_cm_single_thread);
+    RUN_TEST(test_cm_for_each);
+    RUN_TEST(test_cm_concurrent);
+}
@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_CONCURRENT_MAP_H
+#define TEST_CHUTIL_CONCURRENT_MAP_H
+
+void concurrent_map_tests(void);
+
+#endif
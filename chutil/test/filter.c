@@ -0,0 +1,146 @@
+
+#include "filter.h"
+#include "chutil/filter.h"
+#include "chutil/hash.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return hash_u64(*k);
+}
+
+// Keys [num_keys, 2 * num_keys) are never added, returns how many of
+// them the filter thinks it has.
+static size_t count_false_positives(bool (*maybe_contains)(const void *, const void *),
+        const void *filter, uint64_t num_keys) {
+    size_t fps = 0;
+    for (uint64_t key = num_keys; key < 2 * num_keys; key++) {
+        if (maybe_contains(filter, &key)) {
+            fps++;
+        }
+    }
+
+    return fps;
+}
+
+static bool bf_maybe_contains_f(const void *bf, const void *key) {
+    return bf_maybe_contains(bf, key);
+}
+
+static bool cf_maybe_contains_f(const void *cf, const void *key) {
+    return cf_maybe_contains(cf, key);
+}
+
+static void test_bloom_filter(void) {
+    uint64_t n = 10000;
+    bloom_filter_t *bf = new_bloom_filter(n, 10, (hash_map_hash_ft)u64_hash_f);
+
+    for (uint64_t key = 0; key < n; key++) {
+        bf_add(bf, &key);
+    }
+
+    for (uint64_t key = 0; key < n; key++) {
+        TEST_ASSERT_TRUE(bf_maybe_contains(bf, &key));
+    }
+
+    // Should be around 1%.
+    TEST_ASSERT_TRUE(count_false_positives(bf_maybe_contains_f, bf, n) < n / 40);
+
+    bf_clear(bf);
+
+    uint64_t key = 5;
+    TEST_ASSERT_FALSE(bf_maybe_contains(bf, &key));
+
+    delete_bloom_filter(bf);
+}
+
+static void test_bloom_filter_tiny(void) {
+    bloom_filter_t *bf = new_bloom_filter(0, 10, (hash_map_hash_ft)u64_hash_f);
+    TEST_ASSERT_EQUAL_size_t(1, bf->num_blocks);
+    TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)bf->blocks % 64);
+
+    uint64_t key = 1;
+    TEST_ASSERT_FALSE(bf_maybe_contains(bf, &key));
+    bf_add(bf, &key);
+    TEST_ASSERT_TRUE(bf_maybe_contains(bf, &key));
+
+    delete_bloom_filter(bf);
+}
+
+static void test_cuckoo_filter(void) {
+    uint64_t n = 10000;
+    cuckoo_filter_t *cf = new_cuckoo_filter(n, (hash_map_hash_ft)u64_hash_f);
+
+    for (uint64_t key = 0; key < n; key++) {
+        TEST_ASSERT_TRUE(cf_add(cf, &key));
+    }
+    TEST_ASSERT_EQUAL_size_t(n, cf_num_keys(cf));
+
+    for (uint64_t key = 0; key < n; key++) {
+        TEST_ASSERT_TRUE(cf_maybe_contains(cf, &key));
+    }
+
+    // 8 fingerprints checked at 16 bits each, about 0.01%.
+    TEST_ASSERT_TRUE(count_false_positives(cf_maybe_contains_f, cf, n) < n / 1000);
+
+    // Remove the evens.
+    for (uint64_t key = 0; key < n; key += 2) {
+        TEST_ASSERT_TRUE(cf_remove(cf, &key));
+    }
+    TEST_ASSERT_EQUAL_size_t(n / 2, cf_num_keys(cf));
+
+    size_t still_there = 0;
+    for (uint64_t key = 0; key < n; key++) {
+        if (key % 2 == 1) {
+            TEST_ASSERT_TRUE(cf_maybe_contains(cf, &key));
+        } else if (cf_maybe_contains(cf, &key)) {
+            still_there++;
+        }
+    }
+    TEST_ASSERT_TRUE(still_there < n / 1000);
+
+    delete_cuckoo_filter(cf);
+}
+
+static void test_cuckoo_filter_full(void) {
+    cuckoo_filter_t *cf = new_cuckoo_filter(64, (hash_map_hash_ft)u64_hash_f);
+    size_t slots = cf->num_buckets * CF_BUCKET_SIZE;
+
+    uint64_t added = 0;
+    while (cf_add(cf, &added)) {
+        added++;
+        TEST_ASSERT_TRUE(added <= slots + 1);
+    }
+
+    // The add which filled the filter still counts, its fingerprint is
+    // the victim.
+    TEST_ASSERT_TRUE(cf->has_victim);
+    TEST_ASSERT_EQUAL_size_t(added, cf_num_keys(cf));
+
+    for (uint64_t key = 0; key < added; key++) {
+        TEST_ASSERT_TRUE(cf_maybe_contains(cf, &key));
+    }
+
+    // Freeing a slot lets the victim back in, and new keys can be added again.
+    uint64_t key = 0;
+    TEST_ASSERT_TRUE(cf_remove(cf, &key));
+    TEST_ASSERT_FALSE(cf->has_victim);
+
+    for (key = 1; key < added; key++) {
+        TEST_ASSERT_TRUE(cf_maybe_contains(cf, &key));
+    }
+
+    TEST_ASSERT_TRUE(cf_add(cf, &added));
+
+    delete_cuckoo_filter(cf);
+}
+
+void filter_tests(void) {
+    RUN_TEST(test_bloom_filter);
+    RUN_TEST(test_bloom_filter_tiny);
+    RUN_TEST(test_cuckoo_filter);
+    RUN_TEST(test_cuckoo_filter_full);
+}
@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_FILTER_H
+#define TEST_CHUTIL_FILTER_H
+
+void filter_tests(void);
+
+#endif
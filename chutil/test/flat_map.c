@@ -0,0 +1,134 @@
+
+#include "flat_map.h"
+#include "chutil/flat_map.h"
+#include "chutil/map.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static bool u64_eq_f(const uint64_t *k1, const uint64_t *k2) {
+    return *k1 == *k2;
+}
+
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return (((((*k) + 42934191239) * 3) + 12312388491) * 5);
+}
+
+static flat_map_t *new_u64_flat_map(void) {
+    return new_flat_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+}
+
+static void test_fm_insertion_order(void) {
+    flat_map_t *fm = new_u64_flat_map();
+
+    // Crosses the point where the index is built.
+    const uint64_t NUM_KEYS = 3 * FLAT_MAP_MAX_SCAN;
+    uint64_t key, val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = NUM_KEYS - key;
+        fm_put(fm, &key, &val);
+    }
+
+    TEST_ASSERT_NOT_NULL(fm->index);
+
+    // Updating a key doesn't move it.
+    key = 2;
+    val = 1000;
+    fm_put(fm, &key, &val);
+
+    key_val_pair_t kvp;
+    fm_iter_t iter;
+    uint64_t expected = 0;
+
+    fm_iter_begin(fm, &iter);
+    while ((kvp = fm_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        TEST_ASSERT_EQUAL_UINT64(expected, *(const uint64_t *)fm_kvp_key(fm, kvp));
+        expected++;
+    }
+
+    TEST_ASSERT_EQUAL_UINT64(NUM_KEYS, expected);
+    TEST_ASSERT_EQUAL_UINT64(1000, *(uint64_t *)fm_get(fm, &key));
+
+    // Removal moves the last pair into the gap.
+    key = 0;
+    TEST_ASSERT_TRUE(fm_remove(fm, &key));
+    TEST_ASSERT_EQUAL_UINT64(NUM_KEYS - 1, *(const uint64_t *)fm_kvp_key(fm, fm_get_kvp(fm, 0)));
+
+    delete_flat_map(fm);
+}
+
+static void test_fm_small(void) {
+    flat_map_t *fm = new_u64_flat_map();
+
+    uint64_t key, val;
+    for (key = 0; key < FLAT_MAP_MAX_SCAN; key++) {
+        val = key + 1;
+        fm_put(fm, &key, &val);
+    }
+
+    // Small maps never build an index.
+    TEST_ASSERT_NULL(fm->index);
+
+    for (key = 0; key < FLAT_MAP_MAX_SCAN; key++) {
+        TEST_ASSERT_TRUE(fm_get_copy(fm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key + 1, val);
+    }
+
+    key = FLAT_MAP_MAX_SCAN;
+    TEST_ASSERT_FALSE(fm_contains(fm, &key));
+
+    for (key = 0; key < FLAT_MAP_MAX_SCAN; key++) {
+        TEST_ASSERT_TRUE(fm_remove(fm, &key));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(0, fm_num_keys(fm));
+
+    delete_flat_map(fm);
+}
+
+// Lots of churn on an indexed map, checked against the chained map.
+static void test_fm_against_hash_map(void) {
+    flat_map_t *fm = new_u64_flat_map();
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    srand(36);
+
+    for (size_t i = 0; i < 20000; i++) {
+        uint64_t key = rand() % 500;
+        uint64_t val = rand();
+
+        if (rand() % 3 == 0) {
+            TEST_ASSERT_EQUAL(hm_remove(hm, &key), fm_remove(fm, &key));
+        } else {
+            hm_put(hm, &key, &val);
+            fm_put(fm, &key, &val);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_size_t(hm_num_keys(hm), fm_num_keys(fm));
+
+    key_val_pair_t kvp;
+    hm_iter_t iter;
+
+    hm_iter_begin(hm, &iter);
+    while ((kvp = hm_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        uint64_t *v = fm_get(fm, kvp_key(hm, kvp));
+        TEST_ASSERT_NOT_NULL(v);
+        TEST_ASSERT_EQUAL_UINT64(*(uint64_t *)kvp_val(hm, kvp), *v);
+    }
+
+    delete_hash_map(hm);
+    delete_flat_map(fm);
+}
+
+void flat_map_tests(void) {
+    RUN_TEST(test_fm_insertion_order);
+    RUN_TEST(test_fm_small);
+    RUN_TEST(test_fm_against_hash_map);
+}
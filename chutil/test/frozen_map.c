@@ -0,0 +1,237 @@
+
+#include "frozen_map.h"
+#include "chutil/frozen_map.h"
+#include "chutil/hash.h"
+#include "chsys/sys.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool u64_eq_f(const uint64_t *k1, const uint64_t *k2) {
+    return *k1 == *k2;
+}
+
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return hash_u64(*k);
+}
+
+static uint64_t u64_bad_hash_f(const uint64_t *k) {
+    return *k % 3;
+}
+
+// Keys are 0, 7, 14, ... so there are plenty of missing keys in between.
+static hash_map_t *new_u64_hash_map(uint64_t num_keys) {
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    for (uint64_t i = 0; i < num_keys; i++) {
+        uint64_t key = i * 7;
+        uint64_t val = i + 1;
+        hm_put(hm, &key, &val);
+    }
+
+    return hm;
+}
+
+static void assert_frozen_u64(frozen_map_t *frm, uint64_t num_keys) {
+    TEST_ASSERT_EQUAL_size_t(num_keys, frm_num_keys(frm));
+
+    for (uint64_t key = 0; key < num_keys * 7; key++) {
+        const uint64_t *val = frm_get(frm, &key);
+
+        if (key % 7 == 0) {
+            TEST_ASSERT_NOT_NULL(val);
+            TEST_ASSERT_EQUAL_UINT64((key / 7) + 1, *val);
+        } else {
+            TEST_ASSERT_NULL(val);
+        }
+    }
+}
+
+static void test_hm_freeze(void) {
+    uint64_t sizes[] = {0, 1, 2, 3, 5, 17, 100, 1000, 50000};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        hash_map_t *hm = new_u64_hash_map(sizes[i]);
+        frozen_map_t *frm = hm_freeze(hm);
+        delete_hash_map(hm);
+
+        TEST_ASSERT_NOT_NULL(frm);
+        assert_frozen_u64(frm, sizes[i]);
+
+        uint64_t missing = 3;
+        TEST_ASSERT_FALSE(frm_contains(frm, &missing));
+
+        delete_frozen_map(frm);
+    }
+}
+
+static void frm_sum_f(const void *key, const void *value, void *ctx) {
+    uint64_t *sums = ctx;
+    sums[0] += *(const uint64_t *)key;
+    sums[1] += *(const uint64_t *)value;
+}
+
+static void test_frm_for_each(void) {
+    uint64_t n = 300;
+
+    hash_map_t *hm = new_u64_hash_map(n);
+    frozen_map_t *frm = hm_freeze(hm);
+    delete_hash_map(hm);
+
+    uint64_t sums[2] = {0, 0};
+    frm_for_each(frm, frm_sum_f, sums);
+
+    TEST_ASSERT_EQUAL_UINT64(7 * (n * (n - 1) / 2), sums[0]);
+    TEST_ASSERT_EQUAL_UINT64(n * (n + 1) / 2, sums[1]);
+
+    delete_frozen_map(frm);
+}
+
+static void test_hm_freeze_bad_hash(void) {
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_bad_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    // 3 distinct hashes is fine.
+    for (uint64_t key = 0; key < 3; key++) {
+        hm_put(hm, &key, &key);
+    }
+
+    frozen_map_t *frm = hm_freeze(hm);
+    TEST_ASSERT_NOT_NULL(frm);
+    for (uint64_t key = 0; key < 3; key++) {
+        uint64_t val;
+        TEST_ASSERT_TRUE(frm_get_copy(frm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key, val);
+    }
+    delete_frozen_map(frm);
+
+    // A 4th key must share a hash.
+    uint64_t key = 3;
+    hm_put(hm, &key, &key);
+    TEST_ASSERT_NULL(hm_freeze(hm));
+
+    delete_hash_map(hm);
+}
+
+static void test_frm_write_read(void) {
+    uint64_t n = 2000;
+
+    hash_map_t *hm = new_u64_hash_map(n);
+    frozen_map_t *frm = hm_freeze(hm);
+    delete_hash_map(hm);
+
+    FILE *fp = tmpfile();
+    TEST_ASSERT_NOT_NULL(fp);
+
+    TEST_ASSERT_TRUE(frm_write(frm, fp));
+    delete_frozen_map(frm);
+
+    rewind(fp);
+    frm = frm_read(fp, (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+    TEST_ASSERT_NOT_NULL(frm);
+    assert_frozen_u64(frm, n);
+    delete_frozen_map(frm);
+
+    // Not a frozen map.
+    rewind(fp);
+    uint64_t junk[8] = {0};
+    TEST_ASSERT_EQUAL_size_t(8, fwrite(junk, sizeof(uint64_t), 8, fp));
+    rewind(fp);
+    TEST_ASSERT_NULL(frm_read(fp, (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f));
+
+    fclose(fp);
+}
+
+static void test_frm_read_truncated(void) {
+    hash_map_t *hm = new_u64_hash_map(100);
+    frozen_map_t *frm = hm_freeze(hm);
+    delete_hash_map(hm);
+
+    FILE *fp = tmpfile();
+    TEST_ASSERT_NOT_NULL(fp);
+
+    // Just the header and a few displacements.
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(&(frm->header), sizeof(frozen_map_header_t) + 16, 1, fp));
+    delete_frozen_map(frm);
+
+    rewind(fp);
+    TEST_ASSERT_NULL(frm_read(fp, (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f));
+
+    fclose(fp);
+}
+
+static void test_frm_read_bad_header(void) {
+    frozen_map_header_t header = {
+        .magic = FROZEN_MAP_MAGIC,
+        .key_size = sizeof(uint64_t),
+        .value_size = sizeof(uint64_t),
+        .entry_size = 16,
+        .num_keys = 100,
+        .num_buckets = 25,
+        .seed = 0,
+    };
+
+    frozen_map_header_t bad_headers[4];
+    for (size_t i = 0; i < 4; i++) {
+        bad_headers[i] = header;
+    }
+
+    // A huge map, which the file is nowhere near big enough for.
+    bad_headers[0].num_keys = UINT32_MAX - 1;
+    bad_headers[0].num_buckets = (bad_headers[0].num_keys + FROZEN_MAP_BUCKET_SIZE - 1) /
+        FROZEN_MAP_BUCKET_SIZE;
+
+    bad_headers[1].num_buckets = 1;
+    bad_headers[2].entry_size = 24;
+    bad_headers[3].value_size = (uint64_t)1 << 40;
+
+    // Plenty of bytes for every header but the first.
+    uint8_t body[4096];
+    memset(body, 0, sizeof(body));
+
+    for (size_t i = 0; i < 4; i++) {
+        FILE *fp = tmpfile();
+        TEST_ASSERT_NOT_NULL(fp);
+
+        TEST_ASSERT_EQUAL_size_t(1, fwrite(&(bad_headers[i]), sizeof(frozen_map_header_t), 1, fp));
+        TEST_ASSERT_EQUAL_size_t(1, fwrite(body, sizeof(body), 1, fp));
+        rewind(fp);
+
+        // Nothing should even be allocated.
+        size_t mallocs = sys_get_malloc_count();
+        TEST_ASSERT_NULL(frm_read(fp, (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f));
+        TEST_ASSERT_EQUAL_size_t(mallocs, sys_get_malloc_count());
+
+        fclose(fp);
+    }
+
+    // The good header reads fine. (All zero displacements just make for
+    // a map with nothing findable in it)
+    FILE *fp = tmpfile();
+    TEST_ASSERT_NOT_NULL(fp);
+
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(&header, sizeof(frozen_map_header_t), 1, fp));
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(body, sizeof(body), 1, fp));
+    rewind(fp);
+
+    frozen_map_t *frm = frm_read(fp, (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+    TEST_ASSERT_NOT_NULL(frm);
+    TEST_ASSERT_EQUAL_size_t(100, frm_num_keys(frm));
+    delete_frozen_map(frm);
+
+    fclose(fp);
+}
+
+void frozen_map_tests(void) {
+    RUN_TEST(test_hm_freeze);
+    RUN_TEST(test_frm_for_each);
+    RUN_TEST(test_hm_freeze_bad_hash);
+    RUN_TEST(test_frm_write_read);
+    RUN_TEST(test_frm_read_truncated);
+    RUN_TEST(test_frm_read_bad_header);
+}
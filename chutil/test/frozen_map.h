@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_FROZEN_MAP_H
+#define TEST_CHUTIL_FROZEN_MAP_H
+
+void frozen_map_tests(void);
+
+#endif
@@ -0,0 +1,224 @@
+
+#include "hamt.h"
+#include "chutil/hamt.h"
+#include "chutil/hash.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+static bool u64_eq_f(const uint64_t *k1, const uint64_t *k2) {
+    return *k1 == *k2;
+}
+
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return hash_u64(*k);
+}
+
+// Every key has the same hash, so everything ends up in one collision list.
+static uint64_t u64_bad_hash_f(const uint64_t *k) {
+    (void)k;
+    return 12345;
+}
+
+static hamt_t *new_u64_hamt(hash_map_hash_ft hf) {
+    return new_hamt(sizeof(uint64_t), sizeof(uint64_t), hf, (hash_map_key_eq_ft)u64_eq_f);
+}
+
+// Replaces *h with a new version holding key -> val.
+static void hamt_put_u64(hamt_t **h, uint64_t key, uint64_t val) {
+    hamt_t *next = hamt_put(*h, &key, &val);
+    delete_hamt(*h);
+    *h = next;
+}
+
+static void hamt_remove_u64(hamt_t **h, uint64_t key) {
+    hamt_t *next = hamt_remove(*h, &key);
+    delete_hamt(*h);
+    *h = next;
+}
+
+static void test_hamt_put_get_remove_with(hash_map_hash_ft hf, uint64_t num_keys) {
+    hamt_t *h = new_u64_hamt(hf);
+    TEST_ASSERT_NOT_NULL(h);
+
+    for (uint64_t key = 0; key < num_keys; key++) {
+        hamt_put_u64(&h, key, key * 2);
+    }
+    TEST_ASSERT_EQUAL_size_t(num_keys, hamt_num_keys(h));
+
+    for (uint64_t key = 0; key < num_keys; key++) {
+        const uint64_t *val = hamt_get(h, &key);
+        TEST_ASSERT_NOT_NULL(val);
+        TEST_ASSERT_EQUAL_UINT64(key * 2, *val);
+    }
+
+    // Updates.
+    for (uint64_t key = 0; key < num_keys; key += 3) {
+        hamt_put_u64(&h, key, key + 1);
+    }
+    TEST_ASSERT_EQUAL_size_t(num_keys, hamt_num_keys(h));
+
+    for (uint64_t key = 0; key < num_keys; key += 2) {
+        hamt_remove_u64(&h, key);
+    }
+
+    // Removing a missing key changes nothing.
+    uint64_t missing = num_keys + 1;
+    hamt_remove_u64(&h, missing);
+
+    TEST_ASSERT_EQUAL_size_t(num_keys / 2, hamt_num_keys(h));
+
+    for (uint64_t key = 0; key < num_keys; key++) {
+        const uint64_t *val = hamt_get(h, &key);
+
+        if (key % 2 == 0) {
+            TEST_ASSERT_NULL(val);
+        } else {
+            TEST_ASSERT_NOT_NULL(val);
+            TEST_ASSERT_EQUAL_UINT64(key % 3 == 0 ? key + 1 : key * 2, *val);
+        }
+    }
+
+    for (uint64_t key = 1; key < num_keys; key += 2) {
+        hamt_remove_u64(&h, key);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(0, hamt_num_keys(h));
+    TEST_ASSERT_NULL(h->root);
+
+    delete_hamt(h);
+}
+
+static void test_hamt_put_get_remove(void) {
+    test_hamt_put_get_remove_with((hash_map_hash_ft)u64_hash_f, 5000);
+}
+
+static void test_hamt_collisions(void) {
+    test_hamt_put_get_remove_with((hash_map_hash_ft)u64_bad_hash_f, 50);
+}
+
+static void test_hamt_persistence(void) {
+    const uint64_t NUM_VERSIONS = 200;
+    hamt_t *versions[200];
+
+    // Version i holds keys [0, i), key k maps to k * i.
+    versions[0] = new_u64_hamt((hash_map_hash_ft)u64_hash_f);
+
+    for (uint64_t i = 1; i < NUM_VERSIONS; i++) {
+        hamt_t *v = hamt_copy(versions[i - 1]);
+
+        for (uint64_t key = 0; key < i; key++) {
+            hamt_put_u64(&v, key, key * i);
+        }
+
+        versions[i] = v;
+    }
+
+    // Every old version is untouched.
+    for (uint64_t i = 0; i < NUM_VERSIONS; i++) {
+        TEST_ASSERT_EQUAL_size_t(i, hamt_num_keys(versions[i]));
+
+        for (uint64_t key = 0; key < NUM_VERSIONS; key++) {
+            const uint64_t *val = hamt_get(versions[i], &key);
+
+            if (key < i) {
+                TEST_ASSERT_NOT_NULL(val);
+                TEST_ASSERT_EQUAL_UINT64(key * i, *val);
+            } else {
+                TEST_ASSERT_NULL(val);
+            }
+        }
+    }
+
+    // Versions can be let go of in any order.
+    for (uint64_t i = 0; i < NUM_VERSIONS; i += 2) {
+        delete_hamt(versions[i]);
+    }
+
+    hamt_t *v = hamt_copy(versions[NUM_VERSIONS - 1]);
+    hamt_remove_u64(&v, 7);
+    TEST_ASSERT_FALSE(hamt_contains(v, &(uint64_t){7}));
+    TEST_ASSERT_TRUE(hamt_contains(versions[NUM_VERSIONS - 1], &(uint64_t){7}));
+    delete_hamt(v);
+
+    for (uint64_t i = 1; i < NUM_VERSIONS; i += 2) {
+        delete_hamt(versions[i]);
+    }
+}
+
+static void test_hamt_sum_f(const uint64_t *key, const uint64_t *value, uint64_t *sum) {
+    TEST_ASSERT_EQUAL_UINT64(*key * 3, *value);
+    *sum += *key;
+}
+
+static void test_hamt_for_each(void) {
+    hamt_t *h = new_u64_hamt((hash_map_hash_ft)u64_hash_f);
+
+    for (uint64_t key = 1; key <= 1000; key++) {
+        hamt_put_u64(&h, key, key * 3);
+    }
+
+    uint64_t sum = 0;
+    hamt_for_each(h, (hamt_for_each_ft)test_hamt_sum_f, &sum);
+    TEST_ASSERT_EQUAL_UINT64(500500, sum);
+
+    delete_hamt(h);
+}
+
+#define TEST_HAMT_KEYS 500
+
+// Each snapshot maps every key to the same value, a reader checks that
+// it never sees a mix of two versions.
+static void *test_hamt_reader(void *arg) {
+    hamt_t *snapshot = arg;
+
+    uint64_t key = 0;
+    const uint64_t *first = hamt_get(snapshot, &key);
+    bool consistent = first != NULL;
+
+    for (key = 1; consistent && key < TEST_HAMT_KEYS; key++) {
+        const uint64_t *val = hamt_get(snapshot, &key);
+        consistent = val && *val == *first;
+    }
+
+    delete_hamt(snapshot);
+
+    return consistent ? arg : NULL;
+}
+
+static void test_hamt_snapshots(void) {
+    hamt_t *h = new_u64_hamt((hash_map_hash_ft)u64_hash_f);
+    for (uint64_t key = 0; key < TEST_HAMT_KEYS; key++) {
+        hamt_put_u64(&h, key, 0);
+    }
+
+    pthread_t readers[4];
+
+    for (uint64_t round = 0; round < 4; round++) {
+        pthread_create(&(readers[round]), NULL, test_hamt_reader, hamt_copy(h));
+
+        // Meanwhile, keep making new versions.
+        for (uint64_t key = 0; key < TEST_HAMT_KEYS; key++) {
+            hamt_put_u64(&h, key, round + 1);
+        }
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        void *ret;
+        pthread_join(readers[i], &ret);
+        TEST_ASSERT_NOT_NULL(ret);
+    }
+
+    delete_hamt(h);
+}
+
+void hamt_tests(void) {
+    RUN_TEST(test_hamt_put_get_remove);
+    RUN_TEST(test_hamt_collisions);
+    RUN_TEST(test_hamt_persistence);
+    RUN_TEST(test_hamt_for_each);
+    RUN_TEST(test_hamt_snapshots);
+}
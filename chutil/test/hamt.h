@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_HAMT_H
+#define TEST_CHUTIL_HAMT_H
+
+void hamt_tests(void);
+
+#endif
@@ -0,0 +1,95 @@
+
+#include "hash.h"
+#include "chutil/hash.h"
+#include "chutil/string.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define HASH_TEST_MAX_LEN 128
+
+static void test_hash_bytes_lengths(void) {
+    uint8_t buf[HASH_TEST_MAX_LEN];
+    for (size_t i = 0; i < HASH_TEST_MAX_LEN; i++) {
+        buf[i] = (uint8_t)(i * 7);
+    }
+
+    // Every prefix length goes down a slightly different path,
+    // none of them should collide.
+    uint64_t hashes[HASH_TEST_MAX_LEN + 1];
+    for (size_t len = 0; len <= HASH_TEST_MAX_LEN; len++) {
+        hashes[len] = hash_bytes(buf, len);
+        TEST_ASSERT_EQUAL_UINT64(hashes[len], hash_bytes(buf, len));
+
+        for (size_t j = 0; j < len; j++) {
+            TEST_ASSERT_TRUE(hashes[j] != hashes[len]);
+        }
+    }
+}
+
+static void test_hash_bytes_flips(void) {
+    uint8_t buf[HASH_TEST_MAX_LEN] = {0};
+
+    for (size_t len = 1; len <= HASH_TEST_MAX_LEN; len += 13) {
+        uint64_t base = hash_bytes(buf, len);
+
+        // Flipping any single bit should change about half of the
+        // output bits, be generous here.
+        for (size_t i = 0; i < len; i++) {
+            buf[i] ^= 1;
+            uint64_t flipped = hash_bytes(buf, len);
+            buf[i] ^= 1;
+
+            int changed = __builtin_popcountll(base ^ flipped);
+            TEST_ASSERT_TRUE(changed >= 12 && changed <= 52);
+        }
+    }
+}
+
+static void test_hash_bytes_unaligned(void) {
+    uint8_t buf[HASH_TEST_MAX_LEN + 1];
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)(i * 13 + 1);
+    }
+
+    uint8_t copy[HASH_TEST_MAX_LEN];
+    memcpy(copy, buf + 1, HASH_TEST_MAX_LEN);
+
+    TEST_ASSERT_EQUAL_UINT64(hash_bytes(copy, HASH_TEST_MAX_LEN),
+            hash_bytes(buf + 1, HASH_TEST_MAX_LEN));
+}
+
+static void test_hash_seed_and_u64(void) {
+    const char *msg = "hello world";
+
+    TEST_ASSERT_TRUE(hash_bytes_seeded(msg, strlen(msg), 1) !=
+            hash_bytes_seeded(msg, strlen(msg), 2));
+
+    TEST_ASSERT_TRUE(hash_u64(0) != hash_u64(1));
+    TEST_ASSERT_EQUAL_UINT64(hash_u64(12345), hash_u64(12345));
+}
+
+static void test_s_hash(void) {
+    string_t *s1 = new_string_from_literal("some key");
+    string_t *s2 = new_string_from_cstr("some key");
+    string_t *s3 = new_string_from_cstr("some kez");
+
+    // Literal or not, same contents means same hash.
+    TEST_ASSERT_EQUAL_UINT64(s_hash(s1), s_hash(s2));
+    TEST_ASSERT_TRUE(s_hash(s1) != s_hash(s3));
+
+    delete_string(s1);
+    delete_string(s2);
+    delete_string(s3);
+}
+
+void hash_tests(void) {
+    RUN_TEST(test_hash_bytes_lengths);
+    RUN_TEST(test_hash_bytes_flips);
+    RUN_TEST(test_hash_bytes_unaligned);
+    RUN_TEST(test_hash_seed_and_u64);
+    RUN_TEST(test_s_hash);
+}
@@ -162,11 +162,43 @@ static void test_hp_str(void) {
     delete_heap(hp);
 }
 
+static void test_hp_iter(void) {
+    heap_t *hp = new_heap(sizeof(uint32_t), (heap_priority_ft)u32_pf);
+
+    const uint32_t NUM_VALS = 30;
+    for (uint32_t i = 0; i < NUM_VALS; i++) {
+        hp_push(hp, &i);
+    }
+
+    // Both iterators should see every value exactly once.
+    hp_iter_t iter1, iter2;
+    uint32_t *val1, *val2;
+    uint32_t sum1 = 0, sum2 = 0;
+
+    hp_iter_begin(hp, &iter1);
+    hp_iter_begin(hp, &iter2);
+    while ((val1 = hp_iter_next(&iter1))) {
+        val2 = hp_iter_next(&iter2);
+        TEST_ASSERT_NOT_NULL(val2);
+        TEST_ASSERT_EQUAL_UINT32(*val1, *val2);
+
+        sum1 += *val1;
+        sum2 += *val2;
+    }
+
+    TEST_ASSERT_NULL(hp_iter_next(&iter2));
+    TEST_ASSERT_EQUAL_UINT32((NUM_VALS * (NUM_VALS - 1)) / 2, sum1);
+    TEST_ASSERT_EQUAL_UINT32(sum1, sum2);
+
+    delete_heap(hp);
+}
+
 void heap_tests(void) {
     RUN_TEST(test_hp_simple1); 
     RUN_TEST(test_hp_simple2);
     RUN_TEST(test_hp_big);
     RUN_TEST(test_hp_re_heap);
     RUN_TEST(test_hp_str);
+    RUN_TEST(test_hp_iter);
 }
 
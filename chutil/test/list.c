@@ -1,5 +1,6 @@
 
 #include "chutil/list.h"
+#include "chutil/queue.h"
 #include "list.h"
 #include "chsys/mem.h"
 
@@ -180,6 +181,38 @@ static void test_l_iterator(const list_impl_t *impl) {
     delete_list(l);
 }
 
+static void test_l_external_iterator(const list_impl_t *impl) {
+    list_t *l = new_list(impl, sizeof(size_t));
+
+    const size_t NUM_VALS = 20;
+    for (size_t i = 0; i < NUM_VALS; i++) {
+        l_push(l, &i);
+    }
+
+    // Two iterators over the same list at once.
+    list_iter_t outer, inner;
+    size_t *outer_ptr, *inner_ptr;
+    size_t pairs = 0;
+
+    size_t expected_outer = 0;
+    l_iter_begin(l, &outer);
+    while ((outer_ptr = l_iter_next(&outer))) {
+        TEST_ASSERT_EQUAL_size_t(expected_outer++, *outer_ptr);
+
+        size_t expected_inner = 0;
+        l_iter_begin(l, &inner);
+        while ((inner_ptr = l_iter_next(&inner))) {
+            TEST_ASSERT_EQUAL_size_t(expected_inner++, *inner_ptr);
+            pairs++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_VALS, expected_outer);
+    TEST_ASSERT_EQUAL_size_t(NUM_VALS * NUM_VALS, pairs);
+
+    delete_list(l);
+}
+
 static void test_l(const list_impl_t *impl) {
     test_l_cell_size(impl);
     test_l_push(impl);
@@ -188,6 +221,7 @@ static void test_l(const list_impl_t *impl) {
     test_l_poll(impl);
     test_l_poll_pop(impl);
     test_l_iterator(impl);
+    test_l_external_iterator(impl);
 }
 
 static void array_list_tests(void) {
@@ -198,7 +232,123 @@ static void linked_list_tests(void) {
     test_l(LINKED_LIST_IMPL);
 }
 
+static void seg_list_tests(void) {
+    test_l(SEG_LIST_IMPL);
+}
+
+static void test_sgl_stable_pointers(void) {
+    seg_list_t *sgl = new_seg_list(sizeof(uint64_t));
+
+    uint64_t val = 0;
+    sgl_push(sgl, &val);
+
+    uint64_t *first = sgl_get(sgl, 0);
+    const uint64_t NUM_VALS = 10000;
+
+    for (val = 1; val < NUM_VALS; val++) {
+        sgl_push(sgl, &val);
+    }
+
+    // Growth never moves a cell.
+    TEST_ASSERT_TRUE(first == sgl_get(sgl, 0));
+    TEST_ASSERT_EQUAL_UINT64(0, *first);
+    TEST_ASSERT_EQUAL_size_t(NUM_VALS, sgl_len(sgl));
+    TEST_ASSERT_TRUE(sgl_cap(sgl) >= NUM_VALS);
+
+    sgl_iter_t iter;
+    uint64_t *val_ptr;
+    uint64_t expected = 0;
+
+    sgl_iter_begin(sgl, &iter);
+    while ((val_ptr = sgl_iter_next(&iter))) {
+        TEST_ASSERT_EQUAL_UINT64(expected, *val_ptr);
+        TEST_ASSERT_TRUE(val_ptr == sgl_get(sgl, expected));
+        expected++;
+    }
+    TEST_ASSERT_EQUAL_UINT64(NUM_VALS, expected);
+
+    // Polling across many segment boundaries.
+    uint64_t out;
+    for (uint64_t i = 0; i < 100; i++) {
+        sgl_poll(sgl, &out);
+        TEST_ASSERT_EQUAL_UINT64(i, out);
+    }
+
+    for (uint64_t i = 0; i < sgl_len(sgl); i++) {
+        TEST_ASSERT_EQUAL_UINT64(i + 100, *(uint64_t *)sgl_get(sgl, i));
+    }
+
+    delete_seg_list(sgl);
+}
+
+static void small_list_tests(void) {
+    test_l(SMALL_LIST_IMPL);
+}
+
+static void test_sml_spill(void) {
+    small_list_t *sml = new_small_list(sizeof(uint32_t));
+
+    uint32_t val;
+    for (val = 0; val < SMALL_LIST_INLINE_CELLS; val++) {
+        sml_push(sml, &val);
+    }
+
+    // Still inline when exactly full.
+    TEST_ASSERT_TRUE(sml_is_inline(sml));
+
+    sml_push(sml, &val);
+    TEST_ASSERT_FALSE(sml_is_inline(sml));
+
+    for (uint32_t i = 0; i <= SMALL_LIST_INLINE_CELLS; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, *(uint32_t *)sml_get(sml, i));
+    }
+
+    delete_small_list(sml);
+}
+
+static void mpmc_queue_tests(void) {
+    test_l(MPMC_QUEUE_IMPL);
+}
+
+static void concrete_iterator_tests(void) {
+    array_list_t *al = new_array_list(sizeof(uint32_t));
+    linked_list_t *ll = new_linked_list(sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < 10; i++) {
+        al_push(al, &i);
+        ll_push(ll, &i);
+    }
+
+    al_iter_t al_iter;
+    ll_iter_t ll_iter;
+    uint32_t *al_ptr, *ll_ptr;
+    uint32_t expected = 0;
+
+    al_iter_begin(al, &al_iter);
+    ll_iter_begin(ll, &ll_iter);
+    while ((al_ptr = al_iter_next(&al_iter))) {
+        ll_ptr = ll_iter_next(&ll_iter);
+        TEST_ASSERT_NOT_NULL(ll_ptr);
+
+        TEST_ASSERT_EQUAL_UINT32(expected, *al_ptr);
+        TEST_ASSERT_EQUAL_UINT32(expected, *ll_ptr);
+        expected++;
+    }
+
+    TEST_ASSERT_NULL(ll_iter_next(&ll_iter));
+    TEST_ASSERT_EQUAL_UINT32(10, expected);
+
+    delete_array_list(al);
+    delete_linked_list(ll);
+}
+
 void list_tests(void) {
     RUN_TEST(array_list_tests);
     RUN_TEST(linked_list_tests);
+    RUN_TEST(seg_list_tests);
+    RUN_TEST(test_sgl_stable_pointers);
+    RUN_TEST(small_list_tests);
+    RUN_TEST(test_sml_spill);
+    RUN_TEST(mpmc_queue_tests);
+    RUN_TEST(concrete_iterator_tests);
 }
@@ -55,7 +55,75 @@ static void test_l_equals_big(void) {
     delete_list(l2);
 }
 
+static void test_l_equals_pod(void) {
+    list_t *l1 = new_list(POD_ARRAY_LIST_IMPL, sizeof(int));
+    list_t *l2 = new_list(POD_ARRAY_LIST_IMPL, sizeof(int));
+    list_t *l3 = new_list(ARRAY_LIST_IMPL, sizeof(int));
+
+    TEST_ASSERT_TRUE(l_equals(l1, l2, NULL));
+
+    for (int i = 0; i < 100; i++) {
+        l_push(l1, &i);
+        l_push(l2, &i);
+        l_push(l3, &i);
+    }
+
+    // No eq needed between two POD lists.
+    TEST_ASSERT_TRUE(l_equals(l1, l2, NULL));
+
+    // Mixed lists fall back to eq.
+    TEST_ASSERT_TRUE(l_equals(l1, l3, (list_cell_equals_ft)int_eq));
+
+    int num = 11;
+    l_set(l2, 44, &num);
+    TEST_ASSERT_FALSE(l_equals(l1, l2, NULL));
+
+    l_pop(l1, NULL);
+    TEST_ASSERT_FALSE(l_equals(l1, l3, (list_cell_equals_ft)int_eq));
+
+    delete_list(l1);
+    delete_list(l2);
+    delete_list(l3);
+}
+
+static uint64_t int_hash(const int *i) {
+    return (uint64_t)*i;
+}
+
+static void test_l_hash(void) {
+    list_t *l1 = new_list(POD_ARRAY_LIST_IMPL, sizeof(int));
+    list_t *l2 = new_list(POD_ARRAY_LIST_IMPL, sizeof(int));
+    list_t *l3 = new_list(ARRAY_LIST_IMPL, sizeof(int));
+    list_t *l4 = new_list(LINKED_LIST_IMPL, sizeof(int));
+
+    for (int i = 0; i < 50; i++) {
+        l_push(l1, &i);
+        l_push(l2, &i);
+        l_push(l3, &i);
+        l_push(l4, &i);
+    }
+
+    TEST_ASSERT_EQUAL_UINT64(l_hash(l1, NULL), l_hash(l2, NULL));
+    TEST_ASSERT_EQUAL_UINT64(l_hash(l3, (list_cell_hash_ft)int_hash),
+            l_hash(l4, (list_cell_hash_ft)int_hash));
+
+    int num = 7;
+    l_set(l2, 3, &num);
+    TEST_ASSERT_TRUE(l_hash(l1, NULL) != l_hash(l2, NULL));
+
+    l_set(l4, 3, &num);
+    TEST_ASSERT_TRUE(l_hash(l3, (list_cell_hash_ft)int_hash) !=
+            l_hash(l4, (list_cell_hash_ft)int_hash));
+
+    delete_list(l1);
+    delete_list(l2);
+    delete_list(l3);
+    delete_list(l4);
+}
+
 void list_helpers_tests(void) {
     RUN_TEST(test_l_equals_simple);
     RUN_TEST(test_l_equals_big);
+    RUN_TEST(test_l_equals_pod);
+    RUN_TEST(test_l_hash);
 }
@@ -9,6 +9,21 @@
 #include "list_helpers.h"
 #include "stream.h"
 #include "utf8.h"
+#include "sort.h"
+#include "queue.h"
+#include "mapped_list.h"
+#include "parallel.h"
+#include "bitset.h"
+#include "swiss_map.h"
+#include "flat_map.h"
+#include "hash.h"
+#include "concurrent_map.h"
+#include "btree.h"
+#include "art.h"
+#include "hamt.h"
+#include "frozen_map.h"
+#include "filter.h"
+#include "cache.h"
 
 #include "chsys/sys.h"
 
@@ -33,5 +48,20 @@ int main(void) {
     string_tests(); 
     stream_tests();
     utf8_tests();
+    sort_tests();
+    queue_tests();
+    mapped_list_tests();
+    parallel_tests();
+    bitset_tests();
+    swiss_map_tests();
+    flat_map_tests();
+    hash_tests();
+    concurrent_map_tests();
+    btree_tests();
+    art_tests();
+    hamt_tests();
+    frozen_map_tests();
+    filter_tests();
+    cache_tests();
     safe_exit(UNITY_END());
 }
@@ -1,7 +1,12 @@
 
 #include "chutil/map.h"
+#include "chutil/swiss_map.h"
+#include "chutil/flat_map.h"
 #include "chsys/mem.h"
+#include "chsys/sys.h"
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "unity/unity.h"
 #include "unity/unity_internals.h"
@@ -10,8 +15,8 @@ static bool u64_eq_f(const uint64_t *k1, const uint64_t *k2) {
     return *k1 == *k2;
 }
 
-static uint32_t u64_hash_f(const uint64_t *k) {
-    return (uint32_t)(((((*k) + 42934191239) * 3) + 12312388491) * 5);
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return (((((*k) + 42934191239) * 3) + 12312388491) * 5);
 }
 
 static void test_hm_construct_and_destruct(void) {
@@ -84,7 +89,7 @@ bool tct_eq_f(const test_coord_t *tct1, const test_coord_t *tct2) {
         tct1->z == tct2->z;
 }
 
-uint32_t tct_hash_f(const test_coord_t *t) {
+uint64_t tct_hash_f(const test_coord_t *t) {
     return u64_hash_f(&(t->x)) + u64_hash_f(&(t->y)) + u64_hash_f(&(t->z));  
 }
 
@@ -120,7 +125,7 @@ static bool u8_eq_f(const uint8_t *k1, const uint8_t *k2) {
     return *k1 == *k2;
 }
 
-static uint32_t u8_hash_f(const uint8_t *k) {
+static uint64_t u8_hash_f(const uint8_t *k) {
     return (uint32_t)(((((*k) + 5) * 3) + 31) * 5);
 }
 
@@ -166,6 +171,57 @@ static void test_hm_iterator(void) {
     delete_hash_map(hm);
 }
 
+static void test_hm_external_iterator(void) {
+    hash_map_t *hm = new_hash_map(sizeof(uint8_t), sizeof(uint32_t),
+        (hash_map_hash_ft)u8_hash_f, (hash_map_key_eq_ft)u8_eq_f);
+
+    const size_t NUM_KEYS = 40;
+
+    uint8_t key;
+    uint32_t val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key * 3;
+        hm_put(hm, &key, &val);
+    }
+
+    // Nested iteration, every key should be paired with every key.
+    hm_iter_t outer, inner;
+    key_val_pair_t outer_kvp, inner_kvp;
+    size_t outer_cnt = 0;
+    size_t pairs = 0;
+    size_t key_sum = 0;
+
+    hm_iter_begin(hm, &outer);
+    while ((outer_kvp = hm_iter_next(&outer)) != HASH_MAP_EXHAUSTED) {
+        const uint8_t *key_ptr = kvp_key(hm, outer_kvp);
+        uint32_t val_copy;
+        memcpy(&val_copy, kvp_val(hm, outer_kvp), sizeof(uint32_t));
+
+        TEST_ASSERT_EQUAL_UINT32(*key_ptr * 3, val_copy);
+        key_sum += *key_ptr;
+        outer_cnt++;
+
+        hm_iter_begin(hm, &inner);
+        while ((inner_kvp = hm_iter_next(&inner)) != HASH_MAP_EXHAUSTED) {
+            pairs++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, outer_cnt);
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS * NUM_KEYS, pairs);
+    TEST_ASSERT_EQUAL_size_t((NUM_KEYS * (NUM_KEYS - 1)) / 2, key_sum);
+
+    // Empty map.
+    hash_map_t *empty = new_hash_map(sizeof(uint8_t), sizeof(uint32_t),
+        (hash_map_hash_ft)u8_hash_f, (hash_map_key_eq_ft)u8_eq_f);
+    hm_iter_begin(empty, &outer);
+    TEST_ASSERT_TRUE(hm_iter_next(&outer) == HASH_MAP_EXHAUSTED);
+
+    delete_hash_map(empty);
+    delete_hash_map(hm);
+}
+
 static bool u32_eq_f(const uint32_t *n1, const uint32_t *n2) {
     return *n1 == *n2;
 }
@@ -233,13 +289,649 @@ static void test_hm_equals_big(void) {
     delete_hash_map(hm2);
 }
 
+static void test_hm_equals_pod(void) {
+    hash_map_t *hm1 = new_hash_map_with_flags(sizeof(uint8_t), sizeof(uint32_t),
+        (hash_map_hash_ft)u8_hash_f, (hash_map_key_eq_ft)u8_eq_f, HM_POD_VALUES);
+    hash_map_t *hm2 = new_hash_map_with_flags(sizeof(uint8_t), sizeof(uint32_t),
+        (hash_map_hash_ft)u8_hash_f, (hash_map_key_eq_ft)u8_eq_f, HM_POD_VALUES);
+
+    uint8_t k;
+    uint32_t v;
+
+    for (uint8_t i = 0; i < 100; i++) {
+        k = i;
+        v = i * 24;
+        hm_put(hm1, &k, &v);
+        hm_put(hm2, &k, &v);
+    }
+
+    TEST_ASSERT_TRUE(hm_equals(hm1, hm2, NULL));
+
+    k = 32;
+    v = 1;
+    hm_put(hm1, &k, &v);
+    TEST_ASSERT_FALSE(hm_equals(hm1, hm2, NULL));
+
+    hm_put(hm2, &k, &v);
+    TEST_ASSERT_TRUE(hm_equals(hm1, hm2, NULL));
+    
+    delete_hash_map(hm1);
+    delete_hash_map(hm2);
+}
+
+static void test_hm_incremental_resize(void) {
+    hash_map_t *inc = new_hash_map_with_flags(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f, 
+            HM_INCREMENTAL_RESIZE);
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    const uint64_t NUM_KEYS = 1000;
+    uint64_t key, val;
+    bool saw_migration = false;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key * 3;
+        hm_put(inc, &key, &val);
+        hm_put(hm, &key, &val);
+
+        if (inc->old_chains) {
+            saw_migration = true;
+
+            // Every key must be reachable mid resize.
+            TEST_ASSERT_TRUE(hm_equals(inc, hm, (hash_map_val_eq_ft)u64_eq_f));
+        }
+    }
+
+    TEST_ASSERT_TRUE(saw_migration);
+
+    // Removals work mid resize too.
+    for (key = 0; key < NUM_KEYS; key += 3) {
+        TEST_ASSERT_TRUE(hm_remove(inc, &key));
+        TEST_ASSERT_TRUE(hm_remove(hm, &key));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(hm_num_keys(hm), hm_num_keys(inc));
+    TEST_ASSERT_TRUE(hm_equals(inc, hm, (hash_map_val_eq_ft)u64_eq_f));
+    TEST_ASSERT_TRUE(hm_equals(hm, inc, (hash_map_val_eq_ft)u64_eq_f));
+
+    // The internal iterator covers both tables as well.
+    size_t count = 0;
+    hm_reset_iterator(inc);
+    while (hm_next_kvp(inc) != HASH_MAP_EXHAUSTED) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_size_t(hm_num_keys(inc), count);
+
+    delete_hash_map(hm);
+    delete_hash_map(inc);
+}
+
+static void test_hm_resize_start(void) {
+    hash_map_t *hm = new_hash_map_with_flags(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f, 
+            HM_INCREMENTAL_RESIZE);
+
+    hm_reserve(hm, 64);
+    size_t chains_cap = hm->chains_cap;
+
+    uint64_t key = 0, val;
+    while (!(hm->old_chains)) {
+        size_t mallocs = sys_get_malloc_count();
+
+        val = key * 2;
+        hm_put(hm, &key, &val);
+        key++;
+
+        if (hm->old_chains) {
+            // Besides its own pair, the triggering put just allocates the
+            // new table. Nothing is moved or cleared yet.
+            TEST_ASSERT_EQUAL_size_t(mallocs + 2, sys_get_malloc_count());
+            TEST_ASSERT_EQUAL_size_t(chains_cap * 2, hm->chains_cap);
+            TEST_ASSERT_EQUAL_size_t(0, hm->migrate_ind);
+        } else {
+            TEST_ASSERT_EQUAL_size_t(mallocs + 1, sys_get_malloc_count());
+        }
+    }
+
+    // Everything is still there mid resize. (Iteration skips the parts of
+    // the new table not yet cleared)
+    size_t count = 0;
+    hm_reset_iterator(hm);
+    while (hm_next_kvp(hm) != HASH_MAP_EXHAUSTED) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_size_t(key, count);
+
+    hm_stats_t stats = hm_stats(hm);
+    TEST_ASSERT_EQUAL_size_t(key, stats.num_keys);
+
+    for (uint64_t k = 0; hm->old_chains; k++) {
+        val = k * 2;
+        hm_put(hm, &k, &val);
+    }
+
+    for (uint64_t k = 0; k < key; k++) {
+        TEST_ASSERT_TRUE(hm_get_copy(hm, &k, &val));
+        TEST_ASSERT_EQUAL_UINT64(k * 2, val);
+    }
+
+    delete_hash_map(hm);
+}
+
+static void test_hm_reserve(void) {
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    const uint64_t NUM_KEYS = 1000;
+    uint64_t key, val;
+
+    for (key = 0; key < 10; key++) {
+        val = key;
+        hm_put(hm, &key, &val);
+    }
+
+    hm_reserve(hm, NUM_KEYS);
+    size_t chains_cap = hm->chains_cap;
+    TEST_ASSERT_TRUE(chains_cap >= NUM_KEYS * 2);
+
+    // Reserving less than we have does nothing.
+    hm_reserve(hm, 5);
+    TEST_ASSERT_EQUAL_size_t(chains_cap, hm->chains_cap);
+
+    for (key = 10; key < NUM_KEYS; key++) {
+        val = key;
+        hm_put(hm, &key, &val);
+    }
+
+    // No resizing after the reserve.
+    TEST_ASSERT_EQUAL_size_t(chains_cap, hm->chains_cap);
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_TRUE(hm_get_copy(hm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key, val);
+    }
+
+    delete_hash_map(hm);
+}
+
+static void test_hm_batch(void) {
+    hash_map_t *hm = new_hash_map_with_flags(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f,
+            HM_INCREMENTAL_RESIZE);
+
+    // Not a multiple of the batch width on purpose.
+    const size_t NUM_KEYS = 1003;
+    uint64_t keys[1003];
+    uint64_t vals[1003];
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        keys[i] = i * 2;
+        vals[i] = i * 7;
+    }
+
+    hm_put_batch(hm, keys, vals, NUM_KEYS);
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, hm_num_keys(hm));
+
+    // Updates through a batch, keys repeated within the batch too.
+    for (size_t i = 0; i < 20; i++) {
+        keys[i] = (i % 10) * 2;
+        vals[i] = i;
+    }
+    hm_put_batch(hm, keys, vals, 20);
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, hm_num_keys(hm));
+
+    uint64_t val;
+    for (uint64_t key = 0; key < 20; key += 2) {
+        TEST_ASSERT_TRUE(hm_get_copy(hm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64((key / 2) + 10, val);
+    }
+
+    // Every odd key is missing.
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        keys[i] = i;
+    }
+
+    void *dests[1003];
+    TEST_ASSERT_EQUAL_size_t((NUM_KEYS + 1) / 2, hm_get_batch(hm, keys, NUM_KEYS, dests));
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        TEST_ASSERT_TRUE(dests[i] == hm_get(hm, &(keys[i])));
+    }
+
+    delete_hash_map(hm);
+}
+
+static void test_hm_slab_entries(void) {
+    hash_map_t *slab = new_hash_map_with_flags(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f,
+            HM_SLAB_ENTRIES | HM_INCREMENTAL_RESIZE);
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    const uint64_t NUM_KEYS = 2000;
+    uint64_t key, val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key * 5;
+        hm_put(slab, &key, &val);
+        hm_put(hm, &key, &val);
+    }
+
+    TEST_ASSERT_TRUE(hm_equals(slab, hm, (hash_map_val_eq_ft)u64_eq_f));
+
+    // Pairs put back to back share a slab.
+    key = 0;
+    uint8_t *first = hm_get(slab, &key);
+    key = 1;
+    TEST_ASSERT_TRUE((uint8_t *)hm_get(slab, &key) - first == (ptrdiff_t)slab->cell_size);
+
+    for (key = 0; key < NUM_KEYS; key += 2) {
+        TEST_ASSERT_TRUE(hm_remove(slab, &key));
+        TEST_ASSERT_TRUE(hm_remove(hm, &key));
+    }
+
+    TEST_ASSERT_NOT_NULL(slab->free_cells);
+
+    // Removed cells are reused before any new slab is made.
+    hm_slab_t *slabs = slab->slabs;
+    size_t slab_used = slab->slab_used;
+
+    for (key = 0; key < NUM_KEYS; key += 2) {
+        val = key + 1;
+        hm_put(slab, &key, &val);
+        hm_put(hm, &key, &val);
+    }
+
+    TEST_ASSERT_TRUE(slabs == slab->slabs);
+    TEST_ASSERT_EQUAL_size_t(slab_used, slab->slab_used);
+    TEST_ASSERT_NULL(slab->free_cells);
+
+    TEST_ASSERT_TRUE(hm_equals(slab, hm, (hash_map_val_eq_ft)u64_eq_f));
+    TEST_ASSERT_TRUE(hm_equals(hm, slab, (hash_map_val_eq_ft)u64_eq_f));
+
+    delete_hash_map(hm);
+    delete_hash_map(slab);
+}
+
+static uint64_t u64_mod_hash_f(const uint64_t *k) {
+    return *k % 50;
+}
+
+static void test_hm_stats(void) {
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    hm_stats_t stats = hm_stats(hm);
+    TEST_ASSERT_EQUAL_size_t(0, stats.num_keys);
+    TEST_ASSERT_EQUAL_size_t(stats.num_chains, stats.empty_chains);
+    TEST_ASSERT_EQUAL_size_t(stats.num_chains, stats.chain_hist[0]);
+    TEST_ASSERT_EQUAL_size_t(0, stats.longest_chain);
+
+    const uint64_t NUM_KEYS = 1000;
+    uint64_t key, val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key;
+        hm_put(hm, &key, &val);
+    }
+
+    stats = hm_stats(hm);
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, stats.num_keys);
+    TEST_ASSERT_EQUAL_size_t(0, stats.hash_collisions);
+    TEST_ASSERT_TRUE(stats.load_factor > 0.0 && stats.load_factor <= 1.0);
+
+    size_t chains = 0;
+    size_t pairs = 0;
+    for (size_t i = 0; i < HM_STATS_HIST_LEN; i++) {
+        chains += stats.chain_hist[i];
+        pairs += i * stats.chain_hist[i];
+    }
+
+    TEST_ASSERT_EQUAL_size_t(stats.num_chains, chains);
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, pairs);
+    TEST_ASSERT_TRUE(stats.memory_bytes > NUM_KEYS * 2 * sizeof(uint64_t));
+
+    delete_hash_map(hm);
+
+    // Only 50 distinct hashes, the rest collide.
+    hm = new_hash_map_with_flags(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_mod_hash_f, (hash_map_key_eq_ft)u64_eq_f, HM_SLAB_ENTRIES);
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key;
+        hm_put(hm, &key, &val);
+    }
+
+    stats = hm_stats(hm);
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS - 50, stats.hash_collisions);
+    TEST_ASSERT_TRUE(stats.longest_chain >= 20);
+    TEST_ASSERT_TRUE(stats.chain_hist[HM_STATS_HIST_LEN - 1] > 0);
+    TEST_ASSERT_TRUE(stats.memory_bytes >= NUM_KEYS * hm->cell_size);
+
+    delete_hash_map(hm);
+}
+
+// Keys [lo, hi) map to key * mult.
+static hash_map_t *new_u64_range_map(uint64_t lo, uint64_t hi, uint64_t mult,
+        hash_map_flags_t flags) {
+    hash_map_t *hm = new_hash_map_with_flags(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f, flags);
+
+    for (uint64_t key = lo; key < hi; key++) {
+        uint64_t val = key * mult;
+        hm_put(hm, &key, &val);
+    }
+
+    return hm;
+}
+
+static void test_hm_union_into(void) {
+    hash_map_t *hm1 = new_u64_range_map(0, 600, 1, 0);
+    hash_map_t *hm2 = new_u64_range_map(400, 1000, 2, HM_INCREMENTAL_RESIZE);
+
+    hm_union_into(hm1, hm2);
+    TEST_ASSERT_EQUAL_size_t(1000, hm_num_keys(hm1));
+
+    uint64_t key, val;
+    for (key = 0; key < 1000; key++) {
+        TEST_ASSERT_TRUE(hm_get_copy(hm1, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key < 400 ? key : key * 2, val);
+    }
+
+    delete_hash_map(hm1);
+    delete_hash_map(hm2);
+}
+
+static void test_hm_intersect_and_difference(void) {
+    hash_map_t *small = new_u64_range_map(0, 300, 1, 0);
+    hash_map_t *big = new_u64_range_map(200, 1000, 3, 0);
+
+    // Values come from the first map, whichever is walked.
+    hash_map_t *maps[2][2] = {{small, big}, {big, small}};
+    for (size_t m = 0; m < 2; m++) {
+        hash_map_t *inter = hm_intersect(maps[m][0], maps[m][1]);
+        TEST_ASSERT_EQUAL_size_t(100, hm_num_keys(inter));
+
+        uint64_t mult = m == 0 ? 1 : 3;
+        uint64_t key, val;
+        for (key = 200; key < 300; key++) {
+            TEST_ASSERT_TRUE(hm_get_copy(inter, &key, &val));
+            TEST_ASSERT_EQUAL_UINT64(key * mult, val);
+        }
+
+        delete_hash_map(inter);
+    }
+
+    hash_map_t *diff = hm_difference(small, big);
+    TEST_ASSERT_EQUAL_size_t(200, hm_num_keys(diff));
+    for (uint64_t key = 0; key < 300; key++) {
+        TEST_ASSERT_EQUAL(key < 200, hm_contains(diff, &key));
+    }
+    delete_hash_map(diff);
+
+    diff = hm_difference(big, small);
+    TEST_ASSERT_EQUAL_size_t(700, hm_num_keys(diff));
+    delete_hash_map(diff);
+
+    delete_hash_map(small);
+    delete_hash_map(big);
+}
+
+typedef struct _diff_counts_t {
+    size_t counts[3];
+    uint64_t key_sums[3];
+} diff_counts_t;
+
+static void count_diff_f(hm_diff_kind_t kind, const void *key, 
+        const void *old_val, const void *new_val, void *ctx) {
+    diff_counts_t *dc = ctx;
+
+    TEST_ASSERT_EQUAL(kind == HM_DIFF_ADDED, old_val == NULL);
+    TEST_ASSERT_EQUAL(kind == HM_DIFF_REMOVED, new_val == NULL);
+
+    dc->counts[kind]++;
+    dc->key_sums[kind] += *(const uint64_t *)key;
+}
+
+static void test_hm_diff(void) {
+    hash_map_t *old_hm = new_u64_range_map(0, 500, 1, HM_POD_VALUES);
+    hash_map_t *new_hm = new_u64_range_map(100, 600, 1, HM_POD_VALUES);
+
+    // Change 10 values in the middle.
+    for (uint64_t key = 300; key < 310; key++) {
+        uint64_t val = 0;
+        hm_put(new_hm, &key, &val);
+    }
+
+    diff_counts_t dc;
+    memset(&dc, 0, sizeof(dc));
+
+    TEST_ASSERT_EQUAL_size_t(210, hm_diff(old_hm, new_hm, NULL, count_diff_f, &dc));
+
+    TEST_ASSERT_EQUAL_size_t(100, dc.counts[HM_DIFF_ADDED]);
+    TEST_ASSERT_EQUAL_size_t(100, dc.counts[HM_DIFF_REMOVED]);
+    TEST_ASSERT_EQUAL_size_t(10, dc.counts[HM_DIFF_CHANGED]);
+
+    TEST_ASSERT_EQUAL_UINT64((500 + 599) * 50, dc.key_sums[HM_DIFF_ADDED]);
+    TEST_ASSERT_EQUAL_UINT64(99 * 50, dc.key_sums[HM_DIFF_REMOVED]);
+    TEST_ASSERT_EQUAL_UINT64((300 + 309) * 5, dc.key_sums[HM_DIFF_CHANGED]);
+
+    // Nothing to report against itself.
+    memset(&dc, 0, sizeof(dc));
+    TEST_ASSERT_EQUAL_size_t(0, hm_diff(new_hm, new_hm, 
+                (hash_map_val_eq_ft)u64_eq_f, count_diff_f, &dc));
+
+    delete_hash_map(old_hm);
+    delete_hash_map(new_hm);
+}
+
+static void test_hm_get_or_insert(void) {
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    // Count how many times each key mod 50 shows up.
+    bool inserted;
+    for (uint64_t i = 0; i < 1000; i++) {
+        uint64_t key = i % 50;
+
+        uint64_t *count = hm_get_or_insert(hm, &key, &inserted);
+        TEST_ASSERT_EQUAL(i < 50, inserted);
+
+        (*count)++;
+    }
+
+    TEST_ASSERT_EQUAL_size_t(50, hm_num_keys(hm));
+
+    uint64_t key, val;
+    for (key = 0; key < 50; key++) {
+        TEST_ASSERT_TRUE(hm_get_copy(hm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(20, val);
+    }
+
+    // inserted is optional.
+    key = 1000;
+    TEST_ASSERT_EQUAL_UINT64(0, *(uint64_t *)hm_get_or_insert(hm, &key, NULL));
+    TEST_ASSERT_EQUAL_size_t(51, hm_num_keys(hm));
+
+    delete_hash_map(hm);
+}
+
+static void test_hm_remove_copy(void) {
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    uint64_t key, val;
+    for (key = 0; key < 100; key++) {
+        val = key * 11;
+        hm_put(hm, &key, &val);
+    }
+
+    uint64_t key_out, val_out;
+
+    key = 42;
+    TEST_ASSERT_TRUE(hm_remove_copy(hm, &key, &key_out, &val_out));
+    TEST_ASSERT_EQUAL_UINT64(42, key_out);
+    TEST_ASSERT_EQUAL_UINT64(42 * 11, val_out);
+    TEST_ASSERT_FALSE(hm_remove_copy(hm, &key, &key_out, &val_out));
+
+    key = 43;
+    TEST_ASSERT_TRUE(hm_remove_copy(hm, &key, NULL, &val_out));
+    TEST_ASSERT_EQUAL_UINT64(43 * 11, val_out);
+
+    TEST_ASSERT_EQUAL_size_t(98, hm_num_keys(hm));
+
+    delete_hash_map(hm);
+}
+
+// Generic map tests, run against every implementation.
+
+static void test_m_put_get_remove(const map_impl_t *impl) {
+    map_t *m = new_map(impl, sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    TEST_ASSERT_EQUAL_size_t(sizeof(uint64_t), m_key_size(m));
+    TEST_ASSERT_EQUAL_size_t(sizeof(uint64_t), m_value_size(m));
+
+    const uint64_t NUM_KEYS = 300;
+    uint64_t key, val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key * 7;
+        m_put(m, &key, &val);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, m_num_keys(m));
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_TRUE(m_get_copy(m, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key * 7, val);
+    }
+
+    for (key = 0; key < NUM_KEYS; key += 2) {
+        TEST_ASSERT_TRUE(m_remove(m, &key));
+        TEST_ASSERT_FALSE(m_remove(m, &key));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS / 2, m_num_keys(m));
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_EQUAL(key % 2 == 1, m_contains(m, &key));
+    }
+
+    delete_map(m);
+}
+
+static void test_m_iterator(const map_impl_t *impl) {
+    map_t *m = new_map(impl, sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    map_iter_t iter;
+    m_iter_begin(m, &iter);
+    TEST_ASSERT_TRUE(m_iter_next(&iter) == HASH_MAP_EXHAUSTED);
+
+    const uint64_t NUM_KEYS = 40;
+    uint64_t key;
+    for (key = 0; key < NUM_KEYS; key++) {
+        m_put(m, &key, &key);
+    }
+
+    bool seen[40] = {0};
+    size_t count = 0;
+
+    key_val_pair_t kvp;
+    m_iter_begin(m, &iter);
+    while ((kvp = m_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        uint64_t k = *(const uint64_t *)m_kvp_key(m, kvp);
+        TEST_ASSERT_EQUAL_UINT64(k, *(uint64_t *)m_kvp_val(m, kvp));
+        TEST_ASSERT_FALSE(seen[k]);
+
+        seen[k] = true;
+        count++;
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, count);
+
+    delete_map(m);
+}
+
+static void test_m_equals(const map_impl_t *impl) {
+    // Compared against a chained map, so equality across
+    // implementations is checked too.
+    map_t *m1 = new_map(impl, sizeof(uint8_t), sizeof(uint32_t),
+        (hash_map_hash_ft)u8_hash_f, (hash_map_key_eq_ft)u8_eq_f);
+    map_t *m2 = new_map(HASH_MAP_IMPL, sizeof(uint8_t), sizeof(uint32_t),
+        (hash_map_hash_ft)u8_hash_f, (hash_map_key_eq_ft)u8_eq_f);
+
+    uint8_t k;
+    uint32_t v;
+
+    for (uint8_t i = 0; i < 100; i++) {
+        k = i;
+        v = i * 24;
+        m_put(m1, &k, &v);
+        m_put(m2, &k, &v);
+    }
+
+    TEST_ASSERT_TRUE(m_equals(m1, m2, (hash_map_val_eq_ft)u32_eq_f));
+
+    k = 32;
+    v = 1;
+    m_put(m1, &k, &v);
+    TEST_ASSERT_FALSE(m_equals(m1, m2, (hash_map_val_eq_ft)u32_eq_f));
+    TEST_ASSERT_FALSE(m_equals(m2, m1, (hash_map_val_eq_ft)u32_eq_f));
+
+    m_remove(m1, &k);
+    TEST_ASSERT_FALSE(m_equals(m1, m2, (hash_map_val_eq_ft)u32_eq_f));
+
+    m_remove(m2, &k);
+    TEST_ASSERT_TRUE(m_equals(m1, m2, (hash_map_val_eq_ft)u32_eq_f));
+
+    delete_map(m1);
+    delete_map(m2);
+}
+
+static void test_m(const map_impl_t *impl) {
+    test_m_put_get_remove(impl);
+    test_m_iterator(impl);
+    test_m_equals(impl);
+}
+
+static void hash_map_impl_tests(void) {
+    test_m(HASH_MAP_IMPL);
+}
+
+static void swiss_map_impl_tests(void) {
+    test_m(SWISS_MAP_IMPL);
+}
+
+static void flat_map_impl_tests(void) {
+    test_m(FLAT_MAP_IMPL);
+}
+
 void map_tests(void) {
     RUN_TEST(test_hm_construct_and_destruct); 
     RUN_TEST(test_hm_put_and_get);
     RUN_TEST(test_hm_put_and_remove);
     RUN_TEST(test_hm_put_big_key);
     RUN_TEST(test_hm_iterator);
+    RUN_TEST(test_hm_external_iterator);
     RUN_TEST(test_hm_equals_simple);
     RUN_TEST(test_hm_equals_big);
+    RUN_TEST(test_hm_equals_pod);
+    RUN_TEST(test_hm_incremental_resize);
+    RUN_TEST(test_hm_resize_start);
+    RUN_TEST(test_hm_reserve);
+    RUN_TEST(test_hm_batch);
+    RUN_TEST(test_hm_get_or_insert);
+    RUN_TEST(test_hm_remove_copy);
+    RUN_TEST(test_hm_slab_entries);
+    RUN_TEST(test_hm_stats);
+    RUN_TEST(test_hm_union_into);
+    RUN_TEST(test_hm_intersect_and_difference);
+    RUN_TEST(test_hm_diff);
+    RUN_TEST(hash_map_impl_tests);
+    RUN_TEST(swiss_map_impl_tests);
+    RUN_TEST(flat_map_impl_tests);
 }
 
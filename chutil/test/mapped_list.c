@@ -0,0 +1,125 @@
+
+#include "mapped_list.h"
+#include "chutil/mapped_list.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct _test_row_t {
+    uint64_t id;
+    uint32_t x, y;
+} test_row_t;
+
+// Creates an empty temporary file, path_buf is filled with its name.
+static void make_temp_path(char *path_buf) {
+    strcpy(path_buf, "/tmp/chutil_mapped_list_XXXXXX");
+    int fd = mkstemp(path_buf);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+}
+
+static void test_mal_push_and_reopen(void) {
+    char path[64];
+    make_temp_path(path);
+
+    mapped_array_list_t *mal = new_mapped_array_list(path, sizeof(test_row_t));
+    TEST_ASSERT_NOT_NULL(mal);
+    TEST_ASSERT_EQUAL_size_t(0, mal_len(mal));
+
+    const uint64_t NUM_ROWS = 5000;
+    test_row_t row;
+
+    for (uint64_t i = 0; i < NUM_ROWS; i++) {
+        row.id = i;
+        row.x = i * 2;
+        row.y = i * 3;
+        mal_push(mal, &row);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_ROWS, mal_len(mal));
+    TEST_ASSERT_TRUE(mal_cap(mal) >= NUM_ROWS);
+    TEST_ASSERT_TRUE(mal_flush(mal));
+
+    delete_mapped_array_list(mal);
+
+    // Everything should still be there.
+    mal = new_mapped_array_list(path, sizeof(test_row_t));
+    TEST_ASSERT_NOT_NULL(mal);
+    TEST_ASSERT_EQUAL_size_t(NUM_ROWS, mal_len(mal));
+
+    test_row_t *row_ptr;
+    uint64_t expected = 0;
+    mal_reset_iterator(mal);
+    while ((row_ptr = mal_next(mal))) {
+        TEST_ASSERT_EQUAL_UINT64(expected, row_ptr->id);
+        TEST_ASSERT_EQUAL_UINT32(expected * 2, row_ptr->x);
+        TEST_ASSERT_EQUAL_UINT32(expected * 3, row_ptr->y);
+        expected++;
+    }
+    TEST_ASSERT_EQUAL_UINT64(NUM_ROWS, expected);
+
+    mal_poll(mal, &row);
+    TEST_ASSERT_EQUAL_UINT64(0, row.id);
+    mal_pop(mal, &row);
+    TEST_ASSERT_EQUAL_UINT64(NUM_ROWS - 1, row.id);
+    TEST_ASSERT_EQUAL_size_t(NUM_ROWS - 2, mal_len(mal));
+
+    mal_get_copy(mal, 0, &row);
+    TEST_ASSERT_EQUAL_UINT64(1, row.id);
+
+    delete_mapped_array_list(mal);
+
+    // Different cell size, not our list.
+    TEST_ASSERT_NULL(new_mapped_array_list(path, sizeof(uint32_t)));
+
+    unlink(path);
+}
+
+static void test_mal_bad_file(void) {
+    char path[64];
+    make_temp_path(path);
+
+    // Something which isn't a mapped list at all.
+    FILE *f = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    for (size_t i = 0; i < 100; i++) {
+        fputc('a', f);
+    }
+    fclose(f);
+
+    TEST_ASSERT_NULL(new_mapped_array_list(path, sizeof(uint64_t)));
+
+    // A real header, but with a cap so big that cap * cell_size wraps
+    // around to something which would fit.
+    mapped_list_header_t hdr = {
+        .magic = MAPPED_LIST_MAGIC,
+        .cell_size = sizeof(test_row_t),
+        .len = 2,
+        .cap = ((uint64_t)1 << 60) + 1,
+    };
+
+    f = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(&hdr, sizeof(hdr), 1, f));
+    for (size_t i = 0; i < 4 * sizeof(test_row_t); i++) {
+        fputc(0, f);
+    }
+    fclose(f);
+
+    TEST_ASSERT_NULL(new_mapped_array_list(path, sizeof(test_row_t)));
+
+    unlink(path);
+
+    TEST_ASSERT_NULL(new_mapped_array_list("/this/path/does/not/exist", sizeof(uint64_t)));
+}
+
+void mapped_list_tests(void) {
+    RUN_TEST(test_mal_push_and_reopen);
+    RUN_TEST(test_mal_bad_file);
+}
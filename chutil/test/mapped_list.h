@@ -0,0 +1,6 @@
+#ifndef TEST_CHUTIL_MAPPED_LIST_H
+#define TEST_CHUTIL_MAPPED_LIST_H
+
+void mapped_list_tests(void);
+
+#endif
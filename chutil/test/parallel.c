@@ -0,0 +1,180 @@
+
+#include "parallel.h"
+#include "chutil/parallel.h"
+#include "chutil/list.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define TEST_PARALLEL_WORKERS 3
+
+static void add_ctx(uint64_t *cell, const uint64_t *amount) {
+    *cell += *amount;
+}
+
+static void square_to_u64(const uint32_t *src, uint64_t *dest, void *ctx) {
+    (void)ctx;
+    *dest = (uint64_t)(*src) * (*src);
+}
+
+static void sum_u64(uint64_t *acc, const uint64_t *val, void *ctx) {
+    (void)ctx;
+    *acc += *val;
+}
+
+// x -> (a * x) + b, composing these is associative but NOT commutative.
+// This makes sure partials are combined in order.
+typedef struct _affine_t {
+    uint64_t a, b;
+} affine_t;
+
+// acc = cell after acc.
+static void compose_affine(affine_t *acc, const affine_t *cell, void *ctx) {
+    (void)ctx;
+    acc->b = (cell->a * acc->b) + cell->b;
+    acc->a = cell->a * acc->a;
+}
+
+static int u64_cmp(const uint64_t *n1, const uint64_t *n2) {
+    if (*n1 < *n2) {
+        return -1;
+    }
+
+    return *n1 > *n2 ? 1 : 0;
+}
+
+static void test_tp_run(void) {
+    // The pool should be reusable across many jobs.
+    thread_pool_t *tp = new_thread_pool(TEST_PARALLEL_WORKERS);
+    TEST_ASSERT_EQUAL_size_t(TEST_PARALLEL_WORKERS + 1, tp_num_threads(tp));
+
+    array_list_t *al = new_array_list(sizeof(uint64_t));
+    const uint64_t NUM_VALS = 50000;
+    for (uint64_t i = 0; i < NUM_VALS; i++) {
+        al_push(al, &i);
+    }
+
+    uint64_t amount = 3;
+    for (size_t round = 0; round < 10; round++) {
+        al_parallel_for_each(tp, al, (parallel_for_each_ft)add_ctx, &amount);
+    }
+
+    for (uint64_t i = 0; i < NUM_VALS; i++) {
+        TEST_ASSERT_EQUAL_UINT64(i + 30, *(uint64_t *)al_get(al, i));
+    }
+
+    delete_array_list(al);
+    delete_thread_pool(tp);
+
+    // No workers at all is fine too.
+    tp = new_thread_pool(0);
+    al = new_array_list(sizeof(uint64_t));
+    for (uint64_t i = 0; i < 5000; i++) {
+        al_push(al, &i);
+    }
+    al_parallel_for_each(tp, al, (parallel_for_each_ft)add_ctx, &amount);
+    TEST_ASSERT_EQUAL_UINT64(4999 + 3, *(uint64_t *)al_get(al, 4999));
+
+    delete_array_list(al);
+    delete_thread_pool(tp);
+}
+
+static void test_al_parallel_map_reduce(void) {
+    thread_pool_t *tp = new_thread_pool(TEST_PARALLEL_WORKERS);
+
+    array_list_t *src = new_array_list(sizeof(uint32_t));
+    const uint32_t NUM_VALS = 30000;
+    for (uint32_t i = 0; i < NUM_VALS; i++) {
+        al_push(src, &i);
+    }
+
+    array_list_t *dest = new_array_list(sizeof(uint64_t));
+    al_parallel_map(tp, src, dest, (parallel_map_ft)square_to_u64, NULL);
+
+    TEST_ASSERT_EQUAL_size_t(NUM_VALS, al_len(dest));
+
+    uint64_t expected_sum = 0;
+    for (uint32_t i = 0; i < NUM_VALS; i++) {
+        uint64_t sq = (uint64_t)i * i;
+        TEST_ASSERT_EQUAL_UINT64(sq, *(uint64_t *)al_get(dest, i));
+        expected_sum += sq;
+    }
+
+    uint64_t zero = 0;
+    uint64_t sum;
+    al_parallel_reduce(tp, dest, (parallel_combine_ft)sum_u64, NULL, &zero, &sum);
+    TEST_ASSERT_EQUAL_UINT64(expected_sum, sum);
+
+    // Order sensitive reduce.
+    array_list_t *funcs = new_array_list(sizeof(affine_t));
+    affine_t expected_func = {.a = 1, .b = 0};
+    for (uint64_t i = 0; i < 10000; i++) {
+        affine_t func = {.a = (i % 7) + 1, .b = i % 13};
+        al_push(funcs, &func);
+        compose_affine(&expected_func, &func, NULL);
+    }
+
+    affine_t identity = {.a = 1, .b = 0};
+    affine_t composed;
+    al_parallel_reduce(tp, funcs, (parallel_combine_ft)compose_affine, NULL, 
+            &identity, &composed);
+    TEST_ASSERT_EQUAL_UINT64(expected_func.a, composed.a);
+    TEST_ASSERT_EQUAL_UINT64(expected_func.b, composed.b);
+
+    // Empty list gives back the identity.
+    array_list_t *empty = new_array_list(sizeof(uint64_t));
+    sum = 5;
+    al_parallel_reduce(tp, empty, (parallel_combine_ft)sum_u64, NULL, &zero, &sum);
+    TEST_ASSERT_EQUAL_UINT64(0, sum);
+
+    delete_array_list(empty);
+    delete_array_list(funcs);
+    delete_array_list(dest);
+    delete_array_list(src);
+    delete_thread_pool(tp);
+}
+
+static void test_al_parallel_sort(void) {
+    thread_pool_t *tp = new_thread_pool(TEST_PARALLEL_WORKERS);
+
+    const size_t sizes[] = {0, 10, 1500, 100000};
+    const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    for (size_t s = 0; s < num_sizes; s++) {
+        array_list_t *al = new_array_list(sizeof(uint64_t));
+        uint64_t total = 0;
+
+        for (size_t i = 0; i < sizes[s]; i++) {
+            uint64_t val = rand() % 100000;
+            total += val;
+            al_push(al, &val);
+        }
+
+        al_parallel_sort(tp, al, (sort_cmp_ft)u64_cmp);
+        TEST_ASSERT_EQUAL_size_t(sizes[s], al_len(al));
+
+        uint64_t sorted_total = 0;
+        for (size_t i = 0; i < al_len(al); i++) {
+            uint64_t val = *(uint64_t *)al_get(al, i);
+            sorted_total += val;
+
+            if (i > 0) {
+                TEST_ASSERT_TRUE(*(uint64_t *)al_get(al, i - 1) <= val);
+            }
+        }
+        TEST_ASSERT_EQUAL_UINT64(total, sorted_total);
+
+        delete_array_list(al);
+    }
+
+    delete_thread_pool(tp);
+}
+
+void parallel_tests(void) {
+    RUN_TEST(test_tp_run);
+    RUN_TEST(test_al_parallel_map_reduce);
+    RUN_TEST(test_al_parallel_sort);
+}
@@ -0,0 +1,6 @@
+#ifndef TEST_CHUTIL_PARALLEL_H
+#define TEST_CHUTIL_PARALLEL_H
+
+void parallel_tests(void);
+
+#endif
@@ -0,0 +1,154 @@
+
+#include "queue.h"
+#include "chutil/queue.h"
+#include "chsys/mem.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+static void test_mq_bounded(void) {
+    mpmc_queue_t *mq = new_mpmc_queue(sizeof(uint32_t), 5);
+    TEST_ASSERT_NOT_NULL(mq);
+
+    // Rounded up to a power of 2.
+    TEST_ASSERT_EQUAL_size_t(8, mq_cap(mq));
+
+    uint32_t val;
+    for (val = 0; val < 8; val++) {
+        TEST_ASSERT_TRUE(mq_try_push(mq, &val));
+    }
+    TEST_ASSERT_FALSE(mq_try_push(mq, &val));
+    TEST_ASSERT_EQUAL_size_t(8, mq_len(mq));
+
+    // Wrap around the ring a few times.
+    uint32_t out;
+    for (uint32_t i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(mq_try_poll(mq, &out));
+        TEST_ASSERT_EQUAL_UINT32(i, out);
+
+        val = i + 8;
+        TEST_ASSERT_TRUE(mq_try_push(mq, &val));
+    }
+
+    for (uint32_t i = 100; i < 108; i++) {
+        TEST_ASSERT_TRUE(mq_try_poll(mq, &out));
+        TEST_ASSERT_EQUAL_UINT32(i, out);
+    }
+
+    TEST_ASSERT_FALSE(mq_try_poll(mq, &out));
+    TEST_ASSERT_EQUAL_size_t(0, mq_len(mq));
+
+    delete_mpmc_queue(mq);
+}
+
+#define TEST_MQ_PRODUCERS 4
+#define TEST_MQ_CONSUMERS 4
+#define TEST_MQ_PER_PRODUCER 20000
+
+typedef struct _test_mq_ctx_t {
+    mpmc_queue_t *mq;
+    size_t id;
+
+    atomic_size_t *consumed;
+    atomic_uint_fast8_t *seen;
+    atomic_bool *duplicate;
+} test_mq_ctx_t;
+
+static void *test_mq_producer(void *arg) {
+    test_mq_ctx_t *ctx = arg;
+
+    for (uint32_t i = 0; i < TEST_MQ_PER_PRODUCER; i++) {
+        uint32_t val = (ctx->id * TEST_MQ_PER_PRODUCER) + i;
+        mq_push(ctx->mq, &val);
+    }
+
+    return NULL;
+}
+
+static void *test_mq_consumer(void *arg) {
+    test_mq_ctx_t *ctx = arg;
+    const size_t total = TEST_MQ_PRODUCERS * TEST_MQ_PER_PRODUCER;
+
+    uint32_t val;
+    while (atomic_load(ctx->consumed) < total) {
+        if (!mq_try_poll(ctx->mq, &val)) {
+            sched_yield();
+            continue;
+        }
+
+        if (atomic_fetch_add(&(ctx->seen[val]), 1) != 0) {
+            atomic_store(ctx->duplicate, true);
+        }
+        atomic_fetch_add(ctx->consumed, 1);
+    }
+
+    return NULL;
+}
+
+static void test_mq_concurrent(void) {
+    const size_t total = TEST_MQ_PRODUCERS * TEST_MQ_PER_PRODUCER;
+
+    // Small capacity so producers regularly find the queue full.
+    mpmc_queue_t *mq = new_mpmc_queue(sizeof(uint32_t), 64);
+
+    atomic_size_t consumed;
+    atomic_init(&consumed, 0);
+    atomic_bool duplicate;
+    atomic_init(&duplicate, false);
+
+    atomic_uint_fast8_t *seen = safe_malloc(sizeof(atomic_uint_fast8_t) * total);
+    for (size_t i = 0; i < total; i++) {
+        atomic_init(&(seen[i]), 0);
+    }
+
+    pthread_t producers[TEST_MQ_PRODUCERS];
+    pthread_t consumers[TEST_MQ_CONSUMERS];
+    test_mq_ctx_t ctxs[TEST_MQ_PRODUCERS + TEST_MQ_CONSUMERS];
+
+    for (size_t i = 0; i < TEST_MQ_PRODUCERS + TEST_MQ_CONSUMERS; i++) {
+        ctxs[i].mq = mq;
+        ctxs[i].id = i;
+        ctxs[i].consumed = &consumed;
+        ctxs[i].seen = seen;
+        ctxs[i].duplicate = &duplicate;
+    }
+
+    for (size_t i = 0; i < TEST_MQ_CONSUMERS; i++) {
+        pthread_create(&(consumers[i]), NULL, test_mq_consumer, 
+                &(ctxs[TEST_MQ_PRODUCERS + i]));
+    }
+
+    for (size_t i = 0; i < TEST_MQ_PRODUCERS; i++) {
+        pthread_create(&(producers[i]), NULL, test_mq_producer, &(ctxs[i]));
+    }
+
+    for (size_t i = 0; i < TEST_MQ_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+
+    for (size_t i = 0; i < TEST_MQ_CONSUMERS; i++) {
+        pthread_join(consumers[i], NULL);
+    }
+
+    TEST_ASSERT_FALSE(atomic_load(&duplicate));
+    TEST_ASSERT_EQUAL_size_t(total, atomic_load(&consumed));
+
+    for (size_t i = 0; i < total; i++) {
+        TEST_ASSERT_EQUAL_UINT32(1, atomic_load(&(seen[i])));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(0, mq_len(mq));
+
+    safe_free(seen);
+    delete_mpmc_queue(mq);
+}
+
+void queue_tests(void) {
+    RUN_TEST(test_mq_bounded);
+    RUN_TEST(test_mq_concurrent);
+}
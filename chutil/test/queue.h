@@ -0,0 +1,6 @@
+#ifndef TEST_CHUTIL_QUEUE_H
+#define TEST_CHUTIL_QUEUE_H
+
+void queue_tests(void);
+
+#endif
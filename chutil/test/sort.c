@@ -0,0 +1,281 @@
+
+#include "sort.h"
+#include "chutil/sort.h"
+#include "chutil/list.h"
+#include "chutil/list_helpers.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static int u32_cmp(const uint32_t *n1, const uint32_t *n2) {
+    if (*n1 < *n2) {
+        return -1;
+    }
+
+    return *n1 > *n2 ? 1 : 0;
+}
+
+static uint64_t u32_key(const uint32_t *n) {
+    return *n;
+}
+
+// A record larger than a word, to exercise the generic cell paths.
+typedef struct _test_record_t {
+    uint32_t key;
+    uint32_t seq;
+    uint64_t padding[3];
+} test_record_t;
+
+static int tr_cmp(const test_record_t *r1, const test_record_t *r2) {
+    if (r1->key < r2->key) {
+        return -1;
+    }
+
+    return r1->key > r2->key ? 1 : 0;
+}
+
+static uint64_t tr_key(const test_record_t *r) {
+    return r->key;
+}
+
+static array_list_t *new_random_u32_list(size_t n, uint32_t mod) {
+    array_list_t *al = new_array_list(sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++) {
+        uint32_t val = rand() % mod;
+        al_push(al, &val);
+    }
+
+    return al;
+}
+
+static array_list_t *new_random_record_list(size_t n, uint32_t mod) {
+    array_list_t *al = new_array_list(sizeof(test_record_t));
+    test_record_t rec = {0};
+    for (size_t i = 0; i < n; i++) {
+        rec.key = rand() % mod;
+        rec.seq = i;
+        rec.padding[0] = rec.key;
+        al_push(al, &rec);
+    }
+
+    return al;
+}
+
+static void expect_sorted_u32(array_list_t *al) {
+    for (size_t i = 1; i < al_len(al); i++) {
+        TEST_ASSERT_TRUE(*(uint32_t *)al_get(al, i - 1) <= *(uint32_t *)al_get(al, i));
+    }
+}
+
+// Records must be sorted by key, with equal keys in their original order.
+static void expect_stable_records(array_list_t *al) {
+    for (size_t i = 1; i < al_len(al); i++) {
+        test_record_t *prev = al_get(al, i - 1);
+        test_record_t *curr = al_get(al, i);
+
+        TEST_ASSERT_TRUE(prev->key <= curr->key);
+        if (prev->key == curr->key) {
+            TEST_ASSERT_TRUE(prev->seq < curr->seq);
+        }
+        TEST_ASSERT_EQUAL_UINT64(curr->key, curr->padding[0]);
+    }
+}
+
+static void test_al_sort(void) {
+    const size_t sizes[] = {0, 1, 2, 15, 16, 17, 100, 5000};
+    const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    for (size_t i = 0; i < num_sizes; i++) {
+        array_list_t *al = new_random_u32_list(sizes[i], 1000);
+        al_sort(al, (sort_cmp_ft)u32_cmp);
+        TEST_ASSERT_EQUAL_size_t(sizes[i], al_len(al));
+        expect_sorted_u32(al);
+        delete_array_list(al);
+    }
+
+    // Many duplicates.
+    array_list_t *al = new_random_u32_list(3000, 3);
+    al_sort(al, (sort_cmp_ft)u32_cmp);
+    expect_sorted_u32(al);
+    delete_array_list(al);
+
+    // Already sorted, then reversed.
+    al = new_array_list(sizeof(uint32_t));
+    for (uint32_t i = 0; i < 2000; i++) {
+        al_push(al, &i);
+    }
+    al_sort(al, (sort_cmp_ft)u32_cmp);
+    expect_sorted_u32(al);
+
+    for (size_t i = 0; i < 1000; i++) {
+        uint32_t a, b;
+        al_get_copy(al, i, &a);
+        al_get_copy(al, 1999 - i, &b);
+        al_set(al, i, &b);
+        al_set(al, 1999 - i, &a);
+    }
+    al_sort(al, (sort_cmp_ft)u32_cmp);
+    expect_sorted_u32(al);
+    delete_array_list(al);
+}
+
+static void test_al_sort_records(void) {
+    array_list_t *al = new_random_record_list(1000, 50);
+    al_sort(al, (sort_cmp_ft)tr_cmp);
+
+    for (size_t i = 1; i < al_len(al); i++) {
+        test_record_t *prev = al_get(al, i - 1);
+        test_record_t *curr = al_get(al, i);
+        TEST_ASSERT_TRUE(prev->key <= curr->key);
+        TEST_ASSERT_EQUAL_UINT64(curr->key, curr->padding[0]);
+    }
+
+    delete_array_list(al);
+}
+
+static void test_al_stable_sort(void) {
+    array_list_t *al = new_random_record_list(2500, 40);
+    al_stable_sort(al, (sort_cmp_ft)tr_cmp);
+    expect_stable_records(al);
+    delete_array_list(al);
+
+    al = new_random_u32_list(33, 100);
+    al_stable_sort(al, (sort_cmp_ft)u32_cmp);
+    expect_sorted_u32(al);
+    delete_array_list(al);
+}
+
+static void test_al_radix_sort(void) {
+    array_list_t *al = new_random_u32_list(5000, UINT32_MAX);
+    al_radix_sort(al, (sort_key_ft)u32_key);
+    expect_sorted_u32(al);
+    delete_array_list(al);
+
+    al = new_random_record_list(2000, 300);
+    al_radix_sort(al, (sort_key_ft)tr_key);
+    expect_stable_records(al);
+    delete_array_list(al);
+}
+
+static void test_al_bsearch(void) {
+    array_list_t *al = new_array_list(sizeof(uint32_t));
+
+    // Only even numbers.
+    for (uint32_t i = 0; i < 100; i++) {
+        uint32_t val = i * 2;
+        al_push(al, &val);
+    }
+
+    size_t ind;
+    uint32_t key;
+
+    key = 40;
+    TEST_ASSERT_TRUE(al_bsearch(al, &key, (sort_cmp_ft)u32_cmp, &ind));
+    TEST_ASSERT_EQUAL_size_t(20, ind);
+
+    key = 41;
+    TEST_ASSERT_FALSE(al_bsearch(al, &key, (sort_cmp_ft)u32_cmp, &ind));
+    TEST_ASSERT_EQUAL_size_t(21, ind);
+
+    key = 500;
+    TEST_ASSERT_FALSE(al_bsearch(al, &key, (sort_cmp_ft)u32_cmp, &ind));
+    TEST_ASSERT_EQUAL_size_t(100, ind);
+
+    key = 0;
+    TEST_ASSERT_TRUE(al_bsearch(al, &key, (sort_cmp_ft)u32_cmp, NULL));
+
+    delete_array_list(al);
+}
+
+static void test_al_nth_element(void) {
+    for (size_t n = 0; n < 1000; n += 111) {
+        array_list_t *al = new_random_u32_list(1000, 500);
+        array_list_t *sorted = new_array_list(sizeof(uint32_t));
+        for (size_t i = 0; i < al_len(al); i++) {
+            al_push(sorted, al_get(al, i));
+        }
+        al_sort(sorted, (sort_cmp_ft)u32_cmp);
+
+        al_nth_element(al, n, (sort_cmp_ft)u32_cmp);
+
+        uint32_t nth = *(uint32_t *)al_get(al, n);
+        TEST_ASSERT_EQUAL_UINT32(*(uint32_t *)al_get(sorted, n), nth);
+
+        for (size_t i = 0; i < al_len(al); i++) {
+            uint32_t val = *(uint32_t *)al_get(al, i);
+            if (i < n) {
+                TEST_ASSERT_TRUE(val <= nth);
+            } else if (i > n) {
+                TEST_ASSERT_TRUE(val >= nth);
+            }
+        }
+
+        delete_array_list(sorted);
+        delete_array_list(al);
+    }
+}
+
+static void test_l_sort(const list_impl_t *impl) {
+    list_t *l = new_list(impl, sizeof(uint32_t));
+    for (size_t i = 0; i < 300; i++) {
+        uint32_t val = rand() % 100;
+        l_push(l, &val);
+    }
+
+    l_sort(l, (sort_cmp_ft)u32_cmp);
+    TEST_ASSERT_EQUAL_size_t(300, l_len(l));
+
+    uint32_t prev = 0;
+    uint32_t *val_ptr;
+    l_reset_iterator(l);
+    while ((val_ptr = l_next(l))) {
+        TEST_ASSERT_TRUE(prev <= *val_ptr);
+        prev = *val_ptr;
+    }
+
+    delete_list(l);
+
+    l = new_list(impl, sizeof(test_record_t));
+    test_record_t rec = {0};
+    for (size_t i = 0; i < 300; i++) {
+        rec.key = rand() % 10;
+        rec.seq = i;
+        rec.padding[0] = rec.key;
+        l_push(l, &rec);
+    }
+
+    l_stable_sort(l, (sort_cmp_ft)tr_cmp);
+
+    test_record_t *prev_rec = NULL;
+    test_record_t *rec_ptr;
+    l_reset_iterator(l);
+    while ((rec_ptr = l_next(l))) {
+        if (prev_rec) {
+            TEST_ASSERT_TRUE(prev_rec->key <= rec_ptr->key);
+            if (prev_rec->key == rec_ptr->key) {
+                TEST_ASSERT_TRUE(prev_rec->seq < rec_ptr->seq);
+            }
+        }
+        prev_rec = rec_ptr;
+    }
+
+    delete_list(l);
+}
+
+static void test_l_sort_impls(void) {
+    test_l_sort(ARRAY_LIST_IMPL);
+    test_l_sort(LINKED_LIST_IMPL);
+}
+
+void sort_tests(void) {
+    RUN_TEST(test_al_sort);
+    RUN_TEST(test_al_sort_records);
+    RUN_TEST(test_al_stable_sort);
+    RUN_TEST(test_al_radix_sort);
+    RUN_TEST(test_al_bsearch);
+    RUN_TEST(test_al_nth_element);
+    RUN_TEST(test_l_sort_impls);
+}
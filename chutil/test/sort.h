@@ -0,0 +1,6 @@
+#ifndef TEST_CHUTIL_SORT_H
+#define TEST_CHUTIL_SORT_H
+
+void sort_tests(void);
+
+#endif
@@ -0,0 +1,222 @@
+
+#include "swiss_map.h"
+#include "chutil/swiss_map.h"
+#include "chutil/map.h"
+
+#include "unity/unity.h"
+#include "unity/unity_internals.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static bool u64_eq_f(const uint64_t *k1, const uint64_t *k2) {
+    return *k1 == *k2;
+}
+
+static uint64_t u64_hash_f(const uint64_t *k) {
+    return (((((*k) + 42934191239) * 3) + 12312388491) * 5);
+}
+
+// Every key lands in the same place, only the tags can tell them apart.
+static uint64_t u64_bad_hash_f(const uint64_t *k) {
+    (void)k;
+    return 7;
+}
+
+static swiss_map_t *new_u64_swiss_map(hash_map_hash_ft hf) {
+    return new_swiss_map(sizeof(uint64_t), sizeof(uint64_t),
+            hf, (hash_map_key_eq_ft)u64_eq_f);
+}
+
+static void test_sm_put_and_get(void) {
+    swiss_map_t *sm = new_u64_swiss_map((hash_map_hash_ft)u64_hash_f);
+
+    const uint64_t NUM_KEYS = 1000;
+    uint64_t key, val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key * 5;
+        sm_put(sm, &key, &val);
+        TEST_ASSERT_EQUAL_size_t(key + 1, sm_num_keys(sm));
+    }
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_TRUE(sm_get_copy(sm, &key, &val));
+        TEST_ASSERT_EQUAL_UINT64(key * 5, val);
+    }
+
+    key = NUM_KEYS;
+    TEST_ASSERT_NULL(sm_get(sm, &key));
+
+    // Updates don't add keys.
+    key = 3;
+    val = 100;
+    sm_put(sm, &key, &val);
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, sm_num_keys(sm));
+    TEST_ASSERT_EQUAL_UINT64(100, *(uint64_t *)sm_get(sm, &key));
+
+    delete_swiss_map(sm);
+}
+
+static void test_sm_put_and_remove(void) {
+    swiss_map_t *sm = new_u64_swiss_map((hash_map_hash_ft)u64_hash_f);
+
+    const uint64_t NUM_KEYS = 500;
+    uint64_t key, val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key * key;
+        sm_put(sm, &key, &val);
+    }
+
+    for (key = 0; key < NUM_KEYS; key += 2) {
+        TEST_ASSERT_TRUE(sm_remove(sm, &key));
+        TEST_ASSERT_FALSE(sm_remove(sm, &key));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS / 2, sm_num_keys(sm));
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        TEST_ASSERT_EQUAL(key % 2 == 1, sm_contains(sm, &key));
+    }
+
+    delete_swiss_map(sm);
+}
+
+static void test_sm_bad_hash(void) {
+    swiss_map_t *sm = new_u64_swiss_map((hash_map_hash_ft)u64_bad_hash_f);
+
+    const uint64_t NUM_KEYS = 100;
+    uint64_t key, val;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        val = key + 1;
+        sm_put(sm, &key, &val);
+    }
+
+    for (key = 0; key < NUM_KEYS; key += 3) {
+        TEST_ASSERT_TRUE(sm_remove(sm, &key));
+    }
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        uint64_t *v = sm_get(sm, &key);
+        if (key % 3 == 0) {
+            TEST_ASSERT_NULL(v);
+        } else {
+            TEST_ASSERT_NOT_NULL(v);
+            TEST_ASSERT_EQUAL_UINT64(key + 1, *v);
+        }
+    }
+
+    delete_swiss_map(sm);
+}
+
+// Lots of churn, checked against the chained map.
+static void test_sm_against_hash_map(void) {
+    swiss_map_t *sm = new_u64_swiss_map((hash_map_hash_ft)u64_hash_f);
+    hash_map_t *hm = new_hash_map(sizeof(uint64_t), sizeof(uint64_t),
+            (hash_map_hash_ft)u64_hash_f, (hash_map_key_eq_ft)u64_eq_f);
+
+    srand(35);
+
+    for (size_t i = 0; i < 20000; i++) {
+        uint64_t key = rand() % 700;
+        uint64_t val = rand();
+
+        if (rand() % 3 == 0) {
+            TEST_ASSERT_EQUAL(hm_remove(hm, &key), sm_remove(sm, &key));
+        } else {
+            hm_put(hm, &key, &val);
+            sm_put(sm, &key, &val);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_size_t(hm_num_keys(hm), sm_num_keys(sm));
+
+    key_val_pair_t kvp;
+    hm_iter_t iter;
+
+    hm_iter_begin(hm, &iter);
+    while ((kvp = hm_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        uint64_t *v = sm_get(sm, kvp_key(hm, kvp));
+        TEST_ASSERT_NOT_NULL(v);
+        TEST_ASSERT_EQUAL_UINT64(*(uint64_t *)kvp_val(hm, kvp), *v);
+    }
+
+    delete_hash_map(hm);
+    delete_swiss_map(sm);
+}
+
+static void test_sm_iterator(void) {
+    swiss_map_t *sm = new_u64_swiss_map((hash_map_hash_ft)u64_hash_f);
+
+    sm_iter_t iter;
+    sm_iter_begin(sm, &iter);
+    TEST_ASSERT_TRUE(sm_iter_next(&iter) == HASH_MAP_EXHAUSTED);
+
+    const uint64_t NUM_KEYS = 200;
+    uint64_t key;
+
+    for (key = 0; key < NUM_KEYS; key++) {
+        sm_put(sm, &key, &key);
+    }
+
+    bool seen[200] = {0};
+    size_t count = 0;
+
+    key_val_pair_t kvp;
+    sm_iter_begin(sm, &iter);
+    while ((kvp = sm_iter_next(&iter)) != HASH_MAP_EXHAUSTED) {
+        uint64_t k = *(const uint64_t *)sm_kvp_key(sm, kvp);
+        TEST_ASSERT_EQUAL_UINT64(k, *(uint64_t *)sm_kvp_val(sm, kvp));
+        TEST_ASSERT_FALSE(seen[k]);
+
+        seen[k] = true;
+        count++;
+    }
+
+    TEST_ASSERT_EQUAL_size_t(NUM_KEYS, count);
+
+    delete_swiss_map(sm);
+}
+
+static void test_sm_equals(void) {
+    swiss_map_t *sm1 = new_u64_swiss_map((hash_map_hash_ft)u64_hash_f);
+    swiss_map_t *sm2 = new_u64_swiss_map((hash_map_hash_ft)u64_hash_f);
+
+    uint64_t key, val;
+
+    for (key = 0; key < 100; key++) {
+        val = key * 3;
+        sm_put(sm1, &key, &val);
+    }
+
+    for (key = 0; key < 100; key++) {
+        uint64_t rk = 99 - key;
+        val = rk * 3;
+        sm_put(sm2, &rk, &val);
+    }
+
+    TEST_ASSERT_TRUE(sm_equals(sm1, sm2, (hash_map_val_eq_ft)u64_eq_f));
+
+    key = 5;
+    val = 0;
+    sm_put(sm1, &key, &val);
+    TEST_ASSERT_FALSE(sm_equals(sm1, sm2, (hash_map_val_eq_ft)u64_eq_f));
+
+    sm_remove(sm1, &key);
+    sm_remove(sm2, &key);
+    TEST_ASSERT_TRUE(sm_equals(sm1, sm2, (hash_map_val_eq_ft)u64_eq_f));
+
+    delete_swiss_map(sm1);
+    delete_swiss_map(sm2);
+}
+
+void swiss_map_tests(void) {
+    RUN_TEST(test_sm_put_and_get);
+    RUN_TEST(test_sm_put_and_remove);
+    RUN_TEST(test_sm_bad_hash);
+    RUN_TEST(test_sm_against_hash_map);
+    RUN_TEST(test_sm_iterator);
+    RUN_TEST(test_sm_equals);
+}
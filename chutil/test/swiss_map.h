@@ -0,0 +1,7 @@
+
+#ifndef TEST_CHUTIL_SWISS_MAP_H
+#define TEST_CHUTIL_SWISS_MAP_H
+
+void swiss_map_tests(void);
+
+#endif